@@ -22,6 +22,399 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 void CL_FinishTimeDemo (void);
 
+cvar_t	cl_timedemocsv = {"cl_timedemocsv", "0"};	// write <demo>.csv with every frame time
+
+typedef struct
+{
+	float	total;
+	float	phase[TD_PHASES];
+} tdframe_t;
+
+static tdframe_t	*td_frames;
+static int			td_numframes;
+static int			td_maxframes;
+static tdframe_t	td_current;
+static double		td_lastframetime;
+static char			td_name[MAX_QPATH];
+
+static char *td_phasenames[TD_PHASES] = {"parse", "relink", "render", "sound"};
+
+cvar_t	cl_demokeyframe = {"cl_demokeyframe", "10"};	// seconds between seek keyframes, 0 records plain demos
+
+/*
+Recorded demos carry a keyframe every cl_demokeyframe seconds of the first
+level: an ordinary demo message rebuilding the lightstyles, stats and entity
+baselines the client holds at that point. After the final message comes an
+index of the keyframes, which playback uses to seek:
+
+	int		DEMO_INDEXMARK
+	int		numkeys
+	numkeys * demokey_t
+	int		file offset of DEMO_INDEXMARK
+	int		DEMO_INDEXMAGIC
+
+Demos without the trailer play back sequentially as before.
+*/
+#define	DEMO_INDEXMARK		-1
+#define	DEMO_INDEXMAGIC		(('1'<<24)+('X'<<16)+('I'<<8)+'D')
+
+typedef struct
+{
+	float	time;		// cl.mtime[0] the keyframe restores
+	int		offset;		// file offset of the keyframe message
+} demokey_t;
+
+static demokey_t	*demo_keys;
+static int			demo_numkeys;
+static int			demo_maxkeys;
+static int			demo_filepos;			// bytes written or read so far
+static double		demo_keytime;			// recording: cl.mtime[0] of the next keyframe
+static qboolean		demo_keydone;			// recording: left the first level
+static int			demo_nextkey;			// playback: next keyframe offset to skip
+static qboolean		demo_parsekey;			// playback: seeked to demo_nextkey, parse it
+static float		demo_seektime = -1;		// playback: seek once the signon completes
+static float		demo_endtime = -1;		// timedemo: stop at this demo time
+
+/*
+==============================================================================
+
+DEMO FILE IO
+
+All demo file io goes through CL_DemoWrite and CL_DemoRead, which keep
+demo_filepos so the keyframe index knows where every message starts.
+
+Where sys.h defines SYS_THREADS, recording copies messages into a ring
+buffer that a background thread writes out in large batches, so slow
+storage doesn't stall the frame. Only the Linux build does so far; the
+PSP, 3DS and Vita ports have no Sys_ thread API yet. Elsewhere a batch
+would stall a single frame for all of it, so each message is written as
+it comes. Playback reads the file a block at a time.
+==============================================================================
+*/
+
+#define	DEMO_READBLOCK		65536
+
+cvar_t	cl_demobuffer = {"cl_demobuffer", "256"};	// kilobytes of recording held in memory
+
+typedef struct
+{
+	byte		*ring;
+	int			size;
+	int			batch;			// flush once this much is buffered
+	int			head;			// bytes copied in, ring offset is head % size
+	int			tail;			// bytes written to the file
+	int			file;
+	qboolean	quit;
+#ifdef SYS_THREADS
+	sys_thread_t	*thread;
+	sys_mutex_t		*lock;		// head, tail, quit and the counters
+	sys_cond_t		*wake;		// data to write, or space to copy into
+#endif
+
+	int			peak;			// most bytes buffered at once
+	int			flushes;
+	double		flushtime;
+	double		flushmax;
+	int			stalls;			// times recording waited for space
+	double		stalltime;
+	int			errors;
+} demowriter_t;
+
+typedef struct
+{
+	byte		*buf;
+	int			start;			// file offset of buf[0]
+	int			len;
+	int			filepos;		// where the next Sys_FileRead reads, -1 after a seek
+
+	int			blocks;
+	int			bytes;
+	double		readtime;
+} demoreader_t;
+
+static demowriter_t	demo_w;
+static demoreader_t	demo_r;
+
+/*
+====================
+CL_DemoFlushed
+
+Retires a written range, with the lock held where there is one
+====================
+*/
+static void CL_DemoFlushed (int len, double time)
+{
+	demo_w.tail += len;
+	demo_w.flushes++;
+	demo_w.flushtime += time;
+	if (time > demo_w.flushmax)
+		demo_w.flushmax = time;
+}
+
+#ifdef SYS_THREADS
+/*
+====================
+CL_DemoWriteRange
+
+Writes len bytes of the ring starting at byte count start and returns how
+long that took. Called without the lock.
+====================
+*/
+static double CL_DemoWriteRange (int start, int len)
+{
+	int		ofs, n;
+	double	time;
+
+	time = Sys_FloatTime ();
+
+	while (len)
+	{
+		ofs = start % demo_w.size;
+		n = demo_w.size - ofs;
+		if (n > len)
+			n = len;
+		if (Sys_FileWrite (demo_w.file, demo_w.ring + ofs, n) != n)
+			demo_w.errors++;		// only read once the writer is done
+		start += n;
+		len -= n;
+	}
+
+	return Sys_FloatTime () - time;
+}
+
+static void *CL_DemoWriterThread (void *arg)
+{
+	int		start, len;
+	double	time;
+
+	Sys_LockMutex (demo_w.lock);
+	while (1)
+	{
+		while (!demo_w.quit && demo_w.head - demo_w.tail < demo_w.batch)
+			Sys_WaitCond (demo_w.wake, demo_w.lock);
+
+		start = demo_w.tail;
+		len = demo_w.head - demo_w.tail;
+		if (!len)
+			break;		// quit with nothing left
+
+		// the main thread only copies past head, so the range is ours
+		Sys_UnlockMutex (demo_w.lock);
+		time = CL_DemoWriteRange (start, len);
+		Sys_LockMutex (demo_w.lock);
+
+		CL_DemoFlushed (len, time);
+		Sys_SignalCond (demo_w.wake);
+	}
+	Sys_UnlockMutex (demo_w.lock);
+
+	return NULL;
+}
+#endif
+
+static void CL_DemoOpenWrite (int file)
+{
+#ifdef SYS_THREADS
+	int		size;
+#endif
+
+	memset (&demo_w, 0, sizeof(demo_w));
+	demo_w.file = file;
+
+#ifdef SYS_THREADS
+	size = (int)cl_demobuffer.value * 1024;
+	if (size < MAX_MSGLEN * 2)
+		size = MAX_MSGLEN * 2;
+
+	demo_w.ring = Q_malloc (size);
+	demo_w.size = size;
+	demo_w.batch = size / 4;
+
+	demo_w.lock = Sys_CreateMutex ();
+	demo_w.wake = Sys_CreateCond ();
+	demo_w.thread = Sys_CreateThread (CL_DemoWriterThread, NULL);
+#endif
+
+	demo_filepos = 0;
+}
+
+static void CL_DemoCloseWrite (void)
+{
+#ifdef SYS_THREADS
+	Sys_LockMutex (demo_w.lock);
+	demo_w.quit = true;
+	Sys_SignalCond (demo_w.wake);
+	Sys_UnlockMutex (demo_w.lock);
+
+	Sys_WaitThread (demo_w.thread);
+	Sys_DestroyCond (demo_w.wake);
+	Sys_DestroyMutex (demo_w.lock);
+
+	free (demo_w.ring);
+	demo_w.ring = NULL;
+#endif
+
+	if (demo_w.errors)
+		Con_Printf ("WARNING: %i demo writes failed\n", demo_w.errors);
+}
+
+static void CL_DemoWrite (void *data, int len)
+{
+#ifdef SYS_THREADS
+	byte	*src;
+	int		ofs, n;
+	double	time;
+
+	demo_filepos += len;
+
+	Sys_LockMutex (demo_w.lock);
+	if (demo_w.head - demo_w.tail + len > demo_w.size)
+	{
+		time = Sys_FloatTime ();
+		demo_w.stalls++;
+		while (demo_w.head - demo_w.tail + len > demo_w.size)
+		{
+			Sys_SignalCond (demo_w.wake);
+			Sys_WaitCond (demo_w.wake, demo_w.lock);
+		}
+		demo_w.stalltime += Sys_FloatTime () - time;
+	}
+	Sys_UnlockMutex (demo_w.lock);
+
+	for (src = data ; len ; src += n, len -= n)
+	{
+		ofs = (demo_w.head + (src - (byte *)data)) % demo_w.size;
+		n = demo_w.size - ofs;
+		if (n > len)
+			n = len;
+		memcpy (demo_w.ring + ofs, src, n);
+	}
+	n = src - (byte *)data;
+
+	Sys_LockMutex (demo_w.lock);
+	demo_w.head += n;
+	if (demo_w.head - demo_w.tail > demo_w.peak)
+		demo_w.peak = demo_w.head - demo_w.tail;
+	if (demo_w.head - demo_w.tail >= demo_w.batch)
+		Sys_SignalCond (demo_w.wake);
+	Sys_UnlockMutex (demo_w.lock);
+#else
+	double	time;
+
+	demo_filepos += len;
+
+	time = Sys_FloatTime ();
+	if (Sys_FileWrite (demo_w.file, data, len) != len)
+		demo_w.errors++;
+	demo_w.head += len;
+	CL_DemoFlushed (len, Sys_FloatTime () - time);
+#endif
+}
+
+static void CL_DemoOpenRead (void)
+{
+	memset (&demo_r, 0, sizeof(demo_r));
+	demo_r.buf = Q_malloc (DEMO_READBLOCK);
+	demo_r.filepos = -1;
+
+	demo_filepos = 0;
+}
+
+static void CL_DemoCloseRead (void)
+{
+	free (demo_r.buf);
+	demo_r.buf = NULL;
+}
+
+/*
+====================
+CL_DemoSetPos
+
+Seeks are free inside the current block, anything else is read from the
+new position when it is needed
+====================
+*/
+static void CL_DemoSetPos (int pos)
+{
+	demo_filepos = pos;
+}
+
+static int CL_DemoRead (void *data, int len)
+{
+	byte	*dest;
+	int		ofs, n;
+	double	time;
+
+	for (dest = data ; len ; dest += n, len -= n)
+	{
+		ofs = demo_filepos - demo_r.start;
+		if (ofs < 0 || ofs >= demo_r.len)
+		{
+			time = Sys_FloatTime ();
+			if (demo_r.filepos != demo_filepos)
+				Sys_FileSeek (cls.demofile, demo_filepos);
+			demo_r.start = demo_filepos;
+			demo_r.len = Sys_FileRead (cls.demofile, demo_r.buf, DEMO_READBLOCK);
+			if (demo_r.len <= 0)
+			{
+				demo_r.len = 0;
+				demo_r.filepos = -1;
+				break;
+			}
+			demo_r.filepos = demo_r.start + demo_r.len;
+			demo_r.blocks++;
+			demo_r.bytes += demo_r.len;
+			demo_r.readtime += Sys_FloatTime () - time;
+			ofs = 0;
+		}
+
+		n = demo_r.len - ofs;
+		if (n > len)
+			n = len;
+		memcpy (dest, demo_r.buf + ofs, n);
+		demo_filepos += n;
+	}
+
+	return dest - (byte *)data;
+}
+
+/*
+====================
+CL_DemoStats_f
+
+Prints the demo io counters
+====================
+*/
+void CL_DemoStats_f (void)
+{
+	int		buffered;
+
+	if (cls.demorecording || demo_w.flushes)
+	{
+#ifdef SYS_THREADS
+		if (cls.demorecording)
+			Sys_LockMutex (demo_w.lock);
+#endif
+		buffered = demo_w.head - demo_w.tail;
+		if (demo_w.size)
+			Con_Printf ("record: %i KB buffered, %i KB peak of %i KB\n", buffered / 1024, demo_w.peak / 1024, demo_w.size / 1024);
+		else
+			Con_Printf ("record: unbuffered\n");
+		Con_Printf ("  %i KB in %i flushes, %.2f ms avg %.2f ms max\n", demo_w.tail / 1024, demo_w.flushes,
+			demo_w.flushes ? demo_w.flushtime * 1000.0 / demo_w.flushes : 0, demo_w.flushmax * 1000.0);
+		Con_Printf ("  %i stalls, %.2f ms waiting for space\n", demo_w.stalls, demo_w.stalltime * 1000.0);
+#ifdef SYS_THREADS
+		if (cls.demorecording)
+			Sys_UnlockMutex (demo_w.lock);
+#endif
+	}
+
+	if (cls.demoplayback || demo_r.blocks)
+	{
+		Con_Printf ("playback: %i KB in %i blocks, %.2f ms reading\n", demo_r.bytes / 1024, demo_r.blocks, demo_r.readtime * 1000.0);
+	}
+}
+
 /*
 ==============================================================================
 
@@ -47,6 +440,7 @@ void CL_StopPlayback (void)
 	if (!cls.demoplayback)
 		return;
 
+	CL_DemoCloseRead ();
 	Sys_FileClose(cls.demofile);
 	cls.demoplayback = false;
 	cls.demofile = -1;
@@ -54,29 +448,263 @@ void CL_StopPlayback (void)
 
 	if (cls.timedemo)
 		CL_FinishTimeDemo ();
+
+	free (demo_keys);
+	demo_keys = NULL;
+	demo_numkeys = demo_maxkeys = 0;
+	demo_seektime = demo_endtime = -1;
 }
 
 /*
 ====================
-CL_WriteDemoMessage
+CL_WriteDemoBuffer
 
-Dumps the current net message, prefixed by the length and view angles
+Dumps a message, prefixed by the length and view angles
 ====================
 */
-void CL_WriteDemoMessage (void)
+static void CL_WriteDemoBuffer (sizebuf_t *msg)
 {
 	int		len;
 	int		i;
 	float	f;
 
-	len = LittleLong (net_message.cursize);
-	Sys_FileWrite(cls.demofile, &len, 4);
+	len = LittleLong (msg->cursize);
+	CL_DemoWrite (&len, 4);
 	for (i=0 ; i<3 ; i++)
 	{
 		f = LittleFloat (cl.viewangles[i]);
-		Sys_FileWrite(cls.demofile, &f, 4);
+		CL_DemoWrite (&f, 4);
+	}
+	CL_DemoWrite (msg->data, msg->cursize);
+}
+
+/*
+====================
+CL_WriteDemoKeyframe
+
+Writes the state a seek has to restore as regular server messages, so the
+parser needs nothing special to load it. Everything else is resent by the
+server every frame.
+====================
+*/
+static void CL_WriteDemoKeyframe (void)
+{
+	static byte				buf[MAX_MSGLEN];
+	static entity_state_t	nullstate;
+	sizebuf_t	msg;
+	entity_t	*ent;
+	int			i, j;
+
+	memset (&msg, 0, sizeof(msg));
+	msg.data = buf;
+	msg.maxsize = sizeof(buf);
+	msg.allowoverflow = true;
+
+	for (i=0 ; i<MAX_LIGHTSTYLES ; i++)
+	{
+		MSG_WriteByte (&msg, svc_lightstyle);
+		MSG_WriteByte (&msg, i);
+		MSG_WriteString (&msg, cl_lightstyle[i].map);
+	}
+
+	for (i=0 ; i<MAX_CL_STATS ; i++)
+	{
+		MSG_WriteByte (&msg, svc_updatestat);
+		MSG_WriteByte (&msg, i);
+		MSG_WriteLong (&msg, cl.stats[i]);
+	}
+
+	for (i=1, ent=cl_entities+1 ; i<cl.num_entities ; i++, ent++)
+	{
+		if (!memcmp (&ent->baseline, &nullstate, sizeof(nullstate)))
+			continue;
+
+		MSG_WriteByte (&msg, svc_spawnbaseline);
+		MSG_WriteShort (&msg, i);
+		MSG_WriteShort (&msg, ent->baseline.modelindex);
+		MSG_WriteByte (&msg, ent->baseline.frame);
+		MSG_WriteByte (&msg, ent->baseline.colormap);
+		MSG_WriteByte (&msg, ent->baseline.skin);
+		for (j=0 ; j<3 ; j++)
+		{
+			MSG_WriteCoord (&msg, ent->baseline.origin[j]);
+			// MSG_WriteAngle truncates before scaling, which would not
+			// give back the byte the baseline was parsed from
+			MSG_WriteByte (&msg, (int)floor(ent->baseline.angles[j] * 256.0 / 360.0 + 0.5) & 255);
+		}
+	}
+
+	if (msg.overflowed)
+	{
+		Con_DPrintf ("CL_WriteDemoKeyframe: overflow\n");
+		return;
+	}
+
+	if (demo_numkeys == demo_maxkeys)
+	{
+		demo_maxkeys = demo_maxkeys ? demo_maxkeys * 2 : 64;
+		demo_keys = Q_realloc (demo_keys, demo_maxkeys * sizeof(demokey_t));
+	}
+	demo_keys[demo_numkeys].time = cl.mtime[0];
+	demo_keys[demo_numkeys].offset = demo_filepos;
+	demo_numkeys++;
+
+	CL_WriteDemoBuffer (&msg);
+}
+
+/*
+====================
+CL_WriteDemoIndex
+
+Appends the keyframe index after the last message
+====================
+*/
+static void CL_WriteDemoIndex (void)
+{
+	int		i, v[2];
+	float	f;
+
+	if (!demo_numkeys)
+		return;
+
+	v[0] = LittleLong (DEMO_INDEXMARK);
+	v[1] = LittleLong (demo_numkeys);
+	CL_DemoWrite (v, 8);
+
+	for (i=0 ; i<demo_numkeys ; i++)
+	{
+		f = LittleFloat (demo_keys[i].time);
+		v[0] = LittleLong (demo_keys[i].offset);
+		CL_DemoWrite (&f, 4);
+		CL_DemoWrite (v, 4);
+	}
+
+	v[0] = LittleLong (demo_filepos - 8 - demo_numkeys * (int)sizeof(demokey_t));
+	v[1] = LittleLong (DEMO_INDEXMAGIC);
+	CL_DemoWrite (v, 8);
+}
+
+/*
+====================
+CL_ReadDemoIndex
+
+Loads the keyframe index from the end of the demo, if it has one, and
+returns to the first message
+====================
+*/
+static void CL_ReadDemoIndex (int length)
+{
+	int		start, ofs, num, i;
+	int		v[2];
+
+	start = demo_filepos;
+
+	if (length < start + 16)
+		return;
+
+	Sys_FileSeek (cls.demofile, length - 8);
+	if (Sys_FileRead (cls.demofile, v, 8) != 8 || LittleLong (v[1]) != DEMO_INDEXMAGIC)
+		goto done;
+
+	ofs = LittleLong (v[0]);
+	if (ofs < start || ofs > length - 16)
+		goto done;
+
+	Sys_FileSeek (cls.demofile, ofs);
+	if (Sys_FileRead (cls.demofile, v, 8) != 8 || LittleLong (v[0]) != DEMO_INDEXMARK)
+		goto done;
+
+	num = LittleLong (v[1]);
+	if (num <= 0 || num > (length - ofs - 16) / (int)sizeof(demokey_t))
+		goto done;
+
+	demo_keys = Q_malloc (num * sizeof(demokey_t));
+	if (Sys_FileRead (cls.demofile, demo_keys, num * sizeof(demokey_t)) != num * (int)sizeof(demokey_t))
+	{
+		free (demo_keys);
+		demo_keys = NULL;
+		goto done;
+	}
+
+	for (i=0 ; i<num ; i++)
+	{
+		demo_keys[i].time = LittleFloat (demo_keys[i].time);
+		demo_keys[i].offset = LittleLong (demo_keys[i].offset);
+	}
+	demo_numkeys = demo_maxkeys = num;
+
+	Con_DPrintf ("%i demo keyframes, %.1f to %.1f seconds\n", num, demo_keys[0].time, demo_keys[num-1].time);
+
+done:
+	// reads past here go through the block reader, which seeks back itself
+	demo_r.filepos = -1;
+}
+
+/*
+====================
+CL_DemoSeek
+
+Jumps to the last keyframe at or before time. Outside of a timedemo the
+client clock is set to time as well, so the next frame reads every message
+up to it.
+====================
+*/
+static void CL_DemoSeek (float time)
+{
+	int		i;
+
+	for (i=demo_numkeys-1 ; i>0 ; i--)
+		if (demo_keys[i].time <= time)
+			break;
+
+	CL_DemoSetPos (demo_keys[i].offset);
+	demo_nextkey = i;
+	demo_parsekey = true;
+
+	cl.mtime[0] = cl.mtime[1] = demo_keys[i].time;
+	if (cls.timedemo || time < cl.mtime[0])
+		time = cl.mtime[0];
+	cl.time = cl.oldtime = time;
+
+	memset (cl_dlights, 0, sizeof(cl_dlights));
+	memset (cl_beams, 0, sizeof(cl_beams));
+
+	Con_Printf ("Seeked to %.1f seconds\n", demo_keys[i].time);
+
+	if (cls.timedemo)
+	{
+	// time the segment from here on
+		cls.td_startframe = host_framecount;
+		cls.td_lastframe = -1;
+		td_numframes = 0;
+		td_lastframetime = 0;
+		memset (&td_current, 0, sizeof(td_current));
 	}
-	Sys_FileWrite(cls.demofile, net_message.data, net_message.cursize);
+}
+
+/*
+====================
+CL_WriteDemoMessage
+
+Dumps the current net message, preceded by a keyframe when one is due
+====================
+*/
+void CL_WriteDemoMessage (void)
+{
+	if (cls.signon < SIGNONS)
+	{
+	// the index only covers the first level, a later one reuses times
+		if (demo_numkeys)
+			demo_keydone = true;
+	}
+	else if (!demo_keydone && cl_demokeyframe.value > 0 && cl.mtime[0] >= demo_keytime)
+	{
+		// written before the message, the client has not parsed it yet
+		CL_WriteDemoKeyframe ();
+		demo_keytime = cl.mtime[0] + cl_demokeyframe.value;
+	}
+
+	CL_WriteDemoBuffer (&net_message);
 }
 
 /*
@@ -93,6 +721,24 @@ int CL_GetMessage (void)
 	
 	if	(cls.demoplayback)
 	{
+		if (cls.signon == SIGNONS)
+		{
+			if (demo_seektime >= 0)
+			{
+				if (demo_numkeys)
+					CL_DemoSeek (demo_seektime);
+				else
+					Con_Printf ("Demo has no keyframe index, can not seek\n");
+				demo_seektime = -1;
+			}
+
+			if (cls.timedemo && demo_endtime >= 0 && cl.mtime[0] >= demo_endtime)
+			{
+				CL_StopPlayback ();
+				return 0;
+			}
+		}
+
 	// decide if it is time to grab the next message		
 		if (cls.signon == SIGNONS)	// allways grab until fully connected
 		{
@@ -112,19 +758,36 @@ int CL_GetMessage (void)
 			}
 		}
 		
+	// keyframes repeat what the client already has, unless just seeked to
+		while (demo_nextkey < demo_numkeys && demo_keys[demo_nextkey].offset < demo_filepos)
+			demo_nextkey++;
+		if (demo_nextkey < demo_numkeys && demo_keys[demo_nextkey].offset == demo_filepos)
+		{
+			if (demo_parsekey)
+				demo_parsekey = false;
+			else if (CL_DemoRead (&i, 4) == 4)
+				CL_DemoSetPos (demo_filepos + 12 + LittleLong (i));
+			demo_nextkey++;
+		}
+
 	// get the next message
-		Sys_FileRead(cls.demofile, &net_message.cursize, 4);
+		CL_DemoRead (&net_message.cursize, 4);
 		VectorCopy (cl.mviewangles[0], cl.mviewangles[1]);
 		for (i=0 ; i<3 ; i++)
 		{
-			r = Sys_FileRead(cls.demofile, &f, 4) / 4;
+			r = CL_DemoRead (&f, 4) / 4;
 			cl.mviewangles[0][i] = LittleFloat (f);
 		}
 		
 		net_message.cursize = LittleLong (net_message.cursize);
-		if (net_message.cursize > MAX_MSGLEN)
+		if (net_message.cursize == DEMO_INDEXMARK)
+		{
+			CL_StopPlayback ();
+			return 0;
+		}
+		if (net_message.cursize < 0 || net_message.cursize > MAX_MSGLEN)
 			Sys_Error ("Demo message (0x%08x) > MAX_MSGLEN (%d)", net_message.cursize, MAX_MSGLEN);
-		r = Sys_FileRead(cls.demofile, net_message.data, net_message.cursize) / net_message.cursize;
+		r = CL_DemoRead (net_message.data, net_message.cursize) / net_message.cursize;
 		if (r != 1)
 		{
 			CL_StopPlayback ();
@@ -177,8 +840,13 @@ void CL_Stop_f (void)
 	SZ_Clear (&net_message);
 	MSG_WriteByte (&net_message, svc_disconnect);
 	CL_WriteDemoMessage ();
+	CL_WriteDemoIndex ();
 
 // finish up
+	free (demo_keys);
+	demo_keys = NULL;
+	demo_numkeys = demo_maxkeys = 0;
+	CL_DemoCloseWrite ();
 	Sys_FileClose(cls.demofile);
 	cls.demofile = -1;
 	cls.demorecording = false;
@@ -255,24 +923,24 @@ void CL_Record_f (void)
 
 	cls.forcetrack = track;
 	sprintf(forcetrack, "%i\n", cls.forcetrack);
-	Sys_FileWrite(cls.demofile, forcetrack, strlen(forcetrack));
+	CL_DemoOpenWrite (cls.demofile);
+	CL_DemoWrite (forcetrack, strlen(forcetrack));
+
+	free (demo_keys);
+	demo_keys = NULL;
+	demo_numkeys = demo_maxkeys = 0;
+	demo_keytime = 0;
+	demo_keydone = false;
 	
 	cls.demorecording = true;
 }
 
 
-/*
-====================
-CL_PlayDemo_f
-
-play [demoname]
-====================
-*/
-static int CL_FileGetChar(int handle)
+static int CL_FileGetChar(void)
 {
 	char c;
 
-	if (Sys_FileRead(handle, &c, 1) != 1)
+	if (CL_DemoRead(&c, 1) != 1)
 	{
 		return EOF;
 	}
@@ -280,21 +948,20 @@ static int CL_FileGetChar(int handle)
 	return c;
 }
 
-void CL_PlayDemo_f (void)
+/*
+====================
+CL_OpenDemo
+
+Starts playback, seeking to start seconds once the signon completes
+====================
+*/
+static void CL_OpenDemo (char *demoname, float start)
 {
 	char	name[256];
 	int c;
+	int length;
 	qboolean neg = false;
 
-	if (cmd_source != src_command)
-		return;
-
-	if (Cmd_Argc() != 2)
-	{
-		Con_Printf ("play <demoname> : plays a demo\n");
-		return;
-	}
-
 //
 // disconnect from server
 //
@@ -303,11 +970,11 @@ void CL_PlayDemo_f (void)
 //
 // open the demo file
 //
-	strcpy (name, Cmd_Argv(1));
+	Q_strncpyz (name, demoname, sizeof(name) - 4);
 	COM_DefaultExtension (name, ".dem");
 
 	Con_Printf ("Playing demo from %s.\n", name);
-	Sys_FileOpenRead(name, &cls.demofile);
+	length = Sys_FileOpenRead(name, &cls.demofile);
 	if (cls.demofile < 0)
 	{
 		Con_Printf ("ERROR: couldn't open demo for reading.\n");
@@ -318,8 +985,9 @@ void CL_PlayDemo_f (void)
 	cls.demoplayback = true;
 	cls.state = ca_connected;
 	cls.forcetrack = 0;
+	CL_DemoOpenRead ();
 
-	while ((c = CL_FileGetChar(cls.demofile)) != '\n')
+	while ((c = CL_FileGetChar()) != '\n')
 		if (c == '-')
 			neg = true;
 		else
@@ -329,6 +997,210 @@ void CL_PlayDemo_f (void)
 		cls.forcetrack = -cls.forcetrack;
 // ZOID, fscanf is evil
 //	fscanf (cls.demofile, "%i\n", &cls.forcetrack);
+
+	demo_nextkey = 0;
+	demo_parsekey = false;
+	CL_ReadDemoIndex (length);
+
+	demo_seektime = start;
+}
+
+/*
+====================
+CL_PlayDemo_f
+
+playdemo <demoname> [start seconds]
+====================
+*/
+void CL_PlayDemo_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2 && Cmd_Argc() != 3)
+	{
+		Con_Printf ("playdemo <demoname> [start seconds] : plays a demo\n");
+		return;
+	}
+
+	CL_OpenDemo (Cmd_Argv(1), Cmd_Argc() == 3 ? Q_atof (Cmd_Argv(2)) : -1);
+}
+
+/*
+====================
+CL_DemoSeek_f
+
+demoseek <seconds>
+====================
+*/
+void CL_DemoSeek_f (void)
+{
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc() != 2)
+	{
+		Con_Printf ("demoseek <seconds> : jumps to a time in the playing demo\n");
+		return;
+	}
+
+	if (!cls.demoplayback)
+	{
+		Con_Printf ("Not playing a demo.\n");
+		return;
+	}
+
+	demo_seektime = Q_atof (Cmd_Argv(1));
+}
+
+/*
+====================
+CL_TimeDemoPhase
+
+Adds time spent in one part of the client to the current timedemo frame
+====================
+*/
+void CL_TimeDemoPhase (int phase, double time)
+{
+	td_current.phase[phase] += time;
+}
+
+/*
+====================
+CL_TimeDemoFrame
+
+Called at the end of every host frame while timing a demo. Frames before
+the signon completes are loading, not playback, so they are skipped.
+====================
+*/
+void CL_TimeDemoFrame (void)
+{
+	double	now;
+
+	now = Sys_FloatTime ();
+
+	if (cls.signon == SIGNONS && td_lastframetime)
+	{
+		if (td_numframes == td_maxframes)
+		{
+			td_maxframes = td_maxframes ? td_maxframes * 2 : 4096;
+			td_frames = Q_realloc (td_frames, td_maxframes * sizeof(tdframe_t));
+		}
+
+		td_current.total = now - td_lastframetime;
+		td_frames[td_numframes++] = td_current;
+	}
+
+	td_lastframetime = cls.signon == SIGNONS ? now : 0;
+	memset (&td_current, 0, sizeof(td_current));
+}
+
+static int CL_TimeDemoCompare (const void *a, const void *b)
+{
+	float	fa = *(const float *)a;
+	float	fb = *(const float *)b;
+
+	return (fa > fb) - (fa < fb);
+}
+
+/*
+====================
+CL_TimeDemoWriteCSV
+====================
+*/
+static void CL_TimeDemoWriteCSV (void)
+{
+	char	name[MAX_OSPATH], base[MAX_QPATH];
+	char	*line;
+	int		i, j, handle;
+
+	// COM_FileBase needs an extension to strip
+	COM_DefaultExtension (td_name, ".dem");
+	COM_FileBase (td_name, base);
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+	snprintf (name, sizeof(name), "%s/%s.csv", com_gamedir, base);
+#pragma GCC diagnostic pop
+
+	handle = Sys_FileOpenWrite (name);
+	if (handle < 0)
+	{
+		Con_Printf ("ERROR: couldn't open %s for writing.\n", name);
+		return;
+	}
+
+	line = "frame,total_ms";
+	Sys_FileWrite (handle, line, strlen (line));
+	for (j=0 ; j<TD_PHASES ; j++)
+	{
+		line = va(",%s_ms", td_phasenames[j]);
+		Sys_FileWrite (handle, line, strlen (line));
+	}
+	Sys_FileWrite (handle, "\n", 1);
+
+	for (i=0 ; i<td_numframes ; i++)
+	{
+		line = va("%i,%.4f", i, td_frames[i].total * 1000.0);
+		Sys_FileWrite (handle, line, strlen (line));
+		for (j=0 ; j<TD_PHASES ; j++)
+		{
+			line = va(",%.4f", td_frames[i].phase[j] * 1000.0);
+			Sys_FileWrite (handle, line, strlen (line));
+		}
+		Sys_FileWrite (handle, "\n", 1);
+	}
+
+	Sys_FileClose (handle);
+	Con_Printf ("frame times written to %s\n", name);
+}
+
+/*
+====================
+CL_TimeDemoStats
+
+Percentiles use the nearest rank. The worst 1% is the average of the
+slowest hundredth of the frames, which is what a horde spike feels like.
+====================
+*/
+static void CL_TimeDemoStats (void)
+{
+	float	*sorted;
+	double	worstsum, phases[TD_PHASES];
+	int		i, j, worst, last;
+
+	if (!td_numframes)
+		return;
+
+	sorted = Q_malloc (td_numframes * sizeof(float));
+	memset (phases, 0, sizeof(phases));
+	for (i=0 ; i<td_numframes ; i++)
+	{
+		sorted[i] = td_frames[i].total * 1000.0f;
+		for (j=0 ; j<TD_PHASES ; j++)
+			phases[j] += td_frames[i].phase[j] * 1000.0;
+	}
+	qsort (sorted, td_numframes, sizeof(float), CL_TimeDemoCompare);
+
+	last = td_numframes - 1;
+	Con_Printf ("frame ms: min %.3f p50 %.3f p95 %.3f p99 %.3f max %.3f\n",
+		sorted[0], sorted[last * 50 / 100], sorted[last * 95 / 100], sorted[last * 99 / 100], sorted[last]);
+
+	worst = (td_numframes + 99) / 100;
+	worstsum = 0;
+	for (i=td_numframes - worst ; i<td_numframes ; i++)
+		worstsum += sorted[i];
+	Con_Printf ("worst 1%%: %.3f ms (%.1f fps)\n", worstsum / worst,
+		worstsum > 0 ? 1000.0 * worst / worstsum : 0);
+
+	Con_Printf ("ms/frame:");
+	for (j=0 ; j<TD_PHASES ; j++)
+		Con_Printf (" %s %.3f", td_phasenames[j], phases[j] / td_numframes);
+	Con_Printf ("\n");
+
+	free (sorted);
+
+	if (cl_timedemocsv.value)
+		CL_TimeDemoWriteCSV ();
 }
 
 /*
@@ -350,27 +1222,47 @@ void CL_FinishTimeDemo (void)
 	if (time < 1)
 		time = 1;
 	Con_Printf ("%i frames %5.1f seconds %5.1f fps\n", frames, time, frames/time);
+
+	CL_TimeDemoStats ();
+
+	free (td_frames);
+	td_frames = NULL;
+	td_numframes = td_maxframes = 0;
 }
 
 /*
 ====================
 CL_TimeDemo_f
 
-timedemo [demoname]
+timedemo <demoname> [start seconds] [end seconds]
+
+A segment starts at the keyframe before its start time, so separate
+processes can each time one part of a long demo
 ====================
 */
 void CL_TimeDemo_f (void)
 {
+	float	start, end;
+
 	if (cmd_source != src_command)
 		return;
 
-	if (Cmd_Argc() != 2)
+	if (Cmd_Argc() < 2 || Cmd_Argc() > 4)
 	{
-		Con_Printf ("timedemo <demoname> : gets demo speeds\n");
+		Con_Printf ("timedemo <demoname> [start seconds] [end seconds] : gets demo speeds\n");
 		return;
 	}
 
-	CL_PlayDemo_f ();
+	// playing the demo retokenizes
+	Q_strncpyz (td_name, Cmd_Argv (1), sizeof(td_name));
+	start = Cmd_Argc() >= 3 ? Q_atof (Cmd_Argv(2)) : -1;
+	end = Cmd_Argc() == 4 ? Q_atof (Cmd_Argv(3)) : -1;
+
+	CL_OpenDemo (td_name, start);
+	if (!cls.demoplayback)
+		return;
+
+	demo_endtime = end;
 	
 // cls.td_starttime will be grabbed at the second frame of the demo, so
 // all the loading time doesn't get counted
@@ -378,5 +1270,9 @@ void CL_TimeDemo_f (void)
 	cls.timedemo = true;
 	cls.td_startframe = host_framecount;
 	cls.td_lastframe = -1;		// get a new message this frame
+
+	td_numframes = 0;
+	td_lastframetime = 0;
+	memset (&td_current, 0, sizeof(td_current));
 }
 
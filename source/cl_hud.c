@@ -1682,6 +1682,11 @@ HUD_Weapon
 void HUD_Weapon (void)
 {
 	char str[32];
+
+	// the name only lives in the local server's edict, not in demos
+	if (!sv.active)
+		return;
+
 	x_value = vid.width;
 	y_value = vid.height - (40 * hud_scale_factor);
 
@@ -318,7 +318,7 @@ void CL_AdjustAngles (void)
 	// ==== Aim Assist + ====
 	// cut look speed in half when facing enemy, unless
 	// mag is empty
-	if ((in_aimassist.value) && (sv_player->v.facingenemy == 1) && cl.stats[STAT_CURRENTMAG] > 0) {
+	if ((in_aimassist.value) && sv.active && (sv_player->v.facingenemy == 1) && cl.stats[STAT_CURRENTMAG] > 0) {
 		speed *= 0.5f;
 	}
 	// additionally, slice look speed when ADS/scopes
@@ -392,7 +392,8 @@ void CL_BaseMove (usercmd_t *cmd)
 	Q_memset (cmd, 0, sizeof(*cmd));
 
 	// cypress - we handle movespeed in QC now.
-	cl_backspeed = cl_forwardspeed = cl_sidespeed = sv_player->v.maxspeed;
+	// a remote server has no local edict to read, it clamps the move itself
+	cl_backspeed = cl_forwardspeed = cl_sidespeed = sv.active ? sv_player->v.maxspeed : 320;
 
 	// Throttle side and back speeds
 	cl_sidespeed *= 0.8f;
@@ -584,6 +585,7 @@ extern cvar_t cl_crossx, cl_crossy;
 void CL_SendMove (usercmd_t *cmd)
 {
 	long int		bits;
+	int			seq;
 	sizebuf_t	buf;
 	byte	data[128];
 	vec3_t tempv;
@@ -728,6 +730,14 @@ void CL_SendMove (usercmd_t *cmd)
 	if (++cl.movemessages <= 2)
 		return;
 
+// number the move, so the server can say which one it ran last
+	seq = CL_PredictSaveMove (cmd, tempv);
+	if (seq)
+	{
+		MSG_WriteByte (&buf, clc_moveseq);
+		MSG_WriteLong (&buf, seq);
+	}
+
 	if (NET_SendUnreliableMessage (cls.netcon, &buf) == -1)
 	{
 		Con_Printf ("CL_SendMove: lost server connection\n");
@@ -32,6 +32,9 @@ cvar_t	cl_name = {"_cl_name", "player", true};
 cvar_t  cl_truelightning = {"cl_truelightning", "1", true};
 cvar_t	cl_shownet = {"cl_shownet","0"};	// can be 0, 1, or 2
 cvar_t	cl_nolerp = {"cl_nolerp","0"};
+cvar_t	cl_interp = {"cl_interp","1"};					// entities lerp through a history of updates
+cvar_t	cl_interpjitter = {"cl_interpjitter","2"};		// delay covers this many times the measured jitter
+cvar_t	cl_extrapolate = {"cl_extrapolate","0.05"};	// seconds an entity may run past its last update
 cvar_t	cl_lightning_zadjust = {"cl_lightning_zadjust", "0", true};
 
 cvar_t	lookspring = {"lookspring","0", true};
@@ -77,6 +80,7 @@ int				cl_numstaticbrushmodels;
 entity_t		*cl_staticbrushmodels[MAX_VISEDICTS];
 
 void CL_ClearTEnts (void);
+static void CL_InterpClear (void);
 
 /*
 =====================
@@ -104,6 +108,8 @@ void CL_ClearState (void)
 	memset (cl_beams, 0, sizeof(cl_beams));
 
     memset (cl_static_entities, 0, sizeof(cl_static_entities));
+	CL_InterpClear ();
+	CL_PredictClear ();
 //
 // allocate the efrags and chain together into a free list
 //
@@ -167,6 +173,8 @@ CL_EstablishConnection
 Host should be either "local" or a net address to be passed on
 =====================
 */
+static double	cl_connecttime;		// for timing the signon
+
 void CL_EstablishConnection (char *host)
 {
 	if (cls.state == ca_dedicated)
@@ -180,6 +188,7 @@ void CL_EstablishConnection (char *host)
 	cls.netcon = NET_Connect (host);
 	if (!cls.netcon)
 		Host_Error ("CL_Connect: connect failed\n");
+	cl_connecttime = Sys_FloatTime ();
 	//Con_DPrintf ("CL_EstablishConnection: connected to %s\n", host);
 	Con_Printf ("CL_EstablishConnection: connected to %s\n", host);
 
@@ -227,6 +236,8 @@ void CL_SignonReply (void)
 
 		case 4:
 		{
+			if (!cls.demoplayback)
+				Con_DPrintf ("Signon completed in %.3f seconds\n", Sys_FloatTime () - cl_connecttime);
 			SCR_EndLoadingPlaque ();		// allow normal screen updates
 			break;
 		}
@@ -422,6 +433,335 @@ void CL_DecayLights (void)
 }
 
 
+/*
+===============================================================================
+
+INTERPOLATION
+
+Every entity keeps its last few updates, stamped with the server time of
+the message they came in. Entities are drawn at a render time that trails
+the server by the tick interval plus a margin for the jitter measured on
+the arriving messages, so a late packet eats into the margin instead of
+freezing zombies on their last update. Past the newest update an entity
+is extrapolated for at most cl_extrapolate seconds and then held.
+
+The view entity keeps the two-message lerp, it would only add lag.
+===============================================================================
+*/
+
+#define	CL_LERPSAMPLES		8		// power of two
+#define	CL_MAXINTERPDELAY	0.5
+#define	CL_JITTERBUCKETS	8
+
+typedef struct
+{
+	double	time;
+	vec3_t	origin;
+	vec3_t	angles;
+} lerpsample_t;
+
+typedef struct
+{
+	int				head;		// next slot to fill
+	int				count;
+	lerpsample_t	samples[CL_LERPSAMPLES];
+} lerphistory_t;
+
+static lerphistory_t	*cl_lerphistory;	// MAX_EDICTS of them, once a remote game needs them
+
+static struct
+{
+	double	time;			// render time, in server time
+	double	lastarrival;	// realtime the newest svc_time came in
+	double	lastmtime;
+	float	interval;		// running average of the server's message interval
+	float	jitter;			// running average of arrival time errors
+	float	delay;
+
+	int		histogram[CL_JITTERBUCKETS];
+	int		messages;
+	int		frames;
+	int		extrapolated;	// frames an entity ran past its last update
+	int		clamped;		// ...further than cl_extrapolate
+	int		underruns;		// frames an entity had nothing older than the render time
+} cl_interpstate;
+
+static float cl_jitterbuckets[CL_JITTERBUCKETS - 1] = {0.001, 0.002, 0.005, 0.01, 0.02, 0.05, 0.1};
+
+static qboolean CL_InterpActive (void)
+{
+	return cl_interp.value && !cl_nolerp.value && !cls.timedemo && !sv.active;
+}
+
+/*
+===============
+CL_InterpClear
+===============
+*/
+static void CL_InterpClear (void)
+{
+	int		i;
+
+	if (cl_lerphistory)
+		memset (cl_lerphistory, 0, MAX_EDICTS * sizeof(lerphistory_t));
+
+	cl_interpstate.time = 0;
+	cl_interpstate.lastarrival = 0;
+	cl_interpstate.lastmtime = 0;
+	cl_interpstate.interval = 0.1;
+	cl_interpstate.jitter = 0;
+	cl_interpstate.delay = 0.1;
+	cl_interpstate.messages = cl_interpstate.frames = 0;
+	cl_interpstate.extrapolated = cl_interpstate.clamped = cl_interpstate.underruns = 0;
+	for (i=0 ; i<CL_JITTERBUCKETS ; i++)
+		cl_interpstate.histogram[i] = 0;
+}
+
+/*
+===============
+CL_InterpServerTime
+
+Called for every svc_time, after cl.mtime has been shifted. The time
+between two messages arriving is compared with the server time between
+them, and the difference is the jitter.
+===============
+*/
+void CL_InterpServerTime (void)
+{
+	float	dserver, error;
+	int		i;
+
+	if (cl_interpstate.lastarrival && cl.mtime[0] > cl_interpstate.lastmtime)
+	{
+		dserver = cl.mtime[0] - cl_interpstate.lastmtime;
+		error = fabs ((realtime - cl_interpstate.lastarrival) - dserver);
+
+		// a pause or level change is not jitter
+		if (dserver < 1 && error < 1)
+		{
+			cl_interpstate.interval += (dserver - cl_interpstate.interval) * 0.0625;
+			// late packets raise the delay quickly, it comes back down slowly
+			if (error > cl_interpstate.jitter)
+				cl_interpstate.jitter += (error - cl_interpstate.jitter) * 0.25;
+			else
+				cl_interpstate.jitter += (error - cl_interpstate.jitter) * 0.015625;
+
+			for (i=0 ; i<CL_JITTERBUCKETS - 1 ; i++)
+				if (error < cl_jitterbuckets[i])
+					break;
+			cl_interpstate.histogram[i]++;
+			cl_interpstate.messages++;
+		}
+	}
+
+	if (cl.mtime[0] > cl_interpstate.lastmtime)
+	{
+		cl_interpstate.lastarrival = realtime;
+		cl_interpstate.lastmtime = cl.mtime[0];
+	}
+}
+
+/*
+===============
+CL_InterpSample
+
+Called with every entity update. reset throws the history away, when the
+entity was not in the previous message.
+===============
+*/
+void CL_InterpSample (entity_t *ent, qboolean reset)
+{
+	lerphistory_t	*h;
+	lerpsample_t	*s;
+	int				num;
+
+	if (!CL_InterpActive ())
+		return;
+
+	if (!cl_lerphistory)
+		cl_lerphistory = Q_calloc (MAX_EDICTS, sizeof(lerphistory_t));
+
+	num = ent - cl_entities;
+	if (num < 0 || num >= MAX_EDICTS)
+		return;
+	h = &cl_lerphistory[num];
+
+	if (reset)
+		h->count = 0;
+
+	// a second update in the same message replaces the first
+	if (h->count)
+	{
+		s = &h->samples[(h->head - 1) & (CL_LERPSAMPLES - 1)];
+		if (cl.mtime[0] < s->time)
+			h->count = 0;
+		else if (cl.mtime[0] == s->time)
+		{
+			h->head = (h->head - 1) & (CL_LERPSAMPLES - 1);
+			h->count--;
+		}
+	}
+
+	s = &h->samples[h->head];
+	s->time = cl.mtime[0];
+	VectorCopy (ent->msg_origins[0], s->origin);
+	VectorCopy (ent->msg_angles[0], s->angles);
+
+	h->head = (h->head + 1) & (CL_LERPSAMPLES - 1);
+	if (h->count < CL_LERPSAMPLES)
+		h->count++;
+}
+
+/*
+===============
+CL_InterpTime
+
+Advances the render time once a frame. It runs at frame rate and is
+pulled gently toward where it should be, the estimated server time less
+the delay, so arrival jitter does not show up as speed changes.
+===============
+*/
+static void CL_InterpTime (void)
+{
+	double	target, error;
+	float	delay;
+
+	delay = cl_interpstate.interval + cl_interpjitter.value * cl_interpstate.jitter;
+	if (delay > CL_MAXINTERPDELAY)
+		delay = CL_MAXINTERPDELAY;
+	cl_interpstate.delay += (delay - cl_interpstate.delay) * MIN(1, host_frametime);
+
+	target = cl_interpstate.lastmtime + (realtime - cl_interpstate.lastarrival) - cl_interpstate.delay;
+	error = target - cl_interpstate.time;
+
+	if (!cl_interpstate.time || error > 0.25 || error < -0.25)
+		cl_interpstate.time = target;
+	else
+		cl_interpstate.time += host_frametime + error * MIN(1, host_frametime * 4);
+
+	cl_interpstate.frames++;
+}
+
+/*
+===============
+CL_InterpEntity
+
+Puts ent where its history says it was at the render time. Returns true
+when it moved too far between two updates to be anything but a teleport.
+===============
+*/
+static qboolean CL_InterpEntity (entity_t *ent, lerphistory_t *h)
+{
+	lerpsample_t	*from, *to;
+	double			t;
+	float			f, d;
+	int				i, j;
+
+	t = cl_interpstate.time;
+	to = &h->samples[(h->head - 1) & (CL_LERPSAMPLES - 1)];
+
+	if (t >= to->time)
+	{
+		VectorCopy (to->origin, ent->origin);
+		VectorCopy (to->angles, ent->angles);
+		if (h->count < 2 || t == to->time)
+			return false;
+
+		cl_interpstate.extrapolated++;
+		if (t - to->time > cl_extrapolate.value)
+		{
+			cl_interpstate.clamped++;
+			t = to->time + MAX(cl_extrapolate.value, 0);
+		}
+
+		from = &h->samples[(h->head - 2) & (CL_LERPSAMPLES - 1)];
+		f = (t - to->time) / (to->time - from->time);
+		for (j=0 ; j<3 ; j++)
+		{
+			d = to->origin[j] - from->origin[j];
+			if (d > 100 || d < -100)
+				return true;
+			ent->origin[j] += f * d;
+		}
+		return false;
+	}
+
+	// walk back to the update before the render time
+	for (i=2 ; i<=h->count ; i++)
+	{
+		from = &h->samples[(h->head - i) & (CL_LERPSAMPLES - 1)];
+		if (from->time <= t)
+			break;
+		to = from;
+	}
+	if (i > h->count)
+	{	// a new entity waits at its first update, only a full history is short
+		if (h->count == CL_LERPSAMPLES)
+			cl_interpstate.underruns++;
+		VectorCopy (to->origin, ent->origin);
+		VectorCopy (to->angles, ent->angles);
+		return false;
+	}
+
+	f = (t - from->time) / (to->time - from->time);
+	for (j=0 ; j<3 ; j++)
+	{
+		d = to->origin[j] - from->origin[j];
+		if (d > 100 || d < -100)//blubs check here for interpolating zombies
+		{
+			VectorCopy (to->origin, ent->origin);
+			VectorCopy (to->angles, ent->angles);
+			return true;		// assume a teleportation, not a motion
+		}
+	}
+
+	for (j=0 ; j<3 ; j++)
+	{
+		ent->origin[j] = from->origin[j] + f * (to->origin[j] - from->origin[j]);
+
+		d = to->angles[j] - from->angles[j];
+		if (d > 180)
+			d -= 360;
+		else if (d < -180)
+			d += 360;
+		ent->angles[j] = from->angles[j] + f * d;
+	}
+
+	return false;
+}
+
+/*
+===============
+CL_InterpStats_f
+===============
+*/
+static void CL_InterpStats_f (void)
+{
+	int		i, peak;
+
+	Con_Printf ("delay %.1f ms: interval %.1f ms + %g x jitter %.1f ms\n",
+		cl_interpstate.delay * 1000, cl_interpstate.interval * 1000,
+		cl_interpjitter.value, cl_interpstate.jitter * 1000);
+	Con_Printf ("%i frames, entities: %i extrapolated, %i past cl_extrapolate, %i underruns\n",
+		cl_interpstate.frames, cl_interpstate.extrapolated,
+		cl_interpstate.clamped, cl_interpstate.underruns);
+
+	peak = 1;
+	for (i=0 ; i<CL_JITTERBUCKETS ; i++)
+		peak = MAX(peak, cl_interpstate.histogram[i]);
+
+	Con_Printf ("jitter over %i messages:\n", cl_interpstate.messages);
+	for (i=0 ; i<CL_JITTERBUCKETS ; i++)
+	{
+		if (i < CL_JITTERBUCKETS - 1)
+			Con_Printf ("  < %3g ms %6i ", cl_jitterbuckets[i] * 1000, cl_interpstate.histogram[i]);
+		else
+			Con_Printf (" >= %3g ms %6i ", cl_jitterbuckets[i - 1] * 1000, cl_interpstate.histogram[i]);
+		Con_Printf ("%s\n", va("%.*s", cl_interpstate.histogram[i] * 30 / peak,
+			"##############################"));
+	}
+}
+
 /*
 ===============
 CL_LerpPoint
@@ -542,11 +882,16 @@ void CL_RelinkEntities (void)
 	vec3_t		oldorg;
     //model_t		*model;
 	dlight_t	*dl;
+	qboolean	interp;
     //vec3_t		smokeorg, smokeorg2;
 	//float		scale;
 // determine partial update time
 	frac = CL_LerpPoint ();
 
+	interp = CL_InterpActive () && cl_lerphistory;
+	if (interp)
+		CL_InterpTime ();
+
 	CL_UpdatePowerUpAngles();
 
 	cl_numvisedicts = 0;
@@ -615,6 +960,18 @@ void CL_RelinkEntities (void)
 			VectorCopy (ent->msg_origins[0], ent->origin);
 			VectorCopy (ent->msg_angles[0], ent->angles);
 		}
+		else if (i == cl.viewentity && CL_PredictMove (ent->origin))
+		{
+			VectorCopy (ent->msg_angles[0], ent->angles);
+		}
+		else if (interp && i != cl.viewentity && cl_lerphistory[i].count)
+		{
+			if (CL_InterpEntity (ent, &cl_lerphistory[i]))
+			{
+				ent->translate_start_time = 0;
+				ent->rotate_start_time    = 0;
+			}
+		}
 		else
 		{	// if the delta is large, assume a teleport and don't lerp
 			f = frac;
@@ -675,9 +1032,14 @@ void CL_RelinkEntities (void)
 				smokeorg[2] += cl.viewheight; // account for beta maps
 				VectorCopy(smokeorg,start);
 
-				right_offset	 = sv_player->v.Flash_Offset[0];
-				up_offset		 = sv_player->v.Flash_Offset[1];
-				forward_offset 	 = sv_player->v.Flash_Offset[2];
+				if (sv.active)
+				{
+					right_offset	 = sv_player->v.Flash_Offset[0];
+					up_offset		 = sv_player->v.Flash_Offset[1];
+					forward_offset 	 = sv_player->v.Flash_Offset[2];
+				}
+				else
+					right_offset = up_offset = forward_offset = 0;
 				 
 				right_offset	= right_offset/1000;
 				up_offset		= up_offset/1000;
@@ -900,10 +1262,14 @@ Read all incoming data from the server
 int CL_ReadFromServer (void)
 {
 	int		ret;
+	double	time1 = 0, time2 = 0;
 
 	cl.oldtime = cl.time;
 	cl.time += host_frametime;
 
+	if (cls.timedemo)
+		time1 = Sys_FloatTime ();
+
 	do
 	{
 		ret = CL_GetMessage ();
@@ -930,9 +1296,18 @@ int CL_ReadFromServer (void)
 	if (cl_shownet.value)
 		Con_Printf ("\n");
 
+	if (cls.timedemo)
+	{
+		time2 = Sys_FloatTime ();
+		CL_TimeDemoPhase (TD_PARSE, time2 - time1);
+	}
+
 	CL_RelinkEntities ();
 	CL_UpdateTEnts ();
 
+	if (cls.timedemo)
+		CL_TimeDemoPhase (TD_RELINK, Sys_FloatTime () - time2);
+
 //
 // bring the links up to date
 //
@@ -951,6 +1326,14 @@ void CL_SendCmd (void)
 	if (cls.state != ca_connected)
 		return;
 
+	// demos carry their own moves, and the move code reads the local
+	// server's player which doesn't exist during playback
+	if (cls.demoplayback)
+	{
+		SZ_Clear (&cls.message);
+		return;
+	}
+
 	if (cls.signon == SIGNONS)
 	{
 	// get basic movement from keyboard
@@ -965,12 +1348,6 @@ void CL_SendCmd (void)
 
 	}
 
-	if (cls.demoplayback)
-	{
-		SZ_Clear (&cls.message);
-		return;
-	}
-
 // send the reliable message
 	if (!cls.message.cursize)
 		return;		// no message at all
@@ -994,6 +1371,10 @@ CL_Init
 */
 void CL_Init (void)
 {
+	extern	cvar_t	cl_timedemocsv;
+	extern	cvar_t	cl_demokeyframe;
+	extern	cvar_t	cl_demobuffer;
+
 	SZ_Alloc (&cls.message, 1024);
 
 	SList_Init ();
@@ -1001,6 +1382,7 @@ void CL_Init (void)
 
 	CL_InitInput ();
 	CL_InitTEnts ();
+	CL_InitPrediction ();
 //
 // register our commands
 //
@@ -1014,6 +1396,12 @@ void CL_Init (void)
 	Cvar_RegisterVariable (&cl_anglespeedkey);
 	Cvar_RegisterVariable (&cl_shownet);
 	Cvar_RegisterVariable (&cl_nolerp);
+	Cvar_RegisterVariable (&cl_interp);
+	Cvar_RegisterVariable (&cl_interpjitter);
+	Cvar_RegisterVariable (&cl_extrapolate);
+	Cvar_RegisterVariable (&cl_timedemocsv);
+	Cvar_RegisterVariable (&cl_demokeyframe);
+	Cvar_RegisterVariable (&cl_demobuffer);
 	Cvar_RegisterVariable (&lookspring);
 	Cvar_RegisterVariable (&lookstrafe);
 	Cvar_RegisterVariable (&cl_rocket2grenade);
@@ -1051,5 +1439,8 @@ void CL_Init (void)
 	Cmd_AddCommand ("stop", CL_Stop_f);
 	Cmd_AddCommand ("playdemo", CL_PlayDemo_f);
 	Cmd_AddCommand ("timedemo", CL_TimeDemo_f);
+	Cmd_AddCommand ("demoseek", CL_DemoSeek_f);
+	Cmd_AddCommand ("demostats", CL_DemoStats_f);
+	Cmd_AddCommand ("interpstats", CL_InterpStats_f);
 }
 
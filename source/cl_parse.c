@@ -235,7 +235,8 @@ void CL_KeepaliveMessage (void)
 		}
 	} while (ret);
 
-	net_message = old;
+	// reading may have swapped the buffer under net_message, see net_loop.c
+	net_message.cursize = old.cursize;
 #ifdef PSP_VFPU
 	memcpy_vfpu(net_message.data, olddata, net_message.cursize);
 #else
@@ -308,8 +309,10 @@ void CL_ParseServerInfo (void)
 	}
 	cl.scores = Hunk_AllocName (cl.maxclients*sizeof(*cl.scores), "scores");
 
-// parse gametype
-	cl.gametype = MSG_ReadByte ();
+// parse gametype, and whether the server acks numbered moves
+	i = MSG_ReadByte ();
+	cl.gametype = i & ~GAME_MOVEACK;
+	cl.moveacks = (i & GAME_MOVEACK) != 0;
 
 // parse signon message
 	str = MSG_ReadString ();
@@ -463,35 +466,134 @@ void CL_ParseServerInfo (void)
 }
 
 
+// the fields of an entity update, however they arrived
+typedef struct
+{
+	int		modelindex;
+	int		frame;
+	int		colormap;
+	int		skin;
+	int		effects;
+	vec3_t	origin;
+	vec3_t	angles;
+	float	renderamt;
+	float	rendermode;
+	vec3_t	rendercolor;
+	int		scale;
+	qboolean	nolerp;
+} entityupdate_t;
+
 /*
 ==================
-CL_ParseUpdate
+CL_FirstUpdate
+==================
+*/
+static void CL_FirstUpdate (void)
+{
+	if (cls.signon == SIGNONS - 1)
+	{	// first update is the final signon stage
+		Con_DPrintf("First Update\n");
+		cls.signon = SIGNONS;
+		CL_SignonReply (); //disabling this temp-mortem
+	}
+}
+
+/*
+==================
+CL_UpdateEntity
 
-Parse an entity update message from the server
 If an entities model or origin changes from frame to frame, it must be
 relinked.  Other attributes can change without relinking.
 ==================
 */
+static void CL_UpdateEntity (entity_t *ent, entityupdate_t *u)
+{
+	model_t		*model;
+	qboolean	forcelink;
+
+	if (ent->msgtime != cl.mtime[1])
+		forcelink = true;	// no previous frame to lerp from
+	else
+		forcelink = false;
+
+	ent->msgtime = cl.mtime[0];
+
+	model = cl.model_precache[u->modelindex];
+	if (model != ent->model)
+	{
+		ent->model = model;
+	// automatic animation (torches, etc) can be either all together
+	// or randomized
+		if (model)
+		{
+			if (model->synctype == ST_RAND)
+				ent->syncbase = (float)(rand()&0x7fff) / 0x7fff;
+			else
+				ent->syncbase = 0.0;
+		}
+		else
+			forcelink = true;	// hack to make null model players work
+	}
+
+	ent->frame = u->frame;
+
+	if (!u->colormap)
+		ent->colormap = vid.colormap;
+	else
+	{
+		if (u->colormap > cl.maxclients)
+			Sys_Error ("i >= cl.maxclients");
+	}
+
+	ent->skinnum = u->skin;
+	ent->effects = u->effects;
+
+// shift the known values for interpolation
+	VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
+	VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
+	VectorCopy (u->origin, ent->msg_origins[0]);
+	VectorCopy (u->angles, ent->msg_angles[0]);
+
+// Tomaz - QC Alpha Scale Glow Begin
+	ent->renderamt = u->renderamt;
+	ent->rendermode = u->rendermode;
+	VectorCopy (u->rendercolor, ent->rendercolor);
+// Tomaz - QC Alpha Scale Glow End
+
+	ent->scale = u->scale;
+
+	if (u->nolerp)
+		ent->forcelink = true;
+
+	if ( forcelink )
+	{	// didn't have an update last message
+		VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
+		VectorCopy (ent->msg_origins[0], ent->origin);
+		VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
+		VectorCopy (ent->msg_angles[0], ent->angles);
+		ent->forcelink = true;
+	}
+
+	CL_InterpSample (ent, forcelink || u->nolerp);
+}
+
+/*
+==================
+CL_ParseUpdate
+
+Parse an entity update message from the server
+==================
+*/
 int	bitcounts[16];
 
 void CL_ParseUpdate (int bits)
 {
 	int			i;
-	model_t		*model;
-	int			modnum;
-	qboolean	forcelink;
 	entity_t	*ent;
 	int			num;
-    //int		    skin;
-
-	if (cls.signon == SIGNONS - 1)
-	{	// first update is the final signon stage
-		Con_DPrintf("First Update\n");
-		cls.signon = SIGNONS;
-		CL_SignonReply (); //disabling this temp-mortem
-	}
-	//Con_Printf("2\n");
+	entityupdate_t	u;
 
+	CL_FirstUpdate ();
 
 	if (bits & U_MOREBITS)
 	{
@@ -522,137 +624,134 @@ void CL_ParseUpdate (int bits)
 		if (bits&(1<<i))
 			bitcounts[i]++;
 
-	if (ent->msgtime != cl.mtime[1])
-		forcelink = true;	// no previous frame to lerp from
-	else
-		forcelink = false;
-
-	ent->msgtime = cl.mtime[0];
-
 	if (bits & U_MODEL)
 	{
-		modnum = MSG_ReadShort ();
-		if (modnum >= MAX_MODELS)
+		u.modelindex = MSG_ReadShort ();
+		if (u.modelindex >= MAX_MODELS)
 			Host_Error ("CL_ParseModel: bad modnum");
 	}
 	else
-		modnum = ent->baseline.modelindex;
-
-	model = cl.model_precache[modnum];
-	if (model != ent->model)
-	{
-		ent->model = model;
-	// automatic animation (torches, etc) can be either all together
-	// or randomized
-		if (model)
-		{
-			if (model->synctype == ST_RAND)
-				ent->syncbase = (float)(rand()&0x7fff) / 0x7fff;
-			else
-				ent->syncbase = 0.0;
-		}
-		else
-			forcelink = true;	// hack to make null model players work
-	}
+		u.modelindex = ent->baseline.modelindex;
 
 	if (bits & U_FRAME)
-		ent->frame = MSG_ReadByte ();
+		u.frame = MSG_ReadByte ();
 	else
-		ent->frame = ent->baseline.frame;
+		u.frame = ent->baseline.frame;
 
 	if (bits & U_COLORMAP)
-		i = MSG_ReadByte();
+		u.colormap = MSG_ReadByte();
 	else
-		i = ent->baseline.colormap;
-	if (!i)
-		ent->colormap = vid.colormap;
-	else
-	{
-		if (i > cl.maxclients)
-			Sys_Error ("i >= cl.maxclients");
-	}
+		u.colormap = ent->baseline.colormap;
 
 	if (bits & U_SKIN)
-		ent->skinnum = MSG_ReadByte();
+		u.skin = MSG_ReadByte();
 	else
-		ent->skinnum = ent->baseline.skin;
+		u.skin = ent->baseline.skin;
 
 	if (bits & U_EFFECTS)
-		ent->effects = MSG_ReadShort();
+		u.effects = MSG_ReadShort();
 	else
-		ent->effects = ent->baseline.effects;
+		u.effects = ent->baseline.effects;
 
-// shift the known values for interpolation
-	VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
-	VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
 	if (bits & U_ORIGIN1)
-		ent->msg_origins[0][0] = MSG_ReadCoord ();
+		u.origin[0] = MSG_ReadCoord ();
 	else
-		ent->msg_origins[0][0] = ent->baseline.origin[0];
+		u.origin[0] = ent->baseline.origin[0];
 	if (bits & U_ANGLE1)
-		ent->msg_angles[0][0] = MSG_ReadAngle();
+		u.angles[0] = MSG_ReadAngle();
 	else
-		ent->msg_angles[0][0] = ent->baseline.angles[0];
+		u.angles[0] = ent->baseline.angles[0];
 
 	if (bits & U_ORIGIN2)
-		ent->msg_origins[0][1] = MSG_ReadCoord ();
+		u.origin[1] = MSG_ReadCoord ();
 	else
-		ent->msg_origins[0][1] = ent->baseline.origin[1];
+		u.origin[1] = ent->baseline.origin[1];
 	if (bits & U_ANGLE2)
-		ent->msg_angles[0][1] = MSG_ReadAngle();
+		u.angles[1] = MSG_ReadAngle();
 	else
-		ent->msg_angles[0][1] = ent->baseline.angles[1];
+		u.angles[1] = ent->baseline.angles[1];
 
 	if (bits & U_ORIGIN3)
-		ent->msg_origins[0][2] = MSG_ReadCoord ();
+		u.origin[2] = MSG_ReadCoord ();
 	else
-		ent->msg_origins[0][2] = ent->baseline.origin[2];
+		u.origin[2] = ent->baseline.origin[2];
 	if (bits & U_ANGLE3)
-		ent->msg_angles[0][2] = MSG_ReadAngle();
+		u.angles[2] = MSG_ReadAngle();
 	else
-		ent->msg_angles[0][2] = ent->baseline.angles[2];
+		u.angles[2] = ent->baseline.angles[2];
 // Tomaz - QC Alpha Scale Glow Begin
-	if (bits & U_RENDERAMT)
-	    ent->renderamt = MSG_ReadFloat();
+	u.renderamt = (bits & U_RENDERAMT) ? MSG_ReadFloat() : 0;
+	u.rendermode = (bits & U_RENDERMODE) ? MSG_ReadFloat() : 0;
+	u.rendercolor[0] = (bits & U_RENDERCOLOR1) ? MSG_ReadFloat() : 0;
+	u.rendercolor[1] = (bits & U_RENDERCOLOR2) ? MSG_ReadFloat() : 0;
+	u.rendercolor[2] = (bits & U_RENDERCOLOR3) ? MSG_ReadFloat() : 0;
+// Tomaz - QC Alpha Scale Glow End
+
+	if (bits & U_SCALE)
+		u.scale = MSG_ReadByte();
 	else
-	    ent->renderamt = 0;
+		u.scale = ENTSCALE_DEFAULT;
 
-    if (bits & U_RENDERMODE)
-	    ent->rendermode = MSG_ReadFloat();
-    else
-	    ent->rendermode = 0;
+	u.nolerp = (bits & U_NOLERP) != 0;	// there's no data for nolerp, it is the value itself
 
-	if (bits & U_RENDERCOLOR1)
-	    ent->rendercolor[0] = MSG_ReadFloat();
-	else
-	    ent->rendercolor[0] = 0;
+	CL_UpdateEntity (ent, &u);
+}
 
-	if (bits & U_RENDERCOLOR2)
-	    ent->rendercolor[1] = MSG_ReadFloat();
-	else
-	    ent->rendercolor[1] = 0;
+/*
+==================
+CL_ParseSnapshot
 
-	if (bits & U_RENDERCOLOR3)
-	    ent->rendercolor[2] = MSG_ReadFloat();
-	else
-	    ent->rendercolor[2] = 0;
-// Tomaz - QC Alpha Scale Glow End
+svc_snapshot stands in for the entity updates when the server runs in this
+process: the same entities SV_WriteEntitiesToClient would pick are read
+from the edicts, rounded the way the protocol would round them except for
+origins and angles, which keep full precision.
+==================
+*/
+static void CL_ParseSnapshot (void)
+{
+	edict_t			*clent, *ent;
+	byte			*pvs;
+	vec3_t			org;
+	int				e, num;
+	qboolean		nomap;
+	entityupdate_t	u;
 
-	if (bits & U_SCALE)
-		ent->scale = MSG_ReadByte();
-	else
-		ent->scale = ENTSCALE_DEFAULT;
+	num = MSG_ReadShort ();
+	nomap = MSG_ReadByte ();
 
-    if ( bits & U_NOLERP )//there's no data for nolerp, it is the value itself
-		ent->forcelink = true;
+	if (!sv.active || num < 1 || num >= sv.num_edicts)
+		Host_Error ("CL_ParseSnapshot: no local server for the snapshot");
 
-	if ( forcelink )
-	{	// didn't have an update last message
-		VectorCopy (ent->msg_origins[0], ent->msg_origins[1]);
-		VectorCopy (ent->msg_origins[0], ent->origin);
-		VectorCopy (ent->msg_angles[0], ent->msg_angles[1]);
-		VectorCopy (ent->msg_angles[0], ent->angles);
-		ent->forcelink = true;
+	CL_FirstUpdate ();
+
+	clent = EDICT_NUM(num);
+	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
+	pvs = SV_FatPVS (org);
+
+	ent = NEXT_EDICT(sv.edicts);
+	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
+	{
+		if (!SV_EntityVisible (clent, ent, pvs, nomap))
+			continue;
+
+		u.modelindex = (short)ent->v.modelindex;
+		if (u.modelindex < 0 || u.modelindex >= MAX_MODELS)
+			Host_Error ("CL_ParseSnapshot: bad modnum");
+		u.frame = (int)ent->v.frame & 255;
+		u.colormap = (int)ent->v.colormap & 255;
+		u.skin = (int)ent->v.skin & 255;
+		u.effects = (short)ent->v.effects;
+		VectorCopy (ent->v.origin, u.origin);
+		VectorCopy (ent->v.angles, u.angles);
+		SV_EntityRender (ent, &u.renderamt, &u.rendermode, u.rendercolor);
+
+		if (ent->v.scale != ENTSCALE_DEFAULT && ent->v.scale != 0)
+			u.scale = (int)ENTSCALE_ENCODE(ent->v.scale) & 255;
+		else
+			u.scale = ENTSCALE_DEFAULT;
+		u.nolerp = false;
+
+		CL_UpdateEntity (CL_EntityNum (e), &u);
 	}
 }
 
@@ -1178,6 +1277,15 @@ void CL_ParseServerMessage (void)
 		case svc_time:
 			cl.mtime[1] = cl.mtime[0];
 			cl.mtime[0] = (double)MSG_ReadFloat ();
+			CL_InterpServerTime ();
+			break;
+
+		case svc_snapshot:
+			CL_ParseSnapshot ();
+			break;
+
+		case svc_moveack:
+			CL_ParseMoveAck ();
 			break;
 
 		case svc_clientdata:
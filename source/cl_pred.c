@@ -0,0 +1,381 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// cl_pred.c -- client side prediction of the local player's movement
+
+/*
+Every move sent to a remote server is numbered and kept. The server says
+which move its player state includes with each datagram (svc_moveack),
+and every frame the moves it hasn't run yet are replayed on a private copy
+of that state, through the server's own SV_PlayerThink and SV_WalkMove,
+clipped against the client's copy of the world hulls. When an ack shows
+the last prediction was off, the difference is blended out over
+cl_predictsmooth seconds instead of jumping the view.
+
+QuakeC movement (jumping, speed changes in PlayerPreThink) is not
+predicted, the server's answer corrects it a round trip later.
+*/
+
+#include "nzportable_def.h"
+
+cvar_t	cl_predict = {"cl_predict","1"};
+cvar_t	cl_predictsmooth = {"cl_predictsmooth","0.1"};	// seconds to blend out a correction
+
+#define	CL_MAXPREDMOVES		64		// power of two, more than a round trip of frames
+#define	CL_PREDSNAP			64		// corrections larger than this are teleports
+
+typedef struct
+{
+	int			sequence;
+	float		frametime;
+	vec3_t		viewangles;
+	usercmd_t	cmd;
+	qboolean	predicted;
+	vec3_t		predorigin;		// where the last replay put the player after this move
+} predmove_t;
+
+static predmove_t	cl_predmoves[CL_MAXPREDMOVES];
+
+// never reset, so an ack for a move from the last level can't match a new one
+static int			cl_predsequence;
+
+// the server's player, as of the last move it ran
+static struct
+{
+	int			sequence;
+	vec3_t		origin;
+	vec3_t		velocity;
+	vec3_t		mins, maxs;
+	int			movetype;
+	int			flags;
+	qboolean	fresh;		// not compared with the prediction yet
+} cl_moveack;
+
+static struct
+{
+	vec3_t		origin;
+	vec3_t		velocity;
+	vec3_t		error;		// being blended out of the view
+} cl_pred;
+
+static struct
+{
+	int		frames;
+	int		moves;
+	int		maxpending;
+	int		corrections;
+	float	errorsum;
+	float	errormax;
+	int		snaps;
+	int		overflows;
+} cl_predstats;
+
+static edict_t	*cl_predplayer;
+static int		cl_predplayersize;
+static edict_t	cl_predworld;
+
+int SV_FlyMove (edict_t *ent, float time, trace_t *steptrace);
+
+/*
+==================
+CL_PredictClear
+==================
+*/
+void CL_PredictClear (void)
+{
+	memset (&cl_moveack, 0, sizeof(cl_moveack));
+	memset (&cl_pred, 0, sizeof(cl_pred));
+	memset (cl_predmoves, 0, sizeof(cl_predmoves));
+}
+
+/*
+==================
+CL_PredictSaveMove
+
+Keeps a move for replaying, returns its sequence number or 0 when the
+server shouldn't be asked to number its acks. Servers that don't flag
+GAME_MOVEACK in their serverinfo would drop us for sending clc_moveseq.
+==================
+*/
+int CL_PredictSaveMove (usercmd_t *cmd, vec3_t viewangles)
+{
+	predmove_t	*m;
+
+	if (!cl_predict.value || !cl.moveacks || sv.active || cls.demoplayback)
+		return 0;
+
+	cl_predsequence++;
+	m = &cl_predmoves[cl_predsequence & (CL_MAXPREDMOVES - 1)];
+	m->sequence = cl_predsequence;
+	m->frametime = host_frametime;
+	VectorCopy (viewangles, m->viewangles);
+	m->predicted = false;
+
+	// the server only sees what fits in a short
+	m->cmd.forwardmove = (int)cmd->forwardmove;
+	m->cmd.sidemove = (int)cmd->sidemove;
+	m->cmd.upmove = (int)cmd->upmove;
+
+	return cl_predsequence;
+}
+
+/*
+==================
+CL_ParseMoveAck
+==================
+*/
+void CL_ParseMoveAck (void)
+{
+	int		i;
+
+	cl_moveack.sequence = MSG_ReadLong ();
+	for (i=0 ; i<3 ; i++)
+		cl_moveack.origin[i] = MSG_ReadFloat ();
+	for (i=0 ; i<3 ; i++)
+		cl_moveack.velocity[i] = MSG_ReadFloat ();
+	for (i=0 ; i<3 ; i++)
+		cl_moveack.mins[i] = MSG_ReadChar ();
+	for (i=0 ; i<3 ; i++)
+		cl_moveack.maxs[i] = MSG_ReadChar ();
+	cl_moveack.movetype = MSG_ReadByte ();
+	cl_moveack.flags = MSG_ReadByte ();
+	cl_moveack.fresh = true;
+}
+
+/*
+==================
+CL_PredictPlayer
+
+Sets up the private player edict from the last ack. It is sized like a
+progs edict, so field lookups like SV_AddGravity's stay inside it.
+==================
+*/
+static edict_t *CL_PredictPlayer (void)
+{
+	edict_t	*ent;
+	int		size;
+
+	size = MAX(pr_edict_size, (int)sizeof(edict_t));
+	if (size > cl_predplayersize)
+	{
+		free (cl_predplayer);
+		cl_predplayer = Q_malloc (size);
+		cl_predplayersize = size;
+	}
+	ent = cl_predplayer;
+	memset (ent, 0, cl_predplayersize);
+
+	VectorCopy (cl_moveack.origin, ent->v.origin);
+	VectorCopy (cl_moveack.origin, ent->v.oldorigin);
+	VectorCopy (cl_moveack.velocity, ent->v.velocity);
+	VectorCopy (cl_moveack.mins, ent->v.mins);
+	VectorCopy (cl_moveack.maxs, ent->v.maxs);
+	ent->v.movetype = cl_moveack.movetype;
+	ent->v.solid = SOLID_SLIDEBOX;
+	ent->v.health = cl.stats[STAT_HEALTH];
+	ent->v.view_ofs[2] = cl.viewheight;
+	if (cl_moveack.flags & MOVEACK_ONGROUND)
+		ent->v.flags = (int)ent->v.flags | FL_ONGROUND;
+	if (cl_moveack.flags & MOVEACK_WATERJUMP)
+		ent->v.flags = (int)ent->v.flags | FL_WATERJUMP;
+
+	return ent;
+}
+
+/*
+==================
+CL_PredictPhysics
+
+The movement half of SV_Physics_Client, without the QuakeC
+==================
+*/
+static void CL_PredictPhysics (edict_t *ent)
+{
+	SV_CheckVelocity (ent);
+
+	switch ((int)ent->v.movetype)
+	{
+	case MOVETYPE_WALK:
+		if (!SV_CheckWater (ent) && ! ((int)ent->v.flags & FL_WATERJUMP) )
+			SV_AddGravity (ent);
+		SV_CheckStuck (ent);
+		SV_WalkMove (ent);
+		break;
+
+	case MOVETYPE_FLY:
+		SV_FlyMove (ent, host_frametime, NULL);
+		break;
+
+	case MOVETYPE_NOCLIP:
+		VectorMA (ent->v.origin, host_frametime, ent->v.velocity, ent->v.origin);
+		break;
+	}
+}
+
+/*
+==================
+CL_PredictMove
+
+Replays the moves the server hasn't acknowledged yet. Returns false, and
+leaves origin alone, when the player should be drawn where the server
+says instead.
+==================
+*/
+qboolean CL_PredictMove (vec3_t origin)
+{
+	edict_t		*ent, *oldplayer;
+	double		oldframetime;
+	predmove_t	*m;
+	vec3_t		delta;
+	float		f, len;
+	int			pending, sequence;
+
+	if (!cl_predict.value || sv.active || cls.demoplayback || cls.signon != SIGNONS
+	|| !cl_moveack.sequence || !cl.worldmodel)
+		return false;
+
+	switch (cl_moveack.movetype)
+	{
+	case MOVETYPE_WALK:
+	case MOVETYPE_FLY:
+	case MOVETYPE_NOCLIP:
+		break;
+	default:
+		return false;	// dead, or being carried around by the progs
+	}
+
+	pending = cl_predsequence - cl_moveack.sequence;
+	if (pending < 0 || pending >= CL_MAXPREDMOVES)
+	{
+		cl_predstats.overflows++;
+		return false;
+	}
+
+// see how far off the last prediction of the acked move was
+	if (cl_moveack.fresh)
+	{
+		cl_moveack.fresh = false;
+
+		m = &cl_predmoves[cl_moveack.sequence & (CL_MAXPREDMOVES - 1)];
+		if (m->sequence == cl_moveack.sequence && m->predicted)
+		{
+			VectorSubtract (m->predorigin, cl_moveack.origin, delta);
+			len = Length (delta);
+
+			cl_predstats.corrections++;
+			cl_predstats.errorsum += len;
+			cl_predstats.errormax = MAX(cl_predstats.errormax, len);
+
+			if (len > CL_PREDSNAP)
+			{
+				cl_predstats.snaps++;
+				VectorClear (cl_pred.error);
+			}
+			else
+				VectorAdd (cl_pred.error, delta, cl_pred.error);
+		}
+	}
+
+// blend out what is left of earlier corrections
+	if (cl_predictsmooth.value > 0)
+		f = 1 - host_frametime / cl_predictsmooth.value;
+	else
+		f = 0;
+	VectorScale (cl_pred.error, MAX(f, 0), cl_pred.error);
+
+// replay the moves the server hasn't run yet on its player
+	ent = CL_PredictPlayer ();
+
+	oldplayer = sv_player;
+	oldframetime = host_frametime;
+	sv_player = ent;
+	sv_predictmodel = cl.worldmodel;
+	sv_predictworld = &cl_predworld;
+	cl_predworld.v.solid = SOLID_BSP;
+	cl_predworld.v.movetype = MOVETYPE_PUSH;
+
+	for (sequence = cl_moveack.sequence + 1 ; sequence <= cl_predsequence ; sequence++)
+	{
+		m = &cl_predmoves[sequence & (CL_MAXPREDMOVES - 1)];
+
+		host_frametime = m->frametime;
+		VectorCopy (m->viewangles, ent->v.v_angle);
+		SV_PlayerThink (&m->cmd);
+		CL_PredictPhysics (ent);
+
+		VectorCopy (ent->v.origin, m->predorigin);
+		m->predicted = true;
+	}
+
+	sv_predictmodel = NULL;
+	sv_predictworld = NULL;
+	sv_player = oldplayer;
+	host_frametime = oldframetime;
+
+	VectorCopy (ent->v.origin, cl_pred.origin);
+	VectorCopy (ent->v.velocity, cl_pred.velocity);
+
+	cl_predstats.frames++;
+	cl_predstats.moves += pending;
+	cl_predstats.maxpending = MAX(cl_predstats.maxpending, pending);
+
+	VectorAdd (cl_pred.origin, cl_pred.error, origin);
+	VectorCopy (cl_pred.velocity, cl.velocity);
+
+	return true;
+}
+
+/*
+==================
+CL_PredictStats_f
+==================
+*/
+static void CL_PredictStats_f (void)
+{
+	if (Cmd_Argc () > 1 && !Q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		memset (&cl_predstats, 0, sizeof(cl_predstats));
+		return;
+	}
+
+	Con_Printf ("%i frames predicted, %.1f moves replayed per frame, %i at most\n",
+		cl_predstats.frames,
+		cl_predstats.frames ? (float)cl_predstats.moves / cl_predstats.frames : 0,
+		cl_predstats.maxpending);
+	Con_Printf ("%i corrections: %.2f average, %.2f largest, %i snapped\n",
+		cl_predstats.corrections,
+		cl_predstats.corrections ? cl_predstats.errorsum / cl_predstats.corrections : 0,
+		cl_predstats.errormax, cl_predstats.snaps);
+	if (cl_predstats.overflows)
+		Con_Printf ("%i frames not predicted, more than %i moves unacknowledged\n",
+			cl_predstats.overflows, CL_MAXPREDMOVES - 1);
+}
+
+/*
+==================
+CL_InitPrediction
+==================
+*/
+void CL_InitPrediction (void)
+{
+	Cvar_RegisterVariable (&cl_predict);
+	Cvar_RegisterVariable (&cl_predictsmooth);
+
+	Cmd_AddCommand ("predstats", CL_PredictStats_f);
+}
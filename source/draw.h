@@ -64,7 +64,7 @@ extern int font_kerningamount[96];
 qpic_t *Draw_LMP (char *path);
 #endif
 
-#ifdef __NSPIRE__
+#ifdef SOFTWARE_RENDERER
 void Draw_BlackBackground (void);
 // naievil -- texture conversion start 
 #define MAX_SINGLE_PLANE_PIXEL_SIZE 		1048576		// naievil -- 1024 x 1024 single plane (paletted) texture
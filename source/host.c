@@ -584,6 +584,8 @@ Host_ServerFrame
 */
 void Host_ServerFrame (void)
 {
+	double	time1 = 0, time2 = 0, time3 = 0;
+
 // run the world state
 	pr_global_struct->frametime = host_frametime;
 
@@ -593,17 +595,33 @@ void Host_ServerFrame (void)
 // check for new clients
 	SV_CheckForNewClients ();
 
+	if (sv_benchtiming)
+		time1 = Sys_FloatTime ();
+
 // read client messages
 	SV_RunClients ();
 
+	if (sv_benchtiming)
+		time2 = Sys_FloatTime ();
+
 // move things around and think
 // always pause in single player if in console or menus
 	if (!sv.paused && (svs.maxclients > 1 || key_dest == key_game) )
 		SV_Physics ();
 
+	if (sv_benchtiming)
+		time3 = Sys_FloatTime ();
+
 // send all messages to the clients
 	SV_SendClientMessages ();
 
+	if (sv_benchtiming)
+	{
+		sv_benchphase[SV_BENCH_CLIENTS] += time2 - time1;
+		sv_benchphase[SV_BENCH_PHYSICS] += time3 - time2;
+		sv_benchphase[SV_BENCH_SEND] += Sys_FloatTime () - time3;
+	}
+
 	if (sv.time >= 5.0) {
 		TestHandler_MapBoot();
 	}
@@ -621,6 +639,7 @@ void _Host_Frame (float time)
 	static double		time1 = 0;
 	static double		time2 = 0;
 	static double		time3 = 0;
+	double		soundtime = 0;
 	int			pass1, pass2, pass3;
 
 	if (setjmp (host_abortserver) )
@@ -687,6 +706,8 @@ void _Host_Frame (float time)
 	if (host_speeds.value)
 		time2 = Sys_FloatTime ();
 // update audio
+	if (cls.timedemo)
+		soundtime = Sys_FloatTime ();
 	if (cls.signon == SIGNONS)
 	{
 		S_Update (r_origin, vpn, vright, vup);
@@ -694,6 +715,11 @@ void _Host_Frame (float time)
 	}
 	else
 		S_Update (vec3_origin, vec3_origin, vec3_origin, vec3_origin);
+	if (cls.timedemo)
+	{
+		CL_TimeDemoPhase (TD_SOUND, Sys_FloatTime () - soundtime);
+		CL_TimeDemoFrame ();
+	}
 
 	if (host_speeds.value)
 	{
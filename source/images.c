@@ -257,7 +257,7 @@ image_t Image_LoadImage(char* filename, int image_format, int filter, bool keep,
 	texture_index = GL_LoadTexture (texname, image_width, image_height, data, mipmap, true, 4, keep);
 #elif __WII__
 	texture_index = GL_LoadTexture (texname, image_width, image_height, data, false, true, keep, 4);
-#elif __NSPIRE__
+#elif defined (SOFTWARE_RENDERER)
 	qboolean transparenttoblack = (qboolean)filter;
 	texture_index = Soft_LoadTexture (texname, image_width, image_height, data, transparenttoblack, keep);
 #endif
@@ -759,9 +759,10 @@ void FloorDivMod (float numer, float denom, int *quotient,
 	*rem = r;
 }
 
-#ifdef __NSPIRE__
+#if defined( __NSPIRE__ ) || defined( __linux__ )
 // from naievil as to this gating:
-// udiv_64_32 is an assembly function specific to NSPIRE in d_scan_S
+// udiv_64_32 is an assembly function specific to NSPIRE in d_scan_S,
+// the Linux software build gets a portable one from nspire_math.h
 void FloorDivModFixed( int numer, int denom, int *quotient, int *rem )
 {
 	int		q, r, x;
@@ -26,6 +26,75 @@ qboolean	localconnectpending = false;
 qsocket_t	*loop_client = NULL;
 qsocket_t	*loop_server = NULL;
 
+/*
+===============================================================================
+
+MESSAGE BUFFERS
+
+Every queued message and net_message itself sit in a NET_MAXMESSAGE buffer.
+Reading a message swaps its buffer with the one net_message had, so a local
+message is copied once, by the sender, instead of into the queue, out to
+net_message and down the queue again.
+===============================================================================
+*/
+
+#define	LOOP_MAXBUFFERS		64
+
+static byte	*loop_buffers[LOOP_MAXBUFFERS + 1];	// free ones, and the one net_message started with
+static int	loop_numbuffers;
+static int	loop_allocated;
+
+static byte *Loop_AllocBuffer (void)
+{
+	if (loop_numbuffers)
+		return loop_buffers[--loop_numbuffers];
+
+	if (loop_allocated == LOOP_MAXBUFFERS)
+		return NULL;
+	loop_allocated++;
+
+	return Q_malloc (NET_MAXMESSAGE);
+}
+
+static void Loop_FreeBuffer (byte *data)
+{
+	if (loop_numbuffers == LOOP_MAXBUFFERS + 1)
+		Sys_Error ("Loop_FreeBuffer: too many buffers");
+	loop_buffers[loop_numbuffers++] = data;
+}
+
+static void Loop_ClearQueue (qsocket_t *sock)
+{
+	while (sock->loopcount)
+	{
+		Loop_FreeBuffer (sock->loopqueue[sock->loophead].data);
+		sock->loophead = (sock->loophead + 1) % NET_LOOPMESSAGES;
+		sock->loopcount--;
+	}
+	sock->loophead = 0;
+}
+
+static int Loop_Queue (qsocket_t *sock, sizebuf_t *data, int type)
+{
+	loopmessage_t	*m;
+	byte			*buffer;
+
+	buffer = Loop_AllocBuffer ();
+	if (!buffer)
+		return 0;
+
+	m = &sock->loopqueue[(sock->loophead + sock->loopcount) % NET_LOOPMESSAGES];
+	m->type = type;
+	m->length = data->cursize;
+	m->data = buffer;
+	Q_memcpy (buffer, data->data, data->cursize);
+	sock->loopcount++;
+
+	return 1;
+}
+
+//=============================================================================
+
 int Loop_Init (void)
 {
 	if (cls.state == ca_dedicated)
@@ -78,7 +147,7 @@ qsocket_t *Loop_Connect (char *host)
 		}
 		Q_strcpy (loop_client->address, "localhost");
 	}
-	loop_client->receiveMessageLength = 0;
+	Loop_ClearQueue (loop_client);
 	loop_client->sendMessageLength = 0;
 	loop_client->canSend = true;
 
@@ -91,7 +160,7 @@ qsocket_t *Loop_Connect (char *host)
 		}
 		Q_strcpy (loop_server->address, "LOCAL");
 	}
-	loop_server->receiveMessageLength = 0;
+	Loop_ClearQueue (loop_server);
 	loop_server->sendMessageLength = 0;
 	loop_server->canSend = true;
 
@@ -109,40 +178,40 @@ qsocket_t *Loop_CheckNewConnections (void)
 
 	localconnectpending = false;
 	loop_server->sendMessageLength = 0;
-	loop_server->receiveMessageLength = 0;
+	Loop_ClearQueue (loop_server);
 	loop_server->canSend = true;
 	loop_client->sendMessageLength = 0;
-	loop_client->receiveMessageLength = 0;
+	Loop_ClearQueue (loop_client);
 	loop_client->canSend = true;
 	return loop_server;
 }
 
 
-static int IntAlign(int value)
-{
-	return (value + (sizeof(int) - 1)) & (~(sizeof(int) - 1));
-}
-
-
 int Loop_GetMessage (qsocket_t *sock)
 {
-	int		ret;
-	int		length;
+	loopmessage_t	*m;
+	int				ret;
 
-	if (sock->receiveMessageLength == 0)
+	if (!sock->loopcount)
 		return 0;
 
-	ret = sock->receiveMessage[0];
-	length = sock->receiveMessage[1] + (sock->receiveMessage[2] << 8);
-	// alignment byte skipped here
-	SZ_Clear (&net_message);
-	SZ_Write (&net_message, &sock->receiveMessage[4], length);
-
-	length = IntAlign(length + 4);
-	sock->receiveMessageLength -= length;
+	m = &sock->loopqueue[sock->loophead];
+	sock->loophead = (sock->loophead + 1) % NET_LOOPMESSAGES;
+	sock->loopcount--;
+	ret = m->type;
 
-	if (sock->receiveMessageLength)
-		Q_memcpy(sock->receiveMessage, &sock->receiveMessage[length], sock->receiveMessageLength);
+	if (net_message.maxsize == NET_MAXMESSAGE)
+	{
+		Loop_FreeBuffer (net_message.data);
+		net_message.data = m->data;
+		net_message.cursize = m->length;
+	}
+	else
+	{
+		SZ_Clear (&net_message);
+		SZ_Write (&net_message, m->data, m->length);
+		Loop_FreeBuffer (m->data);
+	}
 
 	if (sock->driverdata && ret == 1)
 		((qsocket_t *)sock->driverdata)->canSend = true;
@@ -153,33 +222,16 @@ int Loop_GetMessage (qsocket_t *sock)
 
 int Loop_SendMessage (qsocket_t *sock, sizebuf_t *data)
 {
-	byte *buffer;
-	int  *bufferLength;
+	qsocket_t	*peer;
 
-	if (!sock->driverdata)
+	peer = (qsocket_t *)sock->driverdata;
+	if (!peer)
 		return -1;
 
-	bufferLength = &((qsocket_t *)sock->driverdata)->receiveMessageLength;
-
-	if ((*bufferLength + data->cursize + 4) > NET_MAXMESSAGE)
+	if (data->cursize > NET_MAXMESSAGE || peer->loopcount == NET_LOOPMESSAGES
+		|| !Loop_Queue (peer, data, 1))
 		Sys_Error("overflow\n");
 
-	buffer = ((qsocket_t *)sock->driverdata)->receiveMessage + *bufferLength;
-
-	// message type
-	*buffer++ = 1;
-
-	// length
-	*buffer++ = data->cursize & 0xff;
-	*buffer++ = data->cursize >> 8;
-
-	// align
-	buffer++;
-
-	// message
-	Q_memcpy(buffer, data->data, data->cursize);
-	*bufferLength = IntAlign(*bufferLength + data->cursize + 4);
-
 	sock->canSend = false;
 	return 1;
 }
@@ -187,33 +239,17 @@ int Loop_SendMessage (qsocket_t *sock, sizebuf_t *data)
 
 int Loop_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
 {
-	byte *buffer;
-	int  *bufferLength;
+	qsocket_t	*peer;
 
-	if (!sock->driverdata)
+	peer = (qsocket_t *)sock->driverdata;
+	if (!peer)
 		return -1;
 
-	bufferLength = &((qsocket_t *)sock->driverdata)->receiveMessageLength;
-
-	if ((*bufferLength + data->cursize + sizeof(byte) + sizeof(short)) > NET_MAXMESSAGE)
+	// leave a slot for the reliable message the peer has not read yet
+	if (data->cursize > NET_MAXMESSAGE || peer->loopcount >= NET_LOOPMESSAGES - 1)
 		return 0;
 
-	buffer = ((qsocket_t *)sock->driverdata)->receiveMessage + *bufferLength;
-
-	// message type
-	*buffer++ = 2;
-
-	// length
-	*buffer++ = data->cursize & 0xff;
-	*buffer++ = data->cursize >> 8;
-
-	// align
-	buffer++;
-
-	// message
-	Q_memcpy(buffer, data->data, data->cursize);
-	*bufferLength = IntAlign(*bufferLength + data->cursize + 4);
-	return 1;
+	return Loop_Queue (peer, data, 2);
 }
 
 
@@ -235,11 +271,11 @@ void Loop_Close (qsocket_t *sock)
 {
 	if (sock->driverdata)
 		((qsocket_t *)sock->driverdata)->driverdata = NULL;
-	sock->receiveMessageLength = 0;
+	Loop_ClearQueue (sock);
 	sock->sendMessageLength = 0;
 	sock->canSend = true;
 	if (sock == loop_client)
 		loop_client = NULL;
-	else
+	else if (sock == loop_server)
 		loop_server = NULL;
 }
@@ -328,6 +328,7 @@ extern lpSelTexFUNC qglSelectTextureSGIS;
 extern qboolean gl_mtexable;
 
 void R_DrawBrushModel (entity_t *e);
+float R_AliasRadius (entity_t *e);
 void R_DrawWorld (void);
 void R_DrawParticles (void);
 void R_DrawWaterSurfaces (void);
@@ -952,6 +952,43 @@ void R_DrawTransparentAliasModel (entity_t *e)
 	}
 }
 
+/*
+=================
+R_AliasRadius
+
+How far from the origin any frame of the entity's model can reach, with
+the limbs of a zombie that get drawn along with it
+=================
+*/
+float R_AliasRadius (entity_t *e)
+{
+	int			i, limbs[3];
+	float		radius;
+	model_t		*clmodel;
+	aliashdr_t	*paliashdr;
+	vec3_t		hi;
+
+	limbs[0] = e->z_head;
+	limbs[1] = e->z_larm;
+	limbs[2] = e->z_rarm;
+
+	radius = 0;
+	clmodel = e->model;
+	for (i=0 ; i<4 ; i++)
+	{
+		if (i > 0)
+			clmodel = limbs[i - 1] ? cl_entities[limbs[i - 1]].model : NULL;
+		if (!clmodel || clmodel->type != mod_alias)
+			continue;
+
+		paliashdr = (aliashdr_t *)Mod_Extradata (clmodel);
+		VectorMA (paliashdr->scale_origin, 255, paliashdr->scale, hi);
+		radius = MAX (radius, R_OcclusionRadius (paliashdr->scale_origin, hi));
+	}
+
+	return radius;
+}
+
 /*
 =================
 R_DrawAliasModel
@@ -1246,11 +1283,13 @@ void R_DrawEntitiesOnList (void)
 			{
 				continue;
 			}
-			R_DrawAliasModel (currententity);
+			if (!R_OcclusionAliasCulled (currententity, R_AliasRadius (currententity)))
+				R_DrawAliasModel (currententity);
 			break;
 
 		case mod_brush:
-			R_DrawBrushModel (currententity);
+			if (!R_OcclusionBrushCulled (currententity))
+				R_DrawBrushModel (currententity);
 			break;
 
 		default:
@@ -1276,7 +1315,7 @@ void R_DrawEntitiesOnList (void)
 			R_DrawSpriteModel (currententity);
 			break;
 		case mod_alias:
-			if(specChar == '$')//mdl model with blended alpha
+			if(specChar == '$' && !R_OcclusionAliasCulled (currententity, R_AliasRadius (currententity)))//mdl model with blended alpha
 			{
 					R_DrawTransparentAliasModel(currententity);
 			}
@@ -1662,6 +1701,7 @@ void R_RenderScene (void)
 	R_SetupGL ();
 
 	R_MarkLeaves ();	// done here so we know if we're in water
+	R_OcclusionFrame ();
 
 	R_DrawWorld ();		// adds static entities to the list
 
@@ -255,6 +255,8 @@ void R_Init (void)
 
 	Sky_Init (); //johnfitz
 	Fog_Init (); //johnfitz
+	R_LightGridInit ();
+	R_OcclusionInit ();
 
 #ifdef GLTEST
 	Test_Init ();
@@ -285,6 +287,8 @@ void R_NewMap (void)
 	R_ClearParticles ();
 
 	GL_BuildLightmaps ();
+	R_LightGridBuild (cl.worldmodel, 3);
+	R_OcclusionNewMap (cl.worldmodel);
 
 	Sky_NewMap (); //johnfitz -- skybox in worldspawn
 	Fog_ParseWorldspawn ();
@@ -0,0 +1,144 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// draw_null.c -- null 2D drawing for headless builds
+
+#include "../../nzportable_def.h"
+
+extern int numcachepics;
+
+float 	loading_cur_step;
+char	loading_name[32];
+float 	loading_num_step;
+int 	loading_step;
+
+int		font_kerningamount[96];
+
+void Draw_Init (void)
+{
+}
+
+void Draw_Character (int x, int y, int num)
+{
+}
+
+void Draw_CharacterRGBA (int x, int y, int num, float r, float g, float b, float a, float scale)
+{
+}
+
+void Draw_String (int x, int y, char *str)
+{
+}
+
+void Draw_ColoredString (int x, int y, char *text, float r, float g, float b, float a, float scale)
+{
+}
+
+void Draw_ColoredStringCentered (int y, char *text, float r, float g, float b, float a, float scale)
+{
+}
+
+void Draw_Pic (int x, int y, int texnum)
+{
+}
+
+void Draw_TransPic (int x, int y, int texnum)
+{
+}
+
+void Draw_TransPicTranslate (int x, int y, int texnum, byte *translation)
+{
+}
+
+void Draw_AlphaPic (int x, int y, int texnum, float alpha)
+{
+}
+
+void Draw_StretchPic (int x, int y, int texnum, int x_value, int y_value)
+{
+}
+
+void Draw_ColoredStretchPic (int x, int y, int texnum, int x_value, int y_value, int r, int g, int b, int a)
+{
+}
+
+void Draw_ConsoleBackground (int lines)
+{
+}
+
+void Draw_BlackBackground (void)
+{
+}
+
+void Draw_TileClear (int x, int y, int w, int h)
+{
+}
+
+void Draw_Fill (int x, int y, int w, int h, int c)
+{
+}
+
+void Draw_FillByColor (int x, int y, int w, int h, int r, int g, int b, int a)
+{
+}
+
+void Draw_FadeScreen (void)
+{
+}
+
+void Draw_Crosshair (void)
+{
+}
+
+void Clear_LoadingFill (void)
+{
+	loading_cur_step = 0;
+	loading_num_step = 0;
+	loading_step = -1;
+	memset(loading_name, 0, sizeof(loading_name));
+}
+
+int getTextWidth (char *str, float scale)
+{
+	return strlen(str) * 8 * (int)scale;
+}
+
+int Image_FindImage (const char *identifier)
+{
+	cachepic_t	*pic;
+	int			i;
+
+	for (pic=cachepics, i=0 ; i<numcachepics ; pic++, i++) {
+		if (!strcmp (identifier, pic->name)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+byte findclosestpalmatch (byte r, byte g, byte b, byte a)
+{
+	// nothing samples converted textures, keep the transparency rule only
+	if (a < 128)
+		return 255;
+
+	return 0;
+}
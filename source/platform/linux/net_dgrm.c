@@ -0,0 +1,1794 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_dgrm.c
+
+// This is enables a simple IP banning mechanism
+#define BAN_TEST
+
+#ifdef BAN_TEST
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined (NeXT) || defined (__linux__)
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#else
+#define AF_INET 		2	/* internet */
+struct in_addr
+{
+	union
+	{
+		struct { unsigned char s_b1,s_b2,s_b3,s_b4; } S_un_b;
+		struct { unsigned short s_w1,s_w2; } S_un_w;
+		unsigned long S_addr;
+	} S_un;
+};
+#define	s_addr	S_un.S_addr	/* can be used for most tcp & ip code */
+struct sockaddr_in
+{
+    short			sin_family;
+    unsigned short	sin_port;
+	struct in_addr	sin_addr;
+    char			sin_zero[8];
+};
+char *inet_ntoa(struct in_addr in);
+unsigned long inet_addr(const char *cp);
+#endif
+#endif	// BAN_TEST
+
+#include "../../nzportable_def.h"
+#include "net_dgrm.h"
+#include "net_sim.h"
+
+// these two macros are to make the code more readable
+#define sfunc	net_landrivers[sock->landriver]
+#define dfunc	net_landrivers[net_landriverlevel]
+
+static int net_landriverlevel;
+
+/* statistic counters */
+int	packetsSent = 0;
+int	packetsReSent = 0;
+int packetsReceived = 0;
+int receivedDuplicateCount = 0;
+int shortPacketCount = 0;
+int droppedDatagrams;
+
+static int myDriverLevel;
+
+struct
+{
+	unsigned int	length;
+	unsigned int	sequence;
+	byte			data[MAX_DATAGRAM];
+} packetBuffer;
+
+cvar_t	net_window = {"net_window", "1"};		// offer windowed reliable messages when connecting
+
+extern int m_return_state;
+extern int m_state;
+extern qboolean m_return_onerror;
+extern char m_return_reason[32];
+
+
+#ifdef DEBUG
+char *StrAddr (struct qsockaddr *addr)
+{
+	static char buf[34];
+	byte *p = (byte *)addr;
+	int n;
+
+	for (n = 0; n < 16; n++)
+		sprintf (buf + n * 2, "%02x", *p++);
+	return buf;
+}
+#endif
+
+
+#ifdef BAN_TEST
+unsigned long banAddr = 0x00000000;
+unsigned long banMask = 0xffffffff;
+
+void NET_Ban_f (void)
+{
+	char	addrStr [32];
+	char	maskStr [32];
+	struct in_addr	addr;
+	void	(*print) (char *fmt, ...);
+
+	if (cmd_source == src_command)
+	{
+		if (!sv.active)
+		{
+			Cmd_ForwardToServer ();
+			return;
+		}
+		print = Con_Printf;
+	}
+	else
+	{
+		if (pr_global_struct->deathmatch && !host_client->privileged)
+			return;
+		print = SV_ClientPrintf;
+	}
+
+	switch (Cmd_Argc ())
+	{
+		case 1:
+			if (banAddr)
+			{
+				addr.s_addr = banAddr;
+				Q_strcpy(addrStr, inet_ntoa(addr));
+				addr.s_addr = banMask;
+				Q_strcpy(maskStr, inet_ntoa(addr));
+				print("Banning %s [%s]\n", addrStr, maskStr);
+			}
+			else
+				print("Banning not active\n");
+			break;
+
+		case 2:
+			if (Q_strcasecmp(Cmd_Argv(1), "off") == 0)
+				banAddr = 0x00000000;
+			else
+				banAddr = inet_addr(Cmd_Argv(1));
+			banMask = 0xffffffff;
+			break;
+
+		case 3:
+			banAddr = inet_addr(Cmd_Argv(1));
+			banMask = inet_addr(Cmd_Argv(2));
+			break;
+
+		default:
+			print("BAN ip_address [mask]\n");
+			break;
+	}
+}
+#endif
+
+/*
+===============================================================================
+
+WINDOWED RELIABLE CHANNEL
+
+When both ends offer NET_CAP_WINDOW in the connect handshake, reliable
+messages are no longer sent stop-and-wait. Every message is queued as
+fragments, up to DGRM_WINDOW fragments are in flight at once, the receiver
+acks each fragment it gets along with the next sequence it expects, and
+holds fragments that arrive early until the gap is filled. Fragments that
+stay unacked for the measured retransmit timeout are sent again.
+
+The packet format is unchanged apart from the cumulative sequence carried
+in acks, so a connection without the capability works exactly as before.
+===============================================================================
+*/
+
+#define	DGRM_WINDOW			16					// fragments in flight
+#define	DGRM_MAXFRAGS		256					// fragments queued
+#define	DGRM_QUEUESIZE		(NET_MAXMESSAGE * 4)	// bytes queued
+
+#define	DGRM_MINRTO			0.1
+#define	DGRM_MAXRTO			1.0
+
+typedef struct
+{
+	int				offset;			// byte count into the queue
+	int				length;
+	unsigned int	eom;			// NETFLAG_EOM on the last fragment of a message
+	double			sendtime;		// last transmission
+	qboolean		resent;
+	qboolean		acked;
+} dgrmfrag_t;
+
+typedef struct
+{
+	byte			queue[DGRM_QUEUESIZE];
+	int				queuehead, queuetail;	// byte counts, queue offset is % DGRM_QUEUESIZE
+	dgrmfrag_t		frags[DGRM_MAXFRAGS];	// indexed by sequence % DGRM_MAXFRAGS
+	unsigned int	nextsend;				// first fragment not sent yet
+
+	double			srtt;
+	double			rttvar;
+	double			rto;
+
+	byte			recvdata[DGRM_WINDOW][MAX_DATAGRAM];
+	int				recvlength[DGRM_WINDOW];	// -1 when the slot is empty
+	unsigned int	recveom[DGRM_WINDOW];
+
+	int				resent;
+	int				early;					// fragments that arrived ahead of a gap
+} dgrmwindow_t;
+
+#define	WINDOW(sock)	((dgrmwindow_t *)(sock)->driverdata)
+
+static void Window_Open (qsocket_t *sock)
+{
+	dgrmwindow_t	*w;
+	int				i;
+
+	w = Q_malloc (sizeof(dgrmwindow_t));
+	memset (w, 0, sizeof(*w));
+	for (i = 0; i < DGRM_WINDOW; i++)
+		w->recvlength[i] = -1;
+	w->nextsend = sock->sendSequence;
+	w->rto = DGRM_MAXRTO;
+
+	sock->driverdata = w;
+}
+
+static void Window_Close (qsocket_t *sock)
+{
+	free (sock->driverdata);
+	sock->driverdata = NULL;
+}
+
+/*
+==================
+Window_UpdateCanSend
+
+A message can be queued while there is room for the largest one
+==================
+*/
+static void Window_UpdateCanSend (qsocket_t *sock)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+
+	sock->canSend = (w->queuehead - w->queuetail + NET_MAXMESSAGE <= DGRM_QUEUESIZE
+		&& sock->sendSequence - sock->ackSequence + NET_MAXMESSAGE / MAX_DATAGRAM + 1 <= DGRM_MAXFRAGS);
+}
+
+static int Window_SendFragment (qsocket_t *sock, unsigned int sequence)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	dgrmfrag_t		*f = &w->frags[sequence % DGRM_MAXFRAGS];
+	int				ofs, n;
+
+	ofs = f->offset % DGRM_QUEUESIZE;
+	n = DGRM_QUEUESIZE - ofs;
+	if (n > f->length)
+		n = f->length;
+	Q_memcpy (packetBuffer.data, w->queue + ofs, n);
+	Q_memcpy (packetBuffer.data + n, w->queue, f->length - n);
+
+	packetBuffer.length = BigLong((NET_HEADERSIZE + f->length) | (NETFLAG_DATA | f->eom));
+	packetBuffer.sequence = BigLong(sequence);
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE + f->length, &sock->addr) == -1)
+		return -1;
+
+	if (f->sendtime)
+	{
+		f->resent = true;
+		w->resent++;
+		packetsReSent++;
+	}
+	else
+		packetsSent++;
+	f->sendtime = net_time;
+	sock->lastSendTime = net_time;
+	return 1;
+}
+
+/*
+==================
+Window_Transmit
+
+Sends fragments that fit in the window and resends the ones that timed out
+==================
+*/
+static int Window_Transmit (qsocket_t *sock)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	dgrmfrag_t		*f;
+	unsigned int	seq;
+	qboolean		timedout = false;
+
+	for (seq = sock->ackSequence; seq != w->nextsend; seq++)
+	{
+		f = &w->frags[seq % DGRM_MAXFRAGS];
+		if (!f->acked && net_time - f->sendtime > w->rto)
+		{
+			if (Window_SendFragment (sock, seq) == -1)
+				return -1;
+			timedout = true;
+		}
+	}
+
+	// back off until something new is acked
+	if (timedout)
+		w->rto = min(w->rto * 2, DGRM_MAXRTO);
+
+	while (w->nextsend != sock->sendSequence && w->nextsend - sock->ackSequence < DGRM_WINDOW)
+	{
+		if (Window_SendFragment (sock, w->nextsend) == -1)
+			return -1;
+		w->nextsend++;
+	}
+
+	return 1;
+}
+
+static int Window_SendMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	dgrmfrag_t		*f;
+	int				ofs, n, pos;
+
+	for (pos = 0; pos < data->cursize; pos += f->length)
+	{
+		f = &w->frags[sock->sendSequence++ % DGRM_MAXFRAGS];
+		f->offset = w->queuehead + pos;
+		f->length = min(data->cursize - pos, MAX_DATAGRAM);
+		f->eom = (pos + f->length == data->cursize) ? NETFLAG_EOM : 0;
+		f->sendtime = 0;
+		f->resent = false;
+		f->acked = false;
+	}
+
+	ofs = w->queuehead % DGRM_QUEUESIZE;
+	n = DGRM_QUEUESIZE - ofs;
+	if (n > data->cursize)
+		n = data->cursize;
+	Q_memcpy (w->queue + ofs, data->data, n);
+	Q_memcpy (w->queue, data->data + n, data->cursize - n);
+	w->queuehead += data->cursize;
+
+	Window_UpdateCanSend (sock);
+
+	return Window_Transmit (sock);
+}
+
+static void Window_Ack (qsocket_t *sock, unsigned int sequence, unsigned int cumulative)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	dgrmfrag_t		*f;
+	double			rtt;
+	unsigned int	seq;
+
+	if (sequence - sock->ackSequence >= w->nextsend - sock->ackSequence)
+	{
+		Con_DPrintf("Stale ACK received\n");
+		return;
+	}
+
+	f = &w->frags[sequence % DGRM_MAXFRAGS];
+	if (f->acked)
+	{
+		Con_DPrintf("Duplicate ACK received\n");
+		return;
+	}
+
+	// only fragments sent once give an unambiguous round trip
+	if (!f->resent)
+	{
+		rtt = net_time - f->sendtime;
+		if (!w->srtt)
+		{
+			w->srtt = rtt;
+			w->rttvar = rtt / 2;
+		}
+		else
+		{
+			w->rttvar = 0.75 * w->rttvar + 0.25 * fabs(w->srtt - rtt);
+			w->srtt = 0.875 * w->srtt + 0.125 * rtt;
+		}
+		w->rto = w->srtt + 4 * w->rttvar;
+		w->rto = max(DGRM_MINRTO, min(w->rto, DGRM_MAXRTO));
+	}
+	f->acked = true;
+
+	// everything before the receiver's next expected fragment arrived too
+	if (cumulative - sock->ackSequence <= w->nextsend - sock->ackSequence)
+		for (seq = sock->ackSequence; seq != cumulative; seq++)
+			w->frags[seq % DGRM_MAXFRAGS].acked = true;
+
+	while (sock->ackSequence != w->nextsend)
+	{
+		f = &w->frags[sock->ackSequence % DGRM_MAXFRAGS];
+		if (!f->acked)
+			break;
+		w->queuetail = f->offset + f->length;
+		sock->ackSequence++;
+	}
+
+	Window_UpdateCanSend (sock);
+}
+
+/*
+==================
+Window_SendAck
+
+Acks one fragment and tells the sender the first one still missing
+==================
+*/
+static void Window_SendAck (qsocket_t *sock, unsigned int sequence, struct qsockaddr *addr)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	unsigned int	next;
+
+	for (next = sock->receiveSequence; next - sock->receiveSequence < DGRM_WINDOW; next++)
+		if (w->recvlength[next % DGRM_WINDOW] < 0)
+			break;
+
+	packetBuffer.length = BigLong((NET_HEADERSIZE + 4) | NETFLAG_ACK);
+	packetBuffer.sequence = BigLong(sequence);
+	*(unsigned int *)packetBuffer.data = BigLong(next);
+	sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE + 4, addr);
+}
+
+/*
+==================
+Window_Deliver
+
+Moves fragments that are now in order into receiveMessage and returns 1
+with the message in net_message once one is complete. A peer whose
+fragments add up to more than NET_MAXMESSAGE is dropped, and -1 returned
+with the socket already closed.
+==================
+*/
+static int Window_Deliver (qsocket_t *sock)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	int				slot, length;
+
+	while (1)
+	{
+		slot = sock->receiveSequence % DGRM_WINDOW;
+		length = w->recvlength[slot];
+		if (length < 0)
+			return 0;
+
+		if (sock->receiveMessageLength + length > NET_MAXMESSAGE)
+		{
+			Con_Printf ("Window_Deliver: message too big from %s\n", sock->address);
+			NET_Close (sock);
+			return -1;
+		}
+		Q_memcpy (sock->receiveMessage + sock->receiveMessageLength, w->recvdata[slot], length);
+		sock->receiveMessageLength += length;
+		w->recvlength[slot] = -1;
+		sock->receiveSequence++;
+
+		if (w->recveom[slot])
+		{
+			SZ_Clear (&net_message);
+			SZ_Write (&net_message, sock->receiveMessage, sock->receiveMessageLength);
+			sock->receiveMessageLength = 0;
+			return 1;
+		}
+	}
+}
+
+static void Window_Receive (qsocket_t *sock, unsigned int sequence, unsigned int flags, int length, struct qsockaddr *addr)
+{
+	dgrmwindow_t	*w = WINDOW(sock);
+	int				slot;
+
+	if (length > MAX_DATAGRAM)
+	{
+		shortPacketCount++;
+		return;
+	}
+
+	if (sequence - sock->receiveSequence >= DGRM_WINDOW)
+	{
+		// already delivered, the ack must have been lost
+		if ((int)(sequence - sock->receiveSequence) < 0)
+		{
+			receivedDuplicateCount++;
+			Window_SendAck (sock, sequence, addr);
+		}
+		return;
+	}
+
+	slot = sequence % DGRM_WINDOW;
+	if (w->recvlength[slot] >= 0)
+		receivedDuplicateCount++;
+	else
+	{
+		Q_memcpy (w->recvdata[slot], packetBuffer.data, length);
+		w->recvlength[slot] = length;
+		w->recveom[slot] = flags & NETFLAG_EOM;
+		if (sequence != sock->receiveSequence)
+			w->early++;
+	}
+
+	Window_SendAck (sock, sequence, addr);
+}
+
+
+int Datagram_SendMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+#ifdef DEBUG
+	if (data->cursize == 0)
+		Sys_Error("zero length message\n");
+
+	if (data->cursize > NET_MAXMESSAGE)
+		Sys_Error("message too big %u\n", data->cursize);
+
+	if (sock->canSend == false)
+		Sys_Error("called with canSend == false\n");
+#endif
+
+	if (WINDOW(sock))
+		return Window_SendMessage (sock, data);
+
+	Q_memcpy(sock->sendMessage, data->data, data->cursize);
+	sock->sendMessageLength = data->cursize;
+
+	if (data->cursize <= MAX_DATAGRAM)
+	{
+		dataLen = data->cursize;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence++);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->canSend = false;
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsSent++;
+	return 1;
+}
+
+
+int SendMessageNext (qsocket_t *sock)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
+	{
+		dataLen = sock->sendMessageLength;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence++);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->sendNext = false;
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsSent++;
+	return 1;
+}
+
+
+int ReSendMessage (qsocket_t *sock)
+{
+	unsigned int	packetLen;
+	unsigned int	dataLen;
+	unsigned int	eom;
+
+	if (sock->sendMessageLength <= MAX_DATAGRAM)
+	{
+		dataLen = sock->sendMessageLength;
+		eom = NETFLAG_EOM;
+	}
+	else
+	{
+		dataLen = MAX_DATAGRAM;
+		eom = 0;
+	}
+	packetLen = NET_HEADERSIZE + dataLen;
+
+	packetBuffer.length = BigLong(packetLen | (NETFLAG_DATA | eom));
+	packetBuffer.sequence = BigLong(sock->sendSequence - 1);
+	Q_memcpy (packetBuffer.data, sock->sendMessage, dataLen);
+
+	sock->sendNext = false;
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	sock->lastSendTime = net_time;
+	packetsReSent++;
+	return 1;
+}
+
+
+qboolean Datagram_CanSendMessage (qsocket_t *sock)
+{
+	if (WINDOW(sock))
+	{
+		Window_Transmit (sock);
+		return sock->canSend;
+	}
+
+	if (sock->sendNext)
+		SendMessageNext (sock);
+
+	return sock->canSend;
+}
+
+
+qboolean Datagram_CanSendUnreliableMessage (qsocket_t *sock)
+{
+	return true;
+}
+
+
+int Datagram_SendUnreliableMessage (qsocket_t *sock, sizebuf_t *data)
+{
+	int 	packetLen;
+
+#ifdef DEBUG
+	if (data->cursize == 0)
+		Sys_Error("zero length message\n");
+
+	if (data->cursize > MAX_DATAGRAM)
+		Sys_Error("message too big %u\n", data->cursize);
+#endif
+
+	packetLen = NET_HEADERSIZE + data->cursize;
+
+	packetBuffer.length = BigLong(packetLen | NETFLAG_UNRELIABLE);
+	packetBuffer.sequence = BigLong(sock->unreliableSendSequence++);
+	Q_memcpy (packetBuffer.data, data->data, data->cursize);
+
+	if (sfunc.Write (sock->socket, (byte *)&packetBuffer, packetLen, &sock->addr) == -1)
+		return -1;
+
+	packetsSent++;
+	return 1;
+}
+
+
+int	Datagram_GetMessage (qsocket_t *sock)
+{
+	unsigned int	length;
+	unsigned int	flags;
+	int				ret = 0;
+	struct qsockaddr readaddr;
+	unsigned int	sequence;
+	unsigned int	count;
+
+	if (WINDOW(sock))
+	{
+		if ((ret = Window_Deliver (sock)) != 0)
+			return ret;
+		Window_Transmit (sock);
+	}
+	else if (!sock->canSend)
+		if ((net_time - sock->lastSendTime) > 1.0)
+			ReSendMessage (sock);
+
+	while(1)
+	{	
+		length = sfunc.Read (sock->socket, (byte *)&packetBuffer, NET_DATAGRAMSIZE, &readaddr);
+
+//	if ((rand() & 255) > 220)
+//		continue;
+
+		if (length == 0)
+			break;
+
+		if (length == -1)
+		{
+			Con_Printf("Read error\n");
+			return -1;
+		}
+
+		if (sfunc.AddrCompare(&readaddr, &sock->addr) != 0)
+		{
+#ifdef DEBUG
+			Con_DPrintf("Forged packet received\n");
+			Con_DPrintf("Expected: %s\n", StrAddr (&sock->addr));
+			Con_DPrintf("Received: %s\n", StrAddr (&readaddr));
+#endif
+			continue;
+		}
+
+		if (length < NET_HEADERSIZE)
+		{
+			shortPacketCount++;
+			continue;
+		}
+
+		length = BigLong(packetBuffer.length);
+		flags = length & (~NETFLAG_LENGTH_MASK);
+		length &= NETFLAG_LENGTH_MASK;
+
+		if (flags & NETFLAG_CTL)
+			continue;
+
+		sequence = BigLong(packetBuffer.sequence);
+		packetsReceived++;
+
+		if (flags & NETFLAG_UNRELIABLE)
+		{
+			if (sequence < sock->unreliableReceiveSequence)
+			{
+				Con_DPrintf("Got a stale datagram\n");
+				ret = 0;
+				break;
+			}
+			if (sequence != sock->unreliableReceiveSequence)
+			{
+				count = sequence - sock->unreliableReceiveSequence;
+				droppedDatagrams += count;
+				Con_DPrintf("Dropped %u datagram(s)\n", count);
+			}
+			sock->unreliableReceiveSequence = sequence + 1;
+
+			length -= NET_HEADERSIZE;
+
+			SZ_Clear (&net_message);
+			SZ_Write (&net_message, packetBuffer.data, length);
+
+			ret = 2;
+			break;
+		}
+
+		if (WINDOW(sock) && (flags & NETFLAG_ACK))
+		{
+			Window_Ack (sock, sequence, length >= NET_HEADERSIZE + 4 ? BigLong(*(unsigned int *)packetBuffer.data) : sequence + 1);
+			continue;
+		}
+
+		if (WINDOW(sock) && (flags & NETFLAG_DATA))
+		{
+			Window_Receive (sock, sequence, flags, length - NET_HEADERSIZE, &readaddr);
+			if ((ret = Window_Deliver (sock)) == -1)
+				return -1;		// closed, nothing left to transmit
+			if (ret)
+				break;
+			continue;
+		}
+
+		if (flags & NETFLAG_ACK)
+		{
+			if (sequence != (sock->sendSequence - 1))
+			{
+				Con_DPrintf("Stale ACK received\n");
+				continue;
+			}
+			if (sequence == sock->ackSequence)
+			{
+				sock->ackSequence++;
+				if (sock->ackSequence != sock->sendSequence)
+					Con_DPrintf("ack sequencing error\n");
+			}
+			else
+			{
+				Con_DPrintf("Duplicate ACK received\n");
+				continue;
+			}
+			sock->sendMessageLength -= MAX_DATAGRAM;
+			if (sock->sendMessageLength > 0)
+			{
+				Q_memcpy(sock->sendMessage, sock->sendMessage+MAX_DATAGRAM, sock->sendMessageLength);
+				sock->sendNext = true;
+			}
+			else
+			{
+				sock->sendMessageLength = 0;
+				sock->canSend = true;
+			}
+			continue;
+		}
+
+		if (flags & NETFLAG_DATA)
+		{
+			packetBuffer.length = BigLong(NET_HEADERSIZE | NETFLAG_ACK);
+			packetBuffer.sequence = BigLong(sequence);
+			sfunc.Write (sock->socket, (byte *)&packetBuffer, NET_HEADERSIZE, &readaddr);
+
+			if (sequence != sock->receiveSequence)
+			{
+				receivedDuplicateCount++;
+				continue;
+			}
+			sock->receiveSequence++;
+
+			length -= NET_HEADERSIZE;
+
+			if (flags & NETFLAG_EOM)
+			{
+				SZ_Clear(&net_message);
+				SZ_Write(&net_message, sock->receiveMessage, sock->receiveMessageLength);
+				SZ_Write(&net_message, packetBuffer.data, length);
+				sock->receiveMessageLength = 0;
+
+				ret = 1;
+				break;
+			}
+
+			Q_memcpy(sock->receiveMessage + sock->receiveMessageLength, packetBuffer.data, length);
+			sock->receiveMessageLength += length;
+			continue;
+		}
+	}
+
+	if (WINDOW(sock))
+		Window_Transmit (sock);
+	else if (sock->sendNext)
+		SendMessageNext (sock);
+
+	return ret;
+}
+
+
+void PrintStats(qsocket_t *s)
+{
+	dgrmwindow_t	*w;
+
+	Con_Printf("canSend = %4u   \n", s->canSend);
+	Con_Printf("sendSeq = %4u   ", s->sendSequence);
+	Con_Printf("recvSeq = %4u   \n", s->receiveSequence);
+	if (s->driver == myDriverLevel && (w = WINDOW(s)))
+	{
+		Con_Printf("inFlight = %4u   ", w->nextsend - s->ackSequence);
+		Con_Printf("queued = %4u   \n", s->sendSequence - w->nextsend);
+		Con_Printf("srtt = %5.1f ms   ", w->srtt * 1000.0);
+		Con_Printf("rto = %5.1f ms   \n", w->rto * 1000.0);
+		Con_Printf("reSent = %4i   ", w->resent);
+		Con_Printf("early = %4i   \n", w->early);
+	}
+	Con_Printf("\n");
+}
+
+void NET_Stats_f (void)
+{
+	qsocket_t	*s;
+
+	if (Cmd_Argc () == 1)
+	{
+		Con_Printf("unreliable messages sent   = %i\n", unreliableMessagesSent);
+		Con_Printf("unreliable messages recv   = %i\n", unreliableMessagesReceived);
+		Con_Printf("reliable messages sent     = %i\n", messagesSent);
+		Con_Printf("reliable messages received = %i\n", messagesReceived);
+		Con_Printf("packetsSent                = %i\n", packetsSent);
+		Con_Printf("packetsReSent              = %i\n", packetsReSent);
+		Con_Printf("packetsReceived            = %i\n", packetsReceived);
+		Con_Printf("receivedDuplicateCount     = %i\n", receivedDuplicateCount);
+		Con_Printf("shortPacketCount           = %i\n", shortPacketCount);
+		Con_Printf("droppedDatagrams           = %i\n", droppedDatagrams);
+	}
+	else if (strcmp(Cmd_Argv(1), "*") == 0)
+	{
+		for (s = net_activeSockets; s; s = s->next)
+			PrintStats(s);
+		for (s = net_freeSockets; s; s = s->next)
+			PrintStats(s);
+	}
+	else
+	{
+		for (s = net_activeSockets; s; s = s->next)
+			if (Q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+				break;
+		if (s == NULL)
+			for (s = net_freeSockets; s; s = s->next)
+				if (Q_strcasecmp(Cmd_Argv(1), s->address) == 0)
+					break;
+		if (s == NULL)
+			return;
+		PrintStats(s);
+	}
+}
+
+
+static qboolean testInProgress = false;
+static int		testPollCount;
+static int		testDriver;
+static int		testSocket;
+
+static void Test_Poll(void* unused);
+PollProcedure	testPollProcedure = {NULL, 0.0, Test_Poll};
+
+static void Test_Poll(void* unused)
+{
+	struct qsockaddr clientaddr;
+	int		control;
+	int		len;
+	char	name[32];
+	char	address[64];
+
+	net_landriverlevel = testDriver;
+
+	while (1)
+	{
+		len = dfunc.Read (testSocket, net_message.data, net_message.maxsize, &clientaddr);
+		if (len < sizeof(int))
+			break;
+
+		net_message.cursize = len;
+
+		MSG_BeginReading ();
+		control = BigLong(*((int *)net_message.data));
+		MSG_ReadLong();
+		if (control == -1)
+			break;
+		if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+			break;
+		if ((control & NETFLAG_LENGTH_MASK) != len)
+			break;
+
+		if (MSG_ReadByte() != CCREP_PLAYER_INFO)
+			Sys_Error("Unexpected repsonse to Player Info request\n");
+
+		MSG_ReadByte();
+		Q_strcpy(name, MSG_ReadString());
+		MSG_ReadLong();
+		MSG_ReadLong();
+		MSG_ReadLong();
+		Q_strcpy(address, MSG_ReadString());
+	}
+
+	testPollCount--;
+	if (testPollCount)
+	{
+		SchedulePollProcedure(&testPollProcedure, 0.1);
+	}
+	else
+	{
+		dfunc.CloseSocket(testSocket);
+		testInProgress = false;
+	}
+}
+
+static void Test_f (void)
+{
+	char	*host;
+	int		n;
+	int		max = MAX_SCOREBOARD;
+	struct qsockaddr sendaddr;
+
+	if (testInProgress)
+		return;
+
+	host = Cmd_Argv (1);
+
+	if (host && hostCacheCount)
+	{
+		for (n = 0; n < hostCacheCount; n++)
+			if (Q_strcasecmp (host, hostcache[n].name) == 0)
+			{
+				if (hostcache[n].driver != myDriverLevel)
+					continue;
+				net_landriverlevel = hostcache[n].ldriver;
+				max = hostcache[n].maxusers;
+				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
+				break;
+			}
+		if (n < hostCacheCount)
+			goto JustDoIt;
+	}
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	{
+		if (!net_landrivers[net_landriverlevel].initialized)
+			continue;
+
+		// see if we can resolve the host name
+		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
+			break;
+	}
+	if (net_landriverlevel == net_numlandrivers)
+		return;
+
+JustDoIt:
+	testSocket = dfunc.OpenSocket(0);
+	if (testSocket == -1)
+		return;
+
+	testInProgress = true;
+	testPollCount = 20;
+	testDriver = net_landriverlevel;
+
+	for (n = 0; n < max; n++)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREQ_PLAYER_INFO);
+		MSG_WriteByte(&net_message, n);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | 	(net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (testSocket, net_message.data, net_message.cursize, &sendaddr);
+	}
+	SZ_Clear(&net_message);
+	SchedulePollProcedure(&testPollProcedure, 0.1);
+}
+
+
+static qboolean test2InProgress = false;
+static int		test2Driver;
+static int		test2Socket;
+
+static void Test2_Poll(void* unused);
+PollProcedure	test2PollProcedure = {NULL, 0.0, Test2_Poll};
+
+static void Test2_Poll(void* unused)
+{
+	struct qsockaddr clientaddr;
+	int		control;
+	int		len;
+	char	name[256];
+	char	value[256];
+
+	net_landriverlevel = test2Driver;
+	name[0] = 0;
+
+	len = dfunc.Read (test2Socket, net_message.data, net_message.maxsize, &clientaddr);
+	if (len < sizeof(int))
+		goto Reschedule;
+
+	net_message.cursize = len;
+
+	MSG_BeginReading ();
+	control = BigLong(*((int *)net_message.data));
+	MSG_ReadLong();
+	if (control == -1)
+		goto Error;
+	if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+		goto Error;
+	if ((control & NETFLAG_LENGTH_MASK) != len)
+		goto Error;
+
+	if (MSG_ReadByte() != CCREP_RULE_INFO)
+		goto Error;
+
+	Q_strcpy(name, MSG_ReadString());
+	if (name[0] == 0)
+		goto Done;
+	Q_strcpy(value, MSG_ReadString());
+
+	Con_Printf("%-16.16s  %-16.16s\n", name, value);
+
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
+	MSG_WriteString(&net_message, name);
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &clientaddr);
+	SZ_Clear(&net_message);
+
+Reschedule:
+	SchedulePollProcedure(&test2PollProcedure, 0.05);
+	return;
+
+Error:
+	Con_Printf("Unexpected repsonse to Rule Info request\n");
+Done:
+	dfunc.CloseSocket(test2Socket);
+	test2InProgress = false;
+	return;
+}
+
+static void Test2_f (void)
+{
+	char	*host;
+	int		n;
+	struct qsockaddr sendaddr;
+
+	if (test2InProgress)
+		return;
+
+	host = Cmd_Argv (1);
+
+	if (host && hostCacheCount)
+	{
+		for (n = 0; n < hostCacheCount; n++)
+			if (Q_strcasecmp (host, hostcache[n].name) == 0)
+			{
+				if (hostcache[n].driver != myDriverLevel)
+					continue;
+				net_landriverlevel = hostcache[n].ldriver;
+				Q_memcpy(&sendaddr, &hostcache[n].addr, sizeof(struct qsockaddr));
+				break;
+			}
+		if (n < hostCacheCount)
+			goto JustDoIt;
+	}
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	{
+		if (!net_landrivers[net_landriverlevel].initialized)
+			continue;
+
+		// see if we can resolve the host name
+		if (dfunc.GetAddrFromName(host, &sendaddr) != -1)
+			break;
+	}
+	if (net_landriverlevel == net_numlandrivers)
+		return;
+
+JustDoIt:
+	test2Socket = dfunc.OpenSocket(0);
+	if (test2Socket == -1)
+		return;
+
+	test2InProgress = true;
+	test2Driver = net_landriverlevel;
+
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREQ_RULE_INFO);
+	MSG_WriteString(&net_message, "");
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (test2Socket, net_message.data, net_message.cursize, &sendaddr);
+	SZ_Clear(&net_message);
+	SchedulePollProcedure(&test2PollProcedure, 0.05);
+}
+
+
+int Datagram_Init (void)
+{
+	int i;
+	int csock;
+
+	myDriverLevel = net_driverlevel;
+	Cmd_AddCommand ("net_stats", NET_Stats_f);
+	Cvar_RegisterVariable (&net_window);
+
+	if (COM_CheckParm("-nolan"))
+		return -1;
+
+	for (i = 0; i < net_numlandrivers; i++)
+		{
+		csock = net_landrivers[i].Init ();
+		if (csock == -1)
+			continue;
+		net_landrivers[i].initialized = true;
+		net_landrivers[i].controlSock = csock;
+		if (COM_CheckParm("-netsim"))
+			Sim_Init (&net_landrivers[i]);
+		}
+
+#ifdef BAN_TEST
+	Cmd_AddCommand ("ban", NET_Ban_f);
+#endif
+	Cmd_AddCommand ("test", Test_f);
+	Cmd_AddCommand ("test2", Test2_f);
+
+	return 0;
+}
+
+
+void Datagram_Shutdown (void)
+{
+	int i;
+
+	Sim_Shutdown ();
+
+//
+// shutdown the lan drivers
+//
+	for (i = 0; i < net_numlandrivers; i++)
+	{
+		if (net_landrivers[i].initialized)
+		{
+			net_landrivers[i].Shutdown ();
+			net_landrivers[i].initialized = false;
+		}
+	}
+}
+
+
+void Datagram_Close (qsocket_t *sock)
+{
+	if (WINDOW(sock))
+		Window_Close (sock);
+	sfunc.CloseSocket(sock->socket);
+}
+
+
+void Datagram_Listen (qboolean state)
+{
+	int i;
+
+	for (i = 0; i < net_numlandrivers; i++)
+		if (net_landrivers[i].initialized)
+			net_landrivers[i].Listen (state);
+}
+
+
+static qsocket_t *_Datagram_CheckNewConnections (void)
+{
+	struct qsockaddr clientaddr;
+	struct qsockaddr newaddr;
+	int			newsock;
+	int			acceptsock;
+	qsocket_t	*sock;
+	qsocket_t	*s;
+	int			len;
+	int			command;
+	int			control;
+	int			ret;
+	int			caps;
+
+	acceptsock = dfunc.CheckNewConnections();
+	if (acceptsock == -1)
+		return NULL;
+
+	SZ_Clear(&net_message);
+
+	len = dfunc.Read (acceptsock, net_message.data, net_message.maxsize, &clientaddr);
+	if (len < sizeof(int))
+		return NULL;
+	net_message.cursize = len;
+
+	MSG_BeginReading ();
+	control = BigLong(*((int *)net_message.data));
+	MSG_ReadLong();
+	if (control == -1)
+		return NULL;
+	if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+		return NULL;
+	if ((control & NETFLAG_LENGTH_MASK) != len)
+		return NULL;
+
+	command = MSG_ReadByte();
+	if (command == CCREQ_SERVER_INFO)
+	{
+		if (strcmp(MSG_ReadString(), "QUAKE") != 0)
+			return NULL;
+
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_SERVER_INFO);
+		dfunc.GetSocketAddr(acceptsock, &newaddr);
+		MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+		MSG_WriteString(&net_message, hostname.string);
+		MSG_WriteString(&net_message, sv.name);
+		MSG_WriteByte(&net_message, net_activeconnections);
+		MSG_WriteByte(&net_message, svs.maxclients);
+		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
+
+	if (command == CCREQ_PLAYER_INFO)
+	{
+		int			playerNumber;
+		int			activeNumber;
+		int			clientNumber;
+		client_t	*client;
+		
+		playerNumber = MSG_ReadByte();
+		activeNumber = -1;
+		for (clientNumber = 0, client = svs.clients; clientNumber < svs.maxclients; clientNumber++, client++)
+		{
+			if (client->active)
+			{
+				activeNumber++;
+				if (activeNumber == playerNumber)
+					break;
+			}
+		}
+		if (clientNumber == svs.maxclients)
+			return NULL;
+
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_PLAYER_INFO);
+		MSG_WriteByte(&net_message, playerNumber);
+		MSG_WriteString(&net_message, client->name);
+		//MSG_WriteLong(&net_message, client->colors);
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteLong(&net_message, (int)(net_time - client->netconnection->connecttime));
+		MSG_WriteString(&net_message, client->netconnection->address);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+
+		return NULL;
+	}
+
+	if (command == CCREQ_RULE_INFO)
+	{
+		const char	*prevCvarName;
+		cvar_t			*var;
+
+		// find the search start location
+		prevCvarName = MSG_ReadString();
+		var = Cvar_FindVarAfter (prevCvarName, CVAR_SERVERINFO);
+
+		// send the response
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_RULE_INFO);
+		if (var)
+		{
+			MSG_WriteString(&net_message, var->name);
+			MSG_WriteString(&net_message, var->string);
+		}
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+
+		return NULL;
+	}
+
+	if (command != CCREQ_CONNECT)
+		return NULL;
+
+	if (strcmp(MSG_ReadString(), "QUAKE") != 0)
+		return NULL;
+
+	if (MSG_ReadByte() != NET_PROTOCOL_VERSION)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_REJECT);
+		MSG_WriteString(&net_message, "Incompatible version.\n");
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
+
+	// older clients end the request here
+	caps = MSG_ReadByte();
+	if (caps == -1)
+		caps = 0;
+	caps &= NET_CAP_WINDOW;
+
+#ifdef BAN_TEST
+	// check for a ban
+	if (clientaddr.sa_family == AF_INET)
+	{
+		struct sockaddr_in	sin;
+		unsigned long testAddr;
+		Q_memcpy (&sin, &clientaddr, sizeof(sin));
+		testAddr = sin.sin_addr.s_addr;
+		if ((testAddr & banMask) == banAddr)
+		{
+			SZ_Clear(&net_message);
+			// save space for the header, filled in later
+			MSG_WriteLong(&net_message, 0);
+			MSG_WriteByte(&net_message, CCREP_REJECT);
+			MSG_WriteString(&net_message, "You have been banned.\n");
+			*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+			dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+			SZ_Clear(&net_message);
+			return NULL;
+		}
+	}
+#endif
+
+	// see if this guy is already connected
+	for (s = net_activeSockets; s; s = s->next)
+	{
+		if (s->driver != net_driverlevel)
+			continue;
+		ret = dfunc.AddrCompare(&clientaddr, &s->addr);
+		if (ret >= 0)
+		{
+			// is this a duplicate connection reqeust?
+			if (ret == 0 && net_time - s->connecttime < 2.0)
+			{
+				// yes, so send a duplicate reply
+				SZ_Clear(&net_message);
+				// save space for the header, filled in later
+				MSG_WriteLong(&net_message, 0);
+				MSG_WriteByte(&net_message, CCREP_ACCEPT);
+				dfunc.GetSocketAddr(s->socket, &newaddr);
+				MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+				MSG_WriteByte(&net_message, WINDOW(s) ? NET_CAP_WINDOW : 0);
+				*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+				dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+				SZ_Clear(&net_message);
+				return NULL;
+			}
+			// it's somebody coming back in from a crash/disconnect
+			// so close the old qsocket and let their retry get them back in
+			NET_Close(s);
+			return NULL;
+		}
+	}
+
+	// allocate a QSocket
+	sock = NET_NewQSocket ();
+	if (sock == NULL)
+	{
+		// no room; try to let him know
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREP_REJECT);
+		MSG_WriteString(&net_message, "Server is full.\n");
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+		SZ_Clear(&net_message);
+		return NULL;
+	}
+
+	// allocate a network socket
+	newsock = dfunc.OpenSocket(0);
+	if (newsock == -1)
+	{
+		NET_FreeQSocket(sock);
+		return NULL;
+	}
+
+	// connect to the client
+	if (dfunc.Connect (newsock, &clientaddr) == -1)
+	{
+		dfunc.CloseSocket(newsock);
+		NET_FreeQSocket(sock);
+		return NULL;
+	}
+
+	// everything is allocated, just fill in the details	
+	sock->socket = newsock;
+	sock->landriver = net_landriverlevel;
+	sock->addr = clientaddr;
+	Q_strcpy(sock->address, dfunc.AddrToString(&clientaddr));
+	if (caps & NET_CAP_WINDOW)
+		Window_Open (sock);
+
+	// send him back the info about the server connection he has been allocated
+	SZ_Clear(&net_message);
+	// save space for the header, filled in later
+	MSG_WriteLong(&net_message, 0);
+	MSG_WriteByte(&net_message, CCREP_ACCEPT);
+	dfunc.GetSocketAddr(newsock, &newaddr);
+	MSG_WriteLong(&net_message, dfunc.GetSocketPort(&newaddr));
+//	MSG_WriteString(&net_message, dfunc.AddrToString(&newaddr));
+	MSG_WriteByte(&net_message, caps);
+	*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+	dfunc.Write (acceptsock, net_message.data, net_message.cursize, &clientaddr);
+	SZ_Clear(&net_message);
+
+	return sock;
+}
+
+qsocket_t *Datagram_CheckNewConnections (void)
+{
+	qsocket_t *ret = NULL;
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+		if (net_landrivers[net_landriverlevel].initialized)
+			if ((ret = _Datagram_CheckNewConnections ()) != NULL)
+				break;
+	return ret;
+}
+
+
+static void _Datagram_SearchForHosts (qboolean xmit)
+{
+	int		ret;
+	int		n;
+	int		i;
+	struct qsockaddr readaddr;
+	struct qsockaddr myaddr;
+	int		control;
+
+	dfunc.GetSocketAddr (dfunc.controlSock, &myaddr);
+	if (xmit)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREQ_SERVER_INFO);
+		MSG_WriteString(&net_message, "QUAKE");
+		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Broadcast(dfunc.controlSock, net_message.data, net_message.cursize);
+		SZ_Clear(&net_message);
+	}
+
+	while ((ret = dfunc.Read (dfunc.controlSock, net_message.data, net_message.maxsize, &readaddr)) > 0)
+	{
+		if (ret < sizeof(int))
+			continue;
+		net_message.cursize = ret;
+
+		// don't answer our own query
+		if (dfunc.AddrCompare(&readaddr, &myaddr) >= 0)
+			continue;
+
+		// is the cache full?
+		if (hostCacheCount == HOSTCACHESIZE)
+			continue;
+
+		MSG_BeginReading ();
+		control = BigLong(*((int *)net_message.data));
+		MSG_ReadLong();
+		if (control == -1)
+			continue;
+		if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+			continue;
+		if ((control & NETFLAG_LENGTH_MASK) != ret)
+			continue;
+
+		if (MSG_ReadByte() != CCREP_SERVER_INFO)
+			continue;
+
+		dfunc.GetAddrFromName(MSG_ReadString(), &readaddr);
+		// search the cache for this server
+		for (n = 0; n < hostCacheCount; n++)
+			if (dfunc.AddrCompare(&readaddr, &hostcache[n].addr) == 0)
+				break;
+
+		// is it already there?
+		if (n < hostCacheCount)
+			continue;
+
+		// add it
+		hostCacheCount++;
+		Q_strcpy(hostcache[n].name, MSG_ReadString());
+		Q_strcpy(hostcache[n].map, MSG_ReadString());
+		hostcache[n].users = MSG_ReadByte();
+		hostcache[n].maxusers = MSG_ReadByte();
+		if (MSG_ReadByte() != NET_PROTOCOL_VERSION)
+		{
+			Q_strcpy(hostcache[n].cname, hostcache[n].name);
+			hostcache[n].cname[14] = 0;
+			Q_strcpy(hostcache[n].name, "*");
+			Q_strcat(hostcache[n].name, hostcache[n].cname);
+		}
+		Q_memcpy(&hostcache[n].addr, &readaddr, sizeof(struct qsockaddr));
+		hostcache[n].driver = net_driverlevel;
+		hostcache[n].ldriver = net_landriverlevel;
+		Q_strcpy(hostcache[n].cname, dfunc.AddrToString(&readaddr));
+
+		// check for a name conflict
+		for (i = 0; i < hostCacheCount; i++)
+		{
+			if (i == n)
+				continue;
+			if (Q_strcasecmp (hostcache[n].name, hostcache[i].name) == 0)
+			{
+				i = Q_strlen(hostcache[n].name);
+				if (i < 15 && hostcache[n].name[i-1] > '8')
+				{
+					hostcache[n].name[i] = '0';
+					hostcache[n].name[i+1] = 0;
+				}
+				else
+					hostcache[n].name[i-1]++;
+				i = -1;
+			}
+		}
+	}
+}
+
+void Datagram_SearchForHosts (qboolean xmit)
+{
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+	{
+		if (hostCacheCount == HOSTCACHESIZE)
+			break;
+		if (net_landrivers[net_landriverlevel].initialized)
+			_Datagram_SearchForHosts (xmit);
+	}
+}
+
+
+static qsocket_t *_Datagram_Connect (char *host)
+{
+	struct qsockaddr sendaddr;
+	struct qsockaddr readaddr;
+	qsocket_t	*sock;
+	int			newsock;
+	int			ret;
+	int			reps;
+	double		start_time;
+	int			control;
+	char		*reason;
+	double		connect_time;
+
+	// see if we can resolve the host name
+	if (dfunc.GetAddrFromName(host, &sendaddr) == -1)
+		return NULL;
+
+	newsock = dfunc.OpenSocket (0);
+	if (newsock == -1)
+		return NULL;
+
+	sock = NET_NewQSocket ();
+	if (sock == NULL)
+		goto ErrorReturn2;
+	sock->socket = newsock;
+	sock->landriver = net_landriverlevel;
+
+	// connect to the host
+	if (dfunc.Connect (newsock, &sendaddr) == -1)
+		goto ErrorReturn;
+
+	// send the connection request
+	Con_Printf("trying...\n"); SCR_UpdateScreen ();
+	start_time = connect_time = net_time;
+
+	for (reps = 0; reps < 3; reps++)
+	{
+		SZ_Clear(&net_message);
+		// save space for the header, filled in later
+		MSG_WriteLong(&net_message, 0);
+		MSG_WriteByte(&net_message, CCREQ_CONNECT);
+		MSG_WriteString(&net_message, "QUAKE");
+		MSG_WriteByte(&net_message, NET_PROTOCOL_VERSION);
+		MSG_WriteByte(&net_message, net_window.value ? NET_CAP_WINDOW : 0);
+		*((int *)net_message.data) = BigLong(NETFLAG_CTL | (net_message.cursize & NETFLAG_LENGTH_MASK));
+		dfunc.Write (newsock, net_message.data, net_message.cursize, &sendaddr);
+		SZ_Clear(&net_message);
+		do
+		{
+			ret = dfunc.Read (newsock, net_message.data, net_message.maxsize, &readaddr);
+			// if we got something, validate it
+			if (ret > 0)
+			{
+				// is it from the right place?
+				if (sfunc.AddrCompare(&readaddr, &sendaddr) != 0)
+				{
+#ifdef DEBUG
+					Con_Printf("wrong reply address\n");
+					Con_Printf("Expected: %s\n", StrAddr (&sendaddr));
+					Con_Printf("Received: %s\n", StrAddr (&readaddr));
+					SCR_UpdateScreen ();
+#endif
+					ret = 0;
+					continue;
+				}
+
+				if (ret < sizeof(int))
+				{
+					ret = 0;
+					continue;
+				}
+
+				net_message.cursize = ret;
+				MSG_BeginReading ();
+
+				control = BigLong(*((int *)net_message.data));
+				MSG_ReadLong();
+				if (control == -1)
+				{
+					ret = 0;
+					continue;
+				}
+				if ((control & (~NETFLAG_LENGTH_MASK)) !=  NETFLAG_CTL)
+				{
+					ret = 0;
+					continue;
+				}
+				if ((control & NETFLAG_LENGTH_MASK) != ret)
+				{
+					ret = 0;
+					continue;
+				}
+			}
+		}
+		while (ret == 0 && (SetNetTime() - start_time) < 2.5);
+		if (ret)
+			break;
+		Con_Printf("still trying...\n"); SCR_UpdateScreen ();
+		start_time = SetNetTime();
+	}
+
+	if (ret == 0)
+	{
+		reason = "No Response";
+		Con_Printf("%s\n", reason);
+		Q_strcpy(m_return_reason, reason);
+		goto ErrorReturn;
+	}
+
+	if (ret == -1)
+	{
+		reason = "Network Error";
+		Con_Printf("%s\n", reason);
+		Q_strcpy(m_return_reason, reason);
+		goto ErrorReturn;
+	}
+
+	ret = MSG_ReadByte();
+	if (ret == CCREP_REJECT)
+	{
+		reason = MSG_ReadString();
+		Con_Printf(reason);
+		Q_strncpy(m_return_reason, reason, 31);
+		goto ErrorReturn;
+	}
+
+	if (ret == CCREP_ACCEPT)
+	{
+		Q_memcpy(&sock->addr, &sendaddr, sizeof(struct qsockaddr));
+		dfunc.SetSocketPort (&sock->addr, MSG_ReadLong());
+		// older servers end the reply here
+		if (MSG_ReadByte() == NET_CAP_WINDOW && net_window.value)
+			Window_Open (sock);
+	}
+	else
+	{
+		reason = "Bad Response";
+		Con_Printf("%s\n", reason);
+		Q_strcpy(m_return_reason, reason);
+		goto ErrorReturn;
+	}
+
+	dfunc.GetNameFromAddr (&sendaddr, sock->address);
+
+	Con_Printf ("Connection accepted\n");
+	sock->lastMessageTime = SetNetTime();
+	Con_DPrintf ("Handshake took %.3f seconds, %s reliable messages\n", net_time - connect_time,
+		WINDOW(sock) ? "windowed" : "stop-and-wait");
+
+	// switch the connection to the specified address
+	if (dfunc.Connect (newsock, &sock->addr) == -1)
+	{
+		reason = "Connect to Game failed";
+		Con_Printf("%s\n", reason);
+		Q_strcpy(m_return_reason, reason);
+		goto ErrorReturn;
+	}
+
+	m_return_onerror = false;
+	return sock;
+
+ErrorReturn:
+	NET_FreeQSocket(sock);
+ErrorReturn2:
+	dfunc.CloseSocket(newsock);
+	if (m_return_onerror)
+	{
+		key_dest = key_menu;
+		m_state = m_return_state;
+		m_return_onerror = false;
+	}
+	return NULL;
+}
+
+qsocket_t *Datagram_Connect (char *host)
+{
+	qsocket_t *ret = NULL;
+
+	for (net_landriverlevel = 0; net_landriverlevel < net_numlandrivers; net_landriverlevel++)
+		if (net_landrivers[net_landriverlevel].initialized)
+			if ((ret = _Datagram_Connect (host)) != NULL)
+				break;
+	return ret;
+}
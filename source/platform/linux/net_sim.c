@@ -0,0 +1,445 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// net_sim.c -- network condition simulator
+
+#include "../../nzportable_def.h"
+#include "net_sim.h"
+
+// The simulator sits between the datagram driver and a lan driver, the way
+// the VCR sits between the host and the net drivers.  Every packet the
+// datagram layer writes passes through Sim_Write, where it can be lost,
+// duplicated, delayed or held back behind later packets before it reaches
+// the real driver.  Working on packets rather than whole messages means the
+// reliable channel sees the same damage it would on a real link and has to
+// recover from it with its own acks and resends.
+//
+// Only outgoing packets are touched, so each end of a connection simulates
+// its own direction: set the cvars on both the server and the client to
+// damage both.  The random stream is reseeded from net_simseed, so the same
+// traffic with the same settings loses and delays the same packets.
+
+cvar_t	net_simlatency = {"net_simlatency", "0"};	// milliseconds added to every packet
+cvar_t	net_simjitter = {"net_simjitter", "0"};		// up to this many more milliseconds, at random
+cvar_t	net_simloss = {"net_simloss", "0"};			// percent of packets dropped
+cvar_t	net_simdup = {"net_simdup", "0"};			// percent of packets sent twice
+cvar_t	net_simreorder = {"net_simreorder", "0"};	// percent of packets delivered after later ones
+cvar_t	net_simseed = {"net_simseed", "1"};
+
+#define	MAX_SIMPACKETS	1024
+#define	MAX_SIMPEERS	32
+
+// a reordered packet is held this much longer than the jitter allows, so
+// at least the packets sent right after it overtake it
+#define	SIM_REORDERDELAY	0.02
+
+enum
+{
+	SIM_CTL,
+	SIM_DATA,
+	SIM_ACK,
+	SIM_UNRELIABLE,
+	SIM_NUMCLASSES
+};
+
+static char *sim_classnames[SIM_NUMCLASSES] = {"control", "reliable", "ack", "unreliable"};
+
+typedef struct
+{
+	struct qsockaddr	addr;
+	int					sent[SIM_NUMCLASSES];
+	int					lost[SIM_NUMCLASSES];
+	int					duped[SIM_NUMCLASSES];
+	int					reordered;
+	int					overflowed;
+	int					bytes;
+	int					delayed;
+	double				delay;			// sum of the delays of the delayed packets
+	double				lastdue;		// in order packets never leave before this
+	int					queued;
+	int					peakqueued;
+} simpeer_t;
+
+typedef struct
+{
+	double				time;
+	int					socket;
+	int					length;
+	simpeer_t			*peer;
+	struct qsockaddr	addr;
+	byte				data[NET_DATAGRAMSIZE];
+} simpacket_t;
+
+static net_landriver_t	sim_real;		// the wrapped driver's own functions
+static qboolean			sim_wrapped;
+
+static simpacket_t		*sim_packets;
+static int				sim_free[MAX_SIMPACKETS];
+static int				sim_numfree;
+static int				sim_queue[MAX_SIMPACKETS];	// by release time
+static int				sim_numqueued;
+
+static simpeer_t		sim_peers[MAX_SIMPEERS];
+static int				sim_numpeers;
+
+static unsigned int		sim_rand;
+static float			sim_seed;
+
+/*
+================
+Sim_Seed
+================
+*/
+static void Sim_Seed (void)
+{
+	sim_seed = net_simseed.value;
+
+	// spread small seeds over the whole word, xorshift started from a
+	// few low bits draws tiny numbers first and drops the first packets
+	sim_rand = ((unsigned int)sim_seed + 1) * 2654435769u;
+	if (!sim_rand)
+		sim_rand = 1;		// xorshift sticks at zero
+}
+
+/*
+================
+Sim_Random
+
+Returns 0 <= x < 1
+================
+*/
+static float Sim_Random (void)
+{
+	sim_rand ^= sim_rand << 13;
+	sim_rand ^= sim_rand >> 17;
+	sim_rand ^= sim_rand << 5;
+
+	return (sim_rand >> 8) * (1.0 / 16777216.0);
+}
+
+static qboolean Sim_Active (void)
+{
+	return net_simlatency.value > 0 || net_simjitter.value > 0 || net_simloss.value > 0
+		|| net_simdup.value > 0 || net_simreorder.value > 0;
+}
+
+static int Sim_Class (byte *buf, int len)
+{
+	unsigned int	flags;
+
+	if (len < 4)
+		return SIM_CTL;
+
+	flags = BigLong(*((unsigned int *)buf));
+	if (flags & NETFLAG_CTL)
+		return SIM_CTL;
+	if (flags & NETFLAG_ACK)
+		return SIM_ACK;
+	if (flags & NETFLAG_UNRELIABLE)
+		return SIM_UNRELIABLE;
+	return SIM_DATA;
+}
+
+/*
+================
+Sim_Peer
+
+Peers past MAX_SIMPEERS share the last slot
+================
+*/
+static simpeer_t *Sim_Peer (struct qsockaddr *addr)
+{
+	simpeer_t	*p;
+	int			i;
+
+	for (i = 0, p = sim_peers; i < sim_numpeers; i++, p++)
+		if (sim_real.AddrCompare (addr, &p->addr) == 0)
+			return p;
+
+	if (sim_numpeers == MAX_SIMPEERS)
+		return &sim_peers[MAX_SIMPEERS - 1];
+
+	p = &sim_peers[sim_numpeers++];
+	Q_memset (p, 0, sizeof(*p));
+	p->addr = *addr;
+	return p;
+}
+
+/*
+================
+Sim_Flush
+
+Hands every packet that is due to the real driver.  When the simulation
+is switched off everything still queued goes at once.
+================
+*/
+static void Sim_Flush (qboolean all)
+{
+	simpacket_t	*p;
+	double		now;
+
+	if (!sim_numqueued)
+		return;
+
+	if (!Sim_Active ())
+		all = true;
+
+	now = Sys_FloatTime ();
+	while (sim_numqueued)
+	{
+		p = &sim_packets[sim_queue[0]];
+		if (!all && p->time > now)
+			break;
+
+		sim_real.Write (p->socket, p->data, p->length, &p->addr);
+		p->peer->queued--;
+
+		sim_free[sim_numfree++] = sim_queue[0];
+		sim_numqueued--;
+		memmove (sim_queue, sim_queue + 1, sim_numqueued * sizeof(sim_queue[0]));
+	}
+}
+
+/*
+================
+Sim_Queue
+================
+*/
+static void Sim_Queue (int socket, byte *buf, int len, struct qsockaddr *addr, simpeer_t *peer, double time)
+{
+	simpacket_t	*p;
+	int			i, n;
+
+	// a full queue drops the packet, as a congested link would
+	if (!sim_numfree || len > NET_DATAGRAMSIZE)
+	{
+		peer->overflowed++;
+		return;
+	}
+
+	n = sim_free[--sim_numfree];
+	p = &sim_packets[n];
+	p->time = time;
+	p->socket = socket;
+	p->length = len;
+	p->peer = peer;
+	p->addr = *addr;
+	Q_memcpy (p->data, buf, len);
+
+	// after everything due at the same time, so equal times keep send order
+	for (i = sim_numqueued; i > 0; i--)
+		if (sim_packets[sim_queue[i - 1]].time <= time)
+			break;
+	memmove (sim_queue + i + 1, sim_queue + i, (sim_numqueued - i) * sizeof(sim_queue[0]));
+	sim_queue[i] = n;
+	sim_numqueued++;
+
+	if (++peer->queued > peer->peakqueued)
+		peer->peakqueued = peer->queued;
+}
+
+
+int Sim_CheckNewConnections (void)
+{
+	Sim_Flush (false);
+	return sim_real.CheckNewConnections ();
+}
+
+
+int Sim_Read (int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+	Sim_Flush (false);
+	return sim_real.Read (socket, buf, len, addr);
+}
+
+
+int Sim_Write (int socket, byte *buf, int len, struct qsockaddr *addr)
+{
+	simpeer_t	*peer;
+	int			class;
+	int			copies;
+	double		now, delay, time;
+	qboolean	reorder;
+
+	Sim_Flush (false);
+
+	peer = Sim_Peer (addr);
+	class = Sim_Class (buf, len);
+	peer->sent[class]++;
+	peer->bytes += len;
+
+	if (!Sim_Active ())
+		return sim_real.Write (socket, buf, len, addr);
+
+	if (net_simseed.value != sim_seed)
+		Sim_Seed ();
+
+	if (net_simloss.value > 0 && Sim_Random () * 100 < net_simloss.value)
+	{
+		peer->lost[class]++;
+		return len;
+	}
+
+	copies = 1;
+	if (net_simdup.value > 0 && Sim_Random () * 100 < net_simdup.value)
+	{
+		peer->duped[class]++;
+		copies = 2;
+	}
+
+	reorder = net_simreorder.value > 0 && Sim_Random () * 100 < net_simreorder.value;
+
+	now = Sys_FloatTime ();
+	while (copies--)
+	{
+		delay = max(net_simlatency.value, 0) * 0.001;
+		if (net_simjitter.value > 0)
+			delay += Sim_Random () * net_simjitter.value * 0.001;
+
+		if (reorder)
+		{
+			delay += max(net_simjitter.value * 0.001, 0) + SIM_REORDERDELAY;
+			peer->reordered++;
+			reorder = false;
+			time = now + delay;
+		}
+		else
+		{
+			// jitter alone does not reorder, as on most real routes
+			time = max(now + delay, peer->lastdue);
+			peer->lastdue = time;
+		}
+
+		if (time > now)
+		{
+			peer->delayed++;
+			peer->delay += time - now;
+		}
+		Sim_Queue (socket, buf, len, addr, peer, time);
+	}
+
+	Sim_Flush (false);
+
+	return len;
+}
+
+/*
+================
+Sim_Stats_f
+
+netsim [reset]
+================
+*/
+static void Sim_Stats_f (void)
+{
+	simpeer_t	*p;
+	int			i, c;
+
+	if (Cmd_Argc () > 1 && !Q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		for (i = 0, p = sim_peers; i < sim_numpeers; i++, p++)
+		{
+			Q_memset (p->sent, 0, sizeof(p->sent));
+			Q_memset (p->lost, 0, sizeof(p->lost));
+			Q_memset (p->duped, 0, sizeof(p->duped));
+			p->reordered = p->overflowed = p->bytes = p->delayed = 0;
+			p->delay = 0;
+			p->peakqueued = p->queued;
+		}
+		Sim_Seed ();
+		Con_Printf ("netsim statistics cleared, seed %u\n", sim_rand);
+		return;
+	}
+
+	Con_Printf ("latency %g ms, jitter %g ms, loss %g%%, dup %g%%, reorder %g%%, seed %g\n",
+		net_simlatency.value, net_simjitter.value, net_simloss.value,
+		net_simdup.value, net_simreorder.value, net_simseed.value);
+	Con_Printf ("%i of %i packets queued\n", sim_numqueued, MAX_SIMPACKETS);
+
+	for (i = 0, p = sim_peers; i < sim_numpeers; i++, p++)
+	{
+		if (i == MAX_SIMPEERS - 1)
+			Con_Printf ("%s and later peers\n", sim_real.AddrToString (&p->addr));
+		else
+			Con_Printf ("%s\n", sim_real.AddrToString (&p->addr));
+		Con_Printf ("  %i bytes, %i reordered, %i overflowed, %i peak queued, %.1f ms avg delay\n",
+			p->bytes, p->reordered, p->overflowed, p->peakqueued,
+			p->delayed ? p->delay * 1000 / p->delayed : 0);
+
+		for (c = 0; c < SIM_NUMCLASSES; c++)
+		{
+			if (!p->sent[c])
+				continue;
+			Con_Printf ("  %-10s %6i sent %5i lost (%4.1f%%) %5i duplicated\n",
+				sim_classnames[c], p->sent[c], p->lost[c],
+				p->lost[c] * 100.0 / p->sent[c], p->duped[c]);
+		}
+	}
+}
+
+/*
+================
+Sim_Init
+
+Wraps the packet functions of one lan driver
+================
+*/
+void Sim_Init (net_landriver_t *driver)
+{
+	int		i;
+
+	if (sim_wrapped)
+		return;
+	sim_wrapped = true;
+
+	sim_real = *driver;
+	driver->CheckNewConnections = Sim_CheckNewConnections;
+	driver->Read = Sim_Read;
+	driver->Write = Sim_Write;
+
+	sim_packets = Q_malloc (MAX_SIMPACKETS * sizeof(simpacket_t));
+	for (i = 0; i < MAX_SIMPACKETS; i++)
+		sim_free[i] = MAX_SIMPACKETS - 1 - i;
+	sim_numfree = MAX_SIMPACKETS;
+
+	Cvar_RegisterVariable (&net_simlatency);
+	Cvar_RegisterVariable (&net_simjitter);
+	Cvar_RegisterVariable (&net_simloss);
+	Cvar_RegisterVariable (&net_simdup);
+	Cvar_RegisterVariable (&net_simreorder);
+	Cvar_RegisterVariable (&net_simseed);
+	Cmd_AddCommand ("netsim", Sim_Stats_f);
+
+	Sim_Seed ();
+}
+
+/*
+================
+Sim_Shutdown
+
+Sends whatever is still held, so a disconnect is not lost with the queue
+================
+*/
+void Sim_Shutdown (void)
+{
+	if (!sim_wrapped)
+		return;
+
+	Sim_Flush (true);
+}
@@ -0,0 +1,42 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// platform_def.h -- Linux-specific header to compliment primary definitions (../nzportable_def.h)
+//                   as a general rule, please try to keep this file as small as possible, and
+//                   provide context as to why additions are necessary.
+//
+//                   The Linux target is a headless host build used to run dedicated servers
+//                   and benchmarks on commodity machines. It shares the Nspire software
+//                   renderer headers, so it keeps the same definitions Nspire relies on.
+
+// Fixed point types and helpers the shared Nspire renderer headers are written against.
+#include "../nspire/nspire_math.h"
+
+// glibc does not ship the BSD strlcpy and strlcat the engine uses.
+#include <stddef.h>
+#include "strl_fn.h"
+#define strlcpy q_strlcpy
+#define strlcat q_strlcat
+
+// Some platforms have not fully migrated to bool from qboolean, the Nspire headers included.
+#define qtrue   1
+#define qfalse  0
+
+void Draw_Fill (int x, int y, int w, int h, int c);
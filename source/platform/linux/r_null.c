@@ -0,0 +1,204 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// r_null.c -- null refresh for headless builds. World and entity state is
+// still kept up to date by the client, nothing is ever drawn.
+
+#include "../../nzportable_def.h"
+
+refdef_t	r_refdef;
+
+vec3_t		r_origin, vpn, vright, vup;
+
+int			r_framecount = 1;
+int			r_pixbytes = 1;
+
+texture_t	*r_notexture_mip;
+
+/*
+==================
+R_InitTextures
+
+Models still reference r_notexture_mip for missing textures, so this is
+needed even for dedicated servers.
+==================
+*/
+void	R_InitTextures (void)
+{
+	int		x,y, m;
+	byte	*dest;
+
+// create a simple checkerboard texture for the default
+	r_notexture_mip = Hunk_AllocName (sizeof(texture_t) + 16*16+8*8+4*4+2*2, "notexture");
+
+	r_notexture_mip->width = r_notexture_mip->height = 16;
+	r_notexture_mip->offsets[0] = sizeof(texture_t);
+	r_notexture_mip->offsets[1] = r_notexture_mip->offsets[0] + 16*16;
+	r_notexture_mip->offsets[2] = r_notexture_mip->offsets[1] + 8*8;
+	r_notexture_mip->offsets[3] = r_notexture_mip->offsets[2] + 4*4;
+
+	for (m=0 ; m<4 ; m++)
+	{
+		dest = (byte *)r_notexture_mip + r_notexture_mip->offsets[m];
+		for (y=0 ; y< (16>>m) ; y++)
+			for (x=0 ; x< (16>>m) ; x++)
+			{
+				if (  (y< (8>>m) ) ^ (x< (8>>m) ) )
+					*dest++ = 0;
+				else
+					*dest++ = 0xff;
+			}
+	}
+}
+
+void R_Init (void)
+{
+}
+
+void R_InitSky (texture_t *mt)
+{
+}
+
+void R_NewMap (void)
+{
+	r_framecount = 1;
+}
+
+/*
+================
+R_RenderView
+
+Only the view vectors are kept, the audio spatialization uses them.
+================
+*/
+void R_RenderView (void)
+{
+	VectorCopy (r_refdef.vieworg, r_origin);
+	AngleVectors (r_refdef.viewangles, vpn, vright, vup);
+
+	r_framecount++;
+}
+
+void R_ViewChanged (vrect_t *pvrect, int lineadj, float aspect)
+{
+}
+
+void R_SetVrect (vrect_t *pvrectin, vrect_t *pvrect, int lineadj)
+{
+	*pvrect = *pvrectin;
+}
+
+void R_PushDlights (void)
+{
+}
+
+void R_OcclusionDrawStats (void)
+{
+}
+
+//=============================================================================
+
+/*
+===============
+R_ParseParticleEffect
+
+The message still has to be read so the rest of it parses
+===============
+*/
+void R_ParseParticleEffect (void)
+{
+	int		i;
+
+	for (i=0 ; i<3 ; i++)
+		MSG_ReadCoord ();
+	for (i=0 ; i<3 ; i++)
+		MSG_ReadChar ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+}
+
+void R_RunParticleEffect (vec3_t org, vec3_t dir, int color, int count)
+{
+}
+
+void R_RocketTrail (vec3_t start, vec3_t end, int type)
+{
+}
+
+void R_BlobExplosion (vec3_t org)
+{
+}
+
+void R_ParticleExplosion (vec3_t org)
+{
+}
+
+void R_ParticleExplosion2 (vec3_t org, int colorStart, int colorLength)
+{
+}
+
+void R_LavaSplash (vec3_t org)
+{
+}
+
+void R_TeleportSplash (vec3_t org)
+{
+}
+
+//=============================================================================
+
+void D_EnableBackBufferAccess (void)
+{
+}
+
+void D_DisableBackBufferAccess (void)
+{
+}
+
+void D_UpdateRects (vrect_t *prect)
+{
+}
+
+/*
+================
+test_float32_shift
+
+Portable version of the Nspire exponent shift the fixed point helpers use
+================
+*/
+void test_float32_shift( float *f, int shift )
+{
+	int i_float;
+	int i_e;
+
+	memcpy(&i_float, f, sizeof(i_float));
+	i_e = ( i_float >> 23 ) & 0xff;
+	i_e += shift;
+	if( i_e > 0xfe )
+	{
+		i_e = 0xfe;
+	}
+	else if( i_e < 0x1 )
+	{
+		i_e = 0x1;
+	}
+	i_float = ( i_float & 0x807fffff ) | ( i_e << 23 );
+	memcpy(f, &i_float, sizeof(i_float));
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// snd_null.c -- null sound device for headless builds. The mixer still runs
+// into a memory ring that "plays" in real time, so mixing cost stays measurable.
+
+#include "../../nzportable_def.h"
+
+#define SAMPLE_RATE		44100
+#define BUFFER_SAMPLES	16384		// mono samples, power of two
+
+static short	dma_buffer[BUFFER_SAMPLES];
+static double	dma_starttime;
+
+qboolean SNDDMA_Init(void)
+{
+	shm = &sn;
+	shm->splitbuffer = 0;
+	shm->samplebits = 16;
+	shm->speed = SAMPLE_RATE;
+	shm->channels = 2;
+	shm->samples = BUFFER_SAMPLES;
+	shm->samplepos = 0;
+	shm->submission_chunk = 1;
+	shm->buffer = (unsigned char *)dma_buffer;
+
+	dma_starttime = Sys_FloatTime ();
+
+	return true;
+}
+
+int SNDDMA_GetDMAPos(void)
+{
+	double	elapsed;
+
+	elapsed = Sys_FloatTime () - dma_starttime;
+	shm->samplepos = ((long long)(elapsed * shm->speed) * shm->channels) & (shm->samples - 1);
+
+	return shm->samplepos;
+}
+
+void SNDDMA_Submit(void)
+{
+}
+
+void SNDDMA_Shutdown(void)
+{
+}
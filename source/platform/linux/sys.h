@@ -0,0 +1,47 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sys.h -- Linux shares the Nspire software renderer definitions
+
+#include "../nspire/sys.h"
+
+//
+// threads
+//
+#define	SYS_THREADS
+
+typedef struct sys_thread_s	sys_thread_t;
+typedef struct sys_mutex_s	sys_mutex_t;
+typedef struct sys_cond_s	sys_cond_t;
+
+sys_thread_t *Sys_CreateThread (void *(*func) (void *), void *arg);
+void Sys_WaitThread (sys_thread_t *thread);
+// waits for the thread to return and frees it
+
+sys_mutex_t *Sys_CreateMutex (void);
+void Sys_DestroyMutex (sys_mutex_t *mutex);
+void Sys_LockMutex (sys_mutex_t *mutex);
+void Sys_UnlockMutex (sys_mutex_t *mutex);
+
+sys_cond_t *Sys_CreateCond (void);
+void Sys_DestroyCond (sys_cond_t *cond);
+void Sys_WaitCond (sys_cond_t *cond, sys_mutex_t *mutex);
+void Sys_SignalCond (sys_cond_t *cond);
+// wakes every thread waiting on cond
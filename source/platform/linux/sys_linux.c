@@ -0,0 +1,440 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sys_linux.c -- headless Linux system driver for dedicated servers and benchmarks
+
+#include "../../nzportable_def.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+qboolean			isDedicated;
+
+cvar_t	sys_nostdout = {"sys_nostdout", "0"};
+
+extern int vcrFile;
+extern int recording;
+
+// progs string_t values are 32-bit offsets from pr_strings, and the engine
+// stores offsets to strings outside of the progs (client names, temp strings)
+// in them too. Keeping the hunk in .bss leaves it next to those statics on
+// 64-bit hosts, where a malloc'd hunk could land out of int range.
+#define LINUX_HUNK_MAX_MB		256
+#define LINUX_HUNK_DEFAULT_MB	64
+
+static byte sys_membase[LINUX_HUNK_MAX_MB * 1024 * 1024];
+
+/*
+===============================================================================
+
+FILE IO
+
+===============================================================================
+*/
+
+#define MAX_HANDLES             32
+FILE    *sys_handles[MAX_HANDLES];
+
+int             findhandle (void)
+{
+	int             i;
+
+	for (i=1 ; i<MAX_HANDLES ; i++)
+		if (!sys_handles[i])
+			return i;
+	Sys_Error ("out of handles");
+	return -1;
+}
+
+/*
+================
+filelength
+================
+*/
+int filelength (FILE *f)
+{
+	int             pos;
+	int             end;
+
+	pos = ftell (f);
+	fseek (f, 0, SEEK_END);
+	end = ftell (f);
+	fseek (f, pos, SEEK_SET);
+
+	return end;
+}
+
+int Sys_FileOpenRead (char *path, int *hndl)
+{
+	FILE    *f;
+	int             i;
+
+	i = findhandle ();
+
+	f = fopen(path, "rb");
+	if (!f)
+	{
+		*hndl = -1;
+		return -1;
+	}
+	sys_handles[i] = f;
+	*hndl = i;
+
+	return filelength(f);
+}
+
+int Sys_FileOpenWrite (char *path)
+{
+	FILE    *f;
+	int             i;
+
+	i = findhandle ();
+
+	f = fopen(path, "wb");
+	if (!f)
+		Sys_Error ("Error opening %s: %s", path,strerror(errno));
+	sys_handles[i] = f;
+
+	return i;
+}
+
+void Sys_FileClose (int handle)
+{
+	fclose (sys_handles[handle]);
+	sys_handles[handle] = NULL;
+}
+
+void Sys_FileSeek (int handle, int position)
+{
+	fseek (sys_handles[handle], position, SEEK_SET);
+}
+
+int Sys_FileRead (int handle, void *dest, int count)
+{
+	return fread (dest, 1, count, sys_handles[handle]);
+}
+
+int Sys_FileWrite (int handle, void *data, int count)
+{
+	return fwrite (data, 1, count, sys_handles[handle]);
+}
+
+int     Sys_FileTime (char *path)
+{
+	struct stat buf;
+
+	if (stat (path, &buf) == -1)
+		return -1;
+
+	return buf.st_mtime;
+}
+
+void Sys_mkdir (char *path)
+{
+	mkdir (path, 0777);
+}
+
+/*
+===============================================================================
+
+THREADS
+
+===============================================================================
+*/
+
+struct sys_thread_s
+{
+	pthread_t		thread;
+};
+
+struct sys_mutex_s
+{
+	pthread_mutex_t	mutex;
+};
+
+struct sys_cond_s
+{
+	pthread_cond_t	cond;
+};
+
+sys_thread_t *Sys_CreateThread (void *(*func) (void *), void *arg)
+{
+	sys_thread_t	*t;
+	int				err;
+
+	t = Q_malloc (sizeof(*t));
+	err = pthread_create (&t->thread, NULL, func, arg);
+	if (err)
+		Sys_Error ("Sys_CreateThread: %s", strerror(err));
+
+	return t;
+}
+
+void Sys_WaitThread (sys_thread_t *thread)
+{
+	pthread_join (thread->thread, NULL);
+	free (thread);
+}
+
+sys_mutex_t *Sys_CreateMutex (void)
+{
+	sys_mutex_t	*m;
+
+	m = Q_malloc (sizeof(*m));
+	pthread_mutex_init (&m->mutex, NULL);
+
+	return m;
+}
+
+void Sys_DestroyMutex (sys_mutex_t *mutex)
+{
+	pthread_mutex_destroy (&mutex->mutex);
+	free (mutex);
+}
+
+void Sys_LockMutex (sys_mutex_t *mutex)
+{
+	pthread_mutex_lock (&mutex->mutex);
+}
+
+void Sys_UnlockMutex (sys_mutex_t *mutex)
+{
+	pthread_mutex_unlock (&mutex->mutex);
+}
+
+sys_cond_t *Sys_CreateCond (void)
+{
+	sys_cond_t	*c;
+
+	c = Q_malloc (sizeof(*c));
+	pthread_cond_init (&c->cond, NULL);
+
+	return c;
+}
+
+void Sys_DestroyCond (sys_cond_t *cond)
+{
+	pthread_cond_destroy (&cond->cond);
+	free (cond);
+}
+
+void Sys_WaitCond (sys_cond_t *cond, sys_mutex_t *mutex)
+{
+	pthread_cond_wait (&cond->cond, &mutex->mutex);
+}
+
+void Sys_SignalCond (sys_cond_t *cond)
+{
+	pthread_cond_broadcast (&cond->cond);
+}
+
+/*
+===============================================================================
+
+SYSTEM IO
+
+===============================================================================
+*/
+
+void Sys_MakeCodeWriteable (unsigned long startaddr, unsigned long length)
+{
+}
+
+void Sys_CaptureScreenshot(void)
+{
+	Sys_Error("Not implemented!");
+}
+
+void Sys_DebugLog(char *file, char *fmt, ...)
+{
+	va_list argptr;
+	FILE	*f;
+
+	f = fopen (file, "a");
+	if (!f)
+		return;
+
+	va_start (argptr, fmt);
+	vfprintf (f, fmt, argptr);
+	va_end (argptr);
+	fclose (f);
+}
+
+void Sys_Printf (char *fmt, ...)
+{
+	va_list         argptr;
+
+	if (sys_nostdout.value)
+		return;
+
+	va_start (argptr,fmt);
+	vprintf (fmt,argptr);
+	va_end (argptr);
+	fflush (stdout);
+}
+
+void Sys_PrintSystemInfo(void)
+{
+	Con_Printf ("LINUX NZP v%4.1f (%s "__TIME__" "__DATE__")\n", (double)(VERSION),
+		cls.state == ca_dedicated ? "dedicated" : "headless");
+}
+
+void Sys_SystemError(char *error)
+{
+	fprintf (stderr, "Error: %s\n", error);
+
+	Host_Shutdown ();
+	exit (1);
+}
+
+void Sys_Quit (void)
+{
+	Host_Shutdown();
+	fflush (stdout);
+	exit (0);
+}
+
+double Sys_FloatTime (void)
+{
+	static struct timespec	start;
+	struct timespec			now;
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+	if (!start.tv_sec)
+		start = now;
+
+	return (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) * 0.000000001;
+}
+
+/*
+================
+Sys_ConsoleInput
+
+Console commands are taken a line at a time from stdin, there is no
+other way to type into a headless client
+================
+*/
+char *Sys_ConsoleInput (void)
+{
+	static char	text[256];
+	static int	len;
+	int			c;
+
+	while ((c = getchar ()) != EOF)
+	{
+		if (c == '\n' || c == '\r')
+		{
+			// keep the newline so Cbuf_AddText sees a complete command
+			text[len++] = '\n';
+			text[len] = 0;
+			len = 0;
+			return text;
+		}
+		if (len < (int)sizeof(text) - 2)
+			text[len++] = c;
+	}
+
+	clearerr (stdin);
+	return NULL;
+}
+
+void Sys_Sleep (void)
+{
+	usleep (1);
+}
+
+void Sys_SendKeyEvents (void)
+{
+}
+
+void Sys_HighFPPrecision (void)
+{
+}
+
+void Sys_LowFPPrecision (void)
+{
+}
+
+//=============================================================================
+
+int main (int argc, char **argv)
+{
+	static quakeparms_t	parms;
+	double				time, oldtime, newtime;
+	int					t;
+
+	COM_InitArgv (argc, argv);
+
+	parms.argc = com_argc;
+	parms.argv = com_argv;
+	parms.basedir = ".";
+
+	t = COM_CheckParm ("-basedir");
+	if (t && t < com_argc - 1)
+		parms.basedir = com_argv[t + 1];
+
+	parms.memsize = LINUX_HUNK_DEFAULT_MB * 1024 * 1024;
+	t = COM_CheckParm ("-mem");
+	if (t && t < com_argc - 1)
+		parms.memsize = Q_atoi (com_argv[t + 1]) * 1024 * 1024;
+	if (parms.memsize <= 0 || parms.memsize > (int)sizeof(sys_membase))
+		Sys_Error ("-mem must be between 1 and %i megabytes", LINUX_HUNK_MAX_MB);
+	parms.membase = sys_membase;
+
+	isDedicated = (COM_CheckParm ("-dedicated") != 0);
+
+	// stdin is polled for console commands once per frame
+	fcntl (0, F_SETFL, fcntl (0, F_GETFL, 0) | O_NONBLOCK);
+
+	Host_Init (&parms);
+	Cvar_RegisterVariable (&sys_nostdout);
+
+	oldtime = Sys_FloatTime () - 0.1;
+	while (1)
+	{
+		newtime = Sys_FloatTime ();
+		time = newtime - oldtime;
+
+		if (cls.state == ca_dedicated)
+		{
+			// play vcrfiles at max speed
+			if (time < sys_ticrate.value && (vcrFile == -1 || recording))
+			{
+				usleep (1000);
+				continue;
+			}
+			time = sys_ticrate.value;
+		}
+
+		if (time > sys_ticrate.value * 2)
+			oldtime = newtime;
+		else
+			oldtime += time;
+
+		Host_Frame (time);
+	}
+
+	return 0;
+}
@@ -0,0 +1,371 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// vid_soft.c -- offscreen video driver for the headless software renderer.
+// Frames are drawn into memory and never shown, vid_dumpframes writes
+// them to <gamedir>/frames as PNG or PCX files.
+
+#include "../../nzportable_def.h"
+#include "../nspire/d_local.h"
+
+viddef_t	vid;				// global video state
+
+#define	BASEWIDTH	320
+#define	BASEHEIGHT	240
+
+static byte		*vid_buffer;
+static short	*vid_zbuffer;
+static byte		*vid_surfcache;
+static byte		*vid_colormap;
+
+unsigned short	d_8to16table[256];
+unsigned	d_8to24table[256];
+
+static byte		vid_palette[768];
+
+cvar_t	vid_dumpframes = {"vid_dumpframes","0"};	// write every Nth frame, 0 is off
+cvar_t	vid_dumpformat = {"vid_dumpformat","png"};	// png or pcx
+
+static int		vid_framecount;
+static int		vid_dumpcount;
+
+void	VID_SetPalette (unsigned char *palette)
+{
+	int		i;
+
+	memcpy (vid_palette, palette, sizeof(vid_palette));
+	for (i=0 ; i<256 ; i++)
+		d_8to24table[i] = palette[i*3] | (palette[i*3+1] << 8) | (palette[i*3+2] << 16) | (255u << 24);
+}
+
+void	VID_ShiftPalette (unsigned char *palette)
+{
+	VID_SetPalette (palette);
+}
+
+void	VID_Init (unsigned char *palette)
+{
+	int		i, width, height, surfcachesize;
+
+	width = BASEWIDTH;
+	height = BASEHEIGHT;
+	if ((i = COM_CheckParm ("-width")) && i + 1 < com_argc)
+		width = Q_atoi (com_argv[i+1]);
+	if ((i = COM_CheckParm ("-height")) && i + 1 < com_argc)
+		height = Q_atoi (com_argv[i+1]);
+	width = bound (BASEWIDTH, width, MAXWIDTH) & ~7;
+	height = bound (BASEHEIGHT, height, MAXHEIGHT);
+
+	vid.width = vid.conwidth = width;
+	vid.height = vid.conheight = height;
+	vid.maxwarpwidth = WARP_WIDTH;
+	vid.maxwarpheight = WARP_HEIGHT;
+	vid.aspect = ((float)vid.height / (float)vid.width) * (320.0 / 240.0);
+	vid.numpages = 1;
+
+	// the surface builder checks the colormap is 256 byte aligned
+	vid_colormap = Q_malloc (0x4000 + 255);
+	vid.colormap = (byte *)(((size_t)vid_colormap + 255) & ~(size_t)255);
+	memcpy (vid.colormap, host_colormap, 0x4000);
+	vid.fullbright = 256 - LittleLong (*((int *)vid.colormap + 2048));
+
+	vid_buffer = Q_malloc (width * height);
+	vid.buffer = vid.conbuffer = vid_buffer;
+	vid.rowbytes = vid.conrowbytes = width;
+
+	vid_zbuffer = Q_malloc (width * height * sizeof(*vid_zbuffer));
+	d_pzbuffer = vid_zbuffer;
+
+	surfcachesize = D_SurfaceCacheForRes (width, height);
+	vid_surfcache = Q_malloc (surfcachesize);
+	D_InitCaches (vid_surfcache, surfcachesize);
+
+	VID_SetPalette (palette);
+
+	Cvar_RegisterVariable (&vid_dumpframes);
+	Cvar_RegisterVariable (&vid_dumpformat);
+
+	Con_Printf ("Offscreen video %ix%i\n", width, height);
+}
+
+void	VID_Shutdown (void)
+{
+}
+
+/*
+==============================================================================
+
+FRAME DUMPS
+
+==============================================================================
+*/
+
+static byte		*vid_dumpbuf;
+static int		vid_dumpbufsize;
+
+static unsigned	vid_crctable[256];
+
+/*
+================
+VID_DumpReserve
+
+Grows the scratch buffer an encoded frame is built in
+================
+*/
+static byte *VID_DumpReserve (int size)
+{
+	if (size > vid_dumpbufsize)
+	{
+		free (vid_dumpbuf);
+		vid_dumpbuf = Q_malloc (size);
+		vid_dumpbufsize = size;
+	}
+	return vid_dumpbuf;
+}
+
+/*
+================
+VID_WritePCX
+
+Same encoding as the screenshot command
+================
+*/
+static int VID_WritePCX (byte *out)
+{
+	byte	*p, *data;
+	int		x, y;
+
+	memset (out, 0, 128);
+	out[0] = 0x0a;				// PCX id
+	out[1] = 5;					// 256 color
+	out[2] = 1;					// run length encoded
+	out[3] = 8;					// bits per pixel
+	out[8] = (vid.width - 1) & 0xff;
+	out[9] = (vid.width - 1) >> 8;
+	out[10] = (vid.height - 1) & 0xff;
+	out[11] = (vid.height - 1) >> 8;
+	out[12] = vid.width & 0xff;
+	out[13] = vid.width >> 8;
+	out[14] = vid.height & 0xff;
+	out[15] = vid.height >> 8;
+	out[65] = 1;				// chunky image
+	out[66] = vid.width & 0xff;
+	out[67] = vid.width >> 8;
+	out[68] = 2;				// not a grey scale
+
+	p = out + 128;
+	for (y=0 ; y<(int)vid.height ; y++)
+	{
+		data = vid.buffer + y * vid.rowbytes;
+		for (x=0 ; x<(int)vid.width ; x++)
+		{
+			if ((data[x] & 0xc0) == 0xc0)
+				*p++ = 0xc1;
+			*p++ = data[x];
+		}
+	}
+
+	*p++ = 0x0c;				// palette id
+	memcpy (p, vid_palette, 768);
+	p += 768;
+
+	return p - out;
+}
+
+static void VID_PutLong (byte *p, unsigned l)
+{
+	p[0] = l >> 24;
+	p[1] = l >> 16;
+	p[2] = l >> 8;
+	p[3] = l;
+}
+
+static unsigned VID_CRC (byte *data, int len)
+{
+	unsigned	c;
+	int			i, j;
+
+	if (!vid_crctable[1])
+	{
+		for (i=0 ; i<256 ; i++)
+		{
+			c = i;
+			for (j=0 ; j<8 ; j++)
+				c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+			vid_crctable[i] = c;
+		}
+	}
+
+	c = 0xffffffff;
+	for (i=0 ; i<len ; i++)
+		c = vid_crctable[(c ^ data[i]) & 0xff] ^ (c >> 8);
+	return c ^ 0xffffffff;
+}
+
+/*
+================
+VID_PNGChunk
+
+Fills in the length and crc around len bytes of chunk data already at p + 8
+================
+*/
+static byte *VID_PNGChunk (byte *p, char *type, int len)
+{
+	VID_PutLong (p, len);
+	memcpy (p + 4, type, 4);
+	VID_PutLong (p + 8 + len, VID_CRC (p + 4, len + 4));
+	return p + 12 + len;
+}
+
+/*
+================
+VID_WritePNG
+
+An indexed PNG with the image data in stored deflate blocks. Frames are
+written as fast as they are drawn, so nothing is compressed.
+================
+*/
+static int VID_WritePNG (byte *out)
+{
+	static byte	signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	byte		*p, *z, *row;
+	unsigned	a, b;
+	int			x, y, width, height, rawlen, left, block;
+
+	width = vid.width;
+	height = vid.height;
+
+	memcpy (out, signature, 8);
+	p = out + 8;
+
+	VID_PutLong (p + 8, width);
+	VID_PutLong (p + 12, height);
+	p[16] = 8;					// bits per index
+	p[17] = 3;					// indexed color
+	p[18] = p[19] = p[20] = 0;	// deflate, adaptive filters, not interlaced
+	p = VID_PNGChunk (p, "IHDR", 13);
+
+	memcpy (p + 8, vid_palette, 768);
+	p = VID_PNGChunk (p, "PLTE", 768);
+
+// every row starts with a filter type of none
+	rawlen = (width + 1) * height;
+	z = p + 8;
+	*z++ = 0x78;				// zlib header, 32k window, no compression
+	*z++ = 0x01;
+
+	a = 1;
+	b = 0;
+	left = 0;
+	block = 0;
+	for (y=0 ; y<height ; y++)
+	{
+		row = vid.buffer + y * vid.rowbytes;
+		for (x=-1 ; x<width ; x++)
+		{
+			if (!left)
+			{
+				block = min(rawlen, 65535);
+				rawlen -= block;
+				left = block;
+				*z++ = rawlen ? 0 : 1;	// last block
+				*z++ = block & 0xff;
+				*z++ = block >> 8;
+				*z++ = ~block & 0xff;
+				*z++ = (~block >> 8) & 0xff;
+			}
+			*z = x < 0 ? 0 : row[x];
+			a = (a + *z) % 65521;
+			b = (b + a) % 65521;
+			z++;
+			left--;
+		}
+	}
+	VID_PutLong (z, (b << 16) | a);
+	z += 4;
+	p = VID_PNGChunk (p, "IDAT", z - (p + 8));
+
+	p = VID_PNGChunk (p, "IEND", 0);
+
+	return p - out;
+}
+
+/*
+================
+VID_DumpFrame
+================
+*/
+static void VID_DumpFrame (void)
+{
+	char	name[MAX_OSPATH];
+	int		handle, len, png;
+
+	png = Q_strcasecmp (vid_dumpformat.string, "pcx");
+
+	len = snprintf (name, sizeof(name), "%s/frames/frame%05i.%s", com_gamedir, vid_dumpcount, png ? "png" : "pcx");
+	if (len < 0 || len >= sizeof(name))
+	{
+		Con_Printf ("VID_DumpFrame: path too long, not dumping frames\n");
+		Cvar_SetValue ("vid_dumpframes", 0);
+		return;
+	}
+
+	if (!vid_dumpcount)
+		Sys_mkdir (va("%s/frames", com_gamedir));	// fits, it's a prefix of name
+
+	// worst case for either format, with room for the headers and palette
+	VID_DumpReserve (vid.width * vid.height * 2 + vid.height * 4 + 2048);
+	if (png)
+		len = VID_WritePNG (vid_dumpbuf);
+	else
+		len = VID_WritePCX (vid_dumpbuf);
+
+	handle = Sys_FileOpenWrite (name);
+	Sys_FileWrite (handle, vid_dumpbuf, len);
+	Sys_FileClose (handle);
+
+	vid_dumpcount++;
+}
+
+void	VID_Update (vrect_t *rects)
+{
+	vid_framecount++;
+
+	if (vid_dumpframes.value >= 1 && !(vid_framecount % (int)vid_dumpframes.value))
+		VID_DumpFrame ();
+}
+
+/*
+================
+D_BeginDirectRect
+================
+*/
+void D_BeginDirectRect (int x, int y, byte *pbitmap, int width, int height)
+{
+}
+
+
+/*
+================
+D_EndDirectRect
+================
+*/
+void D_EndDirectRect (int x, int y, int width, int height)
+{
+}
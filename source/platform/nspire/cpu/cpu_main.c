@@ -65,6 +65,15 @@ void Sky_LoadSkyBox(char* name)
 
 void Fog_ParseServerMessage (void)
 {
+	// start, end, red, green, blue, time -- consume them so the
+	// rest of the message still parses
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadByte ();
+	MSG_ReadShort ();
+
 	// naievil -- TODO: implement me
 	Con_Printf("Fog_ParseServerMessage - not implemented!\n");
 	return;
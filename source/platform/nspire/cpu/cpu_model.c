@@ -901,15 +901,11 @@ void Mod_LoadFaces (lump_t *l)
 		// lighting info
 		for (i=0 ; i<MAXLIGHTMAPS ; i++)
 			out->styles[i] = in->styles[i];
-		if (loadmodel->bspversion == HL_BSPVERSION)		//Diabolickal HLBSP
-			i = LittleLong(in->lightofs/3);
-		else
-			i = LittleLong(in->lightofs);
+		i = LittleLong(in->lightofs);
 		if (i == -1)
 			out->samples = NULL;
-		else {
-			out->samples = loadmodel->lightdata + (i * 3); // LordHavoc
-		}
+		else	// lightdata is loaded as is, mono for Q1 and RGB for HL
+			out->samples = loadmodel->lightdata + i;
 
 	// set the drawing flags flag
 		
@@ -1319,6 +1315,11 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	for (i=0 ; i < (int)sizeof(dheader_t)/4 ; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
 
+// key the render cache on the lumps everything is built from
+	mod->checksum = 0;
+	for (i=0 ; i<HEADER_LUMPS ; i++)
+		mod->checksum = R_BSPCacheChecksum (mod->checksum, mod_base + header->lumps[i].fileofs, header->lumps[i].filelen);
+
 // load into heap
 	
 	Mod_LoadVertexes (&header->lumps[LUMP_VERTEXES]);
@@ -381,6 +381,7 @@ typedef struct model_s
 	cache_user_t	cache;		// only access through Mod_Extradata
 
 	int 		bspversion; //Diabolickal HLBSP
+	unsigned	checksum;	// of the lumps, keys the r_bspcache file
 
 } model_t;
 
@@ -0,0 +1,467 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_band.c -- band parallel span drawing
+
+/*
+With d_threads above 1, D_DrawSurfaces still walks the surfaces in order,
+building their surface cache blocks and working out their gradients, but
+only keeps the span state of each instead of drawing it. The view is then
+cut into horizontal bands that the main thread and a pool of workers take
+turns drawing. Each thread copies the spans that fall in its band into its
+own span buffer and runs the usual span drawers over them, with the span
+state in thread local variables, so every pixel and z value comes out the
+same as drawing serially.
+
+The edge scan that produces the spans stays serial, the active edge table
+for one scan line depends on every line above it.
+
+The same threads build the surface cache blocks D_DrawSurfaces asks for
+before the bands are drawn, and the ones D_PrefetchSurfaces queues while
+the main thread gets on with the frame (d_surf.c).
+*/
+
+#include "../../nzportable_def.h"
+#include "r_local.h"
+#include "d_local.h"
+
+cvar_t	d_threads = {"d_threads","0"};	// threads drawing spans, 0 or 1 draws serially
+
+#define	D_MAXTHREADS		16
+#define	D_BANDSPERTHREAD	4		// smaller bands keep the threads finishing together
+
+// what the span drawers read besides the spans
+typedef struct
+{
+	float		sdivzstepu, tdivzstepu, zistepu;
+	float		sdivzstepv, tdivzstepv, zistepv;
+	float		sdivzorigin, tdivzorigin, ziorigin;
+	fixed_spans8_var_package_t	package;
+	fixed16_t	sadjust, tadjust, bbextents, bbextentt;
+	pixel_t		*cacheblock;
+	int			cachewidth;
+} spanstate_t;
+
+typedef struct
+{
+	surf_t		*surf;
+	int			kind;
+	int			color;
+	surfcache_t	*cache;		// NULL if not textured from the surface cache
+	surfcache_t	**owner;
+	spanstate_t	state;
+} bandsurf_t;
+
+struct bandthread_s
+{
+	sys_thread_t	*thread;		// NULL for the main thread
+	int				batch;			// the last batch it worked on
+	espan_t			spans[MAXSPANS];
+};
+
+static struct
+{
+	int				numthreads;		// including the main thread
+	bandthread_t	*threads[D_MAXTHREADS];
+
+	sys_mutex_t		*lock;
+	sys_cond_t		*wake;			// a batch to work on, or a batch finished
+	int				batch;			// bumped for every batch
+	void			(*work) (bandthread_t *t);
+	int				next;			// the next band or job to hand out
+	int				busy;			// workers still on the batch
+	qboolean		quit;
+
+	int				numbands;
+	int				bandtop, bandrows;
+} d_band;
+
+static bandsurf_t	*d_bandsurfs;
+static int			d_numbandsurfs, d_maxbandsurfs;
+
+
+/*
+==============
+D_SaveSpanState
+==============
+*/
+static void D_SaveSpanState (spanstate_t *st)
+{
+	st->sdivzstepu = d_sdivzstepu;
+	st->tdivzstepu = d_tdivzstepu;
+	st->zistepu = d_zistepu;
+	st->sdivzstepv = d_sdivzstepv;
+	st->tdivzstepv = d_tdivzstepv;
+	st->zistepv = d_zistepv;
+	st->sdivzorigin = d_sdivzorigin;
+	st->tdivzorigin = d_tdivzorigin;
+	st->ziorigin = d_ziorigin;
+	st->package = s_spans8_var_package;
+	st->sadjust = sadjust;
+	st->tadjust = tadjust;
+	st->bbextents = bbextents;
+	st->bbextentt = bbextentt;
+	st->cacheblock = cacheblock;
+	st->cachewidth = cachewidth;
+}
+
+
+/*
+==============
+D_LoadSpanState
+==============
+*/
+static void D_LoadSpanState (spanstate_t *st)
+{
+	d_sdivzstepu = st->sdivzstepu;
+	d_tdivzstepu = st->tdivzstepu;
+	d_zistepu = st->zistepu;
+	d_sdivzstepv = st->sdivzstepv;
+	d_tdivzstepv = st->tdivzstepv;
+	d_zistepv = st->zistepv;
+	d_sdivzorigin = st->sdivzorigin;
+	d_tdivzorigin = st->tdivzorigin;
+	d_ziorigin = st->ziorigin;
+	s_spans8_var_package = st->package;
+	sadjust = st->sadjust;
+	tadjust = st->tadjust;
+	bbextents = st->bbextents;
+	bbextentt = st->bbextentt;
+	cacheblock = st->cacheblock;
+	cachewidth = st->cachewidth;
+}
+
+
+/*
+==============
+D_DrawBand
+
+Draws the parts of every kept surface that lie in rows top to bottom - 1
+==============
+*/
+static void D_DrawBand (bandthread_t *t, int top, int bottom)
+{
+	bandsurf_t	*bs;
+	espan_t		*span, *out, *first, **link;
+	int			i;
+
+	out = t->spans;
+
+	for (i=0, bs=d_bandsurfs ; i<d_numbandsurfs ; i++, bs++)
+	{
+	// keep the spans in the order the serial path draws them
+		first = NULL;
+		link = &first;
+		for (span=bs->surf->spans ; span ; span=span->pnext)
+		{
+			if (span->v < top || span->v >= bottom)
+				continue;
+
+			out->u = span->u;
+			out->v = span->v;
+			out->count = span->count;
+			*link = out;
+			link = &out->pnext;
+			out++;
+		}
+		*link = NULL;
+
+		if (!first)
+			continue;
+
+		D_LoadSpanState (&bs->state);
+		D_DrawSurfaceSpans (first, bs->kind, bs->color);
+	}
+}
+
+
+/*
+==============
+D_DrawBands
+
+Takes bands until the batch runs out of them
+==============
+*/
+static void D_DrawBands (bandthread_t *t)
+{
+	int		band, top, bottom;
+
+	while ((band = D_BatchNext ()) < d_band.numbands)
+	{
+		top = d_band.bandtop + band * d_band.bandrows / d_band.numbands;
+		bottom = d_band.bandtop + (band + 1) * d_band.bandrows / d_band.numbands;
+		D_DrawBand (t, top, bottom);
+	}
+}
+
+
+/*
+==============
+D_BandThread
+==============
+*/
+static void *D_BandThread (void *arg)
+{
+	bandthread_t	*t;
+
+	t = arg;
+
+	Sys_LockMutex (d_band.lock);
+	while (1)
+	{
+		while (t->batch == d_band.batch && !d_band.quit)
+			Sys_WaitCond (d_band.wake, d_band.lock);
+		if (d_band.quit)
+			break;
+		t->batch = d_band.batch;
+		Sys_UnlockMutex (d_band.lock);
+
+		d_band.work (t);
+
+		Sys_LockMutex (d_band.lock);
+		if (!--d_band.busy)
+			Sys_SignalCond (d_band.wake);
+	}
+	Sys_UnlockMutex (d_band.lock);
+
+	return NULL;
+}
+
+
+/*
+==============
+D_StartBands
+
+Stops the workers there are and starts numthreads - 1 new ones
+==============
+*/
+static void D_StartBands (int numthreads)
+{
+	int		i;
+
+	if (!d_band.lock)
+	{
+		d_band.lock = Sys_CreateMutex ();
+		d_band.wake = Sys_CreateCond ();
+		d_band.threads[0] = Q_malloc (sizeof(bandthread_t));
+		d_band.threads[0]->thread = NULL;
+		d_band.numthreads = 1;
+	}
+
+	D_FinishBatch ();
+
+	Sys_LockMutex (d_band.lock);
+	d_band.quit = true;
+	Sys_SignalCond (d_band.wake);
+	Sys_UnlockMutex (d_band.lock);
+
+	for (i=1 ; i<d_band.numthreads ; i++)
+	{
+		Sys_WaitThread (d_band.threads[i]->thread);
+		free (d_band.threads[i]);
+	}
+
+	d_band.quit = false;
+	d_band.numthreads = numthreads;
+
+	for (i=1 ; i<d_band.numthreads ; i++)
+	{
+		d_band.threads[i] = Q_malloc (sizeof(bandthread_t));
+		d_band.threads[i]->batch = d_band.batch;
+		d_band.threads[i]->thread = Sys_CreateThread (D_BandThread, d_band.threads[i]);
+	}
+
+	if (numthreads > 1)
+		Con_Printf ("Drawing spans on %i threads\n", numthreads);
+}
+
+
+/*
+==============
+D_BatchNext
+
+Hands out the bands or jobs of a batch, one at a time
+==============
+*/
+int D_BatchNext (void)
+{
+	int		next;
+
+	Sys_LockMutex (d_band.lock);
+	next = d_band.next++;
+	Sys_UnlockMutex (d_band.lock);
+
+	return next;
+}
+
+
+/*
+==============
+D_StartBatch
+
+Has every worker call work, which takes jobs from D_BatchNext until there
+are none left. With join set the main thread works on it too and it is
+finished when this returns, otherwise D_FinishBatch waits for it.
+==============
+*/
+void D_StartBatch (void (*work) (bandthread_t *t), qboolean join)
+{
+	D_FinishBatch ();
+
+	Sys_LockMutex (d_band.lock);
+	d_band.work = work;
+	d_band.next = 0;
+	d_band.busy = d_band.numthreads - 1;
+	d_band.batch++;
+	Sys_SignalCond (d_band.wake);
+	Sys_UnlockMutex (d_band.lock);
+
+	if (join)
+	{
+		work (d_band.threads[0]);
+		D_FinishBatch ();
+	}
+}
+
+
+/*
+==============
+D_FinishBatch
+==============
+*/
+void D_FinishBatch (void)
+{
+	if (!d_band.lock)
+		return;
+
+	Sys_LockMutex (d_band.lock);
+	while (d_band.busy)
+		Sys_WaitCond (d_band.wake, d_band.lock);
+	Sys_UnlockMutex (d_band.lock);
+}
+
+
+/*
+==============
+D_BandsActive
+
+True if D_DrawSurfaces should hand its surfaces to the band threads, and
+the surface cache builds can be queued for them
+==============
+*/
+qboolean D_BandsActive (void)
+{
+	int		numthreads;
+
+	numthreads = bound(1, (int)d_threads.value, D_MAXTHREADS);
+	if (numthreads != d_band.numthreads)
+		D_StartBands (numthreads);
+
+	return d_band.numthreads > 1;
+}
+
+
+/*
+==============
+D_BandAddSurface
+
+Keeps the span state D_DrawSurfaces set up for a surface
+==============
+*/
+void D_BandAddSurface (surf_t *surf, int kind, int color, surfcache_t *cache)
+{
+	bandsurf_t	*bs;
+
+	if (d_numbandsurfs == d_maxbandsurfs)
+	{
+		d_maxbandsurfs = surf_max - surfaces;
+		bs = Q_malloc (d_maxbandsurfs * sizeof(*bs));
+		if (d_bandsurfs)
+		{
+			memcpy (bs, d_bandsurfs, d_numbandsurfs * sizeof(*bs));
+			free (d_bandsurfs);
+		}
+		d_bandsurfs = bs;
+	}
+
+	bs = &d_bandsurfs[d_numbandsurfs++];
+	bs->surf = surf;
+	bs->kind = kind;
+	bs->color = color;
+	bs->cache = cache;
+	bs->owner = cache ? cache->owner : NULL;
+	D_SaveSpanState (&bs->state);
+}
+
+
+/*
+==============
+D_BandDrawSurfaces
+
+Builds the cache blocks the kept surfaces need and draws them on every
+thread. Returns false, without drawing anything, if a later surface's
+cache block took over an earlier one's, or two of them needed different
+contents in the same block. The caller has to draw them serially then.
+==============
+*/
+qboolean D_BandDrawSurfaces (void)
+{
+	bandsurf_t	*bs;
+	int			i;
+
+	for (i=0, bs=d_bandsurfs ; i<d_numbandsurfs ; i++, bs++)
+	{
+		if (bs->cache && *bs->owner != bs->cache)
+			break;
+	}
+
+	if (i < d_numbandsurfs || !D_BuildQueuedSurfaces ())
+	{
+		D_CancelQueuedSurfaces ();
+		d_numbandsurfs = 0;
+		return false;
+	}
+
+	if (!d_numbandsurfs)
+		return true;
+
+	d_band.bandtop = r_refdef.vrect.y;
+	d_band.bandrows = r_refdef.vrectbottom - r_refdef.vrect.y;
+	d_band.numbands = min(d_band.numthreads * D_BANDSPERTHREAD, d_band.bandrows);
+
+	D_StartBatch (D_DrawBands, true);
+
+// leave the state of the last surface behind, like the serial path
+	D_LoadSpanState (&d_bandsurfs[d_numbandsurfs - 1].state);
+	d_numbandsurfs = 0;
+
+	return true;
+}
+
+
+/*
+==============
+D_InitBands
+==============
+*/
+void D_InitBands (void)
+{
+	Cvar_RegisterVariable (&d_threads);
+}
@@ -80,14 +80,14 @@ D_DrawSolidSurface
 
 // FIXME: clean this up
 
-void D_DrawSolidSurface (surf_t *surf, int color)
+void D_DrawSolidSurface (espan_t *pspan, int color)
 {
 	espan_t	*span;
 	byte	*pdest;
 	int		u, u2, pix;
 	
 	pix = (color<<24) | (color<<16) | (color<<8) | color;
-	for (span=surf->spans ; span ; span=span->pnext)
+	for (span=pspan ; span ; span=span->pnext)
 	{
 		pdest = (byte *)d_viewbuffer + screenwidth*span->v;
 		u = span->u;
@@ -178,10 +178,64 @@ void D_CalcGradients (msurface_t *pface)
 
 /*
 ==============
-D_DrawSurfaces
+D_DrawSurfaceSpans
 ==============
 */
-void D_DrawSurfaces (void)
+void D_DrawSurfaceSpans (espan_t *pspan, int kind, int color)
+{
+	switch (kind)
+	{
+	case DSURF_SOLID:
+		D_DrawSolidSurface (pspan, color);
+		break;
+	case DSURF_SKY:
+		D_DrawSkyScans8 (pspan);
+		break;
+	case DSURF_TURB:
+		Turbulent8 (pspan);
+		break;
+	default:
+		(*d_drawspans) (pspan);
+		break;
+	}
+
+	D_DrawZSpans (pspan);
+}
+
+
+#ifdef SYS_THREADS
+static qboolean	d_banding;		// surfaces are handed to the band threads
+#endif
+
+/*
+==============
+D_EmitSurface
+
+Draws a surface with the span state that has been set up for it, or
+keeps that state for the band threads to draw with. cache is the surface
+cache block the spans are textured from, if any.
+==============
+*/
+static void D_EmitSurface (surf_t *s, int kind, int color, surfcache_t *cache)
+{
+#ifdef SYS_THREADS
+	if (d_banding)
+	{
+		D_BandAddSurface (s, kind, color, cache);
+		return;
+	}
+#endif
+
+	D_DrawSurfaceSpans (s->spans, kind, color);
+}
+
+
+/*
+==============
+D_DrawSurfaceList
+==============
+*/
+static void D_DrawSurfaceList (void)
 {
 	surf_t			*s;
 	msurface_t		*pface;
@@ -210,8 +264,7 @@ void D_DrawSurfaces (void)
 			CALCG_FIXED_FTOF32( d_ziorigin, s_spans8_var_package.f32_ziorigin );
 #endif
 
-			D_DrawSolidSurface (s, (int)s->data & 0xFF);
-			D_DrawZSpans (s->spans);
+			D_EmitSurface (s, DSURF_SOLID, (intptr_t)s->data & 0xFF, NULL);
 		}
 	}
 	else
@@ -240,8 +293,7 @@ void D_DrawSurfaces (void)
 					R_MakeSky ();
 				}
 
-				D_DrawSkyScans8 (s->spans);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, DSURF_SKY, 0, NULL);
 			}
 			else if (s->flags & SURF_DRAWBACKGROUND)
 			{
@@ -251,8 +303,7 @@ void D_DrawSurfaces (void)
 				d_zistepv = 0;
 				d_ziorigin = -0.9;
 
-				D_DrawSolidSurface (s, (int)r_clearcolor.value & 0xFF);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, DSURF_SOLID, (int)r_clearcolor.value & 0xFF, NULL);
 			}
 			else if (s->flags & SURF_DRAWTURB)
 			{
@@ -278,8 +329,7 @@ void D_DrawSurfaces (void)
 				}
 
 				D_CalcGradients (pface);
-				Turbulent8 (s->spans);
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, DSURF_TURB, 0, NULL);
 
 				if (s->insubmodel)
 				{
@@ -318,6 +368,11 @@ void D_DrawSurfaces (void)
 				* pface->texinfo->mipadjust);
 
 			// FIXME: make this passed in to D_CacheSurface
+#ifdef SYS_THREADS
+				if (d_banding)
+					pcurrentcache = D_QueueSurface (pface, miplevel);
+				else
+#endif
 				pcurrentcache = D_CacheSurface (pface, miplevel);
 
 				cacheblock = (pixel_t *)pcurrentcache->data;
@@ -325,9 +380,7 @@ void D_DrawSurfaces (void)
 
 				D_CalcGradients (pface);
 
-				(*d_drawspans) (s->spans);
-
-				D_DrawZSpans (s->spans);
+				D_EmitSurface (s, DSURF_TEXTURED, 0, pcurrentcache);
 
 				if (s->insubmodel)
 				{
@@ -350,3 +403,36 @@ void D_DrawSurfaces (void)
 	}
 }
 
+
+/*
+==============
+D_DrawSurfaces
+==============
+*/
+void D_DrawSurfaces (void)
+{
+#ifdef SYS_THREADS
+	int		polycount;
+
+	D_FinishPrefetch ();
+
+	if (D_BandsActive ())
+	{
+		polycount = r_drawnpolycount;
+
+		d_banding = true;
+		D_DrawSurfaceList ();
+		d_banding = false;
+
+		if (D_BandDrawSurfaces ())
+			return;
+
+	// the surface cache wrapped onto a surface before it was drawn, or a
+	// block was needed with two contents, so build and draw them one at a
+	// time like the serial path does
+		r_drawnpolycount = polycount;
+	}
+#endif
+
+	D_DrawSurfaceList ();
+}
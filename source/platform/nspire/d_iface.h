@@ -119,6 +119,14 @@ typedef struct
 	int		color;
 } zpointdesc_t;
 
+// the span drawers' per surface state, private to each thread that
+// rasterizes a band of the view when there is more than one
+#ifdef SYS_THREADS
+#define D_THREADLOCAL	__thread
+#else
+#define D_THREADLOCAL
+#endif
+
 typedef struct {
 	fixed32_t f32_sdivzstepu, f32_tdivzstepu, f32_zistepu;
 	fixed32_t f32_sdivzstepv, f32_tdivzstepv, f32_zistepv;
@@ -185,6 +193,9 @@ void D_WarpScreen (void);
 void D_FillRect (vrect_t *vrect, int color);
 void D_DrawRect (void);
 void D_UpdateRects (vrect_t *prect);
+#ifdef SYS_THREADS
+void D_PrefetchSurfaces (void);	// after R_MarkLeaves, see d_surf.c
+#endif
 
 // currently for internal use only, and should be a do-nothing function in
 // hardware drivers
@@ -219,9 +230,10 @@ typedef struct
 	int			surfmip;	// mipmapped ratio of surface texels / world pixels
 	int			surfwidth;	// in mipmapped texels
 	int			surfheight;	// in mipmapped texels
+	qboolean	nodlights;	// prefetched, built while the entity passes mark lights
 } drawsurf_t;
 
-extern drawsurf_t	r_drawsurf;
+extern D_THREADLOCAL drawsurf_t	r_drawsurf;
 
 void R_DrawSurface (void);
 void R_GenTile (msurface_t *psurf, void *pdest);
@@ -21,12 +21,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../../nzportable_def.h"
 #include "d_local.h"
+#include "d_simd.h"
 
 #define NUM_MIPS	4
 
 cvar_t	d_subdiv16 = {"d_subdiv16", "1"};
 cvar_t	d_mipcap = {"d_mipcap", "0"};
 cvar_t	d_mipscale = {"d_mipscale", "1"};
+#if D_SIMD
+cvar_t	d_simd = {"d_simd", "1"};	// SSE2 or NEON span, surface block and polyset kernels
+
+qboolean		d_usesimd;
+static qboolean	d_simdsupported;
+
+static void D_SimdCheck_f (void);
+#endif
 
 surfcache_t		*d_initial_rover;
 qboolean		d_roverwrapped;
@@ -53,6 +62,15 @@ void D_Init (void)
 	Cvar_RegisterVariable (&d_subdiv16);
 	Cvar_RegisterVariable (&d_mipcap);
 	Cvar_RegisterVariable (&d_mipscale);
+#if D_SIMD
+	Cvar_RegisterVariable (&d_simd);
+	Cmd_AddCommand ("simdcheck", D_SimdCheck_f);
+	d_simdsupported = D_SimdSupported ();
+#endif
+	D_InitSurfaceCache ();
+#ifdef SYS_THREADS
+	D_InitBands ();
+#endif
 
 	r_drawpolys = false;
 	r_drawculledpolys = false;
@@ -134,6 +152,7 @@ void D_SetupFrame (void)
 	else
 		screenwidth = vid.rowbytes;
 
+	D_SurfaceCacheFrame ();
 	d_roverwrapped = false;
 	d_initial_rover = sc_rover;
 
@@ -155,6 +174,10 @@ void D_SetupFrame (void)
 				d_drawspans = D_DrawSpans8;
 #endif
 
+#if D_SIMD
+	d_usesimd = d_simd.value && d_simdsupported;
+#endif
+
 	d_aflatcolor = 0;
 }
 
@@ -172,3 +195,105 @@ void D_UpdateRects (vrect_t *prect)
 	UNUSED(prect);
 }
 
+
+#if D_SIMD
+/*
+===============
+D_SimdSupported
+
+The kernels are built for SSE2 on their own when the rest isn't, so check
+the processor has it
+===============
+*/
+qboolean D_SimdSupported (void)
+{
+#if D_SIMD_SSE2 && !defined( __SSE2__ )
+	return __builtin_cpu_supports ("sse2") != 0;
+#else
+	return true;
+#endif
+}
+
+
+/*
+===============
+D_SimdCheck_f
+
+Draws the view all the way around with d_simd off and then on, building
+every surface again each time, and counts the pixels and z values that
+came out different
+===============
+*/
+static void D_SimdCheck_f (void)
+{
+	int			i, pass, x, y, width, height, pixels, zvalues;
+	float		oldsimd, startangle;
+	byte		*scalarview, *view;
+	short		*scalarz, *z;
+
+	if (cls.state != ca_connected || !cl.worldmodel)
+	{
+		Con_Printf ("simdcheck: no map loaded\n");
+		return;
+	}
+	if (!d_simdsupported)
+	{
+		Con_Printf ("simdcheck: the processor can't run the SIMD kernels\n");
+		return;
+	}
+
+	width = r_refdef.vrect.width;
+	height = r_refdef.vrect.height;
+	scalarview = Q_malloc (width * height);
+	scalarz = Q_malloc (width * height * sizeof(*scalarz));
+
+	oldsimd = d_simd.value;
+	startangle = r_refdef.viewangles[1];
+	pixels = zvalues = 0;
+
+	for (i=0 ; i<16 ; i++)
+	{
+		r_refdef.viewangles[1] = i/16.0*360.0;
+
+		for (pass=0 ; pass<2 ; pass++)
+		{
+			Cvar_SetValue ("d_simd", pass);
+			D_FlushCaches ();
+
+			VID_LockBuffer ();
+			R_RenderView ();
+			VID_UnlockBuffer ();
+
+			for (y=0 ; y<height ; y++)
+			{
+				view = vid.buffer + (r_refdef.vrect.y + y) * vid.rowbytes + r_refdef.vrect.x;
+				z = d_pzbuffer + (r_refdef.vrect.y + y) * d_zwidth + r_refdef.vrect.x;
+
+				if (!pass)
+				{
+					memcpy (scalarview + y * width, view, width);
+					memcpy (scalarz + y * width, z, width * sizeof(*z));
+					continue;
+				}
+
+				for (x=0 ; x<width ; x++)
+				{
+					if (view[x] != scalarview[y * width + x])
+						pixels++;
+					if (z[x] != scalarz[y * width + x])
+						zvalues++;
+				}
+			}
+		}
+	}
+
+	r_refdef.viewangles[1] = startangle;
+	Cvar_SetValue ("d_simd", oldsimd);
+	D_FlushCaches ();
+
+	free (scalarview);
+	free (scalarz);
+
+	Con_Printf ("%i views: %i pixels and %i z values differ\n", i, pixels, zvalues);
+}
+#endif
@@ -44,6 +44,9 @@ typedef struct surfcache_s
 	unsigned			width;
 	unsigned			height;		// DEBUG only needed for debug
 	float				mipscale;
+	int					batch;		// the last build batch it was handed out in
+	int					frame;		// r_framecount it was last drawn or prefetched
+	qboolean			prefetched;	// built ahead of the draw, not drawn yet
 	struct texture_s	*texture;	// checked for animating textures
 	byte				data[4];	// width*height elements
 } surfcache_t;
@@ -62,12 +65,12 @@ extern qboolean		d_roverwrapped;
 extern surfcache_t	*sc_rover;
 extern surfcache_t	*d_initial_rover;
 
-extern float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
-extern float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
-extern float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
+extern D_THREADLOCAL float	d_sdivzstepu, d_tdivzstepu, d_zistepu;
+extern D_THREADLOCAL float	d_sdivzstepv, d_tdivzstepv, d_zistepv;
+extern D_THREADLOCAL float	d_sdivzorigin, d_tdivzorigin, d_ziorigin;
 
 #define CALCG_FIXED 1
-extern fixed_spans8_var_package_t s_spans8_var_package;
+extern D_THREADLOCAL fixed_spans8_var_package_t s_spans8_var_package;
 
 typedef struct {
 	byte *pdest;
@@ -95,8 +98,8 @@ typedef struct {
 
 
 
-extern fixed16_t	sadjust, tadjust;
-extern fixed16_t	bbextents, bbextentt;
+extern D_THREADLOCAL fixed16_t	sadjust, tadjust;
+extern D_THREADLOCAL fixed16_t	bbextents, bbextentt;
 
 
 void D_DrawSpans8 (espan_t *pspans);
@@ -108,9 +111,38 @@ void D_SpriteDrawSpans (sspan_t *pspan);
 void D_DrawSkyScans8 (espan_t *pspan);
 void D_DrawSkyScans16 (espan_t *pspan);
 
+// how D_DrawSurfaces fills in a surface's spans
+#define DSURF_SOLID		0
+#define DSURF_SKY		1
+#define DSURF_TURB		2
+#define DSURF_TEXTURED	3
+
+void D_DrawSurfaceSpans (espan_t *pspan, int kind, int color);
+
+#ifdef SYS_THREADS
+// d_band.c: draws D_DrawSurfaces' spans in horizontal bands on a thread pool
+typedef struct bandthread_s bandthread_t;
+
+void D_InitBands (void);
+qboolean D_BandsActive (void);
+void D_BandAddSurface (surf_t *surf, int kind, int color, surfcache_t *cache);
+qboolean D_BandDrawSurfaces (void);
+void D_StartBatch (void (*work) (bandthread_t *t), qboolean join);
+void D_FinishBatch (void);
+int D_BatchNext (void);
+#endif
+
 void R_ShowSubDiv (void);
 //void (*prealspandrawer)(void);
+void D_InitSurfaceCache (void);
+void D_SurfaceCacheFrame (void);
 surfcache_t	*D_CacheSurface (msurface_t *surface, int miplevel);
+#ifdef SYS_THREADS
+surfcache_t *D_QueueSurface (msurface_t *surface, int miplevel);
+qboolean D_BuildQueuedSurfaces (void);
+void D_CancelQueuedSurfaces (void);
+void D_FinishPrefetch (void);
+#endif
 
 extern int D_MipLevelForScale (float scale);
 
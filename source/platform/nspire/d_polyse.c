@@ -23,6 +23,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "../../nzportable_def.h"
 #include "r_local.h"
 #include "d_local.h"
+#include "d_simd.h"
 
 #define NSPIRE_POLYSET_DRAWSPANS 1
 #define NSPIRE_SMALL_OPTS 1
@@ -706,7 +707,119 @@ typedef struct {
 	fixed16_t r_lstepx;
 } d_polyset_draw_spans_8_nspire_t;
 
+#if defined( __arm__ )
 extern void D_NSpirePolysetDrawSpan (d_polyset_draw_spans_8_nspire_t *);
+#else
+/*
+================
+D_NSpirePolysetDrawSpan
+
+Portable version of the d_scan_nspire.S span, t is kept in the high half
+of tfrac so the texel is lptex[ ( tfrac >> 16 ) * skinwidth + ( sfrac >> 16 ) ]
+================
+*/
+static void D_NSpirePolysetDrawSpan (d_polyset_draw_spans_8_nspire_t *ps_dset)
+{
+	int		lcount, z;
+	byte	*lpdest, *lptex, *colormap;
+	short	*lpz;
+	int		skinwidth;
+	fixed16_t	lsfrac, ltfrac, llight, lzi;
+
+	lcount = ps_dset->lcount;
+	lpdest = ps_dset->lpdest;
+	lptex = ps_dset->lptex;
+	lpz = ps_dset->lpz;
+	colormap = ps_dset->acolormap;
+	skinwidth = ( short )ps_dset->skinwidth;
+	lsfrac = ps_dset->lsfrac;
+	ltfrac = ps_dset->ltfrac;
+	llight = ps_dset->llight;
+	lzi = ps_dset->lzi;
+
+	do
+	{
+		z = lzi >> 16;
+		if (z > *lpz)
+		{
+			*lpz = z;
+			*lpdest = colormap[ ( llight & 0xFF00 ) + lptex[ skinwidth * ( ltfrac >> 16 ) + ( lsfrac >> 16 ) ] ];
+		}
+		lpdest++;
+		lpz++;
+		lzi += ps_dset->r_zistepx;
+		lsfrac += ps_dset->a_sstepxfrac;
+		ltfrac += ps_dset->a_tstepxfrac;
+		llight += ps_dset->r_lstepx;
+	} while (--lcount > 0);
+}
+#endif
+
+#if D_SIMD
+/*
+================
+D_PolysetDrawSpanSimd
+
+D_NSpirePolysetDrawSpan with the z test and texel offsets of 8 pixels
+worked out at once
+================
+*/
+static D_SIMD_TARGET void D_PolysetDrawSpanSimd (d_polyset_draw_spans_8_nspire_t *ps_dset)
+{
+	int		lcount, pass, i, offsets[8];
+	byte	*lpdest, *lptex, *colormap;
+	short	*lpz;
+	int		skinwidth;
+	fixed16_t	lsfrac, ltfrac, llight, lzi;
+
+	lcount = ps_dset->lcount;
+	lpdest = ps_dset->lpdest;
+	lptex = ps_dset->lptex;
+	lpz = ps_dset->lpz;
+	colormap = ps_dset->acolormap;
+	skinwidth = ( short )ps_dset->skinwidth;
+	lsfrac = ps_dset->lsfrac;
+	ltfrac = ps_dset->ltfrac;
+	llight = ps_dset->llight;
+	lzi = ps_dset->lzi;
+
+	for ( ; lcount >= 8 ; lcount -= 8)
+	{
+		pass = D_SimdZTest8 (lpz, lzi, ps_dset->r_zistepx);
+		if (pass)
+		{
+			D_SimdTexelOffsets8 (offsets, lsfrac, ps_dset->a_sstepxfrac, ltfrac, ps_dset->a_tstepxfrac, skinwidth);
+			for (i=0 ; i<8 ; i++)
+			{
+				if (pass & (1 << i))
+					lpdest[i] = colormap[ ( ( llight + i * ps_dset->r_lstepx ) & 0xFF00 ) + lptex[ offsets[i] ] ];
+			}
+		}
+		lpdest += 8;
+		lpz += 8;
+		lzi += ps_dset->r_zistepx * 8;
+		lsfrac += ps_dset->a_sstepxfrac * 8;
+		ltfrac += ps_dset->a_tstepxfrac * 8;
+		llight += ps_dset->r_lstepx * 8;
+	}
+
+	for ( ; lcount > 0 ; lcount--)
+	{
+		i = lzi >> 16;
+		if (i > *lpz)
+		{
+			*lpz = i;
+			*lpdest = colormap[ ( llight & 0xFF00 ) + lptex[ skinwidth * ( ltfrac >> 16 ) + ( lsfrac >> 16 ) ] ];
+		}
+		lpdest++;
+		lpz++;
+		lzi += ps_dset->r_zistepx;
+		lsfrac += ps_dset->a_sstepxfrac;
+		ltfrac += ps_dset->a_tstepxfrac;
+		llight += ps_dset->r_lstepx;
+	}
+}
+#endif
 
 void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 {
@@ -809,6 +922,11 @@ void D_PolysetDrawSpans8 (spanpackage_t *pspanpackage)
 			s_dset.llight = pspanpackage->light;
 			s_dset.lzi = pspanpackage->zi;
 
+#if D_SIMD
+			if( d_usesimd )
+				D_PolysetDrawSpanSimd( &s_dset );
+			else
+#endif
 			D_NSpirePolysetDrawSpan( &s_dset );
 
 #if 0
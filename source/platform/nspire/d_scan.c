@@ -24,11 +24,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "../../nzportable_def.h"
 #include "r_local.h"
 #include "d_local.h"
+#include "d_simd.h"
 
-unsigned char	*r_turb_pbase, *r_turb_pdest;
-fixed16_t		r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
-int				*r_turb_turb;
-int				r_turb_spancount;
+D_THREADLOCAL unsigned char	*r_turb_pbase, *r_turb_pdest;
+D_THREADLOCAL fixed16_t		r_turb_s, r_turb_t, r_turb_sstep, r_turb_tstep;
+D_THREADLOCAL int			*r_turb_turb;
+D_THREADLOCAL int			r_turb_spancount;
 
 void D_DrawTurbulent8Span (void);
 
@@ -402,6 +403,10 @@ do {													\
 
 extern void draw_span_nspire_fw_c( draw_span8_nspire_t *ps_dset );
 extern void draw_span_nspire_bw_c( draw_span8_nspire_t *ps_dset );
+#if D_SIMD
+extern void draw_span_simd_fw_c( draw_span8_nspire_t *ps_dset );
+extern void draw_span_simd_bw_c( draw_span8_nspire_t *ps_dset );
+#endif
 
 
 void D_DrawSpans8 (espan_t *pspan)
@@ -652,6 +657,11 @@ void D_DrawSpans8 (espan_t *pspan)
 		{
 			if( count > 1 )
 			{
+#if D_SIMD
+				if( d_usesimd )
+					draw_span_simd_fw_c( &s_dset );
+				else
+#endif
 				draw_span_nspire_fw_c( &s_dset );
 			}
 			else
@@ -664,6 +674,11 @@ void D_DrawSpans8 (espan_t *pspan)
 		{
 			if( count > 1 )
 			{
+#if D_SIMD
+				if( d_usesimd )
+					draw_span_simd_bw_c( &s_dset );
+				else
+#endif
 				draw_span_nspire_bw_c( &s_dset );
 			}
 			else
@@ -1,11 +1,14 @@
 #include "../../nzportable_def.h"
 
 #include "d_local.h"
+#include "d_simd.h"
 
-extern int bbextents;
-extern int bbextentt;
+extern D_THREADLOCAL int bbextents;
+extern D_THREADLOCAL int bbextentt;
 
 
+#if defined( __arm__ )
+
 static inline void draw_span_nspire_fw_8( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth )
 {
 	int i_tmp;
@@ -229,89 +232,85 @@ static inline void draw_span_nspire_bw_s( byte *pdest, byte *pbase, fixed16_t f1
 	: [_pdest] "+r" (pdest), [_pbase] "+r" (pbase), [_f16_rps] "+r" (f16_rps), [_f16_sstep] "+r" (f16_sstep), [_f16_rpt] "+r" (f16_rpt), [_f16_tstep] "+r" (f16_tstep), [_i_cachewidth] "+r" (i_cachewidth), [_i_count] "+r" (i_count) : : );
 }
 
-#define NSPIRE_NOCLIP_FTW 1
+#else
 
-void draw_span_nspire_fw_c( draw_span8_nspire_t *ps_dset )
+/* portable versions of the span kernels, texel = pbase[ ( t >> 16 ) * cachewidth + ( s >> 16 ) ] */
+
+static inline void draw_span_nspire_fw_s( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth, int i_count )
 {
-	int spancount;
-	fixed16_t f16_psnext;
-	fixed16_t f16_ptnext;
-	register int f16_rps = 0, f16_rpt = 0, f16_sstep = 0, f16_tstep = 0;
+	while( i_count-- > 0 )
+	{
+		*pdest++ = pbase[ ( short )i_cachewidth * ( f16_rpt >> 16 ) + ( f16_rps >> 16 ) ];
+		f16_rps += f16_sstep;
+		f16_rpt += f16_tstep;
+	}
+}
 
-	ps_dset->f16_s = 0;
-	ps_dset->f16_t = 0;
-	do
+static inline void draw_span_nspire_bw_s( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth, int i_count )
+{
+	while( i_count-- > 0 )
 	{
-	// calculate s and t at the far end of the span
-		if (ps_dset->count >= 8)
-			spancount = 8;
-		else
-			spancount = ps_dset->count;
+		*pdest-- = pbase[ ( short )i_cachewidth * ( f16_rpt >> 16 ) + ( f16_rps >> 16 ) ];
+		f16_rps += f16_sstep;
+		f16_rpt += f16_tstep;
+	}
+}
 
-		ps_dset->count -= spancount;
+static inline void draw_span_nspire_fw_8( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth )
+{
+	draw_span_nspire_fw_s( pdest, pbase, f16_rps, f16_sstep, f16_rpt, f16_tstep, i_cachewidth, 8 );
+}
 
-		if ( ps_dset->count)
-		{
-			fixed16_t i_ipersp;
-			ps_dset->f16_p = ( ps_dset->f16_p + ( ps_dset->f16_stepp ) );
-			i_ipersp = udiv_fast_32_32_incorrect( ps_dset->f16_p, 0xffffffffU );
+static inline void draw_span_nspire_bw_8( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth )
+{
+	draw_span_nspire_bw_s( pdest, pbase, f16_rps, f16_sstep, f16_rpt, f16_tstep, i_cachewidth, 8 );
+}
 
-			ps_dset->f16_s = ( ps_dset->f16_s + ( ps_dset->f16_steps << 3 ) );
-			f16_psnext = ps_dset->f16_sstart + llmull_s16( ps_dset->f16_s, i_ipersp );
-#if !NSPIRE_NOCLIP_FTW
-			if( f16_psnext > ps_dset->i_bbextents )
-			{
-				f16_psnext = ps_dset->i_bbextents;
-			}
-			if( f16_psnext < 8 )
-			{
-				f16_psnext = 8;
-			}
 #endif
-			f16_sstep = ( f16_psnext - ps_dset->f16_ps ) >> 3;
-			f16_rps = ps_dset->f16_ps;
-			ps_dset->f16_ps = f16_psnext;
 
+#if D_SIMD
 
-			ps_dset->f16_t = ( ps_dset->f16_t + ( ps_dset->f16_stept << 3 ) );
-			f16_ptnext = ps_dset->f16_tstart + llmull_s16( ps_dset->f16_t, i_ipersp );
-#if !NSPIRE_NOCLIP_FTW
-			if( f16_ptnext > ps_dset->i_bbextentt )
-			{
-				f16_ptnext = ps_dset->i_bbextentt;
-			}
-			if( f16_ptnext < 8 )
-			{
-				f16_ptnext = 8;
-			}
-#endif
-			f16_tstep = ( f16_ptnext - ps_dset->f16_pt ) >> 3;
-			f16_rpt = ps_dset->f16_pt;
-			ps_dset->f16_pt = f16_ptnext;
+/* the same kernels with the texel offsets worked out 8 at a time, see d_simd.h */
 
-			draw_span_nspire_fw_8( ps_dset->pdest, ps_dset->pbase, f16_rps, f16_sstep, f16_rpt, f16_tstep, ps_dset->i_cachewidth );
-			ps_dset->pdest += 8;
-		}
-		else
-		{
-			static const int rgi_mtab[ 8 ] = { 0, 65536, 32768, 21845, 16384, 13107, 10922, 9362 };
+static inline D_SIMD_TARGET void draw_span_simd_fw_8( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth )
+{
+	int rgi_offsets[ 8 ];
+
+	D_SimdTexelOffsets8( rgi_offsets, f16_rps, f16_sstep, f16_rpt, f16_tstep, i_cachewidth );
+	pdest[ 0 ] = pbase[ rgi_offsets[ 0 ] ];
+	pdest[ 1 ] = pbase[ rgi_offsets[ 1 ] ];
+	pdest[ 2 ] = pbase[ rgi_offsets[ 2 ] ];
+	pdest[ 3 ] = pbase[ rgi_offsets[ 3 ] ];
+	pdest[ 4 ] = pbase[ rgi_offsets[ 4 ] ];
+	pdest[ 5 ] = pbase[ rgi_offsets[ 5 ] ];
+	pdest[ 6 ] = pbase[ rgi_offsets[ 6 ] ];
+	pdest[ 7 ] = pbase[ rgi_offsets[ 7 ] ];
+}
 
-			if (spancount > 1 )
-			{
-				f16_psnext = ps_dset->f16_psend;
-				f16_sstep = llmull_s16( f16_psnext - ps_dset->f16_ps, rgi_mtab[ spancount - 1 ] );
+static inline D_SIMD_TARGET void draw_span_simd_bw_8( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth )
+{
+	int rgi_offsets[ 8 ];
+
+	D_SimdTexelOffsets8( rgi_offsets, f16_rps, f16_sstep, f16_rpt, f16_tstep, i_cachewidth );
+	pdest[ 0 ] = pbase[ rgi_offsets[ 0 ] ];
+	pdest[ -1 ] = pbase[ rgi_offsets[ 1 ] ];
+	pdest[ -2 ] = pbase[ rgi_offsets[ 2 ] ];
+	pdest[ -3 ] = pbase[ rgi_offsets[ 3 ] ];
+	pdest[ -4 ] = pbase[ rgi_offsets[ 4 ] ];
+	pdest[ -5 ] = pbase[ rgi_offsets[ 5 ] ];
+	pdest[ -6 ] = pbase[ rgi_offsets[ 6 ] ];
+	pdest[ -7 ] = pbase[ rgi_offsets[ 7 ] ];
+}
 
-				f16_ptnext = ps_dset->f16_ptend;
-				f16_tstep = llmull_s16( f16_ptnext - ps_dset->f16_pt, rgi_mtab[ spancount - 1 ] );
-			}
+#endif
 
-			draw_span_nspire_fw_s( ps_dset->pdest, ps_dset->pbase, ps_dset->f16_ps, f16_sstep, ps_dset->f16_pt, f16_tstep, ps_dset->i_cachewidth, spancount );
-		}
-	} while (ps_dset->count > 0);
-}
+#define NSPIRE_NOCLIP_FTW 1
 
+typedef void ( *draw_span_nspire_8_t )( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth );
+typedef void ( *draw_span_nspire_s_t )( byte *pdest, byte *pbase, fixed16_t f16_rps, fixed16_t f16_sstep, fixed16_t f16_rpt, fixed16_t f16_tstep, int i_cachewidth, int i_count );
 
-void draw_span_nspire_bw_c( draw_span8_nspire_t *ps_dset )
+/* steps along the span 8 pixels at a time, i_dir is 1 left to right and -1 right to left */
+static inline void draw_span_nspire( draw_span8_nspire_t *ps_dset, int i_dir, draw_span_nspire_8_t pfn_span_8, draw_span_nspire_s_t pfn_span_s )
 {
 	int spancount;
 	fixed16_t f16_psnext;
@@ -369,8 +368,8 @@ void draw_span_nspire_bw_c( draw_span8_nspire_t *ps_dset )
 			f16_rpt = ps_dset->f16_pt;
 			ps_dset->f16_pt = f16_ptnext;
 
-			draw_span_nspire_bw_8( ps_dset->pdest, ps_dset->pbase, f16_rps, f16_sstep, f16_rpt, f16_tstep, ps_dset->i_cachewidth );
-			ps_dset->pdest -= 8;
+			pfn_span_8( ps_dset->pdest, ps_dset->pbase, f16_rps, f16_sstep, f16_rpt, f16_tstep, ps_dset->i_cachewidth );
+			ps_dset->pdest += 8 * i_dir;
 		}
 		else
 		{
@@ -385,7 +384,34 @@ void draw_span_nspire_bw_c( draw_span8_nspire_t *ps_dset )
 				f16_tstep = llmull_s16( f16_ptnext - ps_dset->f16_pt, rgi_mtab[ spancount - 1 ] );
 			}
 
-			draw_span_nspire_bw_s( ps_dset->pdest, ps_dset->pbase, ps_dset->f16_ps, f16_sstep, ps_dset->f16_pt, f16_tstep, ps_dset->i_cachewidth, spancount );
+			pfn_span_s( ps_dset->pdest, ps_dset->pbase, ps_dset->f16_ps, f16_sstep, ps_dset->f16_pt, f16_tstep, ps_dset->i_cachewidth, spancount );
 		}
 	} while (ps_dset->count > 0);
 }
+
+
+void draw_span_nspire_fw_c( draw_span8_nspire_t *ps_dset )
+{
+	draw_span_nspire( ps_dset, 1, draw_span_nspire_fw_8, draw_span_nspire_fw_s );
+}
+
+
+void draw_span_nspire_bw_c( draw_span8_nspire_t *ps_dset )
+{
+	draw_span_nspire( ps_dset, -1, draw_span_nspire_bw_8, draw_span_nspire_bw_s );
+}
+
+#if D_SIMD
+
+D_SIMD_TARGET void draw_span_simd_fw_c( draw_span8_nspire_t *ps_dset )
+{
+	draw_span_nspire( ps_dset, 1, draw_span_simd_fw_8, draw_span_nspire_fw_s );
+}
+
+
+D_SIMD_TARGET void draw_span_simd_bw_c( draw_span8_nspire_t *ps_dset )
+{
+	draw_span_nspire( ps_dset, -1, draw_span_simd_bw_8, draw_span_nspire_bw_s );
+}
+
+#endif
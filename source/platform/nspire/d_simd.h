@@ -0,0 +1,241 @@
+/*
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// d_simd.h -- SSE2 and NEON helpers for the span, surface block and
+// polyset kernels
+
+/*
+The texture and colormap reads are still one byte at a time, neither
+instruction set can gather bytes. What the vector units take over is the
+stepping and address math for 4 or 8 pixels at once, and the z test of
+the polyset spans. Every helper gives exactly what the scalar kernel it
+stands in for computes, including the wrap of the 16.16 steps, so
+d_simd 0 and 1 draw the same pixels (see simdcheck in d_init.c).
+
+x86 builds without -msse2 still get the SSE2 kernels, compiled for SSE2
+on their own and only used if the processor has it.
+*/
+
+#ifndef D_SIMD_H
+#define D_SIMD_H
+
+#if defined( __SSE2__ ) || ( defined( __GNUC__ ) && ( defined( __i386__ ) || defined( __x86_64__ ) ) )
+#define D_SIMD_SSE2	1
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ )
+#define D_SIMD_NEON	1
+#endif
+
+#if D_SIMD_SSE2 || D_SIMD_NEON
+#define D_SIMD	1
+#endif
+
+#if D_SIMD
+
+#if D_SIMD_SSE2
+#include <emmintrin.h>
+#if defined( __SSE2__ )
+#define D_SIMD_TARGET
+#else
+#define D_SIMD_TARGET	__attribute__(( target( "sse2" ) ))
+#endif
+#else
+#include <arm_neon.h>
+#define D_SIMD_TARGET
+#endif
+
+extern qboolean	d_usesimd;		// d_simd is on and the processor can run the kernels
+
+qboolean D_SimdSupported (void);
+
+/*
+==============
+D_SimdTexelOffsets8
+
+offsets[i] = ( short )width * ( ( t + i * tstep ) >> 16 ) + ( ( s + i * sstep ) >> 16 )
+for i = 0 to 7
+==============
+*/
+static inline D_SIMD_TARGET void D_SimdTexelOffsets8 (int *offsets, fixed16_t s, fixed16_t sstep, fixed16_t t, fixed16_t tstep, int width)
+{
+	unsigned	us, ut, uss, uts;
+
+	us = s;
+	ut = t;
+	uss = sstep;
+	uts = tstep;
+
+#if D_SIMD_SSE2
+	{
+		__m128i	vs, vt, vs4, vt4, hi, w;
+
+		vs = _mm_setr_epi32 (us, us + uss, us + 2*uss, us + 3*uss);
+		vt = _mm_setr_epi32 (ut, ut + uts, ut + 2*uts, ut + 3*uts);
+		vs4 = _mm_set1_epi32 (4*uss);
+		vt4 = _mm_set1_epi32 (4*uts);
+
+	// s >> 16 in the low half of each lane and t >> 16 in the high half,
+	// so one multiply-add makes the offset
+		hi = _mm_set1_epi32 (0xffff0000);
+		w = _mm_set1_epi32 (((unsigned)(width & 0xffff) << 16) | 1);
+
+		_mm_storeu_si128 ((__m128i *)offsets,
+			_mm_madd_epi16 (_mm_or_si128 (_mm_srli_epi32 (vs, 16), _mm_and_si128 (vt, hi)), w));
+
+		vs = _mm_add_epi32 (vs, vs4);
+		vt = _mm_add_epi32 (vt, vt4);
+		_mm_storeu_si128 ((__m128i *)(offsets + 4),
+			_mm_madd_epi16 (_mm_or_si128 (_mm_srli_epi32 (vs, 16), _mm_and_si128 (vt, hi)), w));
+	}
+#else
+	{
+		int32x4_t	vs, vt, vs4, vt4;
+		int			lanes[4];
+
+		lanes[0] = us; lanes[1] = us + uss; lanes[2] = us + 2*uss; lanes[3] = us + 3*uss;
+		vs = vld1q_s32 (lanes);
+		lanes[0] = ut; lanes[1] = ut + uts; lanes[2] = ut + 2*uts; lanes[3] = ut + 3*uts;
+		vt = vld1q_s32 (lanes);
+		vs4 = vdupq_n_s32 (4*uss);
+		vt4 = vdupq_n_s32 (4*uts);
+
+		vst1q_s32 (offsets, vmlaq_n_s32 (vshrq_n_s32 (vs, 16), vshrq_n_s32 (vt, 16), (short)width));
+
+		vs = vaddq_s32 (vs, vs4);
+		vt = vaddq_s32 (vt, vt4);
+		vst1q_s32 (offsets + 4, vmlaq_n_s32 (vshrq_n_s32 (vs, 16), vshrq_n_s32 (vt, 16), (short)width));
+	}
+#endif
+}
+
+
+/*
+==============
+D_SimdLightOffsets4
+
+offsets[i] = ( ( light + i * lightstep ) & ~0xff ) + pix[i]
+for i = 0 to 3, where a colormap row starts
+==============
+*/
+static inline D_SIMD_TARGET void D_SimdLightOffsets4 (int *offsets, byte *pix, int light, int lightstep)
+{
+	unsigned	ul, uls, p;
+
+	ul = light;
+	uls = lightstep;
+	memcpy (&p, pix, 4);
+
+#if D_SIMD_SSE2
+	{
+		__m128i	vl, vp, zero;
+
+		zero = _mm_setzero_si128 ();
+		vl = _mm_setr_epi32 (ul, ul + uls, ul + 2*uls, ul + 3*uls);
+		vp = _mm_unpacklo_epi16 (_mm_unpacklo_epi8 (_mm_cvtsi32_si128 (p), zero), zero);
+
+		_mm_storeu_si128 ((__m128i *)offsets,
+			_mm_add_epi32 (_mm_and_si128 (vl, _mm_set1_epi32 (~0xff)), vp));
+	}
+#else
+	{
+		int32x4_t	vl;
+		uint32x4_t	vp;
+		int			lanes[4];
+
+		lanes[0] = ul; lanes[1] = ul + uls; lanes[2] = ul + 2*uls; lanes[3] = ul + 3*uls;
+		vl = vld1q_s32 (lanes);
+		vp = vmovl_u16 (vget_low_u16 (vmovl_u8 (vcreate_u8 (p))));
+
+		vst1q_s32 (offsets,
+			vaddq_s32 (vandq_s32 (vl, vdupq_n_s32 (~0xff)), vreinterpretq_s32_u32 (vp)));
+	}
+#endif
+}
+
+
+/*
+==============
+D_SimdZTest8
+
+For i = 0 to 7, if z = ( zi + i * zistep ) >> 16 is nearer than pz[i],
+stores it there and sets bit i of the result
+==============
+*/
+static inline D_SIMD_TARGET int D_SimdZTest8 (short *pz, fixed16_t zi, fixed16_t zistep)
+{
+	unsigned	uz, uzs;
+
+	uz = zi;
+	uzs = zistep;
+
+#if D_SIMD_SSE2
+	{
+		__m128i	vz0, vz1, old, old0, old1, pass, newz;
+
+		vz0 = _mm_setr_epi32 (uz, uz + uzs, uz + 2*uzs, uz + 3*uzs);
+		vz1 = _mm_add_epi32 (vz0, _mm_set1_epi32 (4*uzs));
+		vz0 = _mm_srai_epi32 (vz0, 16);
+		vz1 = _mm_srai_epi32 (vz1, 16);
+
+		old = _mm_loadu_si128 ((__m128i *)pz);
+		old0 = _mm_srai_epi32 (_mm_unpacklo_epi16 (old, old), 16);
+		old1 = _mm_srai_epi32 (_mm_unpackhi_epi16 (old, old), 16);
+
+		pass = _mm_packs_epi32 (_mm_cmpgt_epi32 (vz0, old0), _mm_cmpgt_epi32 (vz1, old1));
+
+	// the stored z is cut to a short, like the scalar assignment
+		newz = _mm_packs_epi32 (_mm_srai_epi32 (_mm_slli_epi32 (vz0, 16), 16),
+			_mm_srai_epi32 (_mm_slli_epi32 (vz1, 16), 16));
+
+		_mm_storeu_si128 ((__m128i *)pz,
+			_mm_or_si128 (_mm_and_si128 (pass, newz), _mm_andnot_si128 (pass, old)));
+
+		return _mm_movemask_epi8 (_mm_packs_epi16 (pass, pass)) & 0xff;
+	}
+#else
+	{
+		int32x4_t	vz0, vz1;
+		int16x8_t	old, newz;
+		uint16x8_t	pass;
+		unsigned short	bits[8];
+		int			lanes[4], i, mask;
+
+		lanes[0] = uz; lanes[1] = uz + uzs; lanes[2] = uz + 2*uzs; lanes[3] = uz + 3*uzs;
+		vz0 = vld1q_s32 (lanes);
+		vz1 = vaddq_s32 (vz0, vdupq_n_s32 (4*uzs));
+		vz0 = vshrq_n_s32 (vz0, 16);
+		vz1 = vshrq_n_s32 (vz1, 16);
+
+		old = vld1q_s16 (pz);
+		pass = vcombine_u16 (vmovn_u32 (vcgtq_s32 (vz0, vmovl_s16 (vget_low_s16 (old)))),
+			vmovn_u32 (vcgtq_s32 (vz1, vmovl_s16 (vget_high_s16 (old)))));
+		newz = vcombine_s16 (vmovn_s32 (vz0), vmovn_s32 (vz1));
+
+		vst1q_s16 (pz, vbslq_s16 (pass, newz, old));
+
+		vst1q_u16 (bits, pass);
+		for (i=0, mask=0 ; i<8 ; i++)
+			mask |= (bits[i] & 1) << i;
+		return mask;
+	}
+#endif
+}
+
+#endif	// D_SIMD
+
+#endif	// D_SIMD_H
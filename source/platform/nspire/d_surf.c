@@ -31,6 +31,41 @@ surfcache_t                     *sc_rover, *sc_base;
 
 #define GUARDSIZE       4
 
+static struct
+{
+	int		frames;
+	int		lookups;
+	int		hits;
+	int		prefetched;		// blocks built ahead of the draw
+	int		prefetchhits;	// lookups that found one of those
+	int		builds;
+	double	buildtime;		// summed over every thread
+	double	stall;			// the main thread building or waiting on builds
+	double	framestall, maxstall;
+} d_cachestats;
+
+static int		d_cachebatch = 1;	// blocks handed out since the last builds
+
+#ifdef SYS_THREADS
+cvar_t	d_prefetch = {"d_prefetch","1"};	// build the visible surfaces ahead of the draw
+
+#define	D_PREFETCHKEEP	30		// frames a block is kept from prefetching after it is used
+
+typedef struct
+{
+	surfcache_t	*cache;
+	surfcache_t	**owner;
+	drawsurf_t	ds;
+	qboolean	built;
+	double		time;
+} surfjob_t;
+
+static surfjob_t	*d_surfjobs;
+static int			d_numsurfjobs, d_maxsurfjobs;
+static qboolean		d_cacheconflict;	// a block was wanted with two contents
+static qboolean		d_prefetching;
+#endif
+
 
 int     D_SurfaceCacheForRes (int width, int height)
 {
@@ -82,6 +117,9 @@ D_InitCaches
 */
 void D_InitCaches (void *buffer, int size)
 {
+#ifdef SYS_THREADS
+	D_FinishPrefetch ();
+#endif
 
 	if (!msg_suppress_1)
 		Con_Printf ("%ik surface cache\n", size/1024);
@@ -110,6 +148,10 @@ void D_FlushCaches (void)
 	if (!sc_base)
 		return;
 
+#ifdef SYS_THREADS
+	D_FinishPrefetch ();
+#endif
+
 	for (c = sc_base ; c ; c = c->next)
 	{
 		if (c->owner)
@@ -193,6 +235,8 @@ surfcache_t     *D_SCAlloc (int width, int size)
 		new->height = (size - sizeof(*new) + sizeof(new->data)) / width;
 
 	new->owner = NULL;              // should be set properly after return
+	new->batch = 0;
+	new->prefetched = false;
 
 	if (d_roverwrapped)
 	{
@@ -258,56 +302,90 @@ int D_log2 (int num)
 
 /*
 ================
-D_CacheSurface
+D_CacheLookup
+
+Fills in the texture and light levels the surface wants, and returns its
+cache block if that already holds them, or will once the current batch of
+builds is done. Without budget, a block that only needs relighting for
+new light styles is returned too, so the prefetch leaves it for draw time
+to charge to r_lightmap.c once.
 ================
 */
-surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+static surfcache_t *D_CacheLookup (msurface_t *surface, int miplevel, drawsurf_t *ds, qboolean budget)
 {
 	surfcache_t     *cache;
 
 //
 // if the surface is animating or flashing, flush the cache
 //
-	r_drawsurf.texture = R_TextureAnimation (surface->texinfo->texture);
-	r_drawsurf.lightadj[0] = d_lightstylevalue[surface->styles[0]];
-	r_drawsurf.lightadj[1] = d_lightstylevalue[surface->styles[1]];
-	r_drawsurf.lightadj[2] = d_lightstylevalue[surface->styles[2]];
-	r_drawsurf.lightadj[3] = d_lightstylevalue[surface->styles[3]];
+	ds->texture = R_TextureAnimation (surface->texinfo->texture);
+	ds->lightadj[0] = d_lightstylevalue[surface->styles[0]];
+	ds->lightadj[1] = d_lightstylevalue[surface->styles[1]];
+	ds->lightadj[2] = d_lightstylevalue[surface->styles[2]];
+	ds->lightadj[3] = d_lightstylevalue[surface->styles[3]];
 	
 //
 // see if the cache holds apropriate data
 //
 	cache = surface->cachespots[miplevel];
 
-	if (cache && !cache->dlight && surface->dlightframe != r_framecount
-			&& cache->texture == r_drawsurf.texture
-			&& cache->lightadj[0] == r_drawsurf.lightadj[0]
-			&& cache->lightadj[1] == r_drawsurf.lightadj[1]
-			&& cache->lightadj[2] == r_drawsurf.lightadj[2]
-			&& cache->lightadj[3] == r_drawsurf.lightadj[3] )
+	if (!cache || cache->texture != ds->texture)
+		return NULL;
+
+	if (cache->batch != d_cachebatch
+		&& (cache->dlight || surface->dlightframe == r_framecount))
+		return NULL;
+
+	if (cache->lightadj[0] == ds->lightadj[0]
+		&& cache->lightadj[1] == ds->lightadj[1]
+		&& cache->lightadj[2] == ds->lightadj[2]
+		&& cache->lightadj[3] == ds->lightadj[3] )
 		return cache;
 
+//
+// only the light styles changed, keep the old lighting for another frame
+// when this frame's relighting is over budget (r_lightmap.c)
+//
+	if (!budget)
+		return cache;
+
+	if (cache->batch != d_cachebatch
+		&& !R_LightmapBudget (((surface->extents[0]>>4)+1) * ((surface->extents[1]>>4)+1)))
+		return cache;
+
+	return NULL;
+}
+
+
+/*
+================
+D_CacheAlloc
+
+Takes a cache block for the surface, or reuses the one it has, and sets
+up ds for building it
+================
+*/
+static surfcache_t *D_CacheAlloc (msurface_t *surface, int miplevel, drawsurf_t *ds)
+{
+	surfcache_t     *cache;
+
 //
 // determine shape of surface
 //
 	surfscale = 1.0 / (1<<miplevel);
-	r_drawsurf.surfmip = miplevel;
-	r_drawsurf.surfwidth = surface->extents[0] >> miplevel;
-	r_drawsurf.rowbytes = r_drawsurf.surfwidth;
-	r_drawsurf.surfheight = surface->extents[1] >> miplevel;
-	
+	ds->surfmip = miplevel;
+	ds->surfwidth = surface->extents[0] >> miplevel;
+	ds->rowbytes = ds->surfwidth;
+	ds->surfheight = surface->extents[1] >> miplevel;
 
-	if( r_drawsurf.surfwidth & 3 )
-	{
-		r_drawsurf.surfwidth = r_drawsurf.surfwidth;
-	}
 //
 // allocate memory if needed
 //
+	cache = surface->cachespots[miplevel];
 	if (!cache)     // if a texture just animated, don't reallocate it
 	{
-		cache = D_SCAlloc (r_drawsurf.surfwidth,
-						   r_drawsurf.surfwidth * r_drawsurf.surfheight);
+		cache = D_SCAlloc (ds->surfwidth,
+						   ds->surfwidth * ds->surfheight);
 		surface->cachespots[miplevel] = cache;
 		cache->owner = &surface->cachespots[miplevel];
 		cache->mipscale = surfscale;
@@ -318,23 +396,547 @@ surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
 	else
 		cache->dlight = 0;
 
-	r_drawsurf.surfdat = (pixel_t *)cache->data;
+	ds->surfdat = (pixel_t *)cache->data;
 	
-	cache->texture = r_drawsurf.texture;
-	cache->lightadj[0] = r_drawsurf.lightadj[0];
-	cache->lightadj[1] = r_drawsurf.lightadj[1];
-	cache->lightadj[2] = r_drawsurf.lightadj[2];
-	cache->lightadj[3] = r_drawsurf.lightadj[3];
+	cache->texture = ds->texture;
+	cache->lightadj[0] = ds->lightadj[0];
+	cache->lightadj[1] = ds->lightadj[1];
+	cache->lightadj[2] = ds->lightadj[2];
+	cache->lightadj[3] = ds->lightadj[3];
+	cache->frame = r_framecount;
+	cache->prefetched = false;
+
+	ds->surf = surface;
+	ds->nodlights = false;
+
+	return cache;
+}
+
+
+/*
+================
+D_CacheHit
+================
+*/
+static void D_CacheHit (surfcache_t *cache)
+{
+	d_cachestats.hits++;
+	cache->frame = r_framecount;
+	if (cache->prefetched)
+	{
+		d_cachestats.prefetchhits++;
+		cache->prefetched = false;
+	}
+}
+
+
+/*
+================
+D_CacheStall
+================
+*/
+static void D_CacheStall (double time)
+{
+	d_cachestats.stall += time;
+	d_cachestats.framestall += time;
+}
+
+
+/*
+================
+D_CacheSurface
+================
+*/
+surfcache_t *D_CacheSurface (msurface_t *surface, int miplevel)
+{
+	surfcache_t     *cache;
+	double			time;
+
+	d_cachestats.lookups++;
+
+	cache = D_CacheLookup (surface, miplevel, &r_drawsurf, true);
+	if (cache)
+	{
+		D_CacheHit (cache);
+		return cache;
+	}
+
+	cache = D_CacheAlloc (surface, miplevel, &r_drawsurf);
 
 //
 // draw and light the surface texture
 //
-	r_drawsurf.surf = surface;
-
 	c_surf++;
+	time = Sys_FloatTime ();
 	R_DrawSurface ();
+	time = Sys_FloatTime () - time;
+
+	d_cachestats.builds++;
+	d_cachestats.buildtime += time;
+	D_CacheStall (time);
+
+	return cache;
+}
+
+#ifdef SYS_THREADS
+/*
+==============================================================================
+
+QUEUED BUILDS
+
+With the span drawing spread over threads (d_band.c), D_DrawSurfaces only
+takes cache blocks for the surfaces it is missing and queues them. The
+blocks are carved out of the cache on the main thread as they are queued,
+so the build threads only ever fill in memory that is already theirs and
+the allocator needs no locking. All of them are built together before the
+spans are drawn.
+
+D_PrefetchSurfaces queues the surfaces of the visible leaves the same way
+right after R_MarkLeaves, at the mip level they will probably be drawn at,
+and has the workers build them while the main thread walks the world and
+scans the edges. Whatever it guessed wrong is built with the rest of the
+misses.
+==============================================================================
+*/
+
+/*
+================
+D_AddSurfaceJob
+================
+*/
+static void D_AddSurfaceJob (surfcache_t *cache, drawsurf_t *ds)
+{
+	surfjob_t	*job;
+
+	if (d_numsurfjobs == d_maxsurfjobs)
+	{
+		d_maxsurfjobs = d_maxsurfjobs ? d_maxsurfjobs * 2 : 256;
+		job = Q_malloc (d_maxsurfjobs * sizeof(*job));
+		if (d_surfjobs)
+		{
+			memcpy (job, d_surfjobs, d_numsurfjobs * sizeof(*job));
+			free (d_surfjobs);
+		}
+		d_surfjobs = job;
+	}
+
+	job = &d_surfjobs[d_numsurfjobs++];
+	job->cache = cache;
+	job->owner = cache->owner;
+	job->ds = *ds;
+	job->built = false;
+}
+
+
+/*
+================
+D_BuildSurfaces
+
+Takes queued surfaces until there are none left
+================
+*/
+static void D_BuildSurfaces (bandthread_t *t)
+{
+	surfjob_t	*job;
+	double		time;
+	int			i;
+
+	while ((i = D_BatchNext ()) < d_numsurfjobs)
+	{
+		job = &d_surfjobs[i];
+		if (*job->owner != job->cache)
+			continue;	// the cache wrapped onto it since
+
+		time = Sys_FloatTime ();
+		r_drawsurf = job->ds;
+		R_DrawSurface ();
+		job->time = Sys_FloatTime () - time;
+		job->built = true;
+	}
+}
+
+
+/*
+================
+D_EndSurfaceJobs
+
+Counts the finished jobs and starts a new batch of blocks
+================
+*/
+static void D_EndSurfaceJobs (void)
+{
+	surfjob_t	*job;
+	int			i;
+
+	for (i=0, job=d_surfjobs ; i<d_numsurfjobs ; i++, job++)
+	{
+		if (!job->built)
+			continue;
+
+		d_cachestats.builds++;
+		d_cachestats.buildtime += job->time;
+		if (d_prefetching)
+			d_cachestats.prefetched++;
+	}
+
+	d_numsurfjobs = 0;
+	d_cacheconflict = false;
+	d_cachebatch++;
+}
+
+
+/*
+================
+D_QueueSurface
+
+D_CacheSurface for D_DrawSurfaces when the bands are drawn on threads.
+The block comes back before it is built.
+================
+*/
+surfcache_t *D_QueueSurface (msurface_t *surface, int miplevel)
+{
+	surfcache_t     *cache;
+	drawsurf_t		ds;
+
+	d_cachestats.lookups++;
+
+	cache = D_CacheLookup (surface, miplevel, &ds, true);
+	if (cache)
+	{
+		D_CacheHit (cache);
+		cache->batch = d_cachebatch;
+		return cache;
+	}
+
+// an earlier surface is going to be drawn from this block as it is, like
+// an instanced brush model on another frame, so it can't be rebuilt yet
+	cache = surface->cachespots[miplevel];
+	if (cache && cache->batch == d_cachebatch)
+		d_cacheconflict = true;
 
-	return surface->cachespots[miplevel];
+	cache = D_CacheAlloc (surface, miplevel, &ds);
+	cache->batch = d_cachebatch;
+
+	c_surf++;
+	D_AddSurfaceJob (cache, &ds);
+
+	return cache;
+}
+
+
+/*
+================
+D_BuildQueuedSurfaces
+
+Builds the queued surfaces on every thread. Returns false, building
+nothing, if the queue can't be built in one go.
+================
+*/
+qboolean D_BuildQueuedSurfaces (void)
+{
+	double	time;
+
+	if (d_cacheconflict)
+		return false;
+
+	if (d_numsurfjobs)
+	{
+		time = Sys_FloatTime ();
+		D_StartBatch (D_BuildSurfaces, true);
+		D_CacheStall (Sys_FloatTime () - time);
+	}
+
+	D_EndSurfaceJobs ();
+
+	return true;
+}
+
+
+/*
+================
+D_CancelQueuedSurfaces
+
+Marks the blocks of the queued surfaces as holding nothing, so the serial
+path builds them again
+================
+*/
+void D_CancelQueuedSurfaces (void)
+{
+	surfjob_t	*job;
+	int			i;
+
+	for (i=0, job=d_surfjobs ; i<d_numsurfjobs ; i++, job++)
+	{
+		if (*job->owner == job->cache)
+			job->cache->texture = NULL;
+	}
+
+	d_numsurfjobs = 0;
+	d_cacheconflict = false;
+	d_cachebatch++;
+}
+
+
+/*
+================
+D_PrefetchRoom
+
+True if D_SCAlloc can find size bytes without throwing out a block that
+was drawn lately
+================
+*/
+static qboolean D_PrefetchRoom (int size)
+{
+	surfcache_t	*c;
+	int			found;
+
+	size += sizeof(surfcache_t) - sizeof(((surfcache_t *)0)->data);
+	size = (size + 3) & ~3;
+
+	c = sc_rover;
+	if (!c || (byte *)c - (byte *)sc_base > sc_size - size)
+		c = sc_base;
+
+	for (found = 0 ; c && found < size ; c = c->next)
+	{
+		if (c->owner && r_framecount - c->frame < D_PREFETCHKEEP)
+			return false;
+		found += c->size;
+	}
+
+	return true;
+}
+
+
+/*
+================
+D_PrefetchMipLevel
+
+Guesses the mip level D_DrawSurfaces will ask for, from the nearest vertex
+in front of the view. Returns -1 if the surface is behind it.
+================
+*/
+static int D_PrefetchMipLevel (msurface_t *surf)
+{
+	model_t		*model;
+	medge_t		*edge;
+	vec3_t		local;
+	float		z, nearz;
+	int			i, lindex;
+	qboolean	crossed;
+
+	model = cl.worldmodel;
+	nearz = 0;
+	crossed = false;
+
+	for (i=0 ; i<surf->numedges ; i++)
+	{
+		lindex = model->surfedges[surf->firstedge + i];
+		if (lindex > 0)
+		{
+			edge = &model->edges[lindex];
+			VectorSubtract (model->vertexes[edge->v[0]].position, r_origin, local);
+		}
+		else
+		{
+			edge = &model->edges[-lindex];
+			VectorSubtract (model->vertexes[edge->v[1]].position, r_origin, local);
+		}
+
+		z = DotProduct (local, vpn);
+		if (z < NEAR_CLIP)
+			crossed = true;
+		else if (!nearz || z < nearz)
+			nearz = z;
+	}
+
+	if (!nearz)
+		return -1;
+	if (crossed)
+		nearz = NEAR_CLIP;	// clipped at the near plane
+
+	return D_MipLevelForScale (scale_for_mip * surf->texinfo->mipadjust / nearz);
+}
+
+
+/*
+================
+D_PrefetchSurfaces
+
+Queues the surfaces of the visible leaves in the view that have nothing
+cached, and has the workers start on them
+================
+*/
+void D_PrefetchSurfaces (void)
+{
+	mleaf_t		*leaf;
+	msurface_t	**mark, *surf;
+	surfcache_t	*cache;
+	drawsurf_t	ds;
+	mplane_t	*plane;
+	int			i, j, miplevel, size, budget, *pindex;
+	float		d;
+	vec3_t		rejectpt;
+
+	if (!d_prefetch.value || !cl.worldmodel || !D_BandsActive ())
+		return;
+
+
+	D_FinishPrefetch ();
+
+// guesses only take blocks nobody drew lately, and only so many a frame
+	budget = sc_size / 8;
+
+	currententity = &cl_entities[0];
+
+	for (i=0 ; i<cl.worldmodel->numleafs && budget > 0 ; i++)
+	{
+		leaf = &cl.worldmodel->leafs[i+1];
+		if (leaf->visframe != r_visframecount || !leaf->nummarksurfaces)
+			continue;
+
+	// same test R_RecursiveWorldNode rejects nodes with
+		for (j=0 ; j<4 ; j++)
+		{
+			pindex = pfrustum_indexes[j];
+			rejectpt[0] = (float)leaf->minmaxs[pindex[0]];
+			rejectpt[1] = (float)leaf->minmaxs[pindex[1]];
+			rejectpt[2] = (float)leaf->minmaxs[pindex[2]];
+
+			d = DotProduct (rejectpt, view_clipplanes[j].normal);
+			d -= view_clipplanes[j].dist;
+			if (d <= 0)
+				break;
+		}
+		if (j < 4)
+			continue;
+
+		mark = leaf->firstmarksurface;
+		for (j=0 ; j<leaf->nummarksurfaces && budget > 0 ; j++)
+		{
+			surf = mark[j];
+			if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB | SURF_DRAWBACKGROUND))
+				continue;
+			if (surf->dlightframe == r_framecount)
+				continue;	// built again at draw time anyway
+
+			plane = surf->plane;
+			d = DotProduct (r_origin, plane->normal) - plane->dist;
+			if ((surf->flags & SURF_PLANEBACK) ? d >= -BACKFACE_EPSILON : d <= BACKFACE_EPSILON)
+				continue;
+
+			miplevel = D_PrefetchMipLevel (surf);
+			if (miplevel < 0)
+				continue;
+
+			if (D_CacheLookup (surf, miplevel, &ds, false))
+				continue;	// already cached, queued from another leaf, or relit at draw time
+
+			size = (surf->extents[0] >> miplevel) * (surf->extents[1] >> miplevel);
+			if (!surf->cachespots[miplevel] && !D_PrefetchRoom (size))
+				goto done;
+
+			cache = D_CacheAlloc (surf, miplevel, &ds);
+			cache->batch = d_cachebatch;
+			cache->prefetched = true;
+
+		// the entity passes mark lights on the main thread while the workers
+		// build, so these go without; D_CacheLookup sends a surface that gets
+		// lit this frame back to be built again at draw time
+			ds.nodlights = true;
+			cache->dlight = 0;
+			D_AddSurfaceJob (cache, &ds);
+
+			budget -= cache->size;
+		}
+	}
+
+done:
+	if (!d_numsurfjobs)
+		return;
+
+	d_prefetching = true;
+	D_StartBatch (D_BuildSurfaces, false);
+}
+
+
+/*
+================
+D_FinishPrefetch
+
+Waits for the prefetched surfaces, before the cache can be touched again
+================
+*/
+void D_FinishPrefetch (void)
+{
+	double	time;
+
+	if (!d_prefetching)
+		return;
+
+	time = Sys_FloatTime ();
+	D_FinishBatch ();
+	D_CacheStall (Sys_FloatTime () - time);
+
+	D_EndSurfaceJobs ();
+	d_prefetching = false;
 }
+#endif
 
 
+/*
+================
+D_SurfaceCacheFrame
+================
+*/
+void D_SurfaceCacheFrame (void)
+{
+	d_cachestats.frames++;
+	d_cachestats.maxstall = max(d_cachestats.maxstall, d_cachestats.framestall);
+	d_cachestats.framestall = 0;
+}
+
+
+/*
+================
+D_CacheStats_f
+================
+*/
+static void D_CacheStats_f (void)
+{
+	int		frames;
+
+	if (Cmd_Argc () > 1 && !Q_strcasecmp (Cmd_Argv (1), "reset"))
+	{
+		memset (&d_cachestats, 0, sizeof(d_cachestats));
+		return;
+	}
+
+	frames = max(d_cachestats.frames, 1);
+
+	Con_Printf ("%i surface lookups, %i hits (%.1f%%), %i of them prefetched\n",
+		d_cachestats.lookups, d_cachestats.hits,
+		d_cachestats.lookups ? 100.0 * d_cachestats.hits / d_cachestats.lookups : 0,
+		d_cachestats.prefetchhits);
+	Con_Printf ("%i surfaces built, %i ahead of the draw, %.3f ms each\n",
+		d_cachestats.builds, d_cachestats.prefetched,
+		d_cachestats.builds ? 1000 * d_cachestats.buildtime / d_cachestats.builds : 0);
+	Con_Printf ("%i frames waited %.3f ms for surfaces on average, %.3f ms at most\n",
+		d_cachestats.frames, 1000 * d_cachestats.stall / frames,
+		1000 * d_cachestats.maxstall);
+}
+
+
+/*
+================
+D_InitSurfaceCache
+================
+*/
+void D_InitSurfaceCache (void)
+{
+#ifdef SYS_THREADS
+	Cvar_RegisterVariable (&d_prefetch);
+#endif
+
+	Cmd_AddCommand ("cachestats", D_CacheStats_f);
+}
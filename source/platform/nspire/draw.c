@@ -187,6 +187,8 @@ void Draw_Init (void)
 	cachepic_t *holder;
 
 	charset = Image_LoadImage ("gfx/charset", IMAGE_TGA, 1, qtrue, qfalse);
+	if (charset < 0)
+		Sys_Error ("Draw_Init: couldn't load gfx/charset");
 	holder = &cachepics[charset];
 	draw_chars = holder->data;
 
@@ -224,6 +226,8 @@ void Draw_Character (int x, int y, int num)
 	
 	if (y <= -8)
 		return;			// totally off screen
+	if (y > (int)vid.conheight - 8 || x < 0 || x > (int)vid.conwidth - 8)
+		return;			// would run off the buffer
 
 #ifdef PARANOID
 	if (y > vid.height - 8 || x < 0 || x > vid.width - 8)
@@ -348,6 +352,8 @@ void Draw_AdvancedCharacter(int x, int y, int num, int alpha, unsigned short col
 	
 	if (y <= -8)
 		return;			// totally off screen
+	if (y > (int)vid.conheight - 8 || x < 0 || x > (int)vid.conwidth - 8)
+		return;			// would run off the buffer
 
 #ifdef PARANOID
 	if (y > vid.height - 8 || x < 0 || x > vid.width - 8)
@@ -685,7 +691,11 @@ void Draw_TransPic (int x, int y, int pic)
 	unsigned short	*pusdest;
 	int				v, u;
 	 
-	cachepic_t *tex = &cachepics[pic];
+	cachepic_t *tex;
+
+	if (pic < 0)
+		return;		// the image failed to load
+	tex = &cachepics[pic];
 
 	if (x < 0 || (unsigned)(x + tex->width) > vid.width || y < 0 ||
 		 (unsigned)(y + tex->height) > vid.height)
@@ -768,7 +778,11 @@ void Draw_AdvancedPic (int x, int y, int pic, unsigned char alpha, unsigned char
 	int 			dither_factor;
 	int 			pixel_tracker;
 	 
-	cachepic_t *tex = &cachepics[pic];
+	cachepic_t *tex;
+
+	if (pic < 0)
+		return;		// the image failed to load
+	tex = &cachepics[pic];
 
 	if (x < 0 || (unsigned)(x + tex->width) > vid.width || y < 0 ||
 		 (unsigned)(y + tex->height) > vid.height)
@@ -922,7 +936,11 @@ void Draw_TransPicTranslate (int x, int y, int pic, byte *translation)
 	unsigned short	*pusdest;
 	int				v, u;
 	 
-	cachepic_t *tex = &cachepics[pic];
+	cachepic_t *tex;
+
+	if (pic < 0)
+		return;		// the image failed to load
+	tex = &cachepics[pic];
 
 	if (x < 0 || (unsigned)(x + tex->width) > vid.width || y < 0 ||
 		 (unsigned)(y + tex->height) > vid.height)
@@ -1574,7 +1592,7 @@ extern cvar_t cl_crosshair_debug;
 extern qboolean crosshair_pulse_grenade;
 void Draw_Crosshair (void)
 {
-	cachepic_t *tex = &cachepics[hitmark];
+	cachepic_t *tex;
 
 	if (cl_crosshair_debug.value) {
 		Draw_FillByColor(vid.width/2, 0, 1, 8, 255, 0, 0, 255);
@@ -1586,8 +1604,11 @@ void Draw_Crosshair (void)
 	if (cl.stats[STAT_ZOOM] == 2)
 		Draw_Pic (0, 0, sniper_scope);
 
-   	if (Hitmark_Time > sv.time)
+   	if (Hitmark_Time > sv.time && hitmark >= 0)
+	{
+		tex = &cachepics[hitmark];
         Draw_Pic ((vid.width - tex->width)/2,(vid.height - tex->height)/2, hitmark);
+	}
 
 	// Make sure to do this after hitmark drawing.
 	if (cl.stats[STAT_ZOOM] == 2 || cl.stats[STAT_ZOOM] == 1)
@@ -1598,7 +1619,7 @@ void Draw_Crosshair (void)
 
 	float col;
 
-	if (sv_player->v.facingenemy == 1) {
+	if (sv_player && sv_player->v.facingenemy == 1) {
 		col = 0;
 	} else {
 		col = 255;
@@ -1634,9 +1655,10 @@ void Draw_Crosshair (void)
 		if (CrossHairMaxSpread() < crosshair_offset || croshhairmoving)
 			crosshair_offset = CrossHairMaxSpread();
 
-		if (sv_player->v.view_ofs[2] == 8) {
+		// demos and remote servers have no player edict to check the stance of
+		if (sv_player && sv_player->v.view_ofs[2] == 8) {
 			crosshair_offset *= 0.80;
-		} else if (sv_player->v.view_ofs[2] == -10) {
+		} else if (sv_player && sv_player->v.view_ofs[2] == -10) {
 			crosshair_offset *= 0.65;
 		}
 
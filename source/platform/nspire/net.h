@@ -44,6 +44,9 @@ struct qsockaddr
 
 #define NET_PROTOCOL_VERSION	3
 
+// capabilities offered in CCREQ_CONNECT and granted in CCREP_ACCEPT
+#define NET_CAP_WINDOW			1		// windowed reliable messages
+
 // This is the network info/connection protocol.  It is used to find Quake
 // servers, get info about them, and connect to them.  Once connected, the
 // Quake game protocol (documented elsewhere) is used.
@@ -56,6 +59,7 @@ struct qsockaddr
 // CCREQ_CONNECT
 //		string	game_name				"QUAKE"
 //		byte	net_protocol_version	NET_PROTOCOL_VERSION
+//		byte	capabilities			NET_CAP_*, left out by older clients
 //
 // CCREQ_SERVER_INFO
 //		string	game_name				"QUAKE"
@@ -71,6 +75,7 @@ struct qsockaddr
 //
 // CCREP_ACCEPT
 //		long	port
+//		byte	capabilities			the ones both ends support, left out by older servers
 //
 // CCREP_REJECT
 //		string	reason
@@ -116,6 +121,17 @@ struct qsockaddr
 #define CCREP_PLAYER_INFO	0x84
 #define CCREP_RULE_INFO		0x85
 
+// net_loop.c queues each local message in a buffer of its own and hands
+// that buffer to the reader as net_message instead of copying it out
+#define	NET_LOOPMESSAGES	8
+
+typedef struct
+{
+	int			type;		// what NET_GetMessage returns for it
+	int			length;
+	byte		*data;		// NET_MAXMESSAGE bytes
+} loopmessage_t;
+
 typedef struct qsocket_s
 {
 	struct qsocket_s	*next;
@@ -143,6 +159,10 @@ typedef struct qsocket_s
 	int				receiveMessageLength;
 	byte			receiveMessage [NET_MAXMESSAGE];
 
+	loopmessage_t	loopqueue[NET_LOOPMESSAGES];	// net_loop.c only
+	int				loophead;
+	int				loopcount;
+
 	struct qsockaddr	addr;
 	char				address[NET_NAMELEN];
 
@@ -1,5 +1,7 @@
 
 
+#if defined( __arm__ )
+
 extern unsigned int udiv_fast_32_32_incorrect(unsigned int d, unsigned int n); /* this one has a slight error */
 extern unsigned int udiv_64_32( unsigned long long n, unsigned int d );
 extern unsigned int udiv_s31_32(unsigned int d, unsigned int n);
@@ -81,6 +83,74 @@ static inline int llmull_s28( int m0, int m1 )
 	return __ires;
 }
 
+#else
+
+/* portable versions for hosts without the ARM long multiplies, the Linux software build uses these */
+
+static inline unsigned int udiv_fast_32_32_incorrect( unsigned int d, unsigned int n )
+{
+	if( !d )
+	{
+		return 0xffffffff;
+	}
+	return n / d;
+}
+
+static inline unsigned int udiv_64_32( unsigned long long n, unsigned int d )
+{
+	if( ( n >> 32 ) >= d )
+	{
+		return 0xffffffff;
+	}
+	return ( unsigned int )( n / d );
+}
+
+static inline unsigned int udiv_s31_32( unsigned int d, unsigned int n )
+{
+	if( n >= d )
+	{
+		return 0x7fffffff;
+	}
+	return ( unsigned int )( ( ( unsigned long long )n << 31 ) / d );
+}
+
+static inline long long mul_64_32_r64( long long m0, int m1 )
+{
+	return ( long long )( ( unsigned long long )m0 * ( unsigned long long )( long long )m1 );
+}
+
+static inline long long llmull_s0( int m0, int m1 )
+{
+	return ( long long )m0 * m1;
+}
+
+static inline int llmull_s16( int m0, int m1 )
+{
+	return ( int )( ( ( long long )m0 * m1 ) >> 16 );
+}
+
+static inline int llmull_s21( int m0, int m1 )
+{
+	return ( int )( ( ( long long )m0 * m1 ) >> 21 );
+}
+
+static inline int llmull_s24( int m0, int m1 )
+{
+	return ( int )( ( ( long long )m0 * m1 ) >> 24 );
+}
+
+static inline int llmull_s27( int m0, int m1 )
+{
+	return ( int )( ( ( long long )m0 * m1 ) >> 27 );
+}
+
+static inline int llmull_s28( int m0, int m1 )
+{
+	return ( int )( ( ( long long )m0 * m1 ) >> 28 );
+}
+
+#endif
+
 typedef	long long fixed32_t;
 extern void test_float32_shift( float *f, int shift );
 #define CALCG_FIXED_FTOF32( f, f32 ) \
@@ -90,6 +90,26 @@ void R_AliasTransformFinalVert (finalvert_t *fv, auxvert_t *av,
 void R_AliasProjectFinalVert (finalvert_t *fv, auxvert_t *av);
 
 
+/*
+================
+R_AliasRadius
+
+How far from the origin any frame of the model can reach
+================
+*/
+float R_AliasRadius (model_t *model)
+{
+	aliashdr_t	*pahdr;
+	mdl_t		*pmdlhdr;
+	vec3_t		hi;
+
+	pahdr = Mod_Extradata (model);
+	pmdlhdr = (mdl_t *)((byte *)pahdr + pahdr->model);
+
+	VectorMA (pmdlhdr->scale_origin, 255, pmdlhdr->scale, hi);
+	return R_OcclusionRadius (pmdlhdr->scale_origin, hi);
+}
+
 /*
 ================
 R_AliasCheckBBox
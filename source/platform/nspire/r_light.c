@@ -131,6 +131,11 @@ void R_PushDlights (void)
 
 int R_LightPoint (vec3_t p)
 {
-	return 24;
+	vec3_t	color;
+
+	if (r_fullbright.value || !r_lightgrid.value || !R_LightGridPoint (p, color, NULL))
+		return 24;
+
+	return (color[0] + color[1] + color[2]) * (1.0 / 3.0);
 }
 
@@ -207,8 +207,8 @@ extern int		*pfrustum_indexes[4];
 extern int			ubasestep, errorterm, erroradjustup, erroradjustdown;
 extern int			vstartscan;
 
-extern fixed16_t	sadjust, tadjust;
-extern fixed16_t	bbextents, bbextentt;
+extern D_THREADLOCAL fixed16_t	sadjust, tadjust;
+extern D_THREADLOCAL fixed16_t	bbextents, bbextentt;
 
 #define MAXBVERTINDEXES	1000	// new clipped vertices when clipping bmodels
 								//  to the world BSP
@@ -254,6 +254,7 @@ extern finalvert_t		*pfinalverts;
 extern auxvert_t		*pauxverts;
 
 qboolean R_AliasCheckBBox (void);
+float R_AliasRadius (model_t *model);
 
 //=========================================================
 // turbulence stuff
@@ -23,9 +23,16 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "r_local.h"
 
 
+#ifdef __NSPIRE__
 extern void nspire_stack_redirect( void (*f_func)(void), void *new_stack );
 extern void *p_nspire_stack_redirect;
 
+// the deep recursions get a bigger stack than the calculator gives us
+#define R_STACK_REDIRECT( f_func ) nspire_stack_redirect( f_func, ( ( unsigned char * )p_nspire_stack_redirect ) + 0x60000 )
+#else
+#define R_STACK_REDIRECT( f_func ) f_func()
+#endif
+
 //define	PASSAGES
 
 void		*colormap;
@@ -240,6 +247,10 @@ void R_Init (void)
 	r_refdef.yOrigin = YCENTERING;
 
 	R_InitParticles ();
+	R_LightGridInit ();
+	R_LightmapInit ();
+	R_BSPCacheInit ();
+	R_OcclusionInit ();
 
 // TODO: collect 386-specific code in one place
 #if	id386
@@ -267,6 +278,11 @@ void R_NewMap (void)
 	r_viewleaf = NULL;
 	R_ClearParticles ();
 
+	R_BSPCacheOpen (cl.worldmodel->name, cl.worldmodel->checksum);
+	R_LightGridBuild (cl.worldmodel, cl.worldmodel->bspversion == HL_BSPVERSION ? 3 : 1);
+	R_BSPCacheClose ();
+	R_OcclusionNewMap (cl.worldmodel);
+
 	r_cnumsurfs = r_maxsurfs.value;
 
 	if (r_cnumsurfs <= MINSURFACES)
@@ -596,6 +612,9 @@ void R_DrawEntitiesOnList_(void)
 				}
 			}
 
+			if (R_OcclusionAliasCulled (currententity, R_AliasRadius (currententity->model)))
+				continue;
+
 			VectorCopy (currententity->origin, r_entorigin);
 			VectorSubtract (r_origin, r_entorigin, modelorg);
 
@@ -643,7 +662,7 @@ void R_DrawEntitiesOnList_(void)
 
 void R_DrawEntitiesOnList(void)
 {
-	nspire_stack_redirect( R_DrawEntitiesOnList_, ( ( unsigned char * )p_nspire_stack_redirect ) + 0x60000 );
+	R_STACK_REDIRECT( R_DrawEntitiesOnList_ );
 
 }
 
@@ -720,7 +739,7 @@ void R_DrawViewModel_ (void)
 
 void R_DrawViewModel(void)
 {
-	nspire_stack_redirect( R_DrawViewModel_, ( ( unsigned char * )p_nspire_stack_redirect ) + 0x60000 );
+	R_STACK_REDIRECT( R_DrawViewModel_ );
 }
 
 
@@ -828,7 +847,7 @@ void R_DrawStaticBEntitiesOnList (void)
 
 			clipflags = R_BmodelCheckBBox (clmodel, minmaxs);
 
-			if (clipflags != BMODEL_FULLY_CLIPPED)
+			if (clipflags != BMODEL_FULLY_CLIPPED && !R_OcclusionBrushCulled (currententity))
 			{
 				VectorCopy (currententity->origin, r_entorigin);
 				VectorSubtract (r_origin, r_entorigin, modelorg);
@@ -997,7 +1016,7 @@ void R_DrawBEntitiesOnList (void)
 
 			clipflags = R_BmodelCheckBBox (clmodel, minmaxs);
 
-			if (clipflags != BMODEL_FULLY_CLIPPED)
+			if (clipflags != BMODEL_FULLY_CLIPPED && !R_OcclusionBrushCulled (currententity))
 			{
 				VectorCopy (currententity->origin, r_entorigin);
 				VectorSubtract (r_origin, r_entorigin, modelorg);
@@ -1166,7 +1185,7 @@ void R_EdgeDrawing_ (void)
 
 void R_EdgeDrawing (void)
 {
-	nspire_stack_redirect( R_EdgeDrawing_, ( ( unsigned char * )p_nspire_stack_redirect ) + 0x60000 );
+	R_STACK_REDIRECT( R_EdgeDrawing_ );
 }
 
 /*
@@ -1195,6 +1214,10 @@ void R_RenderView_ (void)
 SetVisibilityByPassages ();
 #else
 	R_MarkLeaves ();	// done here so we know if we're in water
+#endif
+	R_OcclusionFrame ();
+#ifdef SYS_THREADS
+	D_PrefetchSurfaces ();
 #endif
 	/*printf("R_RenderView_ %s:%d\n", __FILE__, __LINE__ );*/
 // make FDIV fast. This reduces timing precision after we've been running for a
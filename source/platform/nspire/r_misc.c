@@ -430,6 +430,7 @@ void R_SetupFrame (void)
 	R_CheckVariables ();
 	
 	R_AnimateLight ();
+	R_LightmapFrame ();
 
 	r_framecount++;
 
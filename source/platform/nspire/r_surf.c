@@ -21,23 +21,25 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../../nzportable_def.h"
 #include "r_local.h"
+#include "d_simd.h"
 
 #define NSPIRE_CHEAP_SHOT_SURF 1
 
-drawsurf_t	r_drawsurf;
-
-int				lightleft, sourcesstep, blocksize, sourcetstep;
-int				lightdelta, lightdeltastep;
-int				lightright, lightleftstep, lightrightstep, blockdivshift;
-unsigned		blockdivmask;
-void			*prowdestbase;
-unsigned char	*pbasesource;
-int				surfrowbytes;	// used by ASM files
-unsigned		*r_lightptr;
-int				r_stepback;
-int				r_lightwidth;
-int				r_numhblocks, r_numvblocks;
-unsigned char	*r_source, *r_sourcemax;
+// surfaces can be built on several threads at once, see d_band.c
+D_THREADLOCAL drawsurf_t	r_drawsurf;
+
+D_THREADLOCAL int				lightleft, sourcesstep, blocksize, sourcetstep;
+D_THREADLOCAL int				lightdelta, lightdeltastep;
+D_THREADLOCAL int				lightright, lightleftstep, lightrightstep, blockdivshift;
+D_THREADLOCAL unsigned			blockdivmask;
+D_THREADLOCAL void				*prowdestbase;
+D_THREADLOCAL unsigned char		*pbasesource;
+D_THREADLOCAL int				surfrowbytes;	// used by ASM files
+D_THREADLOCAL unsigned			*r_lightptr;
+D_THREADLOCAL int				r_stepback;
+D_THREADLOCAL int				r_lightwidth;
+D_THREADLOCAL int				r_numhblocks, r_numvblocks;
+D_THREADLOCAL unsigned char		*r_source, *r_sourcemax;
 
 void R_DrawSurfaceBlock8_mip0 (void);
 void R_DrawSurfaceBlock8_mip1 (void);
@@ -65,8 +67,22 @@ static void	(*surfmiptable_aligned_colormap[4])(void) = {
 	R_DrawSurfaceBlock8_mip3_aligned_colormap
 };
 
+#if D_SIMD
+void R_DrawSurfaceBlock8_mip0_simd (void);
+void R_DrawSurfaceBlock8_mip1_simd (void);
+void R_DrawSurfaceBlock8_mip2_simd (void);
+
+// mip 3 rows are only 2 texels wide, too short to be worth it
+static void	(*surfmiptable_simd[4])(void) = {
+	R_DrawSurfaceBlock8_mip0_simd,
+	R_DrawSurfaceBlock8_mip1_simd,
+	R_DrawSurfaceBlock8_mip2_simd,
+	R_DrawSurfaceBlock8_mip3_aligned_colormap
+};
+#endif
 
-unsigned		blocklights[18*18];
+
+D_THREADLOCAL unsigned	blocklights[18*18];
 
 /*
 ===============
@@ -89,6 +105,7 @@ void R_AddDynamicLights (void)
 	int			s, t;
 	int			i;
 	int			smax, tmax;
+	int			s0, s1, t0, t1;
 	mtexinfo_t	*tex;
 
 	surf = r_drawsurf.surf;
@@ -121,6 +138,10 @@ void R_AddDynamicLights (void)
 
 		local[0] -= surf->texturemins[0];
 		local[1] -= surf->texturemins[1];
+
+	// skip the texels out of reach
+		R_LightmapLightSpan (local[0], minlight, smax, &s0, &s1);
+		R_LightmapLightSpan (local[1], minlight, tmax, &t0, &t1);
 		
 #if NSPIRE_WHAT_IS_GOING_ON_IN_HERE
 		FIXED_FLOATTOFIXED( local[ 0 ], rgf16_local[ 0 ], 8 );
@@ -128,12 +149,12 @@ void R_AddDynamicLights (void)
 		FIXED_FLOATTOFIXED( rad, f16_rad, 8 );
 		FIXED_FLOATTOFIXED( minlight, f16_minlight, 8 );
 
-		for (t = 0 ; t<tmax ; t++)
+		for (t = t0 ; t<t1 ; t++)
 		{
 			td = rgf16_local[1] - (t<<12);
 			if (td < 0)
 				td = -td;
-			for (s=0 ; s<smax ; s++)
+			for (s=s0 ; s<s1 ; s++)
 			{
 				sd = rgf16_local[0] - (s<<12);
 				if (sd < 0)
@@ -147,12 +168,12 @@ void R_AddDynamicLights (void)
 			}
 		}
 #else
-		for (t = 0 ; t<tmax ; t++)
+		for (t = t0 ; t<t1 ; t++)
 		{
 			td = local[1] - t*16;
 			if (td < 0)
 				td = -td;
-			for (s=0 ; s<smax ; s++)
+			for (s=s0 ; s<s1 ; s++)
 			{
 				sd = local[0] - s*16;
 				if (sd < 0)
@@ -234,7 +255,7 @@ void R_BuildLightMap (void)
 		}
 
 // add all the dynamic lights
-	if (surf->dlightframe == r_framecount)
+	if (!r_drawsurf.nodlights && surf->dlightframe == r_framecount)
 		R_AddDynamicLights ();
 
 // bound, invert, and shift
@@ -336,6 +357,11 @@ void R_DrawSurface (void)
 		}
 		else
 		{
+#if D_SIMD
+			if (d_usesimd)
+				pblockdrawer = surfmiptable_simd[ r_drawsurf.surfmip ];
+			else
+#endif
 			pblockdrawer = surfmiptable_aligned_colormap[ r_drawsurf.surfmip ];
 		}
 	// TODO: only needs to be set when there is a display settings change
@@ -959,6 +985,79 @@ void R_DrawSurfaceBlock8_mip3_aligned_colormap (void)
 }
 
 
+#if D_SIMD
+/*
+================
+R_DrawSurfaceBlock8_simd
+
+The aligned colormap blocks with the light stepping and colormap offsets
+of 4 texels worked out at once. blocksize is 16 >> mip, and a power of two
+of at least 4.
+================
+*/
+static inline D_SIMD_TARGET void R_DrawSurfaceBlock8_simd (int blocksize, int blockshift)
+{
+	int				v, i, b, lightstep, lighttemp, light;
+	unsigned char	*psource, *prowdest;
+	pixel_t *colormap = vid.colormap;
+	int local_lightleft, local_lightright, local_lightleftstep, local_lightrightstep, local_surfrowbytes, local_sourcetstep;
+	int offsets[4];
+
+	psource = pbasesource;
+	prowdest = prowdestbase;
+
+	for (v=0 ; v<r_numvblocks ; v++)
+	{
+		local_lightleft = r_lightptr[0] & 0xffff;
+		local_lightright = r_lightptr[1] & 0xffff;
+		r_lightptr += r_lightwidth;
+		local_lightleftstep = ( ( (int)r_lightptr[0] & 0xffff ) - local_lightleft) >> blockshift;
+		local_lightrightstep = ( ( (int)r_lightptr[1] & 0xffff ) - local_lightright) >> blockshift;
+		local_surfrowbytes = surfrowbytes;
+		local_sourcetstep = sourcetstep;
+
+		for (i=0 ; i<blocksize ; i++)
+		{
+			lighttemp = ( local_lightright - local_lightleft );
+			lightstep = lighttemp >> blockshift;
+			light = local_lightleft;
+			local_lightright += local_lightrightstep;
+			local_lightleft += local_lightleftstep;
+
+			for (b=0; b < blocksize; b += 4)
+			{
+				D_SimdLightOffsets4 (offsets, psource + b, light, lightstep);
+				prowdest[b] = colormap[offsets[0]];
+				prowdest[b+1] = colormap[offsets[1]];
+				prowdest[b+2] = colormap[offsets[2]];
+				prowdest[b+3] = colormap[offsets[3]];
+				light += lightstep * 4;
+			}
+			psource += local_sourcetstep;
+			prowdest += local_surfrowbytes;
+		}
+
+		if (psource >= r_sourcemax)
+			psource -= r_stepback;
+	}
+}
+
+D_SIMD_TARGET void R_DrawSurfaceBlock8_mip0_simd (void)
+{
+	R_DrawSurfaceBlock8_simd (16, 4);
+}
+
+D_SIMD_TARGET void R_DrawSurfaceBlock8_mip1_simd (void)
+{
+	R_DrawSurfaceBlock8_simd (8, 3);
+}
+
+D_SIMD_TARGET void R_DrawSurfaceBlock8_mip2_simd (void)
+{
+	R_DrawSurfaceBlock8_simd (4, 2);
+}
+#endif
+
 #endif
 
 
@@ -1408,6 +1408,7 @@ void SCR_UpdateScreen (void)
 
 	//muff - to show FPS on screen
 	SCR_DrawFPS ();
+	R_OcclusionDrawStats ();
 	SCR_CheckDrawCenterString ();
 	SCR_CheckDrawUseString ();
 	HUD_Draw ();
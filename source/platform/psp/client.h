@@ -232,6 +232,7 @@ typedef struct
 	int			viewentity;		// cl_entities[cl.viewentity] = player
 	int			maxclients;
 	int			gametype;
+	qboolean	moveacks;		// server numbers its acks of our moves
 
 	lerpents_t	*lerpents;
 
@@ -330,6 +331,18 @@ void CL_Disconnect (void);
 void CL_Disconnect_f (void);
 void CL_NextDemo (void);
 
+void CL_InterpServerTime (void);
+void CL_InterpSample (entity_t *ent, qboolean reset);
+
+//
+// cl_pred
+//
+void CL_InitPrediction (void);
+void CL_PredictClear (void);
+int CL_PredictSaveMove (usercmd_t *cmd, vec3_t viewangles);
+void CL_ParseMoveAck (void);
+qboolean CL_PredictMove (vec3_t origin);
+
 #define			MAX_VISEDICTS	256
 extern	int				cl_numvisedicts;
 extern	entity_t		*cl_visedicts[MAX_VISEDICTS];
@@ -403,6 +416,18 @@ void CL_Stop_f (void);
 void CL_Record_f (void);
 void CL_PlayDemo_f (void);
 void CL_TimeDemo_f (void);
+void CL_DemoSeek_f (void);
+void CL_DemoStats_f (void);
+
+// timedemo frame phases
+#define	TD_PARSE		0		// CL_GetMessage, CL_ParseServerMessage
+#define	TD_RELINK		1		// CL_RelinkEntities, CL_UpdateTEnts
+#define	TD_RENDER		2		// V_RenderView
+#define	TD_SOUND		3		// S_Update
+#define	TD_PHASES		4
+
+void CL_TimeDemoPhase (int phase, double time);
+void CL_TimeDemoFrame (void);
 
 //
 // cl_parse.c
@@ -271,6 +271,84 @@ int R_CullBox (vec3_t mins, vec3_t maxs)
 	return result;
 }
 
+/*
+=================
+R_CullEntities
+
+Culls everything R_DrawEntitiesOnList and R_AddStaticBrushModelsToChains
+will draw as one hierarchy, once the world has added the static entities
+=================
+*/
+void R_CullEntities (void)
+{
+	int			i;
+	entity_t	*e;
+	vec3_t		mins, maxs;
+
+	R_CullBeginBoxes ();
+
+	for (i=0 ; i<cl_numvisedicts + cl_numstaticbrushmodels ; i++)
+	{
+		e = i < cl_numvisedicts ? cl_visedicts[i] : cl_staticbrushmodels[i - cl_numvisedicts];
+		e->cullframe = r_framecount;
+		e->cullbox = -1;
+
+		if (!e->model)
+			continue;
+
+		switch (e->model->type)
+		{
+		case mod_alias:
+			// R_CullBox never tested the last plane
+			VectorAdd (e->origin, e->model->mins, mins);
+			VectorAdd (e->origin, e->model->maxs, maxs);
+			e->cullbox = R_CullAddBox (mins, maxs, CULL_ALLPLANES(4));
+			break;
+
+		case mod_brush:
+			// rotated ones in R_DrawBrushModel are bounded by their radius
+			if (i < cl_numvisedicts && (e->angles[0] || e->angles[1] || e->angles[2]))
+			{
+				mins[0] = mins[1] = mins[2] = -e->model->radius;
+				maxs[0] = maxs[1] = maxs[2] = e->model->radius;
+				VectorAdd (e->origin, mins, mins);
+				VectorAdd (e->origin, maxs, maxs);
+			}
+			else
+			{
+				VectorAdd (e->origin, e->model->mins, mins);
+				VectorAdd (e->origin, e->model->maxs, maxs);
+			}
+			e->cullbox = R_CullAddBox (mins, maxs, CULL_ALLPLANES(5));
+			break;
+
+		default:
+			break;
+		}
+	}
+
+	R_CullBoxes ();
+}
+
+/*
+=================
+R_CullEntity
+
+What R_CullEntities found for an entity, or a test of its box alone if it
+wasn't there, like the view model. Same returns as R_FrustumCheckBox
+=================
+*/
+int R_CullEntity (entity_t *e, vec3_t mins, vec3_t maxs, int cullmask)
+{
+	int		mask;
+
+	if (e->cullframe == r_framecount && e->cullbox >= 0)
+		return R_CullBoxResult (e->cullbox);
+
+	mask = cullmask;
+	return R_CullBoxMask (mins, maxs, &mask);
+}
+
 /*
 =================
 R_CullSphere
@@ -1273,7 +1351,7 @@ void R_DrawTransparentAliasModel (entity_t *e)
 	VectorAdd (e->origin, clmodel->mins, mins);
 	VectorAdd (e->origin, clmodel->maxs, maxs);
 
-	if (R_CullBox(mins, maxs) == 2)
+	if (R_CullEntity(e, mins, maxs, CULL_ALLPLANES(4)) == CULL_OUTSIDE)
 		return;
 	
 	VectorCopy (e->origin, r_entorigin);
@@ -1366,6 +1444,45 @@ int partial_zombies_drawn;
 aliashdr_t * zcfull_mdl;
 aliashdr_t * zfull_mdl;
 
+/*
+=================
+R_AliasRadius
+
+How far from the origin any frame of the entity's model can reach, with
+the limbs of a zombie that get drawn along with it
+=================
+*/
+float R_AliasRadius (entity_t *e)
+{
+	int			i, limbs[3];
+	float		radius;
+	model_t		*clmodel;
+	aliashdr_t	*paliashdr;
+	vec3_t		lo, hi;
+
+	limbs[0] = e->z_head;
+	limbs[1] = e->z_larm;
+	limbs[2] = e->z_rarm;
+
+	radius = 0;
+	clmodel = e->model;
+	for (i=0 ; i<4 ; i++)
+	{
+		if (i > 0)
+			clmodel = limbs[i - 1] ? cl_entities[limbs[i - 1]].model : NULL;
+		if (!clmodel || clmodel->type != mod_alias)
+			continue;
+
+		// the vertices were made signed at load, see Mod_LoadAliasFrame
+		paliashdr = (aliashdr_t *)Mod_Extradata (clmodel);
+		VectorMA (paliashdr->scale_origin, -128, paliashdr->scale, lo);
+		VectorMA (paliashdr->scale_origin, 127, paliashdr->scale, hi);
+		radius = MAX (radius, R_OcclusionRadius (lo, hi));
+	}
+
+	return radius;
+}
+
 void R_DrawAliasModel (entity_t *e)
 {
 	char			specChar;
@@ -1380,7 +1497,7 @@ void R_DrawAliasModel (entity_t *e)
 	VectorAdd (e->origin, clmodel->mins, mins);
 	VectorAdd (e->origin, clmodel->maxs, maxs);
 
-	if (R_CullBox(mins, maxs) == 2)
+	if (R_CullEntity(e, mins, maxs, CULL_ALLPLANES(4)) == CULL_OUTSIDE)
 		return;
 
 	//=============================================================================================== 97% at this point
@@ -1822,6 +1939,8 @@ void R_DrawEntitiesOnList (void)
 		case mod_alias:
 			{
 				aliashdr_t * paliashdr = (aliashdr_t *)Mod_Extradata (currententity->model);
+				if (R_OcclusionAliasCulled (currententity, R_AliasRadius (currententity)))
+					break;
 				textureindex = paliashdr->gl_texturenum[currententity->skinnum][anim];
 				if(specChar == '$') { // alpha blended
 					prev_visedict = trans_entity_batches[textureindex];
@@ -1859,7 +1978,8 @@ void R_DrawEntitiesOnList (void)
 			break;
 
 		case mod_brush:
-			R_DrawBrushModel (currententity);
+			if (!R_OcclusionBrushCulled (currententity))
+				R_DrawBrushModel (currententity);
 			break;
 
 		default:
@@ -2156,6 +2276,7 @@ void R_RenderScene (void)
 	//setupframe
 	Fog_SetupFrame(false);
 	R_AnimateLight();
+	R_LightmapFrame();
 	++r_framecount;
 
 	VectorCopy (r_refdef.vieworg, r_origin);
@@ -2189,6 +2310,7 @@ void R_RenderScene (void)
 		frustum[i].dist = DotProduct (r_origin, frustum[i].normal);
 		frustum[i].signbits = SignbitsForPlane (&frustum[i]);
 	}
+	R_CullSetPlanes (frustum, 5);
 
 //setupgl
 	// set up viewpoint
@@ -2307,6 +2429,7 @@ void R_RenderScene (void)
 	sceGuTexFunc(GU_TFX_REPLACE, GU_TCC_RGBA);
 
 	R_MarkLeaves ();	// done here so we know if we're in water
+	R_OcclusionFrame ();
 	Fog_EnableGFog (); //johnfitz
 	R_DrawWorld ();		// adds static entities to the list
 	S_ExtraUpdate ();	// don't let sound get messed up if going slow
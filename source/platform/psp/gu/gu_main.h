@@ -330,6 +330,9 @@ void R_DrawSkyChain (msurface_t *s);
 int R_FrustumCheckBox (vec3_t mins, vec3_t maxs);
 int R_FrustumCheckSphere (vec3_t centre, float radius);
 int R_CullBox (vec3_t emins, vec3_t emaxs);
+void R_CullEntities (void);
+int R_CullEntity (entity_t *e, vec3_t mins, vec3_t maxs, int cullmask);
+float R_AliasRadius (entity_t *e);
 qboolean R_CullSphere (vec3_t centre, float radius);
 void R_RotateForEntity (entity_t *e, int shadow, unsigned char scale);
 void R_BlendedRotateForEntity (entity_t *e, int shadow, unsigned char scale);
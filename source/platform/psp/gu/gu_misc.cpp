@@ -355,6 +355,11 @@ void R_Init (void)
 	R_InitDecals ();
 	Sky_Init (); //johnfitz
 	Fog_Init (); //johnfitz
+	R_LightGridInit ();
+	R_LightmapInit ();
+	R_BSPCacheInit ();
+	R_CullInit ();
+	R_OcclusionInit ();
 
 	/*
 	playertextures = texture_extension_number;
@@ -387,7 +392,12 @@ void R_NewMap (void)
 	R_ClearParticles ();
     R_ClearDecals();
 
+	R_BSPCacheOpen (cl.worldmodel->name, cl.worldmodel->checksum);
 	GL_BuildLightmaps ();
+	R_LightGridBuild (cl.worldmodel, 3);
+	R_BSPCacheClose ();
+	R_LightmapNewMap (cl.worldmodel);
+	R_OcclusionNewMap (cl.worldmodel);
 
 	Sky_NewMap (); //johnfitz -- skybox in worldspawn
     Fog_ParseWorldspawn ();
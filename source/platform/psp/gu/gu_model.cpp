@@ -731,6 +731,7 @@ void Mod_LoadLighting (lump_t *l)
 			{
 				Con_DPrintf("%s loaded", litfilename);
 				loadmodel->lightdata = data + 8;
+				loadmodel->checksum = R_BSPCacheChecksum (loadmodel->checksum, data, com_filesize);
 				return;
 			}
 			else
@@ -1551,6 +1552,11 @@ void Mod_LoadBrushModel (model_t *mod, void *buffer)
 	for (i=0 ; i<sizeof(dheader_t)/4 ; i++)
 		((int *)header)[i] = LittleLong ( ((int *)header)[i]);
 
+// key the render cache on the lumps everything is built from
+	mod->checksum = 0;
+	for (i=0 ; i<HEADER_LUMPS ; i++)
+		mod->checksum = R_BSPCacheChecksum (mod->checksum, mod_base + header->lumps[i].fileofs, header->lumps[i].filelen);
+
 
     loading_num_step = loading_num_step + 16;
 	loading_step = 2;
@@ -591,6 +591,7 @@ typedef struct model_s
 	byte		*lightdata;
 	char		*entities;
     int			bspversion;
+	unsigned	checksum;	// of the lumps and .lit, keys the r_bspcache file
     qboolean	isworldmodel;
 //
 // additional model data
@@ -1524,6 +1524,7 @@ void SCR_UpdateScreen (void)
 
 	//muff - to show FPS on screen
 	SCR_DrawFPS ();
+	R_OcclusionDrawStats ();
 	SCR_DrawBAT ();
 	SCR_CheckDrawCenterString ();
 	SCR_CheckDrawUseString ();
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // r_surf.c: surface-related refresh code
 
 #include <pspgum.h>
+#include <cstddef>
 
 extern "C"
 {
@@ -97,7 +98,7 @@ void 	VID_SetPaletteTX();
 R_AddDynamicLights
 ===============
 */
-void R_AddDynamicLights (msurface_t *surf)
+void R_AddDynamicLights (msurface_t *surf, lightmaprect_t *rect)
 {
 	int			lnum;
 	int			sd, td;
@@ -106,6 +107,7 @@ void R_AddDynamicLights (msurface_t *surf)
 	int			s, t;
 	int			i;
 	int			smax, tmax;
+	int			s0, s1, t0, t1;
 	mtexinfo_t	*tex;
 
 	// LordHavoc: .lit support begin
@@ -143,18 +145,26 @@ void R_AddDynamicLights (msurface_t *surf)
 		local[0] -= surf->texturemins[0];
 		local[1] -= surf->texturemins[1];
 
+	// only the texels being rebuilt that the light reaches
+		R_LightmapLightSpan (local[0], minlight, smax, &s0, &s1);
+		R_LightmapLightSpan (local[1], minlight, tmax, &t0, &t1);
+		s0 = MAX(s0, (int)rect->s0);
+		s1 = MIN(s1, (int)rect->s1);
+		t0 = MAX(t0, (int)rect->t0);
+		t1 = MIN(t1, (int)rect->t1);
+
 		// LordHavoc: .lit support begin
-		bl = blocklights;
 		cred = cl_dlights[lnum].color[0] * 256.0f;
 		cgreen = cl_dlights[lnum].color[1] * 256.0f;
 		cblue = cl_dlights[lnum].color[2] * 256.0f;
 		// LordHavoc: .lit support end
-		for (t = 0 ; t<tmax ; t++)
+		for (t = t0 ; t<t1 ; t++)
 		{
 			td = int(local[1]) - t*16;
 			if (td < 0)
 				td = -td;
-			for (s=0 ; s<smax ; s++)
+			bl = blocklights + (t*smax + s0)*3;
+			for (s=s0 ; s<s1 ; s++)
 			{
 				sd = int(local[0]) - s*16;
 				if (sd < 0)
@@ -209,24 +219,24 @@ void R_AddDynamicLights (msurface_t *surf)
 
 /*
 ===============
-R_BuildLightMap
+R_BuildLightMapRect
 
-Combine and scale multiple lightmaps into the 8.8 format in blocklights
+Combine and scale multiple lightmaps into the 8.8 format in blocklights,
+for the texels of the surface in rect. dest is where the whole surface
+starts.
 ===============
 */
-void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
+void R_BuildLightMapRect (msurface_t *surf, byte *dest, int stride, lightmaprect_t *rect)
 {
 	int			smax, tmax;
 	int			t;
 	int			i, j, size;
-	byte		*lightmap;
+	byte		*lightmap, *src;
 	unsigned	scale;
 	int			maps;
 	unsigned	*bl;
 	int r, g, b, a;
 
-    //unsigned *blcr, *blcg, *blcb;
-
 	surf->cached_dlight = (surf->dlightframe == r_framecount) ? true : false;
 
 	smax = (surf->extents[0]>>4)+1;
@@ -238,13 +248,15 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 	if (r_fullbright.value || !cl.worldmodel->lightdata)
 	{
 		// LordHavoc: .lit support begin
-		bl = blocklights;
-		for (i=0 ; i<size ; i++) // LordHavoc: original code
-		//	blocklights[i] = 255*256; // LordHavoc: original code
+		for (i=rect->t0 ; i<rect->t1 ; i++)
 		{
-			*bl++ = 255*256;
-			*bl++ = 255*256;
-			*bl++ = 255*256;
+			bl = blocklights + (i*smax + rect->s0)*3;
+			for (j=rect->s0 ; j<rect->s1 ; j++)
+			{
+				*bl++ = 255*256;
+				*bl++ = 255*256;
+				*bl++ = 255*256;
+			}
 		}
 		// LordHavoc: .lit support end
 		goto store;
@@ -252,13 +264,15 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 
 // clear to no light
 	// LordHavoc: .lit support begin
-	bl = blocklights;
-	for (i=0 ; i<size ; i++) // LordHavoc: original code
-	//	blocklights[i] = 0; // LordHavoc: original code
+	for (i=rect->t0 ; i<rect->t1 ; i++)
 	{
-		*bl++ = 0;
-		*bl++ = 0;
-		*bl++ = 0;
+		bl = blocklights + (i*smax + rect->s0)*3;
+		for (j=rect->s0 ; j<rect->s1 ; j++)
+		{
+			*bl++ = 0;
+			*bl++ = 0;
+			*bl++ = 0;
+		}
 	}
 	// LordHavoc: .lit support end
 
@@ -270,69 +284,57 @@ void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
 			scale = d_lightstylevalue[surf->styles[maps]];
 			surf->cached_light[maps] = scale;	// 8.8 fraction
 			// LordHavoc: .lit support begin
-			bl = blocklights;
-			for (i=0 ; i<size ; i++) // LordHavoc: original code
-			//	blocklights[i] += lightmap[i] * scale; // LordHavoc: original code
-			//lightmap += size;	// skip to next lightmap // LordHavoc: original code
+			for (i=rect->t0 ; i<rect->t1 ; i++)
 			{
-				*bl++ += *lightmap++ * scale;
-				*bl++ += *lightmap++ * scale;
-				*bl++ += *lightmap++ * scale;
+				bl = blocklights + (i*smax + rect->s0)*3;
+				src = lightmap + (i*smax + rect->s0)*3;
+				for (j=rect->s0 ; j<rect->s1 ; j++)
+				{
+					*bl++ += *src++ * scale;
+					*bl++ += *src++ * scale;
+					*bl++ += *src++ * scale;
+				}
 			}
+			lightmap += size*3;	// skip to next lightmap
 			// LordHavoc: .lit support end
 		}
 
 // add all the dynamic lights
 	if (surf->dlightframe == r_framecount)
-		R_AddDynamicLights (surf);
+		R_AddDynamicLights (surf, rect);
 
 // bound, invert, and shift
 store:
 	switch (LIGHTMAP_BYTES)
 	{
 	case 4:
-		stride -= (smax<<2);
-		bl = blocklights;
-		for (i=0 ; i<tmax ; i++, dest += stride)
-		{
-			for (j=0 ; j<smax ; j++)
-			{
-				// LordHavoc: .lit support begin
-				// LordHavoc: positive lighting (would be 255-t if it were inverse like glquake was)
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				*dest++ = 255;
-				// LordHavoc: .lit support end
-			}
-		}
-		break;
 	case 3:
-		stride -= (smax<<2);
-		bl = blocklights;
-		for (i=0 ; i<tmax ; i++, dest += stride)
+		for (i=rect->t0 ; i<rect->t1 ; i++)
 		{
-			for (j=0 ; j<smax ; j++)
+			bl = blocklights + (i*smax + rect->s0)*3;
+			src = dest + i*stride + (rect->s0<<2);
+			for (j=rect->s0 ; j<rect->s1 ; j++)
 			{
 				// LordHavoc: .lit support begin
 				// LordHavoc: positive lighting (would be 255-t if it were inverse like glquake was)
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				t = *bl++ >> 7;if (t > 255) t = 255;*dest++ = t;
-				*dest++ = 255;
+				t = *bl++ >> 7;if (t > 255) t = 255;*src++ = t;
+				t = *bl++ >> 7;if (t > 255) t = 255;*src++ = t;
+				t = *bl++ >> 7;if (t > 255) t = 255;*src++ = t;
+				*src++ = 255;
 				// LordHavoc: .lit support end
 			}
 		}
 		break;
 	case 2:
-		bl = blocklights;
 		union luxel {
 			unsigned short rgb;
 			byte bytes[2];
 		};
-		for (i=0 ; i<tmax ; i++ ,dest += stride)
+		for (i=rect->t0 ; i<rect->t1 ; i++)
 		{
-			for (j=0 ; j<smax*2 ; j++)
+			bl = blocklights + (i*smax + rect->s0)*3;
+			src = dest + i*stride + (rect->s0<<1);
+			for (j=rect->s0 ; j<rect->s1 ; j++)
 			{
 				r = bl[0] >> 7; if (r > 255) r = 255; r = r >> 3;
 				g = bl[1] >> 7; if (g > 255) g = 255; g = g >> 3;
@@ -342,18 +344,18 @@ store:
 				luxel lx;
 				lx.rgb = (a << 15) | (b << 10) | (g << 5) | (r);
 
-				dest[j] = lx.bytes[0];
-				j++;
-				dest[j] = lx.bytes[1];
+				*src++ = lx.bytes[0];
+				*src++ = lx.bytes[1];
 				bl += 3;
 			}
 		}
 		break;
 	case 1:
-		bl = blocklights;
-		for (i=0 ; i<tmax ; i++ ,dest += stride)
+		for (i=rect->t0 ; i<rect->t1 ; i++)
 		{
-			for (j=0 ; j<smax ; j++)
+			bl = blocklights + (i*smax + rect->s0)*3;
+			src = dest + i*stride;
+			for (j=rect->s0 ; j<rect->s1 ; j++)
 			{
 				// LordHavoc: .lit support begin
 				t = ((bl[0] + bl[1] + bl[2]) * 85) >> 15; // LordHavoc: basically / 3, but faster and combined with >> 7 shift down, note: actual number would be 85.3333...
@@ -361,7 +363,7 @@ store:
 				// LordHavoc: .lit support end
 				if (t > 255)
 					t = 255;
-				dest[j] = t;
+				src[j] = t;
 			}
 		}
 		break;
@@ -370,6 +372,21 @@ store:
 	}
 }
 
+/*
+===============
+R_BuildLightMap
+
+Builds every texel of the surface
+===============
+*/
+void R_BuildLightMap (msurface_t *surf, byte *dest, int stride)
+{
+	lightmaprect_t	rect;
+
+	R_LightmapFullRect (surf, &rect);
+	R_BuildLightMapRect (surf, dest, stride, &rect);
+}
+
 
 /*
 ===============
@@ -905,6 +922,10 @@ void R_RenderBrushPoly (msurface_t *fa)
 	int			maps;
 	glRect_t    *theRect;
 	int smax, tmax;
+	int l, tt;
+	int styledirty;
+	qboolean dynamic;
+	lightmaprect_t rect;
 
 	c_brush_polys++;
 
@@ -958,42 +979,65 @@ void R_RenderBrushPoly (msurface_t *fa)
 		num_lightmapped_faces++;
 	}
 
-	// check for lightmap modification
-	for (maps = 0 ; maps < MAXLIGHTMAPS && fa->styles[maps] != 255 ; maps++)
-		if (d_lightstylevalue[fa->styles[maps]] != fa->cached_light[maps])
-			goto dynamic;
+	// check for lightmap modification, world surfaces are marked when
+	// their styles change (r_lightmap.c)
+	styledirty = R_LightmapStyleDirty (fa);
+	if (styledirty < 0)
+	{
+		styledirty = false;
+		for (maps = 0 ; maps < MAXLIGHTMAPS && fa->styles[maps] != 255 ; maps++)
+			if (d_lightstylevalue[fa->styles[maps]] != fa->cached_light[maps])
+				styledirty = true;
+	}
+
+	dynamic = fa->dlightframe == r_framecount || fa->cached_dlight;	// dynamic now or previously
+
+	if (!(styledirty || dynamic) || !r_dynamic.value)
+		return;
 
-	if (fa->dlightframe == r_framecount || fa->cached_dlight)// dynamic previously
+	if (styledirty)
 	{
-dynamic:
-		if (r_dynamic.value)
-		{
-			lightmap_modified[fa->lightmaptexturenum] = true;
-			theRect = &lightmap_rectchange[fa->lightmaptexturenum];
+		// a style change rebuilds it all, and can wait for another
+		// frame when over budget unless a dynamic light has to show
+		smax = (fa->extents[0]>>4)+1;
+		tmax = (fa->extents[1]>>4)+1;
+		if (!dynamic && !R_LightmapBudget (smax*tmax))
+			return;
 
-			if (fa->light_t < theRect->t) {
-				if (theRect->h)
-					theRect->h += theRect->t - fa->light_t;
-				theRect->t = fa->light_t;
-			}
-			if (fa->light_s < theRect->l) {
-				if (theRect->w)
-					theRect->w += theRect->l - fa->light_s;
-				theRect->l = fa->light_s;
-			}
-			smax = (fa->extents[0]>>4)+1;
-			tmax = (fa->extents[1]>>4)+1;
-			if ((theRect->w + theRect->l) < (fa->light_s + smax))
-				theRect->w = (fa->light_s-theRect->l)+smax;
-			if ((theRect->h + theRect->t) < (fa->light_t + tmax))
-				theRect->h = (fa->light_t-theRect->t)+tmax;
+		R_LightmapDlightUpdateRect (fa, &rect);
+		R_LightmapFullRect (fa, &rect);
+		R_LightmapStyleClean (fa);
+	}
+	else if (!R_LightmapDlightUpdateRect (fa, &rect))
+	{
+		// lit by dynamic lights, but not on any texels
+		fa->cached_dlight = (fa->dlightframe == r_framecount) ? true : false;
+		return;
+	}
 
-			base = lightmaps + fa->lightmaptexturenum*LIGHTMAP_BYTES*BLOCK_WIDTH*BLOCK_HEIGHT;
-			base += fa->light_t * BLOCK_WIDTH * LIGHTMAP_BYTES + fa->light_s * LIGHTMAP_BYTES;
-			R_BuildLightMap (fa, base, BLOCK_WIDTH*LIGHTMAP_BYTES);
+	lightmap_modified[fa->lightmaptexturenum] = true;
+	theRect = &lightmap_rectchange[fa->lightmaptexturenum];
 
-		}
+	l = fa->light_s + rect.s0;
+	tt = fa->light_t + rect.t0;
+	if (tt < theRect->t) {
+		if (theRect->h)
+			theRect->h += theRect->t - tt;
+		theRect->t = tt;
+	}
+	if (l < theRect->l) {
+		if (theRect->w)
+			theRect->w += theRect->l - l;
+		theRect->l = l;
 	}
+	if ((theRect->w + theRect->l) < (fa->light_s + rect.s1))
+		theRect->w = (fa->light_s + rect.s1) - theRect->l;
+	if ((theRect->h + theRect->t) < (fa->light_t + rect.t1))
+		theRect->h = (fa->light_t + rect.t1) - theRect->t;
+
+	base = lightmaps + fa->lightmaptexturenum*LIGHTMAP_BYTES*BLOCK_WIDTH*BLOCK_HEIGHT;
+	base += fa->light_t * BLOCK_WIDTH * LIGHTMAP_BYTES + fa->light_s * LIGHTMAP_BYTES;
+	R_BuildLightMapRect (fa, base, BLOCK_WIDTH*LIGHTMAP_BYTES, &rect);
 }
 
 /*
@@ -1184,17 +1228,21 @@ void R_DrawBrushModel (entity_t *e)
 	if (e->angles[0] || e->angles[1] || e->angles[2])
 	{
 		rotated = true;
-		frustum_check = R_FrustumCheckSphere(e->origin, clmodel->radius);
-		
+		for (i=0 ; i<3 ; i++)
+		{
+			mins[i] = e->origin[i] - clmodel->radius;
+			maxs[i] = e->origin[i] + clmodel->radius;
+		}
 	}
 	else
 	{
 		rotated = false;
 		VectorAdd (e->origin, clmodel->mins, mins);
 		VectorAdd (e->origin, clmodel->maxs, maxs);
-	    frustum_check = R_FrustumCheckBox(mins, maxs);
 	}
 
+	frustum_check = R_CullEntity (e, mins, maxs, CULL_ALLPLANES(5));
+
 	if (frustum_check < 0)
 		return;
 
@@ -1389,7 +1437,7 @@ void R_DrawBrushModel (entity_t *e)
 R_RecursiveWorldNode
 ================
 */
-void R_RecursiveWorldNode (mnode_t *node, bool nofrustumcheck)
+void R_RecursiveWorldNode (mnode_t *node, int clipflags)
 {
 	int			c, side;
 	mplane_t	*plane;
@@ -1403,7 +1451,8 @@ void R_RecursiveWorldNode (mnode_t *node, bool nofrustumcheck)
 	if (node->visframe != r_visframecount)
 		return;
 
-	int frustum_check = nofrustumcheck ? 0 : R_FrustumCheckBox (node->minmaxs, node->minmaxs+3);
+	// planes this node's parents were fully inside are left out
+	int frustum_check = clipflags ? R_CullBoxMask (node->minmaxs, node->minmaxs+3, &clipflags) : 0;
 
 	if (frustum_check < 0)
 		return;
@@ -1459,7 +1508,7 @@ void R_RecursiveWorldNode (mnode_t *node, bool nofrustumcheck)
 		side = 1;
 
 // recurse down the children, front side first
-	R_RecursiveWorldNode (node->children[side], !frustum_check);
+	R_RecursiveWorldNode (node->children[side], clipflags);
 
 // draw stuff
 	c = node->numsurfaces;
@@ -1509,7 +1558,7 @@ void R_RecursiveWorldNode (mnode_t *node, bool nofrustumcheck)
 	}
 
 // recurse down the back side
-	R_RecursiveWorldNode (node->children[!side], !frustum_check);
+	R_RecursiveWorldNode (node->children[!side], clipflags);
 }
 
 void R_AddBrushModelToChains (entity_t * e)
@@ -1518,11 +1567,15 @@ void R_AddBrushModelToChains (entity_t * e)
 	vec3_t mins, maxs;
 	VectorAdd (e->origin, clmodel->mins, mins);
 	VectorAdd (e->origin, clmodel->maxs, maxs);
-	int frustum_check = R_FrustumCheckBox(mins, maxs);
+	int frustum_check = R_CullEntity(e, mins, maxs, CULL_ALLPLANES(5));
 	if (frustum_check < 0)
 	{
 		return;
 	}
+	if (R_OcclusionBrushCulled (e))
+	{
+		return;
+	}
 
 	msurface_t * psurf = &clmodel->surfaces[clmodel->firstmodelsurface];
 
@@ -1594,7 +1647,9 @@ void R_DrawWorld (void)
 	if (skybox_name[0])
 		R_DrawSkyBox();
 
-	R_RecursiveWorldNode (cl.worldmodel->nodes, false);
+	R_RecursiveWorldNode (cl.worldmodel->nodes, CULL_ALLPLANES(5));
+
+	R_CullEntities ();
 
 	R_AddStaticBrushModelsToChains ();
 
@@ -1845,6 +1900,260 @@ static void GL_CreateSurfaceLightmap (msurface_t *surf)
 }
 
 
+/*
+=============================================================================
+
+  LIGHTMAP CACHE
+
+The atlas and display list polys of every brush model, kept in the map's
+r_bspcache file. The section is a lmcacheheader_t, the filled pages, their
+allocated columns, a lmcachesurf_t for each surface of the brush models in
+precache order, then the polys with their pointers cleared.
+
+=============================================================================
+*/
+
+#define LIGHTMAP_CACHEID	BSPCACHE_ID('L', 'M', 'A', 'P')
+
+typedef struct
+{
+	int		numpages;
+	int		numsurfaces;
+	int		polyslen;
+} lmcacheheader_t;
+
+typedef struct
+{
+	short	light_s, light_t;
+	short	lightmaptexturenum;
+	short	pad;
+	int		poly;		// offset into the polys, -1 if the surface has none of its own
+} lmcachesurf_t;
+
+static lmcacheheader_t	lmcache;
+
+/*
+================
+GL_LightmapCacheModel
+
+Brush models with their own lightmaps, in the order GL_BuildLightmaps does them
+================
+*/
+static model_t *GL_LightmapCacheModel (int *j)
+{
+	model_t	*m;
+
+	for ( ; *j<MAX_MODELS ; (*j)++)
+	{
+		m = cl.model_precache[*j];
+		if (!m)
+			return NULL;
+		if (m->name[0] == '*' || m->type != mod_brush)
+			continue;
+		(*j)++;
+		return m;
+	}
+	return NULL;
+}
+
+static qboolean GL_LightmapCachePoly (msurface_t *surf)
+{
+	return !(surf->flags & (SURF_DRAWTURB|SURF_DRAWSKY)) && surf->polys;
+}
+
+static int GL_LightmapCachePolySize (glpoly_t *poly)
+{
+	return (sizeof(glpoly_t) + (poly->numverts - 1) * sizeof(glvert_t) + 7) & ~7;
+}
+
+static int GL_LightmapCachePageSize (void)
+{
+	return BLOCK_WIDTH*BLOCK_HEIGHT*LIGHTMAP_BYTES;
+}
+
+static int GL_LightmapCacheSize (void)
+{
+	return sizeof(lmcache) + lmcache.numpages * (GL_LightmapCachePageSize() + BLOCK_WIDTH*sizeof(int))
+		+ lmcache.numsurfaces * sizeof(lmcachesurf_t) + lmcache.polyslen;
+}
+
+/*
+================
+GL_LightmapCacheKey
+
+What besides the world the section depends on
+================
+*/
+static unsigned GL_LightmapCacheKey (void)
+{
+	int			j, params[7];
+	unsigned	key;
+	model_t		*m;
+
+	params[0] = LIGHTMAP_BYTES;
+	params[1] = BLOCK_WIDTH;
+	params[2] = BLOCK_HEIGHT;
+	params[3] = (int)gl_keeptjunctions.value;
+	params[4] = (int)r_fullbright.value;
+	params[5] = sizeof(glpoly_t);
+	params[6] = sizeof(lmcachesurf_t);
+	key = R_BSPCacheChecksum (0, params, sizeof(params));
+
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+		key = R_BSPCacheChecksum (key, &m->checksum, sizeof(m->checksum));
+
+	return key;
+}
+
+/*
+================
+GL_WriteLightmapCache
+
+Writes the section from what GL_BuildLightmaps built or read
+================
+*/
+static void GL_WriteLightmapCache (void)
+{
+	static byte		zeros[8];
+	lmcachesurf_t	cs;
+	glpoly_t		poly;
+	msurface_t		*surf;
+	model_t			*m;
+	int				i, j, ofs, size;
+
+	R_BSPCacheWrite (&lmcache, sizeof(lmcache));
+	R_BSPCacheWrite (lightmaps, lmcache.numpages * GL_LightmapCachePageSize());
+	R_BSPCacheWrite (allocated, lmcache.numpages * BLOCK_WIDTH*sizeof(int));
+
+	ofs = 0;
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+	{
+		for (i=0, surf=m->surfaces ; i<m->numsurfaces ; i++, surf++)
+		{
+			cs.light_s = surf->light_s;
+			cs.light_t = surf->light_t;
+			cs.lightmaptexturenum = surf->lightmaptexturenum;
+			cs.pad = 0;
+			cs.poly = -1;
+			if (GL_LightmapCachePoly (surf))
+			{
+				cs.poly = ofs;
+				ofs += GL_LightmapCachePolySize (surf->polys);
+			}
+			R_BSPCacheWrite (&cs, sizeof(cs));
+		}
+	}
+
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+	{
+		for (i=0, surf=m->surfaces ; i<m->numsurfaces ; i++, surf++)
+		{
+			if (!GL_LightmapCachePoly (surf))
+				continue;
+
+			memset (&poly, 0, sizeof(poly));
+			poly.numverts = surf->polys->numverts;
+			poly.flags = surf->polys->flags;
+
+			size = offsetof(glpoly_t, verts) + poly.numverts * sizeof(glvert_t);
+			R_BSPCacheWrite (&poly, offsetof(glpoly_t, verts));
+			R_BSPCacheWrite (surf->polys->verts, poly.numverts * sizeof(glvert_t));
+			R_BSPCacheWrite (zeros, GL_LightmapCachePolySize (surf->polys) - size);
+		}
+	}
+}
+
+/*
+================
+GL_ReadLightmapCache
+
+Fills in the atlas and the surfaces from the cache, false if they have to be built
+================
+*/
+static qboolean GL_ReadLightmapCache (unsigned key)
+{
+	lmcachesurf_t	*cs;
+	glpoly_t		*poly;
+	msurface_t		*surf;
+	model_t			*m;
+	byte			*polys;
+	int				i, j, maps, mark, tablemark, ofs, numsurfaces;
+
+	if (R_BSPCacheFind (LIGHTMAP_CACHEID, key) < (int)sizeof(lmcache))
+		return false;
+	if (!R_BSPCacheRead (LIGHTMAP_CACHEID, 0, &lmcache, sizeof(lmcache)))
+		return false;
+
+	numsurfaces = 0;
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+		numsurfaces += m->numsurfaces;
+
+	if (lmcache.numsurfaces != numsurfaces || lmcache.numpages < 0 || lmcache.numpages > MAX_LIGHTMAPS
+		|| lmcache.numpages * GL_LightmapCachePageSize() > (int)sizeof(lightmaps)
+		|| R_BSPCacheFind (LIGHTMAP_CACHEID, key) != GL_LightmapCacheSize())
+		return false;
+
+	ofs = sizeof(lmcache);
+	if (!R_BSPCacheRead (LIGHTMAP_CACHEID, ofs, lightmaps, lmcache.numpages * GL_LightmapCachePageSize()))
+		return false;
+	ofs += lmcache.numpages * GL_LightmapCachePageSize();
+	if (!R_BSPCacheRead (LIGHTMAP_CACHEID, ofs, allocated, lmcache.numpages * BLOCK_WIDTH*sizeof(int)))
+		return false;
+	ofs += lmcache.numpages * BLOCK_WIDTH*sizeof(int);
+
+	// the polys stay with the map, the surface table goes once it's applied
+	mark = Hunk_LowMark ();
+	polys = static_cast<byte*>(Hunk_AllocName (lmcache.polyslen, "lmpolys"));
+	if (!R_BSPCacheRead (LIGHTMAP_CACHEID, ofs + numsurfaces * sizeof(lmcachesurf_t), polys, lmcache.polyslen))
+	{
+		Hunk_FreeToLowMark (mark);
+		return false;
+	}
+
+	tablemark = Hunk_LowMark ();
+	cs = static_cast<lmcachesurf_t*>(Hunk_AllocName (numsurfaces * sizeof(lmcachesurf_t), "lmcache"));
+	if (!R_BSPCacheRead (LIGHTMAP_CACHEID, ofs, cs, numsurfaces * sizeof(lmcachesurf_t)))
+	{
+		Hunk_FreeToLowMark (mark);
+		return false;
+	}
+
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+	{
+		for (i=0, surf=m->surfaces ; i<m->numsurfaces ; i++, surf++, cs++)
+		{
+			if (surf->flags & (SURF_DRAWSKY|SURF_DRAWTURB))
+				continue;
+
+			surf->light_s = cs->light_s;
+			surf->light_t = cs->light_t;
+			surf->lightmaptexturenum = cs->lightmaptexturenum;
+
+			// as R_BuildLightMap leaves them
+			surf->cached_dlight = false;
+			for (maps = 0 ; maps < MAXLIGHTMAPS && surf->styles[maps] != 255 ; maps++)
+				surf->cached_light[maps] = d_lightstylevalue[surf->styles[maps]];
+
+			if (cs->poly < 0)
+				continue;
+			poly = (glpoly_t *)(polys + cs->poly);
+			poly->next = surf->polys;
+			surf->polys = poly;
+		}
+	}
+
+	Hunk_FreeToLowMark (tablemark);
+
+	memset (allocated + lmcache.numpages, 0, (MAX_LIGHTMAPS - lmcache.numpages) * sizeof(allocated[0]));
+	last_lightmap_allocated = lmcache.numpages ? lmcache.numpages - 1 : 0;
+	return true;
+}
+
 /*
 ==================
 GL_BuildLightmaps
@@ -1857,12 +2166,11 @@ void GL_BuildLightmaps (void)
 {
 	int		i, j;
 	model_t	*m;
+	unsigned	key;
 
 	//Con_Printf ("Lightmap surfaces = %i\n", MAX_LIGHTMAPS);
 	//Con_Printf ("Lightmap bytes = %i\n", LIGHTMAP_BYTES);
 
-	memset (allocated, 0, sizeof(allocated));
-
 	r_framecount = 1;		// no dlightcache
 
 	last_lightmap_allocated = 0;
@@ -1872,6 +2180,12 @@ void GL_BuildLightmaps (void)
 		lightmap_textures = 0;
 	}
 
+	key = GL_LightmapCacheKey ();
+	if (GL_ReadLightmapCache (key))
+		goto upload;
+
+	memset (allocated, 0, sizeof(allocated));
+
 	for (j=1 ; j<MAX_MODELS ; j++)
 	{
 		m = cl.model_precache[j];
@@ -1896,6 +2210,25 @@ void GL_BuildLightmaps (void)
 		}
 	}
 
+	memset (&lmcache, 0, sizeof(lmcache));
+	for (i=0 ; i<MAX_LIGHTMAPS && allocated[i][0] ; i++)
+		lmcache.numpages++;
+
+	j = 1;
+	while ((m = GL_LightmapCacheModel (&j)))
+	{
+		for (i=0 ; i<m->numsurfaces ; i++)
+		{
+			if (GL_LightmapCachePoly (m->surfaces + i))
+				lmcache.polyslen += GL_LightmapCachePolySize (m->surfaces[i].polys);
+		}
+		lmcache.numsurfaces += m->numsurfaces;
+	}
+
+upload:
+	if (lmcache.numpages * GL_LightmapCachePageSize() <= (int)sizeof(lightmaps))
+		R_BSPCacheAdd (LIGHTMAP_CACHEID, key, GL_LightmapCacheSize(), GL_WriteLightmapCache);
+
 	//
 	// upload all lightmaps that were filled
 	//
@@ -90,6 +90,10 @@ typedef struct entity_s
 
 	// for batch drawing entities  
 	short next_visedict;
+
+	// box in this frame's R_CullEntities, if cullframe is r_framecount
+	int		cullframe;
+	short	cullbox;
     // fenix@io.com: model transform interpolation
     //  that splits bmodel, or NULL if
     //  not split
@@ -123,6 +123,17 @@ struct qsockaddr
 #define MOD_PROQUAKE		0x01 // ProQuake style
 #define MOD_QSMACK			0x02 // QSmack style (?)
 
+// net_loop.c queues each local message in a buffer of its own and hands
+// that buffer to the reader as net_message instead of copying it out
+#define	NET_LOOPMESSAGES	8
+
+typedef struct
+{
+	int			type;		// what NET_GetMessage returns for it
+	int			length;
+	byte		*data;		// NET_MAXMESSAGE bytes
+} loopmessage_t;
+
 typedef struct qsocket_s
 {
 	struct qsocket_s	*next;
@@ -150,6 +161,10 @@ typedef struct qsocket_s
 	int				receiveMessageLength;
 	byte			receiveMessage [NET_MAXMESSAGE];
 
+	loopmessage_t	loopqueue[NET_LOOPMESSAGES];	// net_loop.c only
+	int				loophead;
+	int				loopcount;
+
 	struct qsockaddr	addr;
 	char				address[NET_NAMELEN];
 
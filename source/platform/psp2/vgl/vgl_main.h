@@ -404,6 +404,7 @@ void GL_SubdivideSurface (msurface_t *fa);
 void GL_MakeAliasModelDisplayLists (model_t *m, aliashdr_t *hdr);
 int R_LightPoint (vec3_t p);
 void R_DrawBrushModel (entity_t *e);
+float R_AliasRadius (entity_t *e);
 void RotatePointAroundVector( vec3_t dst, const vec3_t dir, const vec3_t point, float degrees );
 void V_CalcBlend (void);
 void R_DrawWorld (void);
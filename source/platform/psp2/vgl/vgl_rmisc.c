@@ -201,6 +201,8 @@ void R_Init (void)
 
 	Sky_Init (); //johnfitz
 	Fog_Init (); //johnfitz
+	R_LightGridInit ();
+	R_OcclusionInit ();
 }
 
 /*
@@ -227,6 +229,8 @@ void R_NewMap (void)
 	R_ClearParticles ();
 
 	GL_BuildLightmaps ();
+	R_LightGridBuild (cl.worldmodel, 3);
+	R_OcclusionNewMap (cl.worldmodel);
 
 	Sky_NewMap (); //johnfitz -- skybox in worldspawn
     Fog_ParseWorldspawn ();
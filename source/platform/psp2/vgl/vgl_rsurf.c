@@ -1002,7 +1002,7 @@ void R_AddBrushModelToChains (entity_t * e)
 	VectorAdd (e->origin, clmodel->mins, mins);
 	VectorAdd (e->origin, clmodel->maxs, maxs);
 
-	if (R_CullBox(mins, maxs))
+	if (R_CullBox(mins, maxs) || R_OcclusionBrushCulled (e))
 	{
 		return;
 	}
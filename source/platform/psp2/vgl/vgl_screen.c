@@ -1716,6 +1716,7 @@ void SCR_UpdateScreen (void)
 
 	//muff - to show FPS on screen
 	SCR_DrawFPS ();
+	R_OcclusionDrawStats ();
 	SCR_CheckDrawCenterString ();
 	SCR_CheckDrawUseString ();
 	HUD_Draw ();
@@ -89,6 +89,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // these determine which intermission screen plays
 #define	GAME_COOP			0
 #define	GAME_DEATHMATCH		1
+#define	GAME_MOVEACK		128		// flag, the server takes clc_moveseq and answers with svc_moveack
 
 //==================
 // note that there are some defs.qc that mirror to these numbers
@@ -162,6 +163,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define svc_lockviewmodel	51
 #define svc_rumble			52 		// [short] low frequency [short] high frequency [short] duration (ms)
 #define svc_gamemode		53		// [byte] game mode for client
+#define svc_snapshot		54		// [short] client edict [byte] nomap, loopback only: entities are read from the server
+#define svc_moveack			55		// [long] move sequence [float3] origin [float3] velocity [char3] mins [char3] maxs [byte] movetype [byte] MOVEACK_ flags
+
+// svc_moveack flags
+#define	MOVEACK_ONGROUND	(1<<0)
+#define	MOVEACK_WATERJUMP	(1<<1)
 
 //
 // client to server
@@ -171,6 +178,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define	clc_disconnect	2
 #define	clc_move		3			// [usercmd_t]
 #define	clc_stringcmd	4		// [string] message
+#define	clc_moveseq		5		// [long] sequence number of the preceding clc_move
 
 
 //
@@ -0,0 +1,318 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_bspcache.c -- Sidecar file of render data derived from a map at load
+
+/*
+ * Whatever a backend builds out of the map lumps at load, like the
+ * lightmap atlas or the light grid, can be kept next to the map as
+ * maps/<name>.bspc and read back the next time instead of built again.
+ *
+ * The file is a header then one section per module, each section stored
+ * the way it sits in memory with pointers as offsets into the section, so
+ * loading is a read into place and a pass of fixups. The header keeps a
+ * checksum of the map and every section a key of what else it was built
+ * from; a section whose key doesn't match is built and the file rewritten.
+ * The data belongs to the machine that wrote it, nothing is byte swapped.
+ *
+ * R_NewMap opens the cache, modules Find and Read their section or build
+ * it, then Add it either way so a rewrite has everything, and the cache is
+ * closed once the modules are done.
+ */
+
+#include "../nzportable_def.h"
+
+cvar_t r_bspcache = {"r_bspcache", "1"};
+
+static struct {
+    qboolean            open;
+    char                path[MAX_OSPATH];
+    unsigned            checksum;
+    FILE *              file;       // the cache on disk, NULL if there is none for this map
+    bspcacheheader_t    header;     // of file
+    bspcacheheader_t    out;        // sections added this load
+    bspcachewriter_t    writers[BSPCACHE_MAXSECTIONS];
+    qboolean            dirty;      // out differs from file
+    FILE *              writefile;
+    int                 written;
+} bspcache;
+
+/**
+ * @brief Rounds up to where the next section can start.
+ */
+static inline int
+R_BSPCacheAlign(int ofs)
+{
+    return (ofs + BSPCACHE_ALIGN - 1) & ~(BSPCACHE_ALIGN - 1);
+}
+
+/**
+ * @brief Hashes len bytes into sum, start with 0.
+ *
+ * Works a word at a time so a whole map can be summed at load.
+ */
+unsigned
+R_BSPCacheChecksum(unsigned sum, void * data, int len)
+{
+    byte * p = data;
+    unsigned word;
+
+    for (; len >= 4; len -= 4, p += 4) {
+        memcpy(&word, p, 4);
+        sum  = (sum ^ word) * 16777619;
+        sum  = (sum << 13) | (sum >> 19);
+    }
+    for (; len > 0; len--, p++) {
+        sum  = (sum ^ *p) * 16777619;
+        sum  = (sum << 13) | (sum >> 19);
+    }
+
+    return sum;
+}
+
+/**
+ * @brief Looks up a section of the file on disk.
+ */
+static bspcachesection_t *
+R_BSPCacheSection(int id)
+{
+    int i;
+
+    if (!bspcache.file)
+        return NULL;
+
+    for (i = 0; i < bspcache.header.numsections; i++) {
+        if (bspcache.header.sections[i].id == id)
+            return &bspcache.header.sections[i];
+    }
+    return NULL;
+}
+
+// MARK: Loading
+
+/**
+ * @brief Opens the cache of a map, called from R_NewMap before anything is built.
+ *
+ * @param mapname the model name, maps/<name>.bsp.
+ * @param checksum of the map and anything loaded along with it, like .lit files.
+ */
+void
+R_BSPCacheOpen(char * mapname, unsigned checksum)
+{
+    bspcachesection_t * section;
+    char name[MAX_QPATH];
+    int i, filelen, len;
+
+    R_BSPCacheClose();
+
+    if (!r_bspcache.value)
+        return;
+
+    COM_StripExtension(mapname, name);
+    len = snprintf(bspcache.path, sizeof(bspcache.path), "%s/%s.bspc", com_gamedir, name);
+    if (len < 0 || len >= (int) sizeof(bspcache.path)) {
+        // a truncated path could name some other map's cache
+        Con_DPrintf("R_BSPCacheOpen: path too long, not caching %s\n", mapname);
+        return;
+    }
+    bspcache.checksum = checksum;
+    bspcache.open     = true;
+
+    bspcache.file = fopen(bspcache.path, "rb");
+    if (!bspcache.file)
+        return;
+
+    fseek(bspcache.file, 0, SEEK_END);
+    filelen = ftell(bspcache.file);
+    fseek(bspcache.file, 0, SEEK_SET);
+
+    if (fread(&bspcache.header, sizeof(bspcache.header), 1, bspcache.file) != 1 ||
+      bspcache.header.magic != BSPCACHE_MAGIC || bspcache.header.version != BSPCACHE_VERSION ||
+      bspcache.header.checksum != checksum ||
+      bspcache.header.numsections < 0 || bspcache.header.numsections > BSPCACHE_MAXSECTIONS)
+        goto stale;
+
+    for (i = 0; i < bspcache.header.numsections; i++) {
+        section = &bspcache.header.sections[i];
+        if (section->ofs < (int) sizeof(bspcache.header) || section->len < 0 || section->len > filelen - section->ofs)
+            goto stale;
+    }
+    return;
+
+stale:
+    Con_DPrintf("%s is out of date\n", bspcache.path);
+    fclose(bspcache.file);
+    bspcache.file = NULL;
+} /* R_BSPCacheOpen */
+
+/**
+ * @brief Whether the cache has a section built with key.
+ *
+ * @return the length of the section, -1 if it has to be built.
+ */
+int
+R_BSPCacheFind(int id, unsigned key)
+{
+    bspcachesection_t * section = R_BSPCacheSection(id);
+
+    if (!section || section->key != key)
+        return -1;
+    return section->len;
+}
+
+/**
+ * @brief Reads len bytes at ofs into a section, straight to where they are used.
+ *
+ * @return false if the file came up short, the section has to be built then.
+ */
+qboolean
+R_BSPCacheRead(int id, int ofs, void * dest, int len)
+{
+    bspcachesection_t * section = R_BSPCacheSection(id);
+
+    if (!section || ofs < 0 || len < 0 || len > section->len - ofs)
+        return false;
+
+    if (fseek(bspcache.file, section->ofs + ofs, SEEK_SET) != 0)
+        return false;
+    return fread(dest, 1, len, bspcache.file) == (size_t) len;
+}
+
+// MARK: Saving
+
+/**
+ * @brief Puts a section in the cache, whether it was read or built.
+ *
+ * The writer is called from R_BSPCacheClose if the file is rewritten, so
+ * what it writes from has to last until then.
+ */
+void
+R_BSPCacheAdd(int id, unsigned key, int len, bspcachewriter_t writer)
+{
+    bspcachesection_t * section;
+
+    if (!bspcache.open)
+        return;
+
+    if (bspcache.out.numsections == BSPCACHE_MAXSECTIONS) {
+        Con_DPrintf("R_BSPCacheAdd: too many sections\n");
+        return;
+    }
+
+    section = &bspcache.out.sections[bspcache.out.numsections];
+    section->id  = id;
+    section->key = key;
+    section->len = len;
+    bspcache.writers[bspcache.out.numsections++] = writer;
+
+    if (R_BSPCacheFind(id, key) != len)
+        bspcache.dirty = true;
+}
+
+/**
+ * @brief Writes the next len bytes of a section, only from a writer.
+ */
+void
+R_BSPCacheWrite(void * data, int len)
+{
+    if (!bspcache.writefile)
+        return;
+
+    bspcache.written += fwrite(data, 1, len, bspcache.writefile);
+}
+
+/**
+ * @brief Rewrites the cache file if any section had to be built.
+ *
+ * Nothing is kept from the old file, every section is written from memory.
+ */
+static void
+R_BSPCacheSave(void)
+{
+    static byte zeros[BSPCACHE_ALIGN];
+    bspcachesection_t * section;
+    int i, ofs;
+
+    bspcache.out.magic    = BSPCACHE_MAGIC;
+    bspcache.out.version  = BSPCACHE_VERSION;
+    bspcache.out.checksum = bspcache.checksum;
+
+    ofs = R_BSPCacheAlign(sizeof(bspcache.out));
+    for (i = 0; i < bspcache.out.numsections; i++) {
+        bspcache.out.sections[i].ofs = ofs;
+        ofs = R_BSPCacheAlign(ofs + bspcache.out.sections[i].len);
+    }
+
+    bspcache.writefile = fopen(bspcache.path, "wb");
+    if (!bspcache.writefile) {
+        Con_DPrintf("Couldn't write %s\n", bspcache.path);
+        return;
+    }
+
+    fwrite(&bspcache.out, sizeof(bspcache.out), 1, bspcache.writefile);
+    ofs = sizeof(bspcache.out);
+
+    for (i = 0; i < bspcache.out.numsections; i++) {
+        section = &bspcache.out.sections[i];
+        fwrite(zeros, 1, section->ofs - ofs, bspcache.writefile);
+
+        bspcache.written = 0;
+        bspcache.writers[i]();
+        if (bspcache.written != section->len)
+            break;
+        ofs = section->ofs + section->len;
+    }
+
+    fclose(bspcache.writefile);
+    bspcache.writefile = NULL;
+
+    if (i < bspcache.out.numsections) {
+        Con_Printf("R_BSPCacheSave: section %i wrote %i bytes, not %i\n", i, bspcache.written, bspcache.out.sections[i].len);
+        remove(bspcache.path);
+        return;
+    }
+
+    Con_DPrintf("Wrote %s, %i KB\n", bspcache.path, ofs / 1024);
+} /* R_BSPCacheSave */
+
+/**
+ * @brief Done loading the map, saves the cache if it changed.
+ */
+void
+R_BSPCacheClose(void)
+{
+    if (bspcache.file) {
+        fclose(bspcache.file);
+        bspcache.file = NULL;
+    }
+
+    if (bspcache.open && bspcache.dirty)
+        R_BSPCacheSave();
+
+    memset(&bspcache, 0, sizeof(bspcache));
+}
+
+/**
+ * @brief Called at startup, registers the cvar to turn the cache off.
+ */
+void
+R_BSPCacheInit(void)
+{
+    Cvar_RegisterVariable(&r_bspcache);
+}
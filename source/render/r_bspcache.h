@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_bspcache.h -- Sidecar file of render data derived from a map at load
+
+#ifndef _RENDER_BSPCACHE_H_
+#define _RENDER_BSPCACHE_H_
+
+#define BSPCACHE_MAGIC          (('C' << 24) + ('P' << 16) + ('S' << 8) + 'B')
+#define BSPCACHE_VERSION        1
+#define BSPCACHE_MAXSECTIONS    8
+#define BSPCACHE_ALIGN          16  // sections start on this, so they can be read in place
+
+#define BSPCACHE_ID(a, b, c, d) (((d) << 24) + ((c) << 16) + ((b) << 8) + (a))
+
+typedef struct {
+    int         id;             // BSPCACHE_ID of the module that owns it
+    unsigned    key;            // everything besides the map it was built from, it's rebuilt when this changes
+    int         ofs;            // from the start of the file
+    int         len;
+} bspcachesection_t;
+
+typedef struct {
+    int                 magic;
+    int                 version;
+    unsigned            checksum;   // of the map lumps, see R_BSPCacheChecksum
+    int                 numsections;
+    bspcachesection_t   sections[BSPCACHE_MAXSECTIONS];
+} bspcacheheader_t;
+
+// Streams a section into the file with R_BSPCacheWrite, from the data it was read into or built in
+typedef void (*bspcachewriter_t)(void);
+
+extern cvar_t r_bspcache;
+
+void
+R_BSPCacheInit(void);
+unsigned
+R_BSPCacheChecksum(unsigned sum, void * data, int len);
+void
+R_BSPCacheOpen(char * mapname, unsigned checksum);
+int
+R_BSPCacheFind(int id, unsigned key);
+qboolean
+R_BSPCacheRead(int id, int ofs, void * dest, int len);
+void
+R_BSPCacheAdd(int id, unsigned key, int len, bspcachewriter_t writer);
+void
+R_BSPCacheWrite(void * data, int len);
+void
+R_BSPCacheClose(void);
+
+#endif // _RENDER_BSPCACHE_H_
@@ -0,0 +1,437 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_cull.c -- Frustum culling of world nodes and of a per-frame entity hierarchy
+
+/*
+ * Every test carries a mask of the frustum planes still worth testing. A
+ * box fully in front of a plane clears its bit, so whatever is inside the
+ * box, world nodes under it or entities grouped under it, skips that
+ * plane, and once the mask is empty nothing under it is tested at all.
+ *
+ * The entities of a frame are added as boxes and grouped into a bounding
+ * volume hierarchy split at the median, so a horde behind the player is
+ * culled by a few node tests. Leaves hold up to CULL_LEAFBOXES boxes kept
+ * as structure of arrays, tested a plane at a time across all of them.
+ *
+ * The results are what R_FrustumCheckBox gives, CULL_OUTSIDE or the number
+ * of planes the box crosses, so callers still know what needs clipping.
+ */
+
+#include "../nzportable_def.h"
+
+static struct {
+    int     numplanes;
+    float   normal[CULL_MAXPLANES][3];
+    float   dist[CULL_MAXPLANES];
+} cull_planes;
+
+// Boxes as they were added
+static int cull_numboxes;
+static float cull_boxmins[CULL_MAXBOXES][3];
+static float cull_boxmaxs[CULL_MAXBOXES][3];
+static int cull_boxmasks[CULL_MAXBOXES];    // planes allowed to cull each box
+static int cull_results[CULL_MAXBOXES];
+
+// Boxes in hierarchy order, every node covers a run of them
+static short cull_order[CULL_MAXBOXES];
+static float cull_mins[3][CULL_MAXBOXES];
+static float cull_maxs[3][CULL_MAXBOXES];
+
+typedef struct {
+    float   mins[3], maxs[3];
+    int     cullmask;               // planes allowed to cull every box under it
+    short   first, count;           // of cull_order
+    short   children[2];            // -1 for a leaf
+} cullnode_t;
+
+static cullnode_t cull_nodes[2 * CULL_MAXBOXES];
+static int cull_numnodes;
+
+static struct {
+    int nodes;
+    int nodesculled;
+    int boxes;
+    int boxtests;
+    int boxesculled;
+    int boxesdrawn;
+} cull_stats, cull_laststats;
+
+/**
+ * @brief Number of bits set in a plane mask.
+ */
+static inline int
+R_CullPlaneCount(int mask)
+{
+    int count;
+
+    for (count = 0; mask; mask &= mask - 1)
+        count++;
+    return count;
+}
+
+/**
+ * @brief How far the corners of a box furthest in front of and behind a plane are from it.
+ */
+static inline void
+R_CullPlaneSides(int plane, float * mins, float * maxs, float * front, float * back)
+{
+    float * n = cull_planes.normal[plane];
+    int i;
+
+    *front = *back = -cull_planes.dist[plane];
+    for (i = 0; i < 3; i++) {
+        if (n[i] >= 0) {
+            *front += n[i] * maxs[i];
+            *back  += n[i] * mins[i];
+        } else {
+            *front += n[i] * mins[i];
+            *back  += n[i] * maxs[i];
+        }
+    }
+}
+
+// MARK: World
+
+/**
+ * @brief Takes the frustum for this view, call after it is set up and before any culling.
+ */
+void
+R_CullSetPlanes(mplane_t * planes, int numplanes)
+{
+    int i;
+
+    cull_laststats = cull_stats;
+    memset(&cull_stats, 0, sizeof(cull_stats));
+
+    cull_planes.numplanes = MIN(numplanes, CULL_MAXPLANES);
+    for (i = 0; i < cull_planes.numplanes; i++) {
+        VectorCopy(planes[i].normal, cull_planes.normal[i]);
+        cull_planes.dist[i] = planes[i].dist;
+    }
+}
+
+/**
+ * @brief Tests a box against the planes in mask, like for a world node.
+ *
+ * Planes the box is fully in front of are taken out of mask, pass what is
+ * left on to the children of the node.
+ *
+ * @return CULL_OUTSIDE, or the number of planes in mask the box crosses.
+ */
+int
+R_CullBoxMask(vec3_t mins, vec3_t maxs, int * mask)
+{
+    float front, back;
+    int plane;
+
+    cull_stats.nodes++;
+
+    for (plane = 0; plane < cull_planes.numplanes; plane++) {
+        if (!(*mask & (1 << plane)))
+            continue;
+
+        R_CullPlaneSides(plane, mins, maxs, &front, &back);
+        if (front < 0) {
+            cull_stats.nodesculled++;
+            return CULL_OUTSIDE;
+        }
+        if (back >= 0)
+            *mask &= ~(1 << plane);
+    }
+
+    return R_CullPlaneCount(*mask);
+}
+
+// MARK: Entities
+
+/**
+ * @brief Forgets the boxes of the last view.
+ */
+void
+R_CullBeginBoxes(void)
+{
+    cull_numboxes = 0;
+}
+
+/**
+ * @brief Adds the bounds of something to draw this view.
+ *
+ * @param cullmask planes allowed to cull it, other planes only count as crossed.
+ * @return the box number for R_CullBoxResult, -1 if there is no room and it has to be tested alone.
+ */
+int
+R_CullAddBox(vec3_t mins, vec3_t maxs, int cullmask)
+{
+    if (cull_numboxes == CULL_MAXBOXES)
+        return -1;
+
+    VectorCopy(mins, cull_boxmins[cull_numboxes]);
+    VectorCopy(maxs, cull_boxmaxs[cull_numboxes]);
+    cull_boxmasks[cull_numboxes] = cullmask;
+    return cull_numboxes++;
+}
+
+/**
+ * @brief Twice the center of a box along axis, for splitting.
+ */
+static inline float
+R_CullBoxCenter(int box, int axis)
+{
+    return cull_boxmins[box][axis] + cull_boxmaxs[box][axis];
+}
+
+/**
+ * @brief Moves the boxes of cull_order[first to first + count - 1] so the one at nth is in sorted position.
+ */
+static void
+R_CullSelect(int first, int count, int nth, int axis)
+{
+    int lo = first, hi = first + count - 1, i, j;
+    short swap;
+    float pivot;
+
+    while (lo < hi) {
+        pivot = R_CullBoxCenter(cull_order[(lo + hi) / 2], axis);
+        i     = lo;
+        j     = hi;
+        while (i <= j) {
+            while (R_CullBoxCenter(cull_order[i], axis) < pivot)
+                i++;
+            while (R_CullBoxCenter(cull_order[j], axis) > pivot)
+                j--;
+            if (i <= j) {
+                swap = cull_order[i];
+                cull_order[i++] = cull_order[j];
+                cull_order[j--] = swap;
+            }
+        }
+        if (nth <= j)
+            hi = j;
+        else if (nth >= i)
+            lo = i;
+        else
+            break;
+    }
+}
+
+/**
+ * @brief Builds the hierarchy over a run of cull_order.
+ *
+ * @return the node number.
+ */
+static int
+R_CullBuildNode(int first, int count)
+{
+    cullnode_t * node = &cull_nodes[cull_numnodes];
+    int num = cull_numnodes++, i, box, axis, half;
+
+    VectorCopy(cull_boxmins[cull_order[first]], node->mins);
+    VectorCopy(cull_boxmaxs[cull_order[first]], node->maxs);
+    node->cullmask = CULL_ALLPLANES(CULL_MAXPLANES);
+    for (i = first; i < first + count; i++) {
+        box = cull_order[i];
+        for (axis = 0; axis < 3; axis++) {
+            node->mins[axis] = MIN(node->mins[axis], cull_boxmins[box][axis]);
+            node->maxs[axis] = MAX(node->maxs[axis], cull_boxmaxs[box][axis]);
+        }
+        node->cullmask &= cull_boxmasks[box];
+    }
+
+    node->first       = first;
+    node->count       = count;
+    node->children[0] = node->children[1] = -1;
+    if (count <= CULL_LEAFBOXES)
+        return num;
+
+    // split the longest side at the median
+    axis = 0;
+    for (i = 1; i < 3; i++) {
+        if (node->maxs[i] - node->mins[i] > node->maxs[axis] - node->mins[axis])
+            axis = i;
+    }
+
+    half = count / 2;
+    R_CullSelect(first, count, first + half, axis);
+
+    node->children[0] = R_CullBuildNode(first, half);
+    node->children[1] = R_CullBuildNode(first + half, count - half);
+    return num;
+} /* R_CullBuildNode */
+
+/**
+ * @brief Gives every box of a node the same result.
+ */
+static void
+R_CullNodeResult(cullnode_t * node, int result)
+{
+    int i;
+
+    for (i = node->first; i < node->first + node->count; i++)
+        cull_results[cull_order[i]] = result;
+
+    if (result == CULL_OUTSIDE)
+        cull_stats.boxesculled += node->count;
+    else
+        cull_stats.boxesdrawn += node->count;
+}
+
+/**
+ * @brief Tests the boxes of a leaf together, a plane at a time.
+ */
+static void
+R_CullLeaf(cullnode_t * node, int mask)
+{
+    int out[CULL_LEAFBOXES], clip[CULL_LEAFBOXES];
+    float * front[3], * back[3], * n, d;
+    int plane, axis, i, j, box;
+    const int first = node->first, count = node->count;
+
+    for (j = 0; j < count; j++)
+        out[j] = clip[j] = 0;
+
+    for (plane = 0; plane < cull_planes.numplanes; plane++) {
+        if (!(mask & (1 << plane)))
+            continue;
+
+        // the corners to test are the same for every box
+        n = cull_planes.normal[plane];
+        d = cull_planes.dist[plane];
+        for (axis = 0; axis < 3; axis++) {
+            front[axis] = (n[axis] >= 0 ? cull_maxs[axis] : cull_mins[axis]) + first;
+            back[axis]  = (n[axis] >= 0 ? cull_mins[axis] : cull_maxs[axis]) + first;
+        }
+
+        for (j = 0; j < count; j++) {
+            out[j]  |= (n[0] * front[0][j] + n[1] * front[1][j] + n[2] * front[2][j] < d) << plane;
+            clip[j] |= (n[0] * back[0][j] + n[1] * back[1][j] + n[2] * back[2][j] < d) << plane;
+        }
+    }
+
+    cull_stats.boxtests += count;
+    for (j = 0, i = first; j < count; j++, i++) {
+        box = cull_order[i];
+        if (out[j] & cull_boxmasks[box]) {
+            cull_results[box] = CULL_OUTSIDE;
+            cull_stats.boxesculled++;
+        } else {
+            cull_results[box] = R_CullPlaneCount(clip[j]);
+            cull_stats.boxesdrawn++;
+        }
+    }
+} /* R_CullLeaf */
+
+/**
+ * @brief Walks the hierarchy, planes a node is fully in front of are left out below it.
+ */
+static void
+R_CullNode(int num, int mask)
+{
+    cullnode_t * node = &cull_nodes[num];
+    float front, back;
+    int plane;
+
+    cull_stats.boxtests++;
+
+    for (plane = 0; plane < cull_planes.numplanes; plane++) {
+        if (!(mask & (1 << plane)))
+            continue;
+
+        R_CullPlaneSides(plane, node->mins, node->maxs, &front, &back);
+        if (front < 0 && (node->cullmask & (1 << plane))) {
+            R_CullNodeResult(node, CULL_OUTSIDE);
+            return;
+        }
+        if (back >= 0)
+            mask &= ~(1 << plane);
+    }
+
+    if (!mask) {
+        R_CullNodeResult(node, 0);
+        return;
+    }
+
+    if (node->children[0] < 0) {
+        R_CullLeaf(node, mask);
+        return;
+    }
+
+    R_CullNode(node->children[0], mask);
+    R_CullNode(node->children[1], mask);
+}
+
+/**
+ * @brief Culls every box added since R_CullBeginBoxes, read the results with R_CullBoxResult.
+ */
+void
+R_CullBoxes(void)
+{
+    int i, axis;
+
+    cull_numnodes     = 0;
+    cull_stats.boxes += cull_numboxes;
+    if (!cull_numboxes)
+        return;
+
+    for (i = 0; i < cull_numboxes; i++)
+        cull_order[i] = i;
+    R_CullBuildNode(0, cull_numboxes);
+
+    for (i = 0; i < cull_numboxes; i++) {
+        for (axis = 0; axis < 3; axis++) {
+            cull_mins[axis][i] = cull_boxmins[cull_order[i]][axis];
+            cull_maxs[axis][i] = cull_boxmaxs[cull_order[i]][axis];
+        }
+    }
+
+    R_CullNode(0, CULL_ALLPLANES(cull_planes.numplanes));
+}
+
+/**
+ * @brief What R_CullBoxes found for a box.
+ *
+ * @return CULL_OUTSIDE, or the number of planes the box crosses.
+ */
+int
+R_CullBoxResult(int box)
+{
+    return cull_results[box];
+}
+
+// MARK: Stats
+
+/**
+ * @brief 'cullstats' console command, what the last view tested.
+ */
+static void
+R_CullStats_f(void)
+{
+    Con_Printf("world: %i nodes tested, %i culled\n", cull_laststats.nodes, cull_laststats.nodesculled);
+    Con_Printf("entities: %i boxes, %i tests, %i culled, %i drawn\n",
+      cull_laststats.boxes, cull_laststats.boxtests, cull_laststats.boxesculled, cull_laststats.boxesdrawn);
+}
+
+/**
+ * @brief Called at startup, registers the stats command.
+ */
+void
+R_CullInit(void)
+{
+    Cmd_AddCommand("cullstats", R_CullStats_f);
+}
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_cull.h -- Frustum culling of world nodes and of a per-frame entity hierarchy
+
+#ifndef _RENDER_CULL_H_
+#define _RENDER_CULL_H_
+
+#define CULL_MAXPLANES      8
+#define CULL_MAXBOXES       1024
+#define CULL_LEAFBOXES      4       // boxes a hierarchy leaf tests together
+#define CULL_OUTSIDE        -1
+
+#define CULL_ALLPLANES(n)   ((1 << (n)) - 1)
+
+void
+R_CullInit(void);
+void
+R_CullSetPlanes(mplane_t * planes, int numplanes);
+int
+R_CullBoxMask(vec3_t mins, vec3_t maxs, int * mask);
+
+void
+R_CullBeginBoxes(void);
+int
+R_CullAddBox(vec3_t mins, vec3_t maxs, int cullmask);
+void
+R_CullBoxes(void);
+int
+R_CullBoxResult(int box);
+
+#endif // _RENDER_CULL_H_
@@ -259,12 +259,15 @@ R_LightPoint(vec3_t p)
         return 255;
     }
 
-    end[0] = p[0];
-    end[1] = p[1];
-    end[2] = p[2] - 2048;
-
-    lightcolor[0] = lightcolor[1] = lightcolor[2] = 0;
-    RecursiveLightPoint(lightcolor, cl.worldmodel->nodes, p, end);
+    // the grid baked at map load, tracing only where it has nothing
+    if (!r_lightgrid.value || !R_LightGridPoint(p, lightcolor, lightspot)) {
+        end[0] = p[0];
+        end[1] = p[1];
+        end[2] = p[2] - 2048;
+
+        lightcolor[0] = lightcolor[1] = lightcolor[2] = 0;
+        RecursiveLightPoint(lightcolor, cl.worldmodel->nodes, p, end);
+    }
     return ((lightcolor[0] + lightcolor[1] + lightcolor[2]) * (1.0f / 3.0f));
 }
 
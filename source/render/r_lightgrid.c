@@ -0,0 +1,516 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_lightgrid.c -- Entity lighting grid baked from the world lightmaps
+
+/*
+ * Every entity used to trace through the BSP to the floor under it each
+ * frame to find its light. The grid does that trace once per grid point at
+ * map load and keeps the lightmap colors it found, per light style, so a
+ * lookup is eight cells blended together with the current style values.
+ * Points outside the grid, or surrounded by solid cells, still trace.
+ */
+
+#include "../nzportable_def.h"
+
+extern int d_lightstylevalue[256]; // not in the software renderer headers
+
+cvar_t r_lightgrid = {"r_lightgrid", "1"};
+
+static struct {
+    model_t *           model;
+    lightgridcell_t *   cells;
+    vec3_t              origin;     // position of cell 0
+    int                 spacing;
+    int                 size[3];
+    int                 numcells;
+} lightgrid;
+
+static model_t * lg_tracemodel;
+static int lg_samplesize;
+
+#define LIGHTGRID_CACHEID BSPCACHE_ID('L', 'G', 'R', 'D')
+
+// Section of the grid in the map's r_bspcache file, the cells follow
+typedef struct {
+    int spacing;
+    int size[3];
+} lightgridcache_t;
+
+// MARK: Tracing
+
+/**
+ * @brief Fills in the lightmap colors of one surface at ds, dt, bilinearly filtered.
+ */
+static void
+R_LightGridSampleSurface(msurface_t * surf, int ds, int dt, lightgridcell_t * out)
+{
+    byte * lightmap;
+    int smax, tmax, s0, s1, t0, t1, dsfrac, dtfrac, w00, w01, w10, w11;
+    int maps, c, ofs00, ofs01, ofs10, ofs11;
+
+    for (maps = 0; maps < MAXLIGHTMAPS; maps++)
+        out->styles[maps] = 255;
+
+    if (!surf->samples)
+        return;
+
+    smax = (surf->extents[0] >> 4) + 1;
+    tmax = (surf->extents[1] >> 4) + 1;
+
+    s0 = ds >> 4;
+    t0 = dt >> 4;
+    s1 = MIN(s0 + 1, smax - 1);
+    t1 = MIN(t0 + 1, tmax - 1);
+
+    dsfrac = ds & 15;
+    dtfrac = dt & 15;
+    w00    = (16 - dsfrac) * (16 - dtfrac);
+    w01    = dsfrac * (16 - dtfrac);
+    w10    = (16 - dsfrac) * dtfrac;
+    w11    = dsfrac * dtfrac;
+
+    ofs00 = (t0 * smax + s0) * lg_samplesize;
+    ofs01 = (t0 * smax + s1) * lg_samplesize;
+    ofs10 = (t1 * smax + s0) * lg_samplesize;
+    ofs11 = (t1 * smax + s1) * lg_samplesize;
+
+    lightmap = surf->samples;
+    for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
+        out->styles[maps] = surf->styles[maps];
+        for (c = 0; c < 3; c++) {
+            int k = lg_samplesize == 3 ? c : 0;
+
+            out->rgb[maps][c] = (lightmap[ofs00 + k] * w00 + lightmap[ofs01 + k] * w01
+              + lightmap[ofs10 + k] * w10 + lightmap[ofs11 + k] * w11) >> 8;
+        }
+        lightmap += smax * tmax * lg_samplesize;
+    }
+}
+
+/**
+ * @brief Walks start to end through the BSP, like RecursiveLightPoint, and samples the first lit surface.
+ *
+ * @return true if the line hit the world.
+ */
+static qboolean
+R_LightGridTrace(mnode_t * node, vec3_t start, vec3_t end, lightgridcell_t * out)
+{
+    float front, back, frac;
+    vec3_t mid;
+    msurface_t * surf;
+    int i, ds, dt;
+
+loc0:
+    if (node->contents < 0)
+        return false;
+
+    if (node->plane->type < 3) {
+        front = start[node->plane->type] - node->plane->dist;
+        back  = end[node->plane->type] - node->plane->dist;
+    } else {
+        front = DotProduct(start, node->plane->normal) - node->plane->dist;
+        back  = DotProduct(end, node->plane->normal) - node->plane->dist;
+    }
+
+    if ((back < 0) == (front < 0)) {
+        node = node->children[front < 0];
+        goto loc0;
+    }
+
+    frac   = front / (front - back);
+    mid[0] = start[0] + (end[0] - start[0]) * frac;
+    mid[1] = start[1] + (end[1] - start[1]) * frac;
+    mid[2] = start[2] + (end[2] - start[2]) * frac;
+
+    if (R_LightGridTrace(node->children[front < 0], start, mid, out))
+        return true;
+
+    surf = lg_tracemodel->surfaces + node->firstsurface;
+    for (i = 0; i < node->numsurfaces; i++, surf++) {
+        if (surf->flags & SURF_DRAWTILED)
+            continue;
+
+        ds = (int) ((float) DotProduct(mid, surf->texinfo->vecs[0]) + surf->texinfo->vecs[0][3]);
+        dt = (int) ((float) DotProduct(mid, surf->texinfo->vecs[1]) + surf->texinfo->vecs[1][3]);
+
+        if (ds < surf->texturemins[0] || dt < surf->texturemins[1])
+            continue;
+
+        ds -= surf->texturemins[0];
+        dt -= surf->texturemins[1];
+
+        if (ds > surf->extents[0] || dt > surf->extents[1])
+            continue;
+
+        R_LightGridSampleSurface(surf, ds, dt, out);
+        out->floor = (short) mid[2];
+        return true;
+    }
+
+    return R_LightGridTrace(node->children[front >= 0], mid, end, out);
+} /* R_LightGridTrace */
+
+/**
+ * @brief Finds the lightmap colors under p the way R_LightPoint does, 2048 units straight down.
+ */
+static void
+R_LightGridTracePoint(model_t * model, vec3_t p, lightgridcell_t * out)
+{
+    vec3_t end;
+    int maps;
+
+    VectorCopy(p, end);
+    end[2] -= 2048;
+
+    lg_tracemodel = model;
+    if (!R_LightGridTrace(model->nodes, p, end, out)) {
+        for (maps = 0; maps < MAXLIGHTMAPS; maps++)
+            out->styles[maps] = 255;
+        out->floor = (short) end[2];
+    }
+}
+
+/**
+ * @brief Adds the colors of a cell scaled by the current light styles and weight.
+ */
+static inline void
+R_LightGridAddCell(lightgridcell_t * cell, float weight, vec3_t color)
+{
+    float scale;
+    int maps;
+
+    for (maps = 0; maps < MAXLIGHTMAPS && cell->styles[maps] != 255; maps++) {
+        scale     = d_lightstylevalue[cell->styles[maps]] * (1.0f / 256.0f) * weight;
+        color[0] += cell->rgb[maps][0] * scale;
+        color[1] += cell->rgb[maps][1] * scale;
+        color[2] += cell->rgb[maps][2] * scale;
+    }
+}
+
+// MARK: Cache
+
+/**
+ * @brief What besides the map the cells depend on.
+ */
+static unsigned
+R_LightGridCacheKey(int samplesize)
+{
+    int params[4] = { samplesize, LIGHTGRID_SPACING, LIGHTGRID_MAXCELLS, sizeof(lightgridcell_t) };
+
+    return R_BSPCacheChecksum(0, params, sizeof(params));
+}
+
+static int
+R_LightGridCacheSize(void)
+{
+    return sizeof(lightgridcache_t) + lightgrid.numcells * sizeof(lightgridcell_t);
+}
+
+/**
+ * @brief Reads the cells of the grid laid out in lightgrid from the map cache.
+ */
+static qboolean
+R_LightGridCacheRead(int samplesize)
+{
+    lightgridcache_t header;
+
+    if (R_BSPCacheFind(LIGHTGRID_CACHEID, R_LightGridCacheKey(samplesize)) != R_LightGridCacheSize())
+        return false;
+    if (!R_BSPCacheRead(LIGHTGRID_CACHEID, 0, &header, sizeof(header)))
+        return false;
+    if (header.spacing != lightgrid.spacing || header.size[0] != lightgrid.size[0] ||
+      header.size[1] != lightgrid.size[1] || header.size[2] != lightgrid.size[2])
+        return false;
+
+    return R_BSPCacheRead(LIGHTGRID_CACHEID, sizeof(header), lightgrid.cells, lightgrid.numcells * sizeof(lightgridcell_t));
+}
+
+static void
+R_LightGridCacheWrite(void)
+{
+    lightgridcache_t header;
+
+    header.spacing = lightgrid.spacing;
+    memcpy(header.size, lightgrid.size, sizeof(header.size));
+
+    R_BSPCacheWrite(&header, sizeof(header));
+    R_BSPCacheWrite(lightgrid.cells, lightgrid.numcells * sizeof(lightgridcell_t));
+}
+
+// MARK: Grid
+
+/**
+ * @brief Forgets the grid of the last map, entities trace until the next R_LightGridBuild.
+ */
+void
+R_LightGridClear(void)
+{
+    memset(&lightgrid, 0, sizeof(lightgrid));
+}
+
+/**
+ * @brief Bakes the grid for a world model, called from R_NewMap.
+ *
+ * The cells come from the hunk and go away with the map. They are read
+ * from the map's r_bspcache file instead when it has them.
+ *
+ * @param samplesize bytes per lightmap sample, 3 for colored lightdata and 1 for mono.
+ */
+void
+R_LightGridBuild(model_t * model, int samplesize)
+{
+    lightgridcell_t * cell;
+    vec3_t p;
+    int x, y, z, spacing;
+    double start;
+
+    R_LightGridClear();
+
+    if (!model || !model->lightdata || !model->nodes)
+        return;
+
+    start = Sys_FloatTime();
+
+    // cover the whole world, coarser for maps too big for the cell budget
+    for (spacing = LIGHTGRID_SPACING;; spacing *= 2) {
+        for (x = 0; x < 3; x++)
+            lightgrid.size[x] = (int) ceil((model->maxs[x] - model->mins[x]) / spacing) + 1;
+        lightgrid.numcells = lightgrid.size[0] * lightgrid.size[1] * lightgrid.size[2];
+        if (lightgrid.numcells <= LIGHTGRID_MAXCELLS)
+            break;
+    }
+
+    lightgrid.model   = model;
+    lightgrid.spacing = spacing;
+    VectorCopy(model->mins, lightgrid.origin);
+    lightgrid.cells = Hunk_AllocName(lightgrid.numcells * sizeof(lightgridcell_t), "lightgrid");
+
+    lg_samplesize = samplesize;
+
+    if (R_LightGridCacheRead(samplesize)) {
+        Con_DPrintf("Light grid: read from the map cache\n");
+        R_BSPCacheAdd(LIGHTGRID_CACHEID, R_LightGridCacheKey(samplesize), R_LightGridCacheSize(), R_LightGridCacheWrite);
+        return;
+    }
+
+    cell = lightgrid.cells;
+    for (z = 0; z < lightgrid.size[2]; z++) {
+        for (y = 0; y < lightgrid.size[1]; y++) {
+            for (x = 0; x < lightgrid.size[0]; x++, cell++) {
+                p[0] = lightgrid.origin[0] + x * spacing;
+                p[1] = lightgrid.origin[1] + y * spacing;
+                p[2] = lightgrid.origin[2] + z * spacing;
+
+                if (Mod_PointInLeaf(p, model)->contents == CONTENTS_SOLID) {
+                    memset(cell, 255, sizeof(*cell));
+                    cell->styles[0] = LIGHTGRID_SOLID;
+                    continue;
+                }
+
+                R_LightGridTracePoint(model, p, cell);
+            }
+        }
+    }
+
+    R_BSPCacheAdd(LIGHTGRID_CACHEID, R_LightGridCacheKey(samplesize), R_LightGridCacheSize(), R_LightGridCacheWrite);
+
+    Con_DPrintf("Light grid: %ix%ix%i cells %i units apart, %i KB, %.0f ms\n",
+      lightgrid.size[0], lightgrid.size[1], lightgrid.size[2], spacing,
+      (int) (lightgrid.numcells * sizeof(lightgridcell_t) / 1024), (Sys_FloatTime() - start) * 1000);
+} /* R_LightGridBuild */
+
+/**
+ * @brief Blends the light of the eight cells around p.
+ *
+ * Solid cells are left out and the rest weighted up to make up for them.
+ *
+ * @param color set to the light at p, 0 to 255 at normal style values.
+ * @param spot  if not NULL, set to the floor under p for shadows.
+ * @return false if p is outside the grid or only has solid cells around it.
+ */
+qboolean
+R_LightGridPoint(vec3_t p, vec3_t color, vec3_t spot)
+{
+    lightgridcell_t * base, * cell, * above;
+    float frac[3], w, total, floor, lowz;
+    int i, idx[3], corner;
+
+    if (!lightgrid.cells || lightgrid.model != cl.worldmodel)
+        return false;
+
+    for (i = 0; i < 3; i++) {
+        float f = (p[i] - lightgrid.origin[i]) / lightgrid.spacing;
+
+        if (!(f >= 0))
+            return false;
+        idx[i] = (int) f;
+        if (idx[i] >= lightgrid.size[i] - 1)
+            return false;
+        frac[i] = f - idx[i];
+    }
+
+    base = lightgrid.cells + (idx[2] * lightgrid.size[1] + idx[1]) * lightgrid.size[0] + idx[0];
+
+    lowz = lightgrid.origin[2] + idx[2] * lightgrid.spacing;
+
+    VectorClear(color);
+    total = floor = 0;
+    for (corner = 0; corner < 8; corner++) {
+        cell = base;
+        w    = 1;
+        if (corner & 1) {
+            cell += 1;
+            w    *= frac[0];
+        } else {
+            w *= 1 - frac[0];
+        }
+        if (corner & 2) {
+            cell += lightgrid.size[0];
+            w    *= frac[1];
+        } else {
+            w *= 1 - frac[1];
+        }
+        if (corner & 4) {
+            cell += lightgrid.size[0] * lightgrid.size[1];
+            w    *= frac[2];
+        } else {
+            w *= 1 - frac[2];
+        }
+
+        if (cell->styles[0] == LIGHTGRID_SOLID || w <= 0)
+            continue;
+
+        // leave out cells on the other side of the floor from p, an upper
+        // cell that sees a floor above p or a lower cell below the floor
+        // its upper neighbour sees
+        if (corner & 4) {
+            if (cell->floor > p[2])
+                continue;
+        } else {
+            above = cell + lightgrid.size[0] * lightgrid.size[1];
+            if (above->styles[0] != LIGHTGRID_SOLID && above->floor > lowz)
+                continue;
+        }
+
+        R_LightGridAddCell(cell, w, color);
+        floor += cell->floor * w;
+        total += w;
+    }
+
+    if (total < 0.001f)
+        return false;
+
+    total = 1 / total;
+    VectorScale(color, total, color);
+    if (spot) {
+        spot[0] = p[0];
+        spot[1] = p[1];
+        spot[2] = floor * total;
+    }
+    return true;
+} /* R_LightGridPoint */
+
+// MARK: Benchmark
+
+/**
+ * @brief 'lightbench' console command, times lighting every entity in the map by tracing and by the grid.
+ */
+static void
+R_LightGridBench_f(void)
+{
+    lightgridcell_t cell;
+    vec3_t * points, color, traced;
+    double time1, time2, time3;
+    float error;
+    int frames, frame, i, numpoints, hits;
+
+    if (!lightgrid.cells || lightgrid.model != cl.worldmodel) {
+        Con_Printf("lightbench: no light grid for this map\n");
+        return;
+    }
+
+    frames = Cmd_Argc() > 1 ? Q_atoi(Cmd_Argv(1)) : 100;
+    if (frames < 1) {
+        Con_Printf("usage: lightbench [frames]\n");
+        return;
+    }
+
+    // every entity with a model, or just the view if there are none
+    points    = Q_malloc((cl.num_entities + 1) * sizeof(*points));
+    numpoints = 0;
+    for (i = 1; i < cl.num_entities; i++) {
+        if (cl_entities[i].model) {
+            VectorCopy(cl_entities[i].origin, points[numpoints]);
+            numpoints++;
+        }
+    }
+    if (!numpoints) {
+        VectorCopy(r_refdef.vieworg, points[0]);
+        numpoints = 1;
+    }
+
+    // how far the grid is from the trace it replaces
+    error = 0;
+    hits  = 0;
+    for (i = 0; i < numpoints; i++) {
+        if (!R_LightGridPoint(points[i], color, NULL))
+            continue;
+        R_LightGridTracePoint(cl.worldmodel, points[i], &cell);
+        VectorClear(traced);
+        R_LightGridAddCell(&cell, 1, traced);
+        error += fabs(color[0] - traced[0]) + fabs(color[1] - traced[1]) + fabs(color[2] - traced[2]);
+        hits++;
+    }
+
+    time1 = Sys_FloatTime();
+    for (frame = 0; frame < frames; frame++) {
+        for (i = 0; i < numpoints; i++) {
+            R_LightGridTracePoint(cl.worldmodel, points[i], &cell);
+            VectorClear(color);
+            R_LightGridAddCell(&cell, 1, color);
+        }
+    }
+    time2 = Sys_FloatTime();
+    for (frame = 0; frame < frames; frame++) {
+        for (i = 0; i < numpoints; i++)
+            R_LightGridPoint(points[i], color, NULL);
+    }
+    time3 = Sys_FloatTime();
+
+    free(points);
+
+    Con_Printf("lightbench: %i points, %i frames, %i in the grid, mean error %.1f\n",
+      numpoints, frames, hits, hits ? error / (hits * 3) : 0);
+    Con_Printf("trace: %.4f ms a frame\n", (time2 - time1) * 1000 / frames);
+    Con_Printf("grid:  %.4f ms a frame, %ix%ix%i cells %i units apart, %i KB\n",
+      (time3 - time2) * 1000 / frames, lightgrid.size[0], lightgrid.size[1], lightgrid.size[2],
+      lightgrid.spacing, (int) (lightgrid.numcells * sizeof(lightgridcell_t) / 1024));
+} /* R_LightGridBench_f */
+
+/**
+ * @brief Called at startup, registers the grid cvar and benchmark.
+ */
+void
+R_LightGridInit(void)
+{
+    Cvar_RegisterVariable(&r_lightgrid);
+    Cmd_AddCommand("lightbench", R_LightGridBench_f);
+}
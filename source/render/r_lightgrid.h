@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_lightgrid.h -- Entity lighting grid baked from the world lightmaps
+
+#ifndef _RENDER_LIGHTGRID_H_
+#define _RENDER_LIGHTGRID_H_
+
+#define LIGHTGRID_SPACING   64      // doubled until the map fits in LIGHTGRID_MAXCELLS
+#define LIGHTGRID_MAXCELLS  32768
+#define LIGHTGRID_SOLID     254     // styles[0] of a cell inside the world, never a real style
+
+// The lightmap under one grid point, one color for each style of the surface
+typedef struct {
+    byte    styles[MAXLIGHTMAPS];
+    byte    rgb[MAXLIGHTMAPS][3];
+    short   floor;              // height the trace down hit, for shadows
+} lightgridcell_t;
+
+extern cvar_t r_lightgrid;
+
+void
+R_LightGridInit(void);
+void
+R_LightGridBuild(model_t * model, int samplesize);
+void
+R_LightGridClear(void);
+qboolean
+R_LightGridPoint(vec3_t p, vec3_t color, vec3_t spot);
+
+#endif // _RENDER_LIGHTGRID_H_
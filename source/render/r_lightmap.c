@@ -0,0 +1,351 @@
+/*
+ * Copyright (C) 1996-1997 Id Software, Inc.
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_lightmap.c -- Tracking of which lightmap texels need rebuilding
+
+/*
+ * The world surfaces are indexed by light style at map load, so when a
+ * style changes value only the surfaces that use it are marked, instead of
+ * every drawn surface comparing its styles each frame. Dynamic lights only
+ * dirty the texels inside their radius, plus the ones they lit the frame
+ * before so those go dark again. Rebuilds for style changes share a texel
+ * budget each frame, whatever is over it keeps its old light for a frame.
+ *
+ * Surfaces of models other than the world, like ammo boxes, aren't
+ * indexed and are left to the backends' own cached_light checks.
+ */
+
+#include "../nzportable_def.h"
+
+extern int d_lightstylevalue[256]; // not in the software renderer headers
+
+cvar_t r_lightmapbudget = {"r_lightmapbudget", "16384"};
+
+static model_t * lm_world;
+static int lm_numsurfaces;
+static int * lm_stylefirst;     // surfaces of style i are lm_stylesurfs[lm_stylefirst[i] to lm_stylefirst[i + 1] - 1]
+static int * lm_stylesurfs;
+static byte * lm_dirty;
+static lightmaprect_t * lm_dlightrects; // what dynamic lights lit last time each surface was built
+static int lm_laststyle[256];
+
+static int lm_used;
+static struct {
+    int marked;
+    int built;
+    int texels;
+    int deferred;
+} lm_stats, lm_laststats;
+
+/**
+ * @brief Number of a surface in the index, -1 if it isn't one of the world's.
+ */
+static inline int
+R_LightmapSurfaceNum(msurface_t * surf)
+{
+    int num;
+
+    if (!lm_dirty || cl.worldmodel != lm_world)
+        return -1;
+
+    num = surf - lm_world->surfaces;
+    if (num < 0 || num >= lm_numsurfaces)
+        return -1;
+    return num;
+}
+
+// MARK: Light styles
+
+/**
+ * @brief Indexes the lightmapped surfaces of a new map by style, called from R_NewMap.
+ *
+ * Everything is taken to be built with the current style values.
+ */
+void
+R_LightmapNewMap(model_t * world)
+{
+    msurface_t * surf;
+    int i, maps, total, fill[256];
+
+    lm_world = NULL;
+    lm_dirty = NULL;
+    memcpy(lm_laststyle, d_lightstylevalue, sizeof(lm_laststyle));
+
+    if (!world || !world->lightdata)
+        return;
+
+    lm_numsurfaces = world->numsurfaces;
+    lm_stylefirst  = Hunk_AllocName((256 + 1) * sizeof(int), "lmstyles");
+
+    total = 0;
+    for (i = 0, surf = world->surfaces; i < lm_numsurfaces; i++, surf++) {
+        if (!surf->samples || (surf->flags & SURF_DRAWTILED))
+            continue;
+        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++) {
+            lm_stylefirst[surf->styles[maps] + 1]++;
+            total++;
+        }
+    }
+    for (i = 0; i < 256; i++)
+        lm_stylefirst[i + 1] += lm_stylefirst[i];
+
+    lm_stylesurfs  = Hunk_AllocName(MAX(total, 1) * sizeof(int), "lmstyles");
+    lm_dirty       = Hunk_AllocName(lm_numsurfaces, "lmdirty");
+    lm_dlightrects = Hunk_AllocName(lm_numsurfaces * sizeof(lightmaprect_t), "lmdirty");
+
+    memcpy(fill, lm_stylefirst, sizeof(fill));
+    for (i = 0, surf = world->surfaces; i < lm_numsurfaces; i++, surf++) {
+        if (!surf->samples || (surf->flags & SURF_DRAWTILED))
+            continue;
+        for (maps = 0; maps < MAXLIGHTMAPS && surf->styles[maps] != 255; maps++)
+            lm_stylesurfs[fill[surf->styles[maps]]++] = i;
+    }
+
+    lm_world = world;
+} /* R_LightmapNewMap */
+
+/**
+ * @brief Marks the surfaces of every style that changed since the last frame, call after R_AnimateLight.
+ */
+void
+R_LightmapFrame(void)
+{
+    int style, i;
+
+    lm_laststats = lm_stats;
+    memset(&lm_stats, 0, sizeof(lm_stats));
+    lm_used = 0;
+
+    for (style = 0; style < 256; style++) {
+        if (d_lightstylevalue[style] == lm_laststyle[style])
+            continue;
+        lm_laststyle[style] = d_lightstylevalue[style];
+
+        if (!lm_dirty || cl.worldmodel != lm_world)
+            continue;
+        for (i = lm_stylefirst[style]; i < lm_stylefirst[style + 1]; i++) {
+            lm_stats.marked += !lm_dirty[lm_stylesurfs[i]];
+            lm_dirty[lm_stylesurfs[i]] = true;
+        }
+    }
+}
+
+/**
+ * @brief Whether a style of the surface changed since it was last built.
+ *
+ * @return 1 or 0, or -1 if the surface isn't indexed and the caller has to check itself.
+ */
+int
+R_LightmapStyleDirty(msurface_t * surf)
+{
+    int num = R_LightmapSurfaceNum(surf);
+
+    return num < 0 ? -1 : lm_dirty[num];
+}
+
+/**
+ * @brief Call once a surface is built with the current style values.
+ */
+void
+R_LightmapStyleClean(msurface_t * surf)
+{
+    int num = R_LightmapSurfaceNum(surf);
+
+    if (num >= 0)
+        lm_dirty[num] = false;
+}
+
+/**
+ * @brief Takes texels out of this frame's budget for style changes.
+ *
+ * The first rebuild of a frame always goes through, however big.
+ *
+ * @return false if the rebuild should wait for another frame.
+ */
+qboolean
+R_LightmapBudget(int texels)
+{
+    if (r_lightmapbudget.value > 0 && lm_used && lm_used + texels > r_lightmapbudget.value) {
+        lm_stats.deferred++;
+        return false;
+    }
+
+    lm_used += texels;
+    lm_stats.built++;
+    lm_stats.texels += texels;
+    return true;
+}
+
+// MARK: Dynamic lights
+
+/**
+ * @brief All of a surface's texels.
+ */
+void
+R_LightmapFullRect(msurface_t * surf, lightmaprect_t * rect)
+{
+    rect->s0 = rect->t0 = 0;
+    rect->s1 = (surf->extents[0] >> 4) + 1;
+    rect->t1 = (surf->extents[1] >> 4) + 1;
+}
+
+/**
+ * @brief The texels lo to hi - 1, of size along one axis, less than radius from center.
+ *
+ * Texel i is at i * 16, like in R_AddDynamicLights. One texel of slack is
+ * kept on both ends for the rounding there.
+ */
+void
+R_LightmapLightSpan(float center, float radius, int size, int * lo, int * hi)
+{
+    *lo = (int) floorf((center - radius) / 16);
+    *hi = (int) floorf((center + radius) / 16) + 2;
+
+    *lo = MAX(*lo, 0);
+    *hi = MIN(*hi, size);
+    if (*hi < *lo)
+        *hi = *lo;
+}
+
+/**
+ * @brief Grows rect to cover add as well.
+ */
+static void
+R_LightmapUnionRect(lightmaprect_t * rect, lightmaprect_t * add)
+{
+    if (add->s0 == add->s1)
+        return;
+    if (rect->s0 == rect->s1) {
+        *rect = *add;
+        return;
+    }
+
+    rect->s0 = MIN(rect->s0, add->s0);
+    rect->s1 = MAX(rect->s1, add->s1);
+    rect->t0 = MIN(rect->t0, add->t0);
+    rect->t1 = MAX(rect->t1, add->t1);
+}
+
+/**
+ * @brief The texels the dynamic lights of this frame reach on a surface.
+ *
+ * @return false if there aren't any.
+ */
+qboolean
+R_LightmapDlightRect(msurface_t * surf, lightmaprect_t * rect)
+{
+    lightmaprect_t span;
+    dlight_t * dl;
+    float dist, rad, minlight, local[2];
+    vec3_t impact;
+    int lnum, i, smax, tmax, s0, s1, t0, t1;
+
+    rect->s0 = rect->s1 = rect->t0 = rect->t1 = 0;
+
+    if (surf->dlightframe != r_framecount)
+        return false;
+
+    smax = (surf->extents[0] >> 4) + 1;
+    tmax = (surf->extents[1] >> 4) + 1;
+
+    for (lnum = 0; lnum < MAX_DLIGHTS; lnum++) {
+        if (!(surf->dlightbits & (1 << lnum)))
+            continue;
+
+        dl   = &cl_dlights[lnum];
+        rad  = dl->radius;
+        dist = DotProduct(dl->origin, surf->plane->normal) - surf->plane->dist;
+        rad -= fabsf(dist);
+        minlight = dl->minlight;
+        if (rad < minlight)
+            continue;
+        minlight = rad - minlight;
+
+        for (i = 0; i < 3; i++)
+            impact[i] = dl->origin[i] - surf->plane->normal[i] * dist;
+
+        local[0] = DotProduct(impact, surf->texinfo->vecs[0]) + surf->texinfo->vecs[0][3] - surf->texturemins[0];
+        local[1] = DotProduct(impact, surf->texinfo->vecs[1]) + surf->texinfo->vecs[1][3] - surf->texturemins[1];
+
+        R_LightmapLightSpan(local[0], minlight, smax, &s0, &s1);
+        R_LightmapLightSpan(local[1], minlight, tmax, &t0, &t1);
+        if (s0 == s1 || t0 == t1)
+            continue;
+
+        span.s0 = s0;
+        span.s1 = s1;
+        span.t0 = t0;
+        span.t1 = t1;
+        R_LightmapUnionRect(rect, &span);
+    }
+
+    return rect->s0 != rect->s1;
+} /* R_LightmapDlightRect */
+
+/**
+ * @brief The texels to rebuild for dynamic lights, lit now or on the last build.
+ *
+ * Remembers what is lit now for the next call, so only call it when the
+ * texels are going to be rebuilt.
+ *
+ * @return false if there is nothing to rebuild.
+ */
+qboolean
+R_LightmapDlightUpdateRect(msurface_t * surf, lightmaprect_t * rect)
+{
+    lightmaprect_t lit, * last;
+    int num = R_LightmapSurfaceNum(surf);
+
+    if (num < 0) {
+        R_LightmapFullRect(surf, rect);
+        return true;
+    }
+
+    last = &lm_dlightrects[num];
+    R_LightmapDlightRect(surf, &lit);
+
+    *rect = lit;
+    R_LightmapUnionRect(rect, last);
+    *last = lit;
+
+    return rect->s0 != rect->s1;
+} /* R_LightmapDlightUpdateRect */
+
+// MARK: Stats
+
+/**
+ * @brief 'lightmapstats' console command, what the last frame rebuilt.
+ */
+static void
+R_LightmapStats_f(void)
+{
+    Con_Printf("lightmaps: %i surfaces marked by styles, %i rebuilt, %i texels, %i deferred\n",
+      lm_laststats.marked, lm_laststats.built, lm_laststats.texels, lm_laststats.deferred);
+}
+
+/**
+ * @brief Called at startup, registers the budget cvar and stats command.
+ */
+void
+R_LightmapInit(void)
+{
+    Cvar_RegisterVariable(&r_lightmapbudget);
+    Cmd_AddCommand("lightmapstats", R_LightmapStats_f);
+}
@@ -0,0 +1,53 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_lightmap.h -- Tracking of which lightmap texels need rebuilding
+
+#ifndef _RENDER_LIGHTMAP_H_
+#define _RENDER_LIGHTMAP_H_
+
+// Texels s0 to s1 - 1 and t0 to t1 - 1 of a surface, empty if s0 == s1
+typedef struct {
+    byte    s0, t0, s1, t1;
+} lightmaprect_t;
+
+extern cvar_t r_lightmapbudget;
+
+void
+R_LightmapInit(void);
+void
+R_LightmapNewMap(model_t * world);
+void
+R_LightmapFrame(void);
+int
+R_LightmapStyleDirty(msurface_t * surf);
+void
+R_LightmapStyleClean(msurface_t * surf);
+qboolean
+R_LightmapBudget(int texels);
+void
+R_LightmapFullRect(msurface_t * surf, lightmaprect_t * rect);
+void
+R_LightmapLightSpan(float center, float radius, int size, int * lo, int * hi);
+qboolean
+R_LightmapDlightRect(msurface_t * surf, lightmaprect_t * rect);
+qboolean
+R_LightmapDlightUpdateRect(msurface_t * surf, lightmaprect_t * rect);
+
+#endif // _RENDER_LIGHTMAP_H_
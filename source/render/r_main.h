@@ -27,6 +27,11 @@
 #include "r_color_quantization.h"
 #include "r_entity_fragments.h"
 #include "r_light.h"
+#include "r_lightgrid.h"
+#include "r_lightmap.h"
+#include "r_bspcache.h"
+#include "r_cull.h"
+#include "r_occlusion.h"
 #include "r_fog.h"
 
 #define GFX_REPLACE     0
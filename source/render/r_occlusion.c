@@ -0,0 +1,624 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_occlusion.c -- Culling of entities hidden behind the world with a small CPU depth buffer
+
+/*
+ * The big opaque surfaces of the world are picked out at map load as
+ * occluders. Every view, the ones in visible leaves that face the viewer
+ * are ranked by how much of the screen they are likely to cover, and the
+ * best r_occluders of them are drawn into an OCC_WIDTH by OCC_HEIGHT buffer
+ * of 1 / depth. Entities are then tested against it with their bounding
+ * boxes, before their lighting, animation and drawing are paid for.
+ *
+ * It only ever errs towards drawing. Occluders are written with the
+ * furthest depth they have anywhere inside a pixel, boxes are tested with
+ * their nearest corner over every pixel they touch plus one around, and
+ * whatever is too close to the viewer or off the buffer is left visible.
+ *
+ * Nothing here depends on the backend beyond the Quake world structures,
+ * the view vectors and r_refdef, so the same buffer serves every renderer.
+ */
+
+#include "../nzportable_def.h"
+
+extern int r_visframecount; // not in the software renderer headers
+
+cvar_t r_occlusion     = {"r_occlusion", "1"};
+cvar_t r_occluders     = {"r_occluders", "32"};        // drawn into the buffer each view
+cvar_t r_occluderarea  = {"r_occluderarea", "1024"};   // smallest surface kept as an occluder, on map load
+cvar_t r_showocclusion = {"r_showocclusion", "0"};
+
+typedef struct {
+    float   normal[3];      // towards the side it is drawn from
+    float   dist;
+    float   center[3];
+    float   radius;
+    float   area;
+    int     firstvert;
+    int     numverts;
+    int     visframe;       // of occ_visframe, so surfaces in several leaves are only looked at once
+} occluder_t;
+
+typedef struct {
+    float           score;
+    occluder_t *    occluder;
+} occcandidate_t;
+
+// Textures that can be seen through or aren't drawn at all
+static char * occ_skiptextures[] = {"{", "*", "sky", "nodraw", "glass", "env", "clip", "trigger"};
+
+static model_t * occ_world;
+static int occ_numoccluders;
+static occluder_t * occ_occluders;
+static int * occ_surfoccluders;     // occluder of each world surface, -1 for none
+static float (*occ_verts)[3];
+static int occ_visframe;
+
+static occcandidate_t occ_candidates[OCC_MAXCANDIDATES];
+
+// The view the buffer was drawn for
+static qboolean occ_active;
+static vec3_t occ_origin, occ_forward, occ_right, occ_up;
+static float occ_xscale, occ_yscale;
+
+static float occ_depth[OCC_HEIGHT * OCC_WIDTH];     // 1 / depth, 0 where nothing was drawn
+
+static struct {
+    int candidates;
+    int occluders;
+    int aliases;
+    int aliasesoccluded;
+    int brushes;
+    int brushesoccluded;
+} occ_stats;
+
+// MARK: Occluders
+
+/**
+ * @brief Area of a surface if it can hide what is behind it, 0 if not.
+ */
+static float
+R_OcclusionSurfaceArea(model_t * world, msurface_t * surf)
+{
+    float * v0, * v1, * v2;
+    vec3_t a, b, cross, sum;
+    int i, lindex, verts[OCC_MAXVERTS];
+
+    if (surf->flags & (SURF_DRAWSKY | SURF_DRAWTURB))
+        return 0;
+    if (surf->numedges < 3 || surf->numedges > OCC_MAXVERTS)
+        return 0;
+    for (i = 0; i < (int) (sizeof(occ_skiptextures) / sizeof(occ_skiptextures[0])); i++) {
+        if (!Q_strncasecmp(surf->texinfo->texture->name, occ_skiptextures[i], strlen(occ_skiptextures[i])))
+            return 0;
+    }
+
+    for (i = 0; i < surf->numedges; i++) {
+        lindex   = world->surfedges[surf->firstedge + i];
+        verts[i] = lindex > 0 ? world->edges[lindex].v[0] : world->edges[-lindex].v[1];
+    }
+
+    VectorClear(sum);
+    v0 = world->vertexes[verts[0]].position;
+    for (i = 1; i < surf->numedges - 1; i++) {
+        v1 = world->vertexes[verts[i]].position;
+        v2 = world->vertexes[verts[i + 1]].position;
+        VectorSubtract(v1, v0, a);
+        VectorSubtract(v2, v0, b);
+        CrossProduct(a, b, cross);
+        VectorAdd(sum, cross, sum);
+    }
+
+    return Length(sum) * 0.5f;
+} /* R_OcclusionSurfaceArea */
+
+/**
+ * @brief Picks the occluders out of the world surfaces, called from R_NewMap.
+ */
+void
+R_OcclusionNewMap(model_t * world)
+{
+    msurface_t * surf;
+    occluder_t * occ;
+    float area, * v;
+    vec3_t d;
+    int i, j, lindex, numverts;
+
+    occ_world = NULL;
+    occ_numoccluders = 0;
+    occ_active = false;
+
+    if (!world)
+        return;
+
+    occ_surfoccluders = Hunk_AllocName(world->numsurfaces * sizeof(int), "occluders");
+
+    numverts = 0;
+    for (i = 0, surf = world->surfaces; i < world->numsurfaces; i++, surf++) {
+        area = R_OcclusionSurfaceArea(world, surf);
+        if (area < MAX(r_occluderarea.value, 1)) {
+            occ_surfoccluders[i] = -1;
+            continue;
+        }
+        occ_surfoccluders[i] = occ_numoccluders++;
+        numverts += surf->numedges;
+    }
+
+    occ_occluders = Hunk_AllocName(MAX(occ_numoccluders, 1) * sizeof(occluder_t), "occluders");
+    occ_verts     = Hunk_AllocName(MAX(numverts, 1) * sizeof(*occ_verts), "occluders");
+
+    numverts = 0;
+    for (i = 0, surf = world->surfaces; i < world->numsurfaces; i++, surf++) {
+        if (occ_surfoccluders[i] < 0)
+            continue;
+
+        occ = &occ_occluders[occ_surfoccluders[i]];
+        occ->area      = R_OcclusionSurfaceArea(world, surf);
+        occ->firstvert = numverts;
+        occ->numverts  = surf->numedges;
+        occ->visframe  = 0;
+
+        VectorClear(occ->center);
+        for (j = 0; j < surf->numedges; j++) {
+            lindex = world->surfedges[surf->firstedge + j];
+            v      = world->vertexes[lindex > 0 ? world->edges[lindex].v[0] : world->edges[-lindex].v[1]].position;
+            VectorCopy(v, occ_verts[numverts + j]);
+            VectorAdd(occ->center, v, occ->center);
+        }
+        VectorScale(occ->center, 1.0f / surf->numedges, occ->center);
+
+        occ->radius = 0;
+        for (j = 0; j < surf->numedges; j++) {
+            VectorSubtract(occ_verts[numverts + j], occ->center, d);
+            occ->radius = MAX(occ->radius, Length(d));
+        }
+        numverts += surf->numedges;
+
+        if (surf->flags & SURF_PLANEBACK) {
+            VectorScale(surf->plane->normal, -1, occ->normal);
+            occ->dist = -surf->plane->dist;
+        } else {
+            VectorCopy(surf->plane->normal, occ->normal);
+            occ->dist = surf->plane->dist;
+        }
+    }
+
+    occ_world = world;
+    Con_DPrintf("%i occluders of %i surfaces\n", occ_numoccluders, world->numsurfaces);
+} /* R_OcclusionNewMap */
+
+// MARK: Depth buffer
+
+/**
+ * @brief Occluders worth more come first.
+ */
+static int
+R_OcclusionCompare(const void * a, const void * b)
+{
+    float sa = ((occcandidate_t *) a)->score;
+    float sb = ((occcandidate_t *) b)->score;
+
+    return sa < sb ? 1 : sa > sb ? -1 : 0;
+}
+
+/**
+ * @brief Into view space, x right, y up and z the depth.
+ */
+static inline void
+R_OcclusionToView(float * point, float * out)
+{
+    vec3_t d;
+
+    VectorSubtract(point, occ_origin, d);
+    out[0] = DotProduct(d, occ_right);
+    out[1] = DotProduct(d, occ_up);
+    out[2] = DotProduct(d, occ_forward);
+}
+
+/**
+ * @brief Whether a sphere in view space is at least partly inside the view.
+ */
+static qboolean
+R_OcclusionSphereVisible(float * center, float radius)
+{
+    float tx = (OCC_WIDTH / 2) / occ_xscale;
+    float ty = (OCC_HEIGHT / 2) / occ_yscale;
+
+    if (center[2] < OCC_NEAR - radius)
+        return false;
+    if (fabsf(center[0]) - center[2] * tx > radius * sqrtf(1 + tx * tx))
+        return false;
+    if (fabsf(center[1]) - center[2] * ty > radius * sqrtf(1 + ty * ty))
+        return false;
+    return true;
+}
+
+/**
+ * @brief Adds the occluders of the visible leaves that face the viewer.
+ *
+ * @return how many there are.
+ */
+static int
+R_OcclusionGather(void)
+{
+    mleaf_t * leaf;
+    msurface_t ** mark;
+    occluder_t * occ;
+    vec3_t center;
+    float dist;
+    int i, j, num, count;
+
+    occ_visframe++;
+    count = 0;
+
+    for (i = 0, leaf = occ_world->leafs + 1; i < occ_world->numleafs; i++, leaf++) {
+        if (leaf->visframe != r_visframecount)
+            continue;
+
+        mark = leaf->firstmarksurface;
+        for (j = 0; j < leaf->nummarksurfaces; j++) {
+            num = occ_surfoccluders[mark[j] - occ_world->surfaces];
+            if (num < 0)
+                continue;
+
+            occ = &occ_occluders[num];
+            if (occ->visframe == occ_visframe)
+                continue;
+            occ->visframe = occ_visframe;
+
+            if (DotProduct(occ_origin, occ->normal) - occ->dist <= 0)
+                continue;
+
+            R_OcclusionToView(occ->center, center);
+            if (!R_OcclusionSphereVisible(center, occ->radius))
+                continue;
+
+            if (count == OCC_MAXCANDIDATES)
+                return count;
+
+            dist = MAX(DotProduct(center, center), 1);
+            occ_candidates[count].score    = occ->area / dist;
+            occ_candidates[count].occluder = occ;
+            count++;
+        }
+    }
+
+    return count;
+} /* R_OcclusionGather */
+
+/**
+ * @brief Cuts a polygon in view space at the near plane.
+ *
+ * @return the number of vertices left.
+ */
+static int
+R_OcclusionClipNear(float (*in)[3], int numverts, float (*out)[3])
+{
+    float * a, * b, frac;
+    int i, count = 0;
+
+    for (i = 0; i < numverts; i++) {
+        a = in[i];
+        b = in[(i + 1) % numverts];
+
+        if (a[2] >= OCC_NEAR) {
+            VectorCopy(a, out[count]);
+            count++;
+        }
+        if ((a[2] >= OCC_NEAR) != (b[2] >= OCC_NEAR)) {
+            frac = (OCC_NEAR - a[2]) / (b[2] - a[2]);
+            out[count][0] = a[0] + frac * (b[0] - a[0]);
+            out[count][1] = a[1] + frac * (b[1] - a[1]);
+            out[count][2] = OCC_NEAR;
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/**
+ * @brief Draws an occluder into the depth buffer.
+ *
+ * 1 / depth across the screen is a plane, A * x + B * y + C, taken straight
+ * from the occluder's plane, so nothing is interpolated along the edges.
+ * Every pixel whose center is covered gets the smallest value of that
+ * plane anywhere inside the pixel.
+ */
+static void
+R_OcclusionDrawOccluder(occluder_t * occ)
+{
+    float view[OCC_MAXVERTS][3], clipped[OCC_MAXVERTS + 1][3], screen[OCC_MAXVERTS + 1][2];
+    float nf, nr, nu, denom, a, b, c, slack;
+    float ymin, ymax, yc, xl, xr, x, value, * p0, * p1, * row;
+    int i, j, numverts, x0, x1, y0, y1;
+
+    for (i = 0; i < occ->numverts; i++)
+        R_OcclusionToView(occ_verts[occ->firstvert + i], view[i]);
+
+    numverts = R_OcclusionClipNear(view, occ->numverts, clipped);
+    if (numverts < 3)
+        return;
+
+    ymin = 1e30f;
+    ymax = -1e30f;
+    for (i = 0; i < numverts; i++) {
+        screen[i][0] = OCC_WIDTH / 2 + clipped[i][0] / clipped[i][2] * occ_xscale;
+        screen[i][1] = OCC_HEIGHT / 2 - clipped[i][1] / clipped[i][2] * occ_yscale;
+        ymin = MIN(ymin, screen[i][1]);
+        ymax = MAX(ymax, screen[i][1]);
+    }
+
+    nf    = DotProduct(occ->normal, occ_forward);
+    nr    = DotProduct(occ->normal, occ_right);
+    nu    = DotProduct(occ->normal, occ_up);
+    denom = occ->dist - DotProduct(occ->normal, occ_origin);
+    a     = nr / (occ_xscale * denom);
+    b     = -nu / (occ_yscale * denom);
+    c     = (nf - nr * (OCC_WIDTH / 2) / occ_xscale + nu * (OCC_HEIGHT / 2) / occ_yscale) / denom;
+    slack = 0.5f * (fabsf(a) + fabsf(b));
+
+    y0 = MAX((int) ceilf(MAX(ymin, -1) - 0.5f), 0);
+    y1 = MIN((int) ceilf(MIN(ymax, OCC_HEIGHT + 1) - 0.5f), OCC_HEIGHT);
+
+    for (j = y0; j < y1; j++) {
+        yc = j + 0.5f;
+        xl = 1e30f;
+        xr = -1e30f;
+        for (i = 0; i < numverts; i++) {
+            p0 = screen[i];
+            p1 = screen[(i + 1) % numverts];
+            if ((p0[1] <= yc) == (p1[1] <= yc))
+                continue;
+            x  = p0[0] + (yc - p0[1]) * (p1[0] - p0[0]) / (p1[1] - p0[1]);
+            xl = MIN(xl, x);
+            xr = MAX(xr, x);
+        }
+        if (xl >= xr)
+            continue;
+
+        x0 = (int) ceilf(MAX(xl, -1) - 0.5f);
+        x1 = (int) ceilf(MIN(xr, OCC_WIDTH + 1) - 0.5f);
+        x0 = MAX(x0, 0);
+        x1 = MIN(x1, OCC_WIDTH);
+
+        row   = occ_depth + j * OCC_WIDTH;
+        value = a * (x0 + 0.5f) + b * yc + c - slack;
+        for (i = x0; i < x1; i++, value += a) {
+            if (value > row[i])
+                row[i] = value;
+        }
+    }
+} /* R_OcclusionDrawOccluder */
+
+/**
+ * @brief Draws the depth buffer for this view, call after R_MarkLeaves and before any entity.
+ */
+void
+R_OcclusionFrame(void)
+{
+    int i, count;
+
+    memset(&occ_stats, 0, sizeof(occ_stats));
+    occ_active = false;
+
+    if (!r_occlusion.value || !occ_world || occ_world != cl.worldmodel || !occ_numoccluders)
+        return;
+    if (r_refdef.fov_x <= 0 || r_refdef.fov_x >= 180 || r_refdef.fov_y <= 0 || r_refdef.fov_y >= 180)
+        return;
+
+    VectorCopy(r_origin, occ_origin);
+    VectorCopy(vpn, occ_forward);
+    VectorCopy(vright, occ_right);
+    VectorCopy(vup, occ_up);
+    occ_xscale = (OCC_WIDTH / 2) / tanf(DEG2RAD(r_refdef.fov_x) * 0.5f);
+    occ_yscale = (OCC_HEIGHT / 2) / tanf(DEG2RAD(r_refdef.fov_y) * 0.5f);
+
+    count = R_OcclusionGather();
+    occ_stats.candidates = count;
+    if (count > r_occluders.value) {
+        qsort(occ_candidates, count, sizeof(occ_candidates[0]), R_OcclusionCompare);
+        count = MAX((int) r_occluders.value, 0);
+    }
+
+    memset(occ_depth, 0, sizeof(occ_depth));
+    for (i = 0; i < count; i++)
+        R_OcclusionDrawOccluder(occ_candidates[i].occluder);
+
+    occ_stats.occluders = count;
+    occ_active = count > 0;
+} /* R_OcclusionFrame */
+
+// MARK: Tests
+
+/**
+ * @brief Whether a box is behind the occluders everywhere it shows on screen.
+ */
+qboolean
+R_OcclusionBoxCulled(vec3_t mins, vec3_t maxs)
+{
+    vec3_t corner, view;
+    float sx, sy, xmin, xmax, ymin, ymax, zmin, depth, * row;
+    int i, x, y, x0, x1, y0, y1;
+
+    if (!occ_active)
+        return false;
+
+    xmin = ymin = zmin = 1e30f;
+    xmax = ymax = -1e30f;
+    for (i = 0; i < 8; i++) {
+        corner[0] = (i & 1) ? maxs[0] : mins[0];
+        corner[1] = (i & 2) ? maxs[1] : mins[1];
+        corner[2] = (i & 4) ? maxs[2] : mins[2];
+        R_OcclusionToView(corner, view);
+        if (view[2] < OCC_NEAR)
+            return false;
+
+        sx   = OCC_WIDTH / 2 + view[0] / view[2] * occ_xscale;
+        sy   = OCC_HEIGHT / 2 - view[1] / view[2] * occ_yscale;
+        xmin = MIN(xmin, sx);
+        xmax = MAX(xmax, sx);
+        ymin = MIN(ymin, sy);
+        ymax = MAX(ymax, sy);
+        zmin = MIN(zmin, view[2]);
+    }
+
+    // off the buffer is off the screen, the frustum culls that
+    if (xmax < 0 || xmin >= OCC_WIDTH || ymax < 0 || ymin >= OCC_HEIGHT)
+        return false;
+
+    x0 = MAX((int) floorf(xmin) - 1, 0);
+    x1 = MIN((int) floorf(xmax) + 1, OCC_WIDTH - 1);
+    y0 = MAX((int) floorf(ymin) - 1, 0);
+    y1 = MIN((int) floorf(ymax) + 1, OCC_HEIGHT - 1);
+
+    depth = 1.0f / zmin;
+    for (y = y0; y <= y1; y++) {
+        row = occ_depth + y * OCC_WIDTH;
+        for (x = x0; x <= x1; x++) {
+            if (row[x] <= depth)
+                return false;
+        }
+    }
+
+    return true;
+} /* R_OcclusionBoxCulled */
+
+/**
+ * @brief How far the furthest corner of a box is from the origin.
+ *
+ * Backends use it for the reach of an alias model, with the box every
+ * vertex of it can be in.
+ */
+float
+R_OcclusionRadius(vec3_t lo, vec3_t hi)
+{
+    vec3_t corner;
+    int i;
+
+    for (i = 0; i < 3; i++)
+        corner[i] = MAX(fabsf(lo[i]), fabsf(hi[i]));
+    return Length(corner);
+}
+
+/**
+ * @brief Tests an alias model entity that reaches radius from its origin at any angles.
+ */
+qboolean
+R_OcclusionAliasCulled(entity_t * e, float radius)
+{
+    vec3_t mins, maxs;
+    int i;
+
+    if (!occ_active)
+        return false;
+
+    if (e->scale && e->scale != ENTSCALE_DEFAULT)
+        radius *= ENTSCALE_DECODE(e->scale);
+    radius += OCC_ENTITYPAD;
+
+    for (i = 0; i < 3; i++) {
+        mins[i] = e->origin[i] - radius;
+        maxs[i] = e->origin[i] + radius;
+    }
+
+    occ_stats.aliases++;
+    if (!R_OcclusionBoxCulled(mins, maxs))
+        return false;
+    occ_stats.aliasesoccluded++;
+    return true;
+}
+
+/**
+ * @brief Tests a brush model entity.
+ */
+qboolean
+R_OcclusionBrushCulled(entity_t * e)
+{
+    model_t * clmodel = e->model;
+    vec3_t mins, maxs;
+    int i;
+
+    if (!occ_active)
+        return false;
+
+    for (i = 0; i < 3; i++) {
+        if (e->angles[0] || e->angles[1] || e->angles[2]) {
+            mins[i] = e->origin[i] - clmodel->radius;
+            maxs[i] = e->origin[i] + clmodel->radius;
+        } else {
+            mins[i] = e->origin[i] + clmodel->mins[i];
+            maxs[i] = e->origin[i] + clmodel->maxs[i];
+        }
+        mins[i] -= OCC_ENTITYPAD;
+        maxs[i] += OCC_ENTITYPAD;
+    }
+
+    occ_stats.brushes++;
+    if (!R_OcclusionBoxCulled(mins, maxs))
+        return false;
+    occ_stats.brushesoccluded++;
+    return true;
+} /* R_OcclusionBrushCulled */
+
+// MARK: Stats
+
+/**
+ * @brief Overlay of what the last view culled, while r_showocclusion is set.
+ */
+void
+R_OcclusionDrawStats(void)
+{
+    char str[64];
+
+    if (!r_showocclusion.value)
+        return;
+
+    snprintf(str, sizeof(str), "occluders %i/%i", occ_stats.occluders, occ_stats.candidates);
+    Draw_String(8, 8, str);
+    snprintf(str, sizeof(str), "models %i/%i hidden", occ_stats.aliasesoccluded, occ_stats.aliases);
+    Draw_String(8, 16, str);
+    snprintf(str, sizeof(str), "brushes %i/%i hidden", occ_stats.brushesoccluded, occ_stats.brushes);
+    Draw_String(8, 24, str);
+}
+
+/**
+ * @brief 'occlusionstats' console command, what the last view culled.
+ */
+static void
+R_OcclusionStats_f(void)
+{
+    Con_Printf("occlusion: %i of %i occluders drawn, %i of %i models and %i of %i brush models hidden\n",
+      occ_stats.occluders, occ_stats.candidates, occ_stats.aliasesoccluded, occ_stats.aliases,
+      occ_stats.brushesoccluded, occ_stats.brushes);
+}
+
+/**
+ * @brief Called at startup, registers the cvars and stats command.
+ */
+void
+R_OcclusionInit(void)
+{
+    Cvar_RegisterVariable(&r_occlusion);
+    Cvar_RegisterVariable(&r_occluders);
+    Cvar_RegisterVariable(&r_occluderarea);
+    Cvar_RegisterVariable(&r_showocclusion);
+    Cmd_AddCommand("occlusionstats", R_OcclusionStats_f);
+}
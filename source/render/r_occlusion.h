@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2025 NZ:P Team
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * as published by the Free Software Foundation; either version 2
+ * of the License, or (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ *
+ * See the GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+ *
+ */
+// r_occlusion.h -- Culling of entities hidden behind the world with a small CPU depth buffer
+
+#ifndef _RENDER_OCCLUSION_H_
+#define _RENDER_OCCLUSION_H_
+
+#define OCC_WIDTH           128
+#define OCC_HEIGHT          64
+#define OCC_MAXVERTS        32      // surfaces with more edges aren't occluders
+#define OCC_MAXCANDIDATES   2048    // occluders looked at in a frame
+#define OCC_NEAR            1.0f
+#define OCC_ENTITYPAD       8.0f    // added around entities for the lerp between origins
+
+extern cvar_t r_occlusion;
+extern cvar_t r_occluders;
+extern cvar_t r_occluderarea;
+extern cvar_t r_showocclusion;
+
+void
+R_OcclusionInit(void);
+void
+R_OcclusionNewMap(model_t * world);
+void
+R_OcclusionFrame(void);
+qboolean
+R_OcclusionBoxCulled(vec3_t mins, vec3_t maxs);
+float
+R_OcclusionRadius(vec3_t lo, vec3_t hi);
+qboolean
+R_OcclusionAliasCulled(entity_t * e, float radius);
+qboolean
+R_OcclusionBrushCulled(entity_t * e);
+void
+R_OcclusionDrawStats(void);
+
+#endif // _RENDER_OCCLUSION_H_
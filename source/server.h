@@ -86,6 +86,7 @@ typedef struct client_s
 	struct qsocket_s *netconnection;	// communications handle
 
 	usercmd_t		cmd;				// movement
+	int				movesequence;		// of the last clc_move, 0 if the client doesn't number them
 	vec3_t			wishdir;			// intended motion calced from cmd
 
 	sizebuf_t		message;			// can be added to at any time,
@@ -227,17 +228,26 @@ void SV_SetIdealPitch (void);
 void SV_AddUpdates (void);
 
 void SV_ClientThink (void);
+void SV_PlayerThink (usercmd_t *move);
 void SV_AddClientToServer (struct qsocket_s	*ret);
 
 void SV_ClientPrintf (char *fmt, ...);
 void SV_BroadcastPrintf (char *fmt, ...);
 
 void SV_Physics (void);
+void SV_CheckVelocity (edict_t *ent);
+qboolean SV_CheckWater (edict_t *ent);
+void SV_AddGravity (edict_t *ent);
+void SV_CheckStuck (edict_t *ent);
+void SV_WalkMove (edict_t *ent);
 
 qboolean SV_CheckBottom (edict_t *ent);
 qboolean SV_movestep (edict_t *ent, vec3_t move, qboolean relink);
 
 void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg);
+byte *SV_FatPVS (vec3_t org);
+qboolean SV_EntityVisible (edict_t *clent, edict_t *ent, byte *pvs, qboolean nomap);
+void SV_EntityRender (edict_t *ent, float *renderamt, float *rendermode, float *rendercolor);
 
 void SV_MoveToGoal (void);
 void SV_MoveToOrigin (void);
@@ -246,3 +256,17 @@ void SV_CheckForNewClients (void);
 void SV_RunClients (void);
 void SV_SaveSpawnparms ();
 void SV_SpawnServer (char *server);
+void SV_ConnectClient (int clientnum);
+
+// sv_bench.c
+#define	SV_BENCH_CLIENTS	0
+#define	SV_BENCH_PHYSICS	1
+#define	SV_BENCH_SEND		2
+#define	SV_BENCH_PHASES		3
+
+extern	qboolean	sv_benchtiming;			// Host_ServerFrame adds to sv_benchphase
+extern	double		sv_benchphase[SV_BENCH_PHASES];
+
+void SV_Bench_f (void);
+void SV_BenchRecord_f (void);
+void SV_BenchRecordMove (vec3_t angles, usercmd_t *move, int buttons, int impulse);
@@ -27,6 +27,7 @@ void S_Play_f(void);
 void S_PlayVol_f(void);
 void S_SoundList_f(void);
 void S_Update_();
+void SND_AllocateVoices (void);
 void S_StopAllSounds(qboolean clear);
 void S_StopAllSoundsC_f(void);
 void S_VolumeDown_f (void); // Baker 3.60 - from JoeQuake 0.15
@@ -39,6 +40,10 @@ void S_VolumeUp_f (void);  // Baker 3.60 - from JoeQuake 0.15
 channel_t   channels[MAX_CHANNELS];
 int			total_channels;
 
+int			snd_voices_active;
+int			snd_voices_virtual;
+int			snd_voices_stolen;
+
 int				snd_blocked = 0;
 static qboolean	snd_ambient = 1;
 qboolean		snd_initialized = false;
@@ -80,6 +85,7 @@ cvar_t ambient_fade = {"ambient_fade", "100"};
 cvar_t snd_noextraupdate = {"snd_noextraupdate", "0"};
 cvar_t snd_show = {"snd_show", "0"};
 cvar_t _snd_mixahead = {"_snd_mixahead", "0.1", true};
+cvar_t snd_maxvoices = {"snd_maxvoices", "16", true};
 
 // ====================================================================
 // User-setable variables
@@ -188,6 +194,8 @@ void S_Init (void)
 	Cmd_AddCommand("soundinfo", S_SoundInfo_f);
 	Cmd_AddCommand ("volumedown", S_VolumeDown_f); // Baker 3.60 - from JoeQuake 0.15
 	Cmd_AddCommand ("volumeup", S_VolumeUp_f); // Baker 3.60 - from JoeQuake 0.15
+	Cmd_AddCommand ("snd_bench", SND_Bench_f);
+	Cmd_AddCommand ("snd_buildcache", S_BuildSoundCache_f);
 
 	Cvar_RegisterVariable(&nosound);
 	Cvar_RegisterVariable(&volume);
@@ -200,6 +208,9 @@ void S_Init (void)
 	Cvar_RegisterVariable(&snd_noextraupdate);
 	Cvar_RegisterVariable(&snd_show);
 	Cvar_RegisterVariable(&_snd_mixahead);
+	Cvar_RegisterVariable(&snd_simd);
+	Cvar_RegisterVariable(&snd_maxvoices);
+	Cvar_RegisterVariable(&snd_resamplecache);
 
 	//if (host_parms.memsize < 0x800000)
 	{
@@ -357,36 +368,92 @@ sfx_t *S_PrecacheSound (char *name)
 
 //=============================================================================
 
+/*
+=================
+SND_ChannelPriority
+
+Louder is more important, with the heard volume already including
+distance attenuation. Sounds the local player makes and weapon sounds
+are weighted up so a crowd of zombies can't push them out.
+=================
+*/
+int SND_ChannelPriority(channel_t *ch)
+{
+	int		priority;
+
+	priority = ch->leftvol + ch->rightvol;
+
+	if (ch->entnum == cl.viewentity)
+		priority *= 4;
+	else if (ch->entchannel == 1)	// CHAN_WEAPON
+		priority *= 2;
+
+	return priority;
+}
+
+/*
+=================
+SND_OverrideChannel
+
+The channel a new sound from entnum on entchannel always replaces, or -1
+=================
+*/
+static int SND_OverrideChannel (int entnum, int entchannel)
+{
+	int		ch_idx;
+
+	if (entchannel == 0)		// channel 0 never overrides
+		return -1;
+
+	for (ch_idx=NUM_AMBIENTS ; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS ; ch_idx++)
+	{
+		if (channels[ch_idx].entnum == entnum
+		&& (channels[ch_idx].entchannel == entchannel || entchannel == -1) )
+			return ch_idx;
+	}
+
+	return -1;
+}
+
 /*
 =================
 SND_PickChannel
+
+Replaces a sound from the same entity, otherwise takes a free channel,
+otherwise steals the least important one. Returns NULL when every
+channel matters more than the new sound.
 =================
 */
-channel_t *SND_PickChannel(int entnum, int entchannel)
+channel_t *SND_PickChannel(int entnum, int entchannel, int priority)
 {
     int ch_idx;
     int first_to_die;
     int life_left;
+    int lowest;
+    int score;
 
-// Check for replacement sound, or find the best one to replace
-    first_to_die = -1;
+// always override sound from same entity
+    first_to_die = SND_OverrideChannel (entnum, entchannel);
+    if (first_to_die != -1)
+    {
+		channels[first_to_die].sfx = NULL;
+		return &channels[first_to_die];
+    }
+
+// otherwise find the best one to replace
     life_left = 0x7fffffff;
+    lowest = 0x7fffffff;
     for (ch_idx=NUM_AMBIENTS ; ch_idx < NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS ; ch_idx++)
     {
-		if (entchannel != 0		// channel 0 never overrides
-		&& channels[ch_idx].entnum == entnum
-		&& (channels[ch_idx].entchannel == entchannel || entchannel == -1) )
-		{	// always override sound from same entity
-			first_to_die = ch_idx;
-			break;
-		}
-
 		// don't let monster sounds override player sounds
 		if (channels[ch_idx].entnum == cl.viewentity && entnum != cl.viewentity && channels[ch_idx].sfx)
 			continue;
 
-		if (channels[ch_idx].end - paintedtime < life_left)
+		score = channels[ch_idx].sfx ? channels[ch_idx].priority : -1;
+
+		if (score < lowest || (score == lowest && channels[ch_idx].end - paintedtime < life_left))
 		{
+			lowest = score;
 			life_left = channels[ch_idx].end - paintedtime;
 			first_to_die = ch_idx;
 		}
@@ -396,7 +463,12 @@ channel_t *SND_PickChannel(int entnum, int entchannel)
 		return NULL;
 
 	if (channels[first_to_die].sfx)
+	{
+		if (lowest > priority)
+			return NULL;
+		snd_voices_stolen++;
 		channels[first_to_die].sfx = NULL;
+	}
 
     return &channels[first_to_die];
 }
@@ -531,6 +603,7 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
 #endif
 
 	channel_t *target_chan, *check;
+	channel_t	spatial;
 	sfxcache_t	*sc;
 	int		vol;
 	int		ch_idx;
@@ -547,22 +620,32 @@ void S_StartSound(int entnum, int entchannel, sfx_t *sfx, vec3_t origin, float f
 
 	vol = fvol*255;
 
+// spatialize first so the new sound can be weighed against playing ones
+	memset (&spatial, 0, sizeof(spatial));
+	VectorCopy(origin, spatial.origin);
+	spatial.dist_mult = attenuation / sound_nominal_clip_dist;
+	spatial.master_vol = vol;
+	spatial.entnum = entnum;
+	spatial.entchannel = entchannel;
+	SND_Spatialize(&spatial);
+
+	if (!spatial.leftvol && !spatial.rightvol)
+	{
+		// not audible at all, but it still cuts off what its entity
+		// channel was playing, as it would have if it were heard
+		if ((ch_idx = SND_OverrideChannel (entnum, entchannel)) != -1)
+			channels[ch_idx].sfx = NULL;
+		return;
+	}
+
+	spatial.priority = SND_ChannelPriority(&spatial);
+
 // pick a channel to play on
-	target_chan = SND_PickChannel(entnum, entchannel);
+	target_chan = SND_PickChannel(entnum, entchannel, spatial.priority);
 	if (!target_chan)
 		return;
 
-// spatialize
-	memset (target_chan, 0, sizeof(*target_chan));
-	VectorCopy(origin, target_chan->origin);
-	target_chan->dist_mult = attenuation / sound_nominal_clip_dist;
-	target_chan->master_vol = vol;
-	target_chan->entnum = entnum;
-	target_chan->entchannel = entchannel;
-	SND_Spatialize(target_chan);
-
-	if (!target_chan->leftvol && !target_chan->rightvol)
-		return;		// not audible at all
+	*target_chan = spatial;
 
 // new channel
 	if (!(sc = S_LoadSound (sfx)))
@@ -602,7 +685,7 @@ void S_StopSound(int entnum, int entchannel)
 
 	int i;
 
-	for (i=0 ; i<MAX_DYNAMIC_CHANNELS ; i++)
+	for (i=NUM_AMBIENTS ; i<NUM_AMBIENTS + MAX_DYNAMIC_CHANNELS ; i++)
 	{
 		if (channels[i].entnum == entnum && channels[i].entchannel == entchannel)
 		{
@@ -765,6 +848,61 @@ void S_UpdateAmbientSounds (void)
 }
 
 
+/*
+============
+SND_AllocateVoices
+
+Only the snd_maxvoices most important audible channels get mixed. The
+rest, and anything that can't be heard, go virtual: S_PaintChannels
+keeps their play position moving without touching their samples, so
+they pick up in the right place once they are important again.
+============
+*/
+static int SND_ComparePriority (const void *a, const void *b)
+{
+	return (*(channel_t **)b)->priority - (*(channel_t **)a)->priority;
+}
+
+void SND_AllocateVoices (void)
+{
+	channel_t	*audible[MAX_CHANNELS];
+	channel_t	*ch;
+	int			i, numaudible, maxvoices;
+
+	numaudible = 0;
+	snd_voices_virtual = 0;
+
+	for (i=0, ch=channels ; i<total_channels ; i++, ch++)
+	{
+		if (!ch->sfx)
+			continue;
+
+		ch->priority = SND_ChannelPriority(ch);
+		ch->isvirtual = true;
+
+		if (ch->priority)
+			audible[numaudible++] = ch;
+		else
+			snd_voices_virtual++;
+	}
+
+	maxvoices = snd_maxvoices.value;
+	if (maxvoices < 1)
+		maxvoices = 1;
+
+	if (numaudible > maxvoices)
+	{
+		qsort (audible, numaudible, sizeof(audible[0]), SND_ComparePriority);
+		snd_voices_virtual += numaudible - maxvoices;
+		numaudible = maxvoices;
+	}
+
+	for (i=0 ; i<numaudible ; i++)
+		audible[i]->isvirtual = false;
+
+	snd_voices_active = numaudible;
+}
+
 /*
 ============
 S_Update
@@ -779,7 +917,6 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 #endif
 
 	int			i, j;
-	int			total;
 	channel_t	*ch;
 	channel_t	*combine;
 
@@ -842,20 +979,13 @@ void S_Update(vec3_t origin, vec3_t forward, vec3_t right, vec3_t up)
 		}
 	}
 
+	SND_AllocateVoices ();
+
 // debugging output
 	if (snd_show.value)
-	{
-		total = 0;
-		ch = channels;
-		for (i=0 ; i<total_channels; i++, ch++)
-			if (ch->sfx && (ch->leftvol || ch->rightvol) )
-			{
-				//Con_Printf ("%3i %3i %s\n", ch->leftvol, ch->rightvol, ch->sfx->name);
-				total++;
-			}
+		Con_Printf ("----(%i active, %i virtual, %i stolen)----\n", snd_voices_active, snd_voices_virtual, snd_voices_stolen);
 
-		Con_Printf ("----(%i)----\n", total);
-	}
+	snd_voices_stolen = 0;
 
 // mix some sound
 	S_Update_();
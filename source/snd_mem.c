@@ -25,6 +25,36 @@ int			cache_full_cycle;
 
 byte *S_Alloc (int size);
 
+extern sfx_t	*known_sfx;
+extern int		num_sfx;
+
+cvar_t	snd_resamplecache = {"snd_resamplecache", "1", true};
+
+/*
+Sounds converted to the output rate and width are kept on disk under
+<gamedir>/sndcache so reloading an evicted sound is a single read instead
+of a resample. Each file remembers the CRC and size of the .wav it was
+made from, and is checked against it the first time the sound is loaded
+in a session. Files are written in native byte order; one made on a
+different platform fails the ident check and is rebuilt.
+*/
+#define SFXCACHE_IDENT		(('C'<<24)+('X'<<16)+('F'<<8)+'S')
+#define SFXCACHE_VERSION	1
+
+typedef struct
+{
+	int		ident;
+	int		version;
+	int		srccrc;
+	int		srcsize;
+	int		speed;
+	int		width;
+	int		length;
+	int		loopstart;
+} sfxcachefile_t;
+
+static qboolean	sfxcache_readonly;	// stop trying once a write has failed
+
 /*
 ================
 ResampleSfx
@@ -87,6 +117,279 @@ void ResampleSfx (sfx_t *sfx, int inrate, int inwidth, byte *data)
 	}
 }
 
+/*
+================
+S_ResampleSample
+
+Reads one source sample scaled to 16 bits.
+================
+*/
+static int S_ResampleSample (byte *data, int inwidth, int i)
+{
+	if (inwidth == 2)
+		return LittleShort (((short *)data)[i]);
+	return (int)((unsigned char)(data[i]) - 128) << 8;
+}
+
+/*
+================
+ResampleSfxLinear
+
+Slower, better sounding version of ResampleSfx, only used when building
+the disk cache. Upsampling interpolates between neighbouring samples,
+downsampling averages every source sample an output sample covers.
+================
+*/
+void ResampleSfxLinear (sfxcache_t *sc, int insamples, float stepscale, int inwidth, byte *data)
+{
+	int		i, j, first, last, sample, s0, s1;
+	double	pos, frac;
+
+	for (i=0 ; i<sc->length ; i++)
+	{
+		pos = i * (double)stepscale;
+		first = (int)pos;
+		if (first >= insamples)
+			first = insamples - 1;
+
+		if (stepscale <= 1)
+		{
+			frac = pos - first;
+			s0 = S_ResampleSample (data, inwidth, first);
+			s1 = S_ResampleSample (data, inwidth, first + 1 < insamples ? first + 1 : first);
+			sample = s0 + (int)((s1 - s0) * frac);
+		}
+		else
+		{
+			last = (int)(pos + stepscale);
+			if (last > insamples)
+				last = insamples;
+			if (last <= first)
+				last = first + 1;
+
+			sample = 0;
+			for (j=first ; j<last ; j++)
+				sample += S_ResampleSample (data, inwidth, j);
+			sample /= last - first;
+		}
+
+		if (sc->width == 2)
+			((short *)sc->data)[i] = sample;
+		else
+		{
+			sample = (sample + 128) >> 8;
+			((signed char *)sc->data)[i] = bound (-128, sample, 127);
+		}
+	}
+}
+
+/*
+================
+S_DiskCachePath
+
+Returns false when the path doesn't fit, and the sound isn't cached.
+================
+*/
+static qboolean S_DiskCachePath (sfx_t *s, char *path, int size)
+{
+	char	*c;
+	int		len;
+
+	len = snprintf (path, size, "%s/sndcache/%s%s.sfx%s", com_gamedir, FILE_SPECIAL_PREFIX, s->name, FILE_SPECIAL_SUFFIX);
+	if (len < 0 || len >= size)
+		return false;
+
+	// flatten the sound's own directories into the file name
+	for (c = path + strlen (com_gamedir) + 10 ; *c ; c++)
+	{
+		if (*c == '/' || *c == '\\')
+			*c = '_';
+	}
+
+	return true;
+}
+
+/*
+================
+S_ReadDiskCache
+
+Loads a converted sound straight into the cache. srcsize is -1 when the
+file has already been checked against its source this session.
+================
+*/
+static sfxcache_t *S_ReadDiskCache (sfx_t *s, int srccrc, int srcsize)
+{
+	char			path[MAX_OSPATH];
+	sfxcachefile_t	header;
+	sfxcache_t		*sc;
+	int				handle, len;
+
+	if (!S_DiskCachePath (s, path, sizeof(path)))
+		return NULL;
+	if (Sys_FileOpenRead (path, &handle) < 0)
+		return NULL;
+
+	sc = NULL;
+	if (Sys_FileRead (handle, &header, sizeof(header)) != sizeof(header)
+		|| header.ident != SFXCACHE_IDENT || header.version != SFXCACHE_VERSION
+		|| header.speed != shm->speed || header.length <= 0
+		|| (header.width != 1 && header.width != 2) || (loadas8bit.value && header.width != 1)
+		|| (srcsize != -1 && (header.srccrc != srccrc || header.srcsize != srcsize)))
+		goto done;
+
+	len = header.length * header.width;
+	sc = Cache_Alloc (&s->cache, len + sizeof(sfxcache_t), s->name);
+	if (!sc)
+		goto done;
+
+	if (Sys_FileRead (handle, sc->data, len) != len)
+	{
+		Cache_Free (&s->cache);
+		sc = NULL;
+		goto done;
+	}
+
+	sc->length = header.length;
+	sc->loopstart = header.loopstart;
+	sc->speed = header.speed;
+	sc->width = header.width;
+	sc->stereo = 0;
+
+done:
+	Sys_FileClose (handle);
+	return sc;
+}
+
+/*
+================
+S_WriteDiskCache
+
+Uses stdio instead of Sys_FileOpenWrite, which is fatal on some
+platforms when the file can't be made.
+================
+*/
+static qboolean S_WriteDiskCache (sfx_t *s, sfxcache_t *sc, int srccrc, int srcsize)
+{
+	char			path[MAX_OSPATH];
+	sfxcachefile_t	header;
+	FILE			*f;
+	int				len;
+	qboolean		ok;
+
+	if (sfxcache_readonly)
+		return false;
+
+	if (!S_DiskCachePath (s, path, sizeof(path)))
+		return false;
+
+	Sys_mkdir (va("%s/sndcache", com_gamedir));
+
+	f = fopen (path, "wb");
+	if (!f)
+	{
+		Con_Printf ("Couldn't write %s, sound disk cache disabled\n", path);
+		sfxcache_readonly = true;
+		return false;
+	}
+
+	header.ident = SFXCACHE_IDENT;
+	header.version = SFXCACHE_VERSION;
+	header.srccrc = srccrc;
+	header.srcsize = srcsize;
+	header.speed = sc->speed;
+	header.width = sc->width;
+	header.length = sc->length;
+	header.loopstart = sc->loopstart;
+
+	len = sc->length * sc->width;
+	ok = fwrite (&header, sizeof(header), 1, f) == 1
+		&& fwrite (sc->data, 1, len, f) == len;
+	if (fclose (f))
+		ok = false;
+
+	return ok;
+}
+
+/*
+================
+S_BuildDiskCache
+
+Uses the disk cache file if it was made from this exact .wav, otherwise
+converts the sound with the better resampler and writes a new one.
+================
+*/
+static sfxcache_t *S_BuildDiskCache (sfx_t *s, wavinfo_t *info, float stepscale, byte *data, int size)
+{
+	sfxcache_t	*sc;
+	int			crc, len, width;
+
+	crc = CRC_Block (data, size);
+
+	if ((sc = S_ReadDiskCache (s, crc, size)))
+	{
+		s->diskcached = true;
+		return sc;
+	}
+
+	width = loadas8bit.value ? 1 : info->width;
+	len = info->samples / stepscale;
+
+	sc = Cache_Alloc (&s->cache, len * width + sizeof(sfxcache_t), s->name);
+	if (!sc)
+		return NULL;
+
+	sc->length = len;
+	sc->loopstart = info->loopstart;
+	if (sc->loopstart != -1)
+		sc->loopstart = sc->loopstart / stepscale;
+	sc->speed = shm->speed;
+	sc->width = width;
+	sc->stereo = 0;
+
+	ResampleSfxLinear (sc, info->samples, stepscale, info->width, data + info->dataofs);
+
+	s->diskcached = S_WriteDiskCache (s, sc, crc, size);
+
+	return sc;
+}
+
+/*
+================
+S_BuildSoundCache_f
+
+Converts every sound that has been precached and writes its disk cache
+file, so a release can ship with the cache already built.
+================
+*/
+void S_BuildSoundCache_f (void)
+{
+	sfx_t	*sfx;
+	int		i, built;
+
+	if (!shm || !known_sfx)
+	{
+		Con_Printf ("sound system not started\n");
+		return;
+	}
+
+	built = 0;
+	for (sfx = known_sfx, i = 0 ; i < num_sfx ; i++, sfx++)
+	{
+		if (sfx->diskcached)
+		{
+			built++;
+			continue;
+		}
+		if (Cache_Check (&sfx->cache))
+			Cache_Free (&sfx->cache);
+
+		if (S_LoadSound (sfx) && sfx->diskcached)
+			built++;
+	}
+
+	Con_Printf ("%i of %i sounds in the disk cache\n", built, num_sfx);
+}
+
 //=============================================================================
 
 /*
@@ -108,6 +411,14 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	if ((sc = Cache_Check (&s->cache)))
 		return sc;
 
+// already converted and checked this session, just read it back
+	if (s->diskcached && snd_resamplecache.value)
+	{
+		if ((sc = S_ReadDiskCache (s, 0, -1)))
+			return sc;
+		s->diskcached = false;
+	}
+
 //Con_Printf ("S_LoadSound: %x\n", (int)stackbuf);
 // load it in
     Q_strcpy(namebuffer, "");
@@ -129,6 +440,11 @@ sfxcache_t *S_LoadSound (sfx_t *s)
 	}
 
 	stepscale = (float)info.rate / shm->speed;
+
+	// sounds already at the output rate are a plain copy, not worth a file
+	if (snd_resamplecache.value && info.rate != shm->speed)
+		return S_BuildDiskCache (s, &info, stepscale, data, com_filesize);
+
 	len = info.samples / stepscale;
 
 	len = len * info.width * info.channels;
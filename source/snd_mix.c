@@ -21,6 +21,13 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "nzportable_def.h"
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SND_NEON
+#endif
+
 #define DWORD	unsigned long
 
 #define	PAINTBUFFER_SIZE	512
@@ -29,31 +36,304 @@ int		snd_scaletable[32][256];
 int 	*snd_p, snd_linear_count, snd_vol;
 short	*snd_out;
 
+cvar_t	snd_simd = {"snd_simd", "1"};
+
 void Snd_WriteLinearBlastStereo16 (void);
 
-#if	!id386
-void Snd_WriteLinearBlastStereo16 (void)
+/*
+===============================================================================
+
+MIXING KERNELS
+
+The scalar kernels are the reference, the vector ones must produce the same
+bits. 8 bit data is scaled by (vol>>3)*8 just like snd_scaletable, which
+always fits in 16 bits, so it can be multiplied sixteen bits wide.
+
+===============================================================================
+*/
+
+typedef struct
 {
-	int	i, val;
+	char	*name;
+	void	(*paint8) (portable_samplepair_t *out, unsigned char *sfx, int leftvol, int rightvol, int count);
+	void	(*paint16) (portable_samplepair_t *out, signed short *sfx, int leftvol, int rightvol, int count);
+	void	(*clamp16) (short *out, int *in, int count, int vol);
+} snd_mixkernels_t;
 
-	for (i=0 ; i<snd_linear_count ; i+=2)
+static void SND_Paint8_Scalar (portable_samplepair_t *out, unsigned char *sfx, int leftvol, int rightvol, int count)
+{
+	int		i, data, *lscale, *rscale;
+
+	lscale = snd_scaletable[leftvol >> 3];
+	rscale = snd_scaletable[rightvol >> 3];
+
+	for (i=0 ; i<count ; i++)
 	{
-		val = (snd_p[i]*snd_vol)>>8;
-		if (val > 0x7fff)
-			snd_out[i] = 0x7fff;
-		else if (val < (short)0x8000)
-			snd_out[i] = (short)0x8000;
-		else
-			snd_out[i] = val;
+		data = sfx[i];
+		out[i].left += lscale[data];
+		out[i].right += rscale[data];
+	}
+}
+
+static void SND_Paint16_Scalar (portable_samplepair_t *out, signed short *sfx, int leftvol, int rightvol, int count)
+{
+	int		i, data;
+
+	for (i=0 ; i<count ; i++)
+	{
+		data = sfx[i];
+		out[i].left += (data * leftvol) >> 8;
+		out[i].right += (data * rightvol) >> 8;
+	}
+}
+
+static void SND_Clamp16_Scalar (short *out, int *in, int count, int vol)
+{
+	int		i, val;
 
-		val = (snd_p[i+1]*snd_vol)>>8;
+	for (i=0 ; i<count ; i++)
+	{
+		val = (in[i]*vol)>>8;
 		if (val > 0x7fff)
-			snd_out[i+1] = 0x7fff;
+			out[i] = 0x7fff;
 		else if (val < (short)0x8000)
-			snd_out[i+1] = (short)0x8000;
+			out[i] = (short)0x8000;
 		else
-			snd_out[i+1] = val;
+			out[i] = val;
+	}
+}
+
+static snd_mixkernels_t snd_scalarkernels =
+{
+	"scalar", SND_Paint8_Scalar, SND_Paint16_Scalar, SND_Clamp16_Scalar
+};
+
+#if defined(__SSE2__)
+
+// adds 8 left and 8 right 32 bit values, as two 4 lane halves each, to
+// 8 interleaved paintbuffer pairs
+static inline void SND_Accumulate_SSE2 (portable_samplepair_t *out, __m128i l_lo, __m128i l_hi, __m128i r_lo, __m128i r_hi)
+{
+	__m128i	*p = (__m128i *)out;
+
+	_mm_storeu_si128 (p + 0, _mm_add_epi32 (_mm_loadu_si128 (p + 0), _mm_unpacklo_epi32 (l_lo, r_lo)));
+	_mm_storeu_si128 (p + 1, _mm_add_epi32 (_mm_loadu_si128 (p + 1), _mm_unpackhi_epi32 (l_lo, r_lo)));
+	_mm_storeu_si128 (p + 2, _mm_add_epi32 (_mm_loadu_si128 (p + 2), _mm_unpacklo_epi32 (l_hi, r_hi)));
+	_mm_storeu_si128 (p + 3, _mm_add_epi32 (_mm_loadu_si128 (p + 3), _mm_unpackhi_epi32 (l_hi, r_hi)));
+}
+
+static void SND_Paint8_SSE2 (portable_samplepair_t *out, unsigned char *sfx, int leftvol, int rightvol, int count)
+{
+	__m128i	lscale, rscale, data, l, r;
+	int		i;
+
+	lscale = _mm_set1_epi16 ((leftvol >> 3) * 8);
+	rscale = _mm_set1_epi16 ((rightvol >> 3) * 8);
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		data = _mm_loadl_epi64 ((__m128i *)(sfx + i));
+		data = _mm_srai_epi16 (_mm_unpacklo_epi8 (data, data), 8);	// sign extend
+
+		l = _mm_mullo_epi16 (data, lscale);
+		r = _mm_mullo_epi16 (data, rscale);
+
+		SND_Accumulate_SSE2 (out + i,
+			_mm_srai_epi32 (_mm_unpacklo_epi16 (l, l), 16), _mm_srai_epi32 (_mm_unpackhi_epi16 (l, l), 16),
+			_mm_srai_epi32 (_mm_unpacklo_epi16 (r, r), 16), _mm_srai_epi32 (_mm_unpackhi_epi16 (r, r), 16));
+	}
+
+	if (i < count)
+		SND_Paint8_Scalar (out + i, sfx + i, leftvol, rightvol, count - i);
+}
+
+static void SND_Paint16_SSE2 (portable_samplepair_t *out, signed short *sfx, int leftvol, int rightvol, int count)
+{
+	__m128i	lvol, rvol, data, lo, hi;
+	__m128i	l_lo, l_hi, r_lo, r_hi;
+	int		i;
+
+	// combined static channels can go past what a 16 bit multiply holds
+	if (leftvol > 0x7fff || rightvol > 0x7fff)
+	{
+		SND_Paint16_Scalar (out, sfx, leftvol, rightvol, count);
+		return;
+	}
+
+	lvol = _mm_set1_epi16 (leftvol);
+	rvol = _mm_set1_epi16 (rightvol);
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		data = _mm_loadu_si128 ((__m128i *)(sfx + i));
+
+		lo = _mm_mullo_epi16 (data, lvol);
+		hi = _mm_mulhi_epi16 (data, lvol);
+		l_lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (lo, hi), 8);
+		l_hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (lo, hi), 8);
+
+		lo = _mm_mullo_epi16 (data, rvol);
+		hi = _mm_mulhi_epi16 (data, rvol);
+		r_lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (lo, hi), 8);
+		r_hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (lo, hi), 8);
+
+		SND_Accumulate_SSE2 (out + i, l_lo, l_hi, r_lo, r_hi);
+	}
+
+	if (i < count)
+		SND_Paint16_Scalar (out + i, sfx + i, leftvol, rightvol, count - i);
+}
+
+// low 32 bits of a 32x32 multiply, SSE2 only has the 64 bit result form
+static inline __m128i SND_MulLo32_SSE2 (__m128i a, __m128i b)
+{
+	__m128i	even, odd;
+
+	even = _mm_mul_epu32 (a, b);
+	odd = _mm_mul_epu32 (_mm_srli_epi64 (a, 32), _mm_srli_epi64 (b, 32));
+
+	return _mm_unpacklo_epi32 (_mm_shuffle_epi32 (even, _MM_SHUFFLE (0, 0, 2, 0)), _mm_shuffle_epi32 (odd, _MM_SHUFFLE (0, 0, 2, 0)));
+}
+
+static void SND_Clamp16_SSE2 (short *out, int *in, int count, int vol)
+{
+	__m128i	v, a, b;
+	int		i;
+
+	v = _mm_set1_epi32 (vol);
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		a = _mm_srai_epi32 (SND_MulLo32_SSE2 (_mm_loadu_si128 ((__m128i *)(in + i)), v), 8);
+		b = _mm_srai_epi32 (SND_MulLo32_SSE2 (_mm_loadu_si128 ((__m128i *)(in + i + 4)), v), 8);
+		_mm_storeu_si128 ((__m128i *)(out + i), _mm_packs_epi32 (a, b));	// saturates like the clamp
+	}
+
+	if (i < count)
+		SND_Clamp16_Scalar (out + i, in + i, count - i, vol);
+}
+
+static snd_mixkernels_t snd_simdkernels =
+{
+	"sse2", SND_Paint8_SSE2, SND_Paint16_SSE2, SND_Clamp16_SSE2
+};
+#define SND_HAVE_SIMD
+
+#elif defined(SND_NEON)
+
+static inline void SND_Accumulate_NEON (portable_samplepair_t *out, int32x4_t l, int32x4_t r)
+{
+	int32x4x2_t	pair;
+
+	pair = vld2q_s32 ((int32_t *)out);
+	pair.val[0] = vaddq_s32 (pair.val[0], l);
+	pair.val[1] = vaddq_s32 (pair.val[1], r);
+	vst2q_s32 ((int32_t *)out, pair);
+}
+
+static void SND_Paint8_NEON (portable_samplepair_t *out, unsigned char *sfx, int leftvol, int rightvol, int count)
+{
+	int16x8_t	data, l, r;
+	int16_t		lscale, rscale;
+	int			i;
+
+	lscale = (leftvol >> 3) * 8;
+	rscale = (rightvol >> 3) * 8;
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		data = vmovl_s8 (vld1_s8 ((int8_t *)(sfx + i)));
+
+		l = vmulq_n_s16 (data, lscale);
+		r = vmulq_n_s16 (data, rscale);
+
+		SND_Accumulate_NEON (out + i, vmovl_s16 (vget_low_s16 (l)), vmovl_s16 (vget_low_s16 (r)));
+		SND_Accumulate_NEON (out + i + 4, vmovl_s16 (vget_high_s16 (l)), vmovl_s16 (vget_high_s16 (r)));
+	}
+
+	if (i < count)
+		SND_Paint8_Scalar (out + i, sfx + i, leftvol, rightvol, count - i);
+}
+
+static void SND_Paint16_NEON (portable_samplepair_t *out, signed short *sfx, int leftvol, int rightvol, int count)
+{
+	int16x8_t	data;
+	int			i;
+
+	// combined static channels can go past what a 16 bit multiply holds
+	if (leftvol > 0x7fff || rightvol > 0x7fff)
+	{
+		SND_Paint16_Scalar (out, sfx, leftvol, rightvol, count);
+		return;
+	}
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		data = vld1q_s16 ((int16_t *)(sfx + i));
+
+		SND_Accumulate_NEON (out + i,
+			vshrq_n_s32 (vmull_n_s16 (vget_low_s16 (data), leftvol), 8),
+			vshrq_n_s32 (vmull_n_s16 (vget_low_s16 (data), rightvol), 8));
+		SND_Accumulate_NEON (out + i + 4,
+			vshrq_n_s32 (vmull_n_s16 (vget_high_s16 (data), leftvol), 8),
+			vshrq_n_s32 (vmull_n_s16 (vget_high_s16 (data), rightvol), 8));
+	}
+
+	if (i < count)
+		SND_Paint16_Scalar (out + i, sfx + i, leftvol, rightvol, count - i);
+}
+
+static void SND_Clamp16_NEON (short *out, int *in, int count, int vol)
+{
+	int32x4_t	a, b;
+	int			i;
+
+	for (i=0 ; i+8<=count ; i+=8)
+	{
+		a = vshrq_n_s32 (vmulq_n_s32 (vld1q_s32 ((int32_t *)(in + i)), vol), 8);
+		b = vshrq_n_s32 (vmulq_n_s32 (vld1q_s32 ((int32_t *)(in + i + 4)), vol), 8);
+		vst1q_s16 ((int16_t *)(out + i), vcombine_s16 (vqmovn_s32 (a), vqmovn_s32 (b)));	// saturates like the clamp
+	}
+
+	if (i < count)
+		SND_Clamp16_Scalar (out + i, in + i, count - i, vol);
+}
+
+static snd_mixkernels_t snd_simdkernels =
+{
+	"neon", SND_Paint8_NEON, SND_Paint16_NEON, SND_Clamp16_NEON
+};
+#define SND_HAVE_SIMD
+
+#endif
+
+static snd_mixkernels_t	*snd_kernels = &snd_scalarkernels;
+
+/*
+================
+SND_SelectKernels
+
+Picked again before every paint, so snd_simd can be flipped while
+sounds are playing.
+================
+*/
+static void SND_SelectKernels (void)
+{
+#ifdef SND_HAVE_SIMD
+	if (snd_simd.value)
+	{
+		snd_kernels = &snd_simdkernels;
+		return;
 	}
+#endif // SND_HAVE_SIMD
+
+	snd_kernels = &snd_scalarkernels;
+}
+
+#if	!id386
+void Snd_WriteLinearBlastStereo16 (void)
+{
+	snd_kernels->clamp16 (snd_out, snd_p, snd_linear_count, snd_vol);
 }
 #endif
 
@@ -160,12 +440,59 @@ CHANNEL MIXING
 void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int endtime);
 void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int endtime);
 
+/*
+================
+SND_AdvanceChannel
+
+Moves a virtual channel along as if it had been mixed up to end. The
+sound data is only needed when it reaches its end and might loop.
+================
+*/
+void SND_AdvanceChannel (channel_t *ch, int end)
+{
+	int			ltime, count;
+	sfxcache_t	*sc;
+
+	ltime = paintedtime;
+
+	while (ltime < end)
+	{
+		if (ch->end < end)
+			count = ch->end - ltime;
+		else
+			count = end - ltime;
+
+		if (count > 0)
+		{
+			ch->pos += count;
+			ltime += count;
+		}
+
+		if (ltime >= ch->end)
+		{
+			sc = S_LoadSound (ch->sfx);
+			if (sc && sc->loopstart >= 0)
+			{
+				ch->pos = sc->loopstart;
+				ch->end = ltime + sc->length - ch->pos;
+			}
+			else
+			{	// channel just stopped
+				ch->sfx = NULL;
+				break;
+			}
+		}
+	}
+}
+
 void S_PaintChannels(int endtime)
 {
 	int		i, end, ltime, count;
 	channel_t *ch;
 	sfxcache_t	*sc;
 
+	SND_SelectKernels ();
+
 	while (paintedtime < endtime)
 	{
 	// if paintbuffer is smaller than DMA buffer
@@ -182,8 +509,11 @@ void S_PaintChannels(int endtime)
 		{
 			if (!ch->sfx)
 				continue;
-			if (!ch->leftvol && !ch->rightvol)
+			if (ch->isvirtual || (!ch->leftvol && !ch->rightvol))
+			{
+				SND_AdvanceChannel (ch, end);
 				continue;
+			}
 			if (!(sc = S_LoadSound (ch->sfx)))
 				continue;
 
@@ -244,24 +574,12 @@ void SND_InitScaletable (void)
 
 void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int 		i, data, *lscale, *rscale;
-	unsigned char *sfx;
-
 	if (ch->leftvol > 255)
 		ch->leftvol = 255;
 	if (ch->rightvol > 255)
 		ch->rightvol = 255;
 
-	lscale = snd_scaletable[ch->leftvol >> 3];
-	rscale = snd_scaletable[ch->rightvol >> 3];
-	sfx = (unsigned char *)sc->data + ch->pos;
-
-	for (i=0 ; i<count ; i++)
-	{
-		data = sfx[i];
-		paintbuffer[i].left += lscale[data];
-		paintbuffer[i].right += rscale[data];
-	}
+	snd_kernels->paint8 (paintbuffer, (unsigned char *)sc->data + ch->pos, ch->leftvol, ch->rightvol, count);
 
 	ch->pos += count;
 }
@@ -271,23 +589,137 @@ void SND_PaintChannelFrom8 (channel_t *ch, sfxcache_t *sc, int count)
 
 void SND_PaintChannelFrom16 (channel_t *ch, sfxcache_t *sc, int count)
 {
-	int data, left, right, leftvol, rightvol;
-	signed short *sfx;
-	int	i;
+	snd_kernels->paint16 (paintbuffer, (signed short *)sc->data + ch->pos, ch->leftvol, ch->rightvol, count);
 
-	leftvol = ch->leftvol;
-	rightvol = ch->rightvol;
-	sfx = (signed short *)sc->data + ch->pos;
+	ch->pos += count;
+}
 
-	for (i=0 ; i<count ; i++)
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+#define SND_BENCH_SAMPLES	(PAINTBUFFER_SIZE * 4)
+
+/*
+================
+SND_BenchMix
+
+Mixes the fixed channel set from SND_Bench_f into a paint buffer and
+clamps it to 16 bit output, the same work S_PaintChannels does for one
+full paintbuffer.
+================
+*/
+static void SND_BenchMix (snd_mixkernels_t *k, int numchannels, byte *sfx8, short *sfx16,
+	portable_samplepair_t *paint, short *out)
+{
+	int		i, pos, leftvol, rightvol;
+
+	memset (paint, 0, PAINTBUFFER_SIZE * sizeof(portable_samplepair_t));
+
+	for (i=0 ; i<numchannels ; i++)
 	{
-		data = sfx[i];
-		left = (data * leftvol) >> 8;
-		right = (data * rightvol) >> 8;
-		paintbuffer[i].left += left;
-		paintbuffer[i].right += right;
+		pos = (i * 397) % (SND_BENCH_SAMPLES - PAINTBUFFER_SIZE);
+		leftvol = (i * 53 + 17) & 255;
+		rightvol = (i * 97 + 101) & 255;
+
+		if (i & 3)
+			k->paint8 (paint, sfx8 + pos, leftvol, rightvol, PAINTBUFFER_SIZE - (i & 7));
+		else
+		{
+			// every so often a combined static channel, louder than 255
+			if (!(i & 15))
+				leftvol += 255 * (i >> 4);
+			k->paint16 (paint, sfx16 + pos, leftvol, rightvol, PAINTBUFFER_SIZE - (i & 7));
+		}
 	}
 
-	ch->pos += count;
+	k->clamp16 (out, (int *)paint, PAINTBUFFER_SIZE * 2, 179);
 }
 
+/*
+================
+SND_Bench_f
+
+snd_bench [channels] [passes]
+
+Mixes a fixed set of channels offline with the scalar kernels and the
+vector ones, prints the time per paintbuffer and checks both produced
+exactly the same output. Doesn't touch the sound device or channels[].
+================
+*/
+void SND_Bench_f (void)
+{
+	byte					*sfx8;
+	short					*sfx16, *out[2];
+	portable_samplepair_t	*paint[2];
+	snd_mixkernels_t		*kernels[2];
+	double					start, time[2];
+	unsigned int			seed;
+	int						i, k, numkernels, numchannels, passes, mark;
+
+	numchannels = MAX_CHANNELS;
+	passes = 200;
+	if (Cmd_Argc () > 1)
+		numchannels = bound (1, Q_atoi (Cmd_Argv (1)), 1024);
+	if (Cmd_Argc () > 2)
+		passes = bound (1, Q_atoi (Cmd_Argv (2)), 100000);
+
+	mark = Hunk_LowMark ();
+	sfx8 = Hunk_AllocName (SND_BENCH_SAMPLES, "sndbench");
+	sfx16 = Hunk_AllocName (SND_BENCH_SAMPLES * sizeof(short), "sndbench");
+	for (k=0 ; k<2 ; k++)
+	{
+		paint[k] = Hunk_AllocName (PAINTBUFFER_SIZE * sizeof(portable_samplepair_t), "sndbench");
+		out[k] = Hunk_AllocName (PAINTBUFFER_SIZE * 2 * sizeof(short), "sndbench");
+	}
+
+	// same noise every run so numbers compare between builds
+	seed = 0x12345678;
+	for (i=0 ; i<SND_BENCH_SAMPLES ; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		sfx8[i] = seed >> 24;
+		sfx16[i] = seed >> 16;
+	}
+
+	kernels[0] = &snd_scalarkernels;
+	numkernels = 1;
+#ifdef SND_HAVE_SIMD
+	kernels[1] = &snd_simdkernels;
+	numkernels = 2;
+#endif // SND_HAVE_SIMD
+
+	Con_Printf ("snd_bench: %i channels, %i passes\n", numchannels, passes);
+
+	for (k=0 ; k<numkernels ; k++)
+	{
+		start = Sys_FloatTime ();
+		for (i=0 ; i<passes ; i++)
+			SND_BenchMix (kernels[k], numchannels, sfx8, sfx16, paint[k], out[k]);
+		time[k] = (Sys_FloatTime () - start) * 1000.0 / passes;
+
+		Con_Printf ("%8s: %.3f ms per %i samples", kernels[k]->name, time[k], PAINTBUFFER_SIZE);
+		if (k && time[k] > 0)
+			Con_Printf (" (%.2fx)", time[0] / time[k]);
+		Con_Printf ("\n");
+	}
+
+	if (numkernels == 1)
+		Con_Printf ("no vector kernels in this build\n");
+	else if (memcmp (paint[0], paint[1], PAINTBUFFER_SIZE * sizeof(portable_samplepair_t))
+		|| memcmp (out[0], out[1], PAINTBUFFER_SIZE * 2 * sizeof(short)))
+	{
+		for (i=0 ; i<PAINTBUFFER_SIZE * 2 ; i++)
+			if (((int *)paint[0])[i] != ((int *)paint[1])[i] || out[0][i] != out[1][i])
+				break;
+		Con_Printf ("MISMATCH: %s output differs from scalar at sample %i\n", kernels[1]->name, i);
+	}
+	else
+		Con_Printf ("%s output is bit-identical to scalar\n", kernels[1]->name);
+
+	Hunk_FreeToLowMark (mark);
+}
@@ -35,6 +35,7 @@ typedef struct sfx_s
 {
 	char 	name[MAX_QPATH];
 	cache_user_t	cache;
+	qboolean	diskcached;		// converted copy on disk matches the source
 } sfx_t;
 
 typedef struct
@@ -74,6 +75,8 @@ typedef struct
 	vec3_t	origin;			// origin of sound effect
 	vec_t	dist_mult;		// distance multiplier (attenuation/clipK)
 	int		master_vol;		// 0-255 master volume
+	int		priority;		// audibility score, see SND_ChannelPriority
+	qboolean	isvirtual;	// still playing, but not mixed this frame
 } channel_t;
 
 typedef struct
@@ -106,7 +109,10 @@ void S_PaintChannels(int endtime);
 void S_InitPaintChannels (void);
 
 // picks a channel based on priorities, empty slots, number of channels
-channel_t *SND_PickChannel(int entnum, int entchannel);
+channel_t *SND_PickChannel(int entnum, int entchannel, int priority);
+
+// scores how much a spatialized channel matters to the listener
+int SND_ChannelPriority(channel_t *ch);
 
 // spatializes a channel
 void SND_Spatialize(channel_t *ch);
@@ -125,7 +131,7 @@ void SNDDMA_Shutdown(void);
 // ====================================================================
 
 #define	MAX_CHANNELS			128
-#define	MAX_DYNAMIC_CHANNELS	8
+#define	MAX_DYNAMIC_CHANNELS	32
 
 #define	MAX_SFX		512
 
@@ -137,6 +143,11 @@ extern	channel_t   channels[MAX_CHANNELS];
 
 extern	int			total_channels;
 
+// voice counts from the last S_Update, shown with snd_show
+extern	int			snd_voices_active;
+extern	int			snd_voices_virtual;
+extern	int			snd_voices_stolen;
+
 //
 // Fake dma is a synchronous faking of the DMA progress used for
 // isolating performance in the renderer.  The fakedma_updates is
@@ -158,6 +169,9 @@ extern	cvar_t loadas8bit;
 extern	cvar_t bgmvolume;
 extern	cvar_t bgmtype; 
 extern	cvar_t volume;
+extern	cvar_t snd_simd;
+extern	cvar_t snd_maxvoices;
+extern	cvar_t snd_resamplecache;
 
 extern qboolean	snd_initialized;
 
@@ -169,6 +183,8 @@ sfxcache_t *S_LoadSound (sfx_t *s);
 wavinfo_t GetWavinfo (char *name, byte *wav, int wavlength);
 
 void SND_InitScaletable (void);
+void SND_Bench_f (void);
+void S_BuildSoundCache_f (void);
 void SNDDMA_Submit(void);
 
 void S_AmbientOff (void);
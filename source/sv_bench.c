@@ -0,0 +1,517 @@
+/*
+Copyright (C) 1996-1997 Id Software, Inc.
+Copyright (C) 2025 NZ:P Team
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+*/
+// sv_bench.c -- deterministic server tick benchmark
+//
+// Synthetic players are connected over loopback sockets and fed clc_move
+// messages, so their input goes through SV_ReadClientMessage exactly like a
+// real client's. Host_ServerFrame is then run back to back at a fixed
+// frametime and the final edict state is checksummed, so two builds can be
+// compared on the same map and input.
+
+#include "nzportable_def.h"
+
+// angles, forward/side/up, buttons, impulse as they follow the time in clc_move
+#define	SV_BENCH_MOVESIZE		(3*4 + 3*2 + 4 + 1)
+#define	SV_BENCH_SYNTHMOVES		1024
+#define	SV_BENCH_SIGNONTICKS	3
+#define	SV_BENCH_IDENT			(('1'<<24)+('B'<<16)+('V'<<8)+'S')	// "SVB1"
+
+qboolean	sv_benchtiming;
+double		sv_benchphase[SV_BENCH_PHASES];
+
+static int	sv_benchrecordfile = -1;
+static int	sv_benchrecorded;
+
+typedef struct
+{
+	qsocket_t	*sock;		// server end, owned by net_main
+	qsocket_t	*sink;		// client end, drained after every tick
+} benchplayer_t;
+
+/*
+===============================================================================
+
+INPUT RECORDING
+
+===============================================================================
+*/
+
+/*
+==================
+SV_BenchRecordMove
+
+Called from SV_ReadClientMove for the first client while recording
+==================
+*/
+void SV_BenchRecordMove (vec3_t angles, usercmd_t *move, int buttons, int impulse)
+{
+	byte		data[SV_BENCH_MOVESIZE];
+	sizebuf_t	buf;
+	int			i;
+
+	if (sv_benchrecordfile < 0)
+		return;
+
+	memset (&buf, 0, sizeof(buf));
+	buf.data = data;
+	buf.maxsize = sizeof(data);
+
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteFloat (&buf, angles[i]);
+	MSG_WriteShort (&buf, move->forwardmove);
+	MSG_WriteShort (&buf, move->sidemove);
+	MSG_WriteShort (&buf, move->upmove);
+	MSG_WriteLong (&buf, buttons);
+	MSG_WriteByte (&buf, impulse);
+
+	Sys_FileWrite (sv_benchrecordfile, buf.data, buf.cursize);
+	sv_benchrecorded++;
+}
+
+/*
+==================
+SV_BenchRecord_f
+
+sv_benchrecord <name> : records the first client's moves for sv_bench
+sv_benchrecord        : stops recording
+==================
+*/
+void SV_BenchRecord_f (void)
+{
+	char	name[MAX_OSPATH];
+	int		ident;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (sv_benchrecordfile >= 0)
+	{
+		Sys_FileClose (sv_benchrecordfile);
+		sv_benchrecordfile = -1;
+		Con_Printf ("sv_benchrecord: %i moves recorded\n", sv_benchrecorded);
+		if (Cmd_Argc () == 1)
+			return;
+	}
+
+	if (Cmd_Argc () != 2)
+	{
+		Con_Printf ("sv_benchrecord <name> : record client moves for sv_bench\n");
+		return;
+	}
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+	snprintf (name, sizeof(name), "%s/%s", com_gamedir, Cmd_Argv (1));
+#pragma GCC diagnostic pop
+	COM_DefaultExtension (name, ".svb");
+
+	sv_benchrecordfile = Sys_FileOpenWrite (name);
+	if (sv_benchrecordfile < 0)
+	{
+		Con_Printf ("ERROR: couldn't open %s for writing.\n", name);
+		return;
+	}
+
+	ident = LittleLong (SV_BENCH_IDENT);
+	Sys_FileWrite (sv_benchrecordfile, &ident, 4);
+	sv_benchrecorded = 0;
+
+	Con_Printf ("recording moves to %s.\n", name);
+}
+
+/*
+==================
+SV_BenchLoadMoves
+
+Returns the number of moves in the recording, or 0 if it can't be used
+==================
+*/
+static int SV_BenchLoadMoves (char *filename, byte **moves)
+{
+	char	name[MAX_OSPATH];
+	int		handle, length, ident, nummoves;
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-truncation"
+	snprintf (name, sizeof(name), "%s/%s", com_gamedir, filename);
+#pragma GCC diagnostic pop
+	COM_DefaultExtension (name, ".svb");
+
+	length = Sys_FileOpenRead (name, &handle);
+	if (handle < 0)
+	{
+		Con_Printf ("sv_bench: couldn't open %s\n", name);
+		return 0;
+	}
+
+	ident = 0;
+	Sys_FileRead (handle, &ident, 4);
+	nummoves = (length - 4) / SV_BENCH_MOVESIZE;
+	if (LittleLong (ident) != SV_BENCH_IDENT || nummoves <= 0)
+	{
+		Con_Printf ("sv_bench: %s is not a move recording\n", name);
+		Sys_FileClose (handle);
+		return 0;
+	}
+
+	*moves = Hunk_AllocName (nummoves * SV_BENCH_MOVESIZE, "benchmoves");
+	Sys_FileRead (handle, *moves, nummoves * SV_BENCH_MOVESIZE);
+	Sys_FileClose (handle);
+
+	return nummoves;
+}
+
+/*
+==================
+SV_BenchSynthMoves
+
+Without a recording the players run, strafe, turn and jump in a fixed
+pseudo random pattern
+==================
+*/
+static int SV_BenchSynthMoves (byte **moves)
+{
+	sizebuf_t		buf;
+	unsigned int	seed;
+	float			yaw, pitch;
+	int				i, buttons;
+
+	memset (&buf, 0, sizeof(buf));
+	buf.maxsize = SV_BENCH_SYNTHMOVES * SV_BENCH_MOVESIZE;
+	buf.data = *moves = Hunk_AllocName (buf.maxsize, "benchmoves");
+
+	seed = 0x1d872b41;
+	yaw = pitch = 0;
+	for (i=0 ; i<SV_BENCH_SYNTHMOVES ; i++)
+	{
+		seed = seed * 1103515245 + 12345;
+		yaw = anglemod (yaw + (int)((seed >> 16) % 21) - 10);
+		pitch = bound (-30, pitch + (int)((seed >> 8) % 5) - 2, 30);
+
+		buttons = 0;
+		if (!(i % 48))
+			buttons |= 2;					// jump
+		if ((seed >> 24) < 32)
+			buttons |= 1;					// fire
+
+		MSG_WriteFloat (&buf, pitch);
+		MSG_WriteFloat (&buf, yaw);
+		MSG_WriteFloat (&buf, 0);
+		MSG_WriteShort (&buf, (i & 255) < 224 ? 200 : -200);
+		MSG_WriteShort (&buf, ((i >> 5) & 1) ? 150 : -150);
+		MSG_WriteShort (&buf, 0);
+		MSG_WriteLong (&buf, buttons);
+		MSG_WriteByte (&buf, 0);
+	}
+
+	return SV_BENCH_SYNTHMOVES;
+}
+
+/*
+===============================================================================
+
+BENCHMARK
+
+===============================================================================
+*/
+
+/*
+==================
+SV_BenchSend
+
+Queues a message from the player's end of the loopback pair, so the server
+reads it in SV_RunClients
+==================
+*/
+static void SV_BenchSend (benchplayer_t *p, sizebuf_t *msg, qboolean reliable)
+{
+	if (reliable)
+		NET_SendMessage (p->sink, msg);
+	else
+		NET_SendUnreliableMessage (p->sink, msg);
+}
+
+/*
+==================
+SV_BenchDrain
+
+Throws away everything the server sent the player and returns its size
+==================
+*/
+static int SV_BenchDrain (benchplayer_t *p)
+{
+	int		bytes;
+
+	bytes = 0;
+	while (NET_GetMessage (p->sink) > 0)
+		bytes += net_message.cursize;
+	SZ_Clear (&net_message);
+
+	return bytes;
+}
+
+/*
+==================
+SV_BenchChecksum
+
+CRC of every edict's free flag and fields
+==================
+*/
+static unsigned short SV_BenchChecksum (void)
+{
+	unsigned short	crc;
+	edict_t			*ent;
+	byte			*v;
+	int				e, i;
+
+	CRC_Init (&crc);
+	for (e=0 ; e<sv.num_edicts ; e++)
+	{
+		ent = EDICT_NUM(e);
+		CRC_ProcessByte (&crc, ent->free);
+		if (ent->free)
+			continue;
+
+		v = (byte *)&ent->v;
+		for (i=0 ; i<progs->entityfields*4 ; i++)
+			CRC_ProcessByte (&crc, v[i]);
+	}
+
+	return CRC_Value (crc);
+}
+
+static int SV_BenchStatements (void)
+{
+	int		i, count;
+
+	count = 0;
+	for (i=0 ; i<progs->numfunctions ; i++)
+		count += pr_functions[i].profile;
+
+	return count;
+}
+
+/*
+==================
+SV_Bench_f
+
+sv_bench <map> [players] [ticks] [recording]
+
+Spawns the map, connects synthetic players and runs the server as fast as
+it will go at sys_ticrate. The random seed, frametime and input are fixed,
+so the checksum only changes when the simulation does.
+==================
+*/
+void SV_Bench_f (void)
+{
+	benchplayer_t	*players;
+	byte			*moves, msgdata[64];
+	sizebuf_t		msg;
+	char			mapname[MAX_QPATH], input[MAX_QPATH];
+	double			start, total, saverealtime;
+	keydest_t		savekeydest;
+	int				numplayers, numticks, nummoves, saveclients;
+	int				i, tick, loopdriver, statements, bytes;
+
+	if (cmd_source != src_command)
+		return;
+
+	if (Cmd_Argc () < 2)
+	{
+		Con_Printf ("sv_bench <map> [players] [ticks] [recording]\n");
+		return;
+	}
+
+	numplayers = 4;
+	numticks = 2000;
+	if (Cmd_Argc () > 2)
+		numplayers = Q_atoi (Cmd_Argv (2));
+	if (Cmd_Argc () > 3)
+		numticks = bound (1, Q_atoi (Cmd_Argv (3)), 10000000);
+	if (numplayers < 1 || numplayers > svs.maxclientslimit)
+	{
+		Con_Printf ("sv_bench: players must be between 1 and %i\n", svs.maxclientslimit);
+		return;
+	}
+
+	for (loopdriver=0 ; loopdriver<net_numdrivers ; loopdriver++)
+		if (!strcmp (net_drivers[loopdriver].name, "Loopback"))
+			break;
+	if (loopdriver == net_numdrivers)
+	{
+		Con_Printf ("sv_bench: no loopback driver\n");
+		return;
+	}
+
+	// the player's string commands retokenize, keep the arguments
+	Q_strncpyz (mapname, Cmd_Argv (1), sizeof(mapname));
+	Q_strncpyz (input, Cmd_Argc () > 4 ? Cmd_Argv (4) : "", sizeof(input));
+
+	CL_Disconnect ();
+	Host_ShutdownServer (false);
+
+	saveclients = svs.maxclients;
+	saverealtime = realtime;
+	savekeydest = key_dest;
+
+	// single player servers pause with the console up
+	key_dest = key_game;
+	svs.maxclients = numplayers;
+	svs.serverflags = 0;
+
+	srand (0);
+	SV_SpawnServer (mapname);
+	if (!sv.active)
+	{
+		svs.maxclients = saveclients;
+		key_dest = savekeydest;
+		return;
+	}
+
+	if (input[0])
+		nummoves = SV_BenchLoadMoves (input, &moves);
+	else
+		nummoves = SV_BenchSynthMoves (&moves);
+
+	players = Hunk_AllocName (numplayers * sizeof(benchplayer_t), "benchplayers");
+	for (i=0 ; i<numplayers && nummoves ; i++)
+	{
+		players[i].sock = NET_NewQSocket ();
+		if (!players[i].sock)
+		{
+			Con_Printf ("sv_bench: no qsocket available\n");
+			nummoves = 0;
+			break;
+		}
+		players[i].sink = Hunk_AllocName (sizeof(qsocket_t), "benchsink");
+
+		players[i].sock->driver = players[i].sink->driver = loopdriver;
+		players[i].sock->driverdata = players[i].sink;
+		players[i].sink->driverdata = players[i].sock;
+		players[i].sink->canSend = true;
+		sprintf (players[i].sock->address, "bench%i", i);
+
+		svs.clients[i].netconnection = players[i].sock;
+		SV_ConnectClient (i);
+		net_activeconnections++;
+	}
+
+	memset (&msg, 0, sizeof(msg));
+	msg.data = msgdata;
+	msg.maxsize = sizeof(msgdata);
+
+	host_frametime = sys_ticrate.value;
+	if (host_frametime <= 0)
+		host_frametime = 0.05;
+
+	start = 0;
+	statements = bytes = 0;
+	for (tick=-SV_BENCH_SIGNONTICKS ; tick<numticks && nummoves ; tick++)
+	{
+		// the signon goes one stage per tick like a real client
+		if (tick < 0)
+		{
+			for (i=0 ; i<numplayers ; i++)
+			{
+				SZ_Clear (&msg);
+				MSG_WriteByte (&msg, clc_stringcmd);
+				if (tick == -SV_BENCH_SIGNONTICKS)
+				{
+					MSG_WriteString (&msg, va("name bench%i", i));
+					MSG_WriteByte (&msg, clc_stringcmd);
+					MSG_WriteString (&msg, "prespawn");
+				}
+				else if (tick == -SV_BENCH_SIGNONTICKS + 1)
+					MSG_WriteString (&msg, "spawn");
+				else
+					MSG_WriteString (&msg, "begin");
+				SV_BenchSend (&players[i], &msg, true);
+			}
+		}
+		else
+		{
+			if (!tick)
+			{
+				memset (sv_benchphase, 0, sizeof(sv_benchphase));
+				statements = SV_BenchStatements ();
+				bytes = 0;
+				sv_benchtiming = true;
+				start = Sys_FloatTime ();
+			}
+
+			// players walk the same path at different offsets
+			for (i=0 ; i<numplayers ; i++)
+			{
+				SZ_Clear (&msg);
+				MSG_WriteByte (&msg, clc_move);
+				MSG_WriteFloat (&msg, sv.time);
+				SZ_Write (&msg, moves + ((tick + i * 97) % nummoves) * SV_BENCH_MOVESIZE, SV_BENCH_MOVESIZE);
+				SV_BenchSend (&players[i], &msg, false);
+			}
+		}
+
+		realtime += host_frametime;
+		Host_ServerFrame ();
+
+		for (i=0 ; i<numplayers ; i++)
+		{
+			if (!svs.clients[i].active)
+			{
+				Con_Printf ("sv_bench: player %i was dropped\n", i);
+				nummoves = 0;
+				break;
+			}
+			if (tick >= 0)
+				bytes += SV_BenchDrain (&players[i]);
+			else
+				SV_BenchDrain (&players[i]);
+		}
+	}
+
+	sv_benchtiming = false;
+	total = Sys_FloatTime () - start;
+
+	if (nummoves && tick == numticks)
+	{
+		statements = SV_BenchStatements () - statements;
+
+		Con_Printf ("sv_bench: %s, %i players, %i ticks of %.3f sec, %s\n", sv.name, numplayers, numticks,
+			host_frametime, input[0] ? input : "synthetic input");
+		if (total > 0)
+			Con_Printf ("%.1f ticks/sec, %.3f ms/tick\n", numticks / total, total * 1000.0 / numticks);
+		Con_Printf ("  clients %8.3f ms/tick\n", sv_benchphase[SV_BENCH_CLIENTS] * 1000.0 / numticks);
+		Con_Printf ("  physics %8.3f ms/tick\n", sv_benchphase[SV_BENCH_PHYSICS] * 1000.0 / numticks);
+		Con_Printf ("  send    %8.3f ms/tick\n", sv_benchphase[SV_BENCH_SEND] * 1000.0 / numticks);
+		Con_Printf ("  qc      %8i statements/tick\n", statements / numticks);
+		Con_Printf ("  net     %8i bytes/tick to players\n", bytes / numticks);
+		Con_Printf ("%i edicts, checksum %04x\n", sv.num_edicts, SV_BenchChecksum ());
+	}
+
+	Host_ShutdownServer (false);
+
+	// give back the loopback buffers still queued for the players
+	for (i=0 ; i<numplayers ; i++)
+		SV_BenchDrain (&players[i]);
+
+	svs.maxclients = saveclients;
+	realtime = saverealtime;
+	key_dest = savekeydest;
+}
@@ -35,6 +35,7 @@ cvar_t 	sv_startround = {"sv_startround", "0", true};
 cvar_t 	sv_magic = {"sv_magic", "1", true};
 cvar_t 	sv_headshotonly = {"sv_headshotonly", "0", true};
 cvar_t 	sv_fastrounds = {"sv_fastrounds", "0", true};
+cvar_t	sv_directsnapshot = {"sv_directsnapshot", "0"};	// local client reads entities from the edicts
 
 /*
 ===============
@@ -72,9 +73,13 @@ void SV_Init (void)
 	Cvar_RegisterVariable (&sv_magic);
 	Cvar_RegisterVariable (&sv_headshotonly);
 	Cvar_RegisterVariable (&sv_fastrounds);
+	Cvar_RegisterVariable (&sv_directsnapshot);
 
 	Cvar_SetValue("sv_maxai", MAX_AI_COUNT);
 
+	Cmd_AddCommand ("sv_bench", SV_Bench_f);
+	Cmd_AddCommand ("sv_benchrecord", SV_BenchRecord_f);
+
 #ifdef __3DS__
 	if (!new3ds_flag)
 		Cvar_SetValue("sv_maxai", 12);
@@ -222,9 +227,9 @@ void SV_SendServerinfo (client_t *client)
 	MSG_WriteByte (&client->message, svs.maxclients);
 
 	if (!coop.value && deathmatch.value)
-		MSG_WriteByte (&client->message, GAME_DEATHMATCH);
+		MSG_WriteByte (&client->message, GAME_DEATHMATCH | GAME_MOVEACK);
 	else
-		MSG_WriteByte (&client->message, GAME_COOP);
+		MSG_WriteByte (&client->message, GAME_COOP | GAME_MOVEACK);
 
 	sprintf (message, "%s", pr_strings+sv.edicts->v.message);
 
@@ -448,6 +453,70 @@ byte *SV_FatPVS (vec3_t org)
 //=============================================================================
 
 
+/*
+=============
+SV_EntityVisible
+
+Whether clent gets an update for ent this frame
+=============
+*/
+qboolean SV_EntityVisible (edict_t *clent, edict_t *ent, byte *pvs, qboolean nomap)
+{
+	int		i;
+
+	// don't send if flagged for NODRAW and there are no lighting effects
+	if (ent->v.effects == EF_NODRAW)
+		return false;
+
+	if (ent == clent)	// clent is ALLWAYS sent
+		return true;
+
+// ignore ents without visible models
+	if (!ent->v.modelindex || !pr_strings[ent->v.model])
+		return false;
+
+// ignore if not touching a PV leaf
+	for (i=0 ; i < ent->num_leafs ; i++)
+	{
+		if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
+			break;
+	}
+	if (i == ent->num_leafs)
+		return false;		// not visible
+
+	// joe, from ProQuake: don't send updates if the client doesn't have the map
+	return !nomap;
+}
+
+/*
+=============
+SV_EntityRender
+
+Tomaz - QC Alpha Scale Glow, the HalfLife render fields scaled to 0-1
+=============
+*/
+void SV_EntityRender (edict_t *ent, float *renderamt, float *rendermode, float *rendercolor)
+{
+	eval_t	*val;
+
+	*renderamt = 0;
+	*rendermode = 0;
+	rendercolor[0] = rendercolor[1] = rendercolor[2] = 0;
+
+	if ((val = GETEDICTFIELDVALUE(ent, eval_renderamt)) && val->_float != 255.0f)
+		*renderamt = val->_float / 255.0f;
+
+	if ((val = GETEDICTFIELDVALUE(ent, eval_rendermode)) && val->_float != 0)
+		*rendermode = val->_float;
+
+	if ((val = GETEDICTFIELDVALUE(ent, eval_rendercolor)))
+	{
+		rendercolor[0] = val->vector[0] / 255.0f;
+		rendercolor[1] = val->vector[1] / 255.0f;
+		rendercolor[2] = val->vector[2] / 255.0f;
+	}
+}
+
 /*
 =============
 SV_WriteEntitiesToClient
@@ -462,15 +531,8 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg, qboolean nomap)
 	vec3_t	org;
 	float	miss;
 	edict_t	*ent;
-
-	// Tomaz - QC Alpha Scale Glow Begin
-		eval_t  *val;
-		float	renderamt  = 0;
-		float	rendermode = 0;
-
-		float	rendercolor[3];
-		memset(rendercolor, 0, sizeof(rendercolor));
-	// Tomaz - QC Alpha Scale Glow End
+	float	renderamt, rendermode;
+	float	rendercolor[3];
 
 	// find the client's PVS
 	VectorAdd (clent->v.origin, clent->v.view_ofs, org);
@@ -480,28 +542,9 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg, qboolean nomap)
 	ent = NEXT_EDICT(sv.edicts);
 	for (e=1 ; e<sv.num_edicts ; e++, ent = NEXT_EDICT(ent))
 	{
-		// don't send if flagged for NODRAW and there are no lighting effects
-		if (ent->v.effects == EF_NODRAW)
+		if (!SV_EntityVisible (clent, ent, pvs, nomap))
 			continue;
 
-// ignore if not touching a PV leaf
-		if (ent != clent)	// clent is ALLWAYS sent
-		{
-// ignore ents without visible models
-			if (!ent->v.modelindex || !pr_strings[ent->v.model])
-				continue;
-
-			for (i=0 ; i < ent->num_leafs ; i++)
-			{
-				if (pvs[ent->leafnums[i] >> 3] & (1 << (ent->leafnums[i]&7) ))
-					break;
-			}
-			if (i == ent->num_leafs)
-				continue;		// not visible
-            // joe, from ProQuake: don't send updates if the client doesn't have the map
-			if (nomap)
-				continue;
-		}
 		if (msg->maxsize - msg->cursize < 16)
 		{
 			Con_Printf ("SV_WriteEntitiesToClient: packet overflow->big_value\n");
@@ -547,22 +590,7 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg, qboolean nomap)
 		if (ent->v.scale != ENTSCALE_DEFAULT && ent->v.scale != 0)
 			bits |= U_SCALE;
 
-        // Tomaz - QC Alpha Scale Glow Begin
-
-	{
-		//Smal Size
-		if ((val = GETEDICTFIELDVALUE(ent, eval_renderamt)) && val->_float != 255.0f) // HalfLife support
-			 renderamt = val->_float / 255.0f;
-
-		if ((val = GETEDICTFIELDVALUE(ent, eval_rendermode)) && val->_float != 0) // HalfLife support
-			rendermode = val->_float;
-
-		if ((val = GETEDICTFIELDVALUE(ent, eval_rendercolor))) // HalfLife support
-		{
-			rendercolor[0] = val->vector[0] / 255.0f;
-			rendercolor[1] = val->vector[1] / 255.0f;
-			rendercolor[2] = val->vector[2] / 255.0f;
-		}
+		SV_EntityRender (ent, &renderamt, &rendermode, rendercolor);
 
 		if (renderamt > 0)
 			bits |= U_RENDERAMT;
@@ -571,22 +599,14 @@ void SV_WriteEntitiesToClient (edict_t	*clent, sizebuf_t *msg, qboolean nomap)
 			bits |= U_RENDERMODE;
 
 		if (rendercolor[0] > 0)
-		{
 			bits |= U_RENDERCOLOR1;
-		}
 
-		if (rendercolor[1] > 0 )
-		{
+		if (rendercolor[1] > 0)
 			bits |= U_RENDERCOLOR2;
-		}
 
-		if (rendercolor[2] > 0 )
-		{
+		if (rendercolor[2] > 0)
 			bits |= U_RENDERCOLOR3;
-		}
-	}
 
-	// Tomaz - QC Alpha Scale Glow End
 		if (e >= 256)//We have more than 256 entities
 			bits |= U_LONGENTITY;
 
@@ -809,6 +829,60 @@ void SV_WriteClientdataToMessage (edict_t *ent, sizebuf_t *msg)
 	MSG_WriteShort (msg, ent->v.viewmodel2_effects);
 }
 
+/*
+=======================
+SV_DirectSnapshot
+
+The client in this process can read the entities straight out of the
+edicts instead of parsing them, see CL_ParseSnapshot. Anything that keeps
+the datagram, a demo or a remote connection, gets the real updates.
+=======================
+*/
+static qboolean SV_DirectSnapshot (client_t *client)
+{
+	extern qsocket_t	*loop_server;
+
+	if (!sv_directsnapshot.value || cls.demorecording)
+		return false;
+
+	return client->netconnection && client->netconnection == loop_server;
+}
+
+/*
+==================
+SV_WriteMoveAck
+
+Tells a client which of its moves the player state in this datagram
+includes, and everything its prediction needs to carry on from there
+==================
+*/
+static void SV_WriteMoveAck (client_t *client, sizebuf_t *msg)
+{
+	edict_t	*ent;
+	int		i, flags;
+
+	ent = client->edict;
+
+	flags = 0;
+	if ((int)ent->v.flags & FL_ONGROUND)
+		flags |= MOVEACK_ONGROUND;
+	if ((int)ent->v.flags & FL_WATERJUMP)
+		flags |= MOVEACK_WATERJUMP;
+
+	MSG_WriteByte (msg, svc_moveack);
+	MSG_WriteLong (msg, client->movesequence);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteFloat (msg, ent->v.origin[i]);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteFloat (msg, ent->v.velocity[i]);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteChar (msg, ent->v.mins[i]);
+	for (i=0 ; i<3 ; i++)
+		MSG_WriteChar (msg, ent->v.maxs[i]);
+	MSG_WriteByte (msg, ent->v.movetype);
+	MSG_WriteByte (msg, flags);
+}
+
 /*
 =======================
 SV_SendClientDatagram
@@ -828,8 +902,17 @@ qboolean SV_SendClientDatagram (client_t *client)
 
 // add the client specific data to the datagram
 	SV_WriteClientdataToMessage (client->edict, &msg);//This should be good now
+	if (client->movesequence)
+		SV_WriteMoveAck (client, &msg);
 
-	SV_WriteEntitiesToClient (client->edict, &msg, client->nomap);
+	if (SV_DirectSnapshot (client))
+	{
+		MSG_WriteByte (&msg, svc_snapshot);
+		MSG_WriteShort (&msg, NUM_FOR_EDICT(client->edict));
+		MSG_WriteByte (&msg, client->nomap);
+	}
+	else
+		SV_WriteEntitiesToClient (client->edict, &msg, client->nomap);
 
 // copy the server datagram if there is space
 	if (msg.cursize + sv.datagram.cursize < msg.maxsize)
@@ -1307,6 +1390,8 @@ void SV_SpawnServer (char *server)
 
 	Load_Waypoint ();
 	Con_DPrintf ("Server spawned.\n");
+
+	Memory_TraceReport (sv.name);
 }
 
 
@@ -148,6 +148,9 @@ void SV_Impact (edict_t *e1, edict_t *e2)
 {
 	int		old_self, old_other;
 
+	if (sv_predictmodel)
+		return;		// predicting on the client, touches are the server's
+
 	old_self = pr_global_struct->self;
 	old_other = pr_global_struct->other;
 
@@ -1003,7 +1006,7 @@ void SV_WalkMove (edict_t *ent)
 	if (sv_nostep.value)
 		return;
 
-	if ( (int)sv_player->v.flags & FL_WATERJUMP )
+	if ( (int)ent->v.flags & FL_WATERJUMP )
 		return;
 
 	VectorCopy (ent->v.origin, nosteporg);
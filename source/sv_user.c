@@ -371,13 +371,16 @@ void SV_AirMove (void)
 
 /*
 ===================
-SV_ClientThink
+SV_PlayerThink
 
 the move fields specify an intended velocity in pix/sec
 the angle fields specify an exact angular motion in degrees
+
+Client prediction runs this on its own copy of the player, so it only
+touches sv_player and the move it is given
 ===================
 */
-void SV_ClientThink (void)
+void SV_PlayerThink (usercmd_t *move)
 {
 	vec3_t		v_angle;
 
@@ -403,7 +406,7 @@ void SV_ClientThink (void)
 //
 // angles
 // show 1/3 the pitch angle and all the roll angle
-	cmd = host_client->cmd;
+	cmd = *move;
 	angles = sv_player->v.angles;
 
 	VectorAdd (sv_player->v.v_angle, sv_player->v.punchangle, v_angle);
@@ -433,6 +436,17 @@ void SV_ClientThink (void)
 }
 
 
+/*
+===================
+SV_ClientThink
+===================
+*/
+void SV_ClientThink (void)
+{
+	SV_PlayerThink (&host_client->cmd);
+}
+
+
 /*
 ===================
 SV_ReadClientMove
@@ -475,6 +489,9 @@ void SV_ReadClientMove (usercmd_t *move)
 	i = MSG_ReadByte ();
 	if (i)
 		host_client->edict->v.impulse = i;
+
+	if (host_client == svs.clients)
+		SV_BenchRecordMove (angle, move, bits, i);
 }
 
 /*
@@ -589,6 +606,10 @@ nextmsg:
 			case clc_move:
 				SV_ReadClientMove (&host_client->cmd);
 				break;
+
+			case clc_moveseq:
+				host_client->movesequence = MSG_ReadLong ();
+				break;
 			}
 		}
 	} while (ret == 1);
@@ -1108,7 +1108,7 @@ void V_CalcRefdef (void)
 	AngleVectors (r_refdef.viewangles, temp_forward, temp_right, temp_up);
 
 	vec3_t ADSOffset;
-	if(cl.stats[STAT_ZOOM] == 1 || cl.stats[STAT_ZOOM] == 2)
+	if((cl.stats[STAT_ZOOM] == 1 || cl.stats[STAT_ZOOM] == 2) && sv.active)
 	{
 		ADSOffset[0] = sv_player->v.ADS_Offset[0];
 		ADSOffset[1] = sv_player->v.ADS_Offset[1];
@@ -1602,9 +1602,14 @@ extern vrect_t	scr_vrect;
 
 void V_RenderView (void)
 {
+	double	time1 = 0;
+
 	if (con_forcedup)
 		return;
 
+	if (cls.timedemo)
+		time1 = Sys_FloatTime ();
+
 // don't allow cheats in multiplayer
 	if (cl.maxclients > 1)
 	{
@@ -1660,6 +1665,9 @@ void V_RenderView (void)
 		R_RenderView ();
 	}
 
+	if (cls.timedemo)
+		CL_TimeDemoPhase (TD_RENDER, Sys_FloatTime () - time1);
+
 	//Blub's debug tracemove: to use: uncomment this, go above and uncomment the functions used above this one, and go in qc and make the player spawn an entity of .enemy
 	//tryLine();
 }
@@ -48,6 +48,9 @@ typedef struct
 
 int SV_HullPointContents (hull_t *hull, int num, vec3_t p);
 
+model_t		*sv_predictmodel;
+edict_t		*sv_predictworld;
+
 /*
 ===============================================================================
 
@@ -141,7 +144,10 @@ hull_t *SV_HullForEntity (edict_t *ent, vec3_t mins, vec3_t maxs, vec3_t offset,
 		if (ent->v.movetype != MOVETYPE_PUSH)
 			Sys_Error ("SOLID_BSP without MOVETYPE_PUSH");
 
-		model = sv.models[ (int)ent->v.modelindex ];
+		if (ent == sv_predictworld)
+			model = sv_predictmodel;
+		else
+			model = sv.models[ (int)ent->v.modelindex ];
 
 		if (!model || model->type != mod_brush)
 			Sys_Error ("MOVETYPE_PUSH with a non bsp model");
@@ -454,6 +460,9 @@ void SV_LinkEdict (edict_t *ent, qboolean touch_triggers)
 {
 	areanode_t	*node;
 
+	if (sv_predictmodel)
+		return;		// the predicted player isn't in the server's world
+
 	if (ent->area.prev)
 		SV_UnlinkEdict (ent);	// unlink from old position
 
@@ -581,7 +590,7 @@ int SV_PointContents (vec3_t p)
 {
 	int		cont;
 
-	cont = SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	cont = SV_HullPointContents (&(sv_predictmodel ? sv_predictmodel : sv.worldmodel)->hulls[0], 0, p);
 	if (cont <= CONTENTS_CURRENT_0 && cont >= CONTENTS_CURRENT_DOWN)
 		cont = CONTENTS_WATER;
 	return cont;
@@ -589,7 +598,7 @@ int SV_PointContents (vec3_t p)
 
 int SV_TruePointContents (vec3_t p)
 {
-	return SV_HullPointContents (&sv.worldmodel->hulls[0], 0, p);
+	return SV_HullPointContents (&(sv_predictmodel ? sv_predictmodel : sv.worldmodel)->hulls[0], 0, p);
 }
 
 //===========================================================================
@@ -608,7 +617,7 @@ edict_t	*SV_TestEntityPosition (edict_t *ent)
 	trace = SV_Move (ent->v.origin, ent->v.mins, ent->v.maxs, ent->v.origin, 0, ent);
 
 	if (trace.startsolid)
-		return sv.edicts;
+		return sv_predictmodel ? sv_predictworld : sv.edicts;
 
 	return NULL;
 }
@@ -1085,6 +1094,8 @@ trace_t SV_Move (vec3_t start, vec3_t mins, vec3_t maxs, vec3_t end, int type, e
 	clip.passedict = passedict;
 
 // clip to world
+	if (sv_predictmodel)
+		return SV_ClipMoveToEntity (sv_predictworld, start, mins, maxs, end, passedict);
 	clip.trace = SV_ClipMoveToEntity( sv.edicts, start, mins, maxs, end, passedict);
 
 	if (type == MOVE_MISSILE)
@@ -42,6 +42,12 @@ typedef struct
 #define	MOVE_MISSILE	2
 
 
+extern	model_t	*sv_predictmodel;
+extern	edict_t	*sv_predictworld;
+// while client prediction runs the player movement code, the world is
+// sv_predictmodel alone, standing in as sv_predictworld: moves clip only
+// against its hulls, nothing is linked and no touch functions run
+
 void SV_ClearWorld (void);
 // called after the world model has been loaded, before linking any entities
 
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // zone.c
 
+#define ZONE_INTERNAL	// keep the tracing wrappers in zone.h off the definitions below
 #include "nzportable_def.h"
 
 // cypress -- who the fuck needs a 250kB zone block?? what?? restoring to 50kB.
@@ -48,6 +49,20 @@ typedef struct
 void Cache_FreeLow (int new_low_hunk);
 void Cache_FreeHigh (int new_high_hunk);
 
+typedef enum
+{
+	MEMTRACE_HUNK,
+	MEMTRACE_HIGHHUNK,
+	MEMTRACE_ZONE,
+	MEMTRACE_CACHE,
+	MEMTRACE_NUMKINDS
+} memtrace_kind_t;
+
+static void Memory_TraceAlloc (memtrace_kind_t kind, char *tag, int size);
+
+int		zone_used;
+int		cache_used;
+
 #ifdef PSP_VFPU
 void* memcpy_vfpu( void* dst, void* src, unsigned int size )
 {
@@ -487,6 +502,7 @@ void Z_Free (void *ptr)
 		Sys_Error ("freed a freed pointer");
 
 	block->tag = 0;		// mark as free
+	zone_used -= block->size;
 
 	other = block->prev;
 	if (!other->tag)
@@ -558,6 +574,8 @@ void *Z_TagMalloc (int size, int tag)
 	}
 
 	base->tag = tag;				// no longer a free block
+	zone_used += base->size;
+	Memory_TraceAlloc (MEMTRACE_ZONE, "zone", base->size);
 
 	mainzone->rover = base->next;	// next allocation will start looking here
 
@@ -851,6 +869,8 @@ void *Hunk_AllocName (int size, char *name)
 	h->sentinel = HUNK_SENTINEL;
 	strlcpy(h->name, name, HUNKNAME_LEN);
 
+	Memory_TraceAlloc (MEMTRACE_HUNK, h->name, size);
+
 	return (void *)(h+1);
 }
 
@@ -942,6 +962,8 @@ void *Hunk_HighAllocName (int size, char *name)
 	h->sentinel = HUNK_SENTINEL;
 	strlcpy (h->name, name, HUNKNAME_LEN);
 
+	Memory_TraceAlloc (MEMTRACE_HIGHHUNK, h->name, size);
+
 	return (void *)(h+1);
 }
 
@@ -1001,9 +1023,230 @@ typedef struct cache_system_s
 } cache_system_t;
 
 cache_system_t *Cache_TryAlloc (int size, qboolean nobottom);
+void Cache_UnlinkLRU (cache_system_t *cs);
+void Cache_MakeLRU (cache_system_t *cs);
 
 cache_system_t	cache_head;
 
+/*
+Free space between two cached blocks (an interior hole) is indexed by size
+so allocation doesn't have to walk the whole block chain. The hole header
+is written into the hole itself, so no extra memory is needed. The spaces
+below the first block and above the last one are not indexed, since the
+low and high hunk grow into them without telling the cache; they are
+cheap to compute from cache_head instead.
+
+Holes too small to hold any allocation are never indexed, they get picked
+up again when a neighbouring block is freed and the space coalesces.
+*/
+typedef struct cache_hole_s
+{
+	int			size;
+	cache_system_t		*block;		// cached block right above the hole
+	struct cache_hole_s	*prev, *next;
+} cache_hole_t;
+
+#define CACHE_MINHOLE	((int)((sizeof(cache_system_t) + 16 + 15) & ~15))
+#define CACHE_NUMBINS	32
+
+cache_hole_t	*cache_bins[CACHE_NUMBINS];	// holes of size [2^i, 2^(i+1))
+unsigned int	cache_binmask;				// bit i set if cache_bins[i] is non-empty
+
+int		cache_hits;
+int		cache_misses;
+int		cache_evictions;
+int		cache_moves;
+
+/*
+===========
+Cache_HoleBin
+===========
+*/
+static int Cache_HoleBin (int size)
+{
+	int		bin;
+
+	for (bin = 0 ; size > 1 ; bin++)
+		size >>= 1;
+
+	return bin;
+}
+
+/*
+===========
+Cache_GapStart / Cache_GapEnd
+
+Bounds of the free space following prev / preceding next. cache_head
+stands for the low and high hunk marks.
+===========
+*/
+static byte *Cache_GapStart (cache_system_t *prev)
+{
+	if (prev == &cache_head)
+		return hunk_base + hunk_low_used;
+	return (byte *)prev + prev->size;
+}
+
+static byte *Cache_GapEnd (cache_system_t *next)
+{
+	if (next == &cache_head)
+		return hunk_base + hunk_size - hunk_high_used;
+	return (byte *)next;
+}
+
+/*
+===========
+Cache_AddHole
+===========
+*/
+static void Cache_AddHole (byte *start, cache_system_t *block)
+{
+	cache_hole_t	*hole;
+	int				size, bin;
+
+	size = (byte *)block - start;
+	if (size < CACHE_MINHOLE)
+		return;
+
+	hole = (cache_hole_t *)start;
+	hole->size = size;
+	hole->block = block;
+
+	bin = Cache_HoleBin (size);
+	hole->prev = NULL;
+	hole->next = cache_bins[bin];
+	if (hole->next)
+		hole->next->prev = hole;
+	cache_bins[bin] = hole;
+	cache_binmask |= 1u << bin;
+}
+
+/*
+===========
+Cache_RemoveHole
+===========
+*/
+static void Cache_RemoveHole (byte *start, cache_system_t *block)
+{
+	cache_hole_t	*hole;
+	int				bin;
+
+	if ((byte *)block - start < CACHE_MINHOLE)
+		return;
+
+	hole = (cache_hole_t *)start;
+	if (hole->block != block || hole->size != (byte *)block - start)
+		Sys_Error ("bad hole");
+
+	bin = Cache_HoleBin (hole->size);
+	if (hole->prev)
+		hole->prev->next = hole->next;
+	else
+		cache_bins[bin] = hole->next;
+	if (hole->next)
+		hole->next->prev = hole->prev;
+
+	if (!cache_bins[bin])
+		cache_binmask &= ~(1u << bin);
+}
+
+/*
+===========
+Cache_FindHole
+
+Returns the block right above a hole of at least size bytes, or NULL.
+Holes in the bin matching size are checked first fit, any hole in a
+higher bin is big enough so the first one is taken.
+===========
+*/
+static cache_system_t *Cache_FindHole (int size)
+{
+	cache_hole_t	*hole;
+	unsigned int	mask;
+	int				bin;
+
+	bin = Cache_HoleBin (size);
+	for (hole = cache_bins[bin] ; hole ; hole = hole->next)
+	{
+		if (hole->size >= size)
+			return hole->block;
+	}
+
+	if (bin == CACHE_NUMBINS - 1)
+		return NULL;
+
+	mask = cache_binmask & ~((2u << bin) - 1);
+	if (!mask)
+		return NULL;
+
+	for (bin++ ; !(mask & (1u << bin)) ; bin++)
+		;
+
+	return cache_bins[bin]->block;
+}
+
+/*
+===========
+Cache_LinkBlock
+
+Places a block of the given size at the bottom of the free space between
+prev and next, which the caller has checked is big enough.
+===========
+*/
+static cache_system_t *Cache_LinkBlock (cache_system_t *prev, cache_system_t *next, int size)
+{
+	cache_system_t	*new_cs;
+
+	new_cs = (cache_system_t *)Cache_GapStart (prev);
+	if (prev != &cache_head && next != &cache_head)
+		Cache_RemoveHole ((byte *)new_cs, next);
+
+	memset (new_cs, 0, sizeof(*new_cs));
+	new_cs->size = size;
+	cache_used += size;
+
+	new_cs->next = next;
+	new_cs->prev = prev;
+	prev->next = new_cs;
+	next->prev = new_cs;
+
+	if (next != &cache_head)
+		Cache_AddHole ((byte *)new_cs + size, next);
+
+	Cache_MakeLRU (new_cs);
+
+	return new_cs;
+}
+
+/*
+===========
+Cache_UnlinkBlock
+
+Removes a block from the address chain and merges the space it leaves
+with the holes around it.
+===========
+*/
+static void Cache_UnlinkBlock (cache_system_t *cs)
+{
+	cache_system_t	*prev, *next;
+
+	prev = cs->prev;
+	next = cs->next;
+
+	if (prev != &cache_head)
+		Cache_RemoveHole (Cache_GapStart (prev), cs);
+	if (next != &cache_head)
+		Cache_RemoveHole ((byte *)cs + cs->size, next);
+
+	prev->next = next;
+	next->prev = prev;
+	cs->next = cs->prev = NULL;
+	cache_used -= cs->size;
+
+	if (prev != &cache_head && next != &cache_head)
+		Cache_AddHole (Cache_GapStart (prev), next);
+}
+
 /*
 ===========
 Cache_Move
@@ -1024,11 +1267,13 @@ void Cache_Move ( cache_system_t *c)
 		Q_memcpy (new_cs->name, c->name, sizeof(new_cs->name));
 		Cache_Free (c->user);
 		new_cs->user->data = (void *)(new_cs+1);
+		cache_moves++;
 	}
 	else
 	{
 		//Con_DPrintf ("cache_move failed\n");
 		Cache_Free (c->user); // tough luck...
+		cache_evictions++;
 	}
 }
 
@@ -1074,7 +1319,10 @@ void Cache_FreeHigh (int new_high_hunk)
 		if ( (byte *)c + c->size <= hunk_base + hunk_size - new_high_hunk)
 			return;		// there is space to grow the hunk
 		if (c == prev)
+		{
 			Cache_Free (c->user);	// didn't move out of the way
+			cache_evictions++;
+		}
 		else
 		{
 			Cache_Move (c);	// try to move it
@@ -1111,11 +1359,13 @@ Cache_TryAlloc
 
 Looks for a free block of memory between the high and low hunk marks
 Size should already include the header and padding
+Interior holes are tried first, then the space above the low hunk,
+then the space below the high hunk
 ============
 */
 cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 {
-	cache_system_t	*cs, *new_cs;
+	cache_system_t	*next;
 
 // is the cache completely empty?
 
@@ -1124,63 +1374,22 @@ cache_system_t *Cache_TryAlloc (int size, qboolean nobottom)
 		if (hunk_size - hunk_high_used - hunk_low_used < size)
 			Sys_Error ("%i is greater then free hunk", size);
 
-		new_cs = (cache_system_t *) (hunk_base + hunk_low_used);
-		memset (new_cs, 0, sizeof(*new_cs));
-		new_cs->size = size;
-
-		cache_head.prev = cache_head.next = new_cs;
-		new_cs->prev = new_cs->next = &cache_head;
-
-		Cache_MakeLRU (new_cs);
-		return new_cs;
+		return Cache_LinkBlock (&cache_head, &cache_head, size);
 	}
 
-// search from the bottom up for space
-
-	new_cs = (cache_system_t *) (hunk_base + hunk_low_used);
-	cs = cache_head.next;
-
-	do
-	{
-		if (!nobottom || cs != cache_head.next)
-		{
-			if ( (byte *)cs - (byte *)new_cs >= size)
-			{	// found space
-				memset (new_cs, 0, sizeof(*new_cs));
-				new_cs->size = size;
-
-				new_cs->next = cs;
-				new_cs->prev = cs->prev;
-				cs->prev->next = new_cs;
-				cs->prev = new_cs;
-
-				Cache_MakeLRU (new_cs);
-
-				return new_cs;
-			}
-		}
+// look for a hole between two blocks
 
-	// continue looking
-		new_cs = (cache_system_t *)((byte *)cs + cs->size);
-		cs = cs->next;
+	next = Cache_FindHole (size);
+	if (next)
+		return Cache_LinkBlock (next->prev, next, size);
 
-	} while (cs != &cache_head);
+// try the space above the low hunk
+	if (!nobottom && Cache_GapEnd (cache_head.next) - Cache_GapStart (&cache_head) >= size)
+		return Cache_LinkBlock (&cache_head, cache_head.next, size);
 
 // try to allocate one at the very end
-	if ( hunk_base + hunk_size - hunk_high_used - (byte *)new_cs >= size)
-	{
-		memset (new_cs, 0, sizeof(*new_cs));
-		new_cs->size = size;
-
-		new_cs->next = &cache_head;
-		new_cs->prev = cache_head.prev;
-		cache_head.prev->next = new_cs;
-		cache_head.prev = new_cs;
-
-		Cache_MakeLRU (new_cs);
-
-		return new_cs;
-	}
+	if (Cache_GapEnd (&cache_head) - Cache_GapStart (cache_head.prev) >= size)
+		return Cache_LinkBlock (cache_head.prev, &cache_head, size);
 
 	return NULL;		// couldn't allocate
 }
@@ -1214,6 +1423,32 @@ void Cache_Print (void)
 	}
 }
 
+/*
+============
+Cache_Stats
+
+============
+*/
+static void Cache_Stats (void (*print) (char *fmt, ...))
+{
+	cache_hole_t	*hole;
+	int				i, holes, holebytes;
+
+	holes = holebytes = 0;
+	for (i = 0 ; i < CACHE_NUMBINS ; i++)
+	{
+		for (hole = cache_bins[i] ; hole ; hole = hole->next)
+		{
+			holes++;
+			holebytes += hole->size;
+		}
+	}
+
+	print ("%4.1f megabyte data cache\n", (double)(hunk_size - hunk_high_used - hunk_low_used) / (double)(1024*1024) );
+	print ("cache: %i hits, %i misses, %i evictions, %i moves\n", cache_hits, cache_misses, cache_evictions, cache_moves);
+	print ("cache: %i holes, %i bytes fragmented\n", holes, holebytes);
+}
+
 /*
 ============
 Cache_Report
@@ -1222,7 +1457,17 @@ Cache_Report
 */
 void Cache_Report (void)
 {
-	Con_DPrintf ("%4.1f megabyte data cache\n", (double)(hunk_size - hunk_high_used - hunk_low_used) / (double)(1024*1024) );
+	Cache_Stats (Con_DPrintf);
+}
+
+/*
+============
+Cache_Report_f
+============
+*/
+void Cache_Report_f (void)
+{
+	Cache_Stats (Con_Printf);
 }
 
 /*
@@ -1237,6 +1482,7 @@ void Cache_Init (void)
 	cache_head.lru_next = cache_head.lru_prev = &cache_head;
 
 	Cmd_AddCommand ("flush", Cache_Flush);
+	Cmd_AddCommand ("cache_report", Cache_Report_f);
 }
 
 /*
@@ -1255,9 +1501,7 @@ void Cache_Free (cache_user_t *c)
 
 	cs = ((cache_system_t *)c->data) - 1;
 
-	cs->prev->next = cs->next;
-	cs->next->prev = cs->prev;
-	cs->next = cs->prev = NULL;
+	Cache_UnlinkBlock (cs);
 
 	c->data = NULL;
 
@@ -1276,7 +1520,12 @@ void *Cache_Check (cache_user_t *c)
 	cache_system_t	*cs;
 
 	if (!c->data)
+	{
+		cache_misses++;
 		return NULL;
+	}
+
+	cache_hits++;
 
 	cs = ((cache_system_t *)c->data) - 1;
 
@@ -1295,7 +1544,7 @@ Cache_Alloc
 */
 void *Cache_Alloc (cache_user_t *c, int size, char *name)
 {
-	cache_system_t	*cs;
+	cache_system_t	*cs, *victim, *prev, *next;
 
 	if (c->data)
 		Sys_Error ("already allocated");
@@ -1306,25 +1555,382 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name)
 	size = (size + sizeof(cache_system_t) + 15) & ~15;
 
 // find memory for it
-	while (1)
+	cs = Cache_TryAlloc (size, false);
+
+// nothing fits, so the only space that can open up is around whatever gets
+// thrown out. free the least recently used data until that space is big
+// enough, rather than searching the whole cache again after every free
+	while (!cs)
 	{
-		cs = Cache_TryAlloc (size, false);
-		if (cs)
+		victim = cache_head.lru_prev;
+		if (victim == &cache_head)
+			Sys_Error ("out of memory"); // not enough memory at all
+
+		prev = victim->prev;
+		next = victim->next;
+		Cache_Free (victim->user);
+		cache_evictions++;
+
+		if (Cache_GapEnd (next) - Cache_GapStart (prev) >= size)
+			cs = Cache_LinkBlock (prev, next, size);
+	}
+
+	strlcpy (cs->name, name, CACHENAME_LEN);
+	c->data = (void *)(cs+1);
+	cs->user = c;
+
+	Memory_TraceAlloc (MEMTRACE_CACHE, cs->name, size);
+
+	return c->data;
+}
+
+/*
+===============================================================================
+
+ALLOCATION TRACING
+
+===============================================================================
+*/
+
+#define MEMTRACE_MAXSITES	512
+#define MEMTRACE_MAXTAGS	512
+
+typedef struct
+{
+	const char		*file;		// NULL = unused slot
+	int				line;
+	memtrace_kind_t	kind;
+	char			tag[HUNKNAME_LEN];	// name of the most recent allocation
+	int				count;
+	int				bytes;
+	int				largest;
+} memtrace_site_t;
+
+typedef struct
+{
+	memtrace_kind_t	kind;
+	char			name[HUNKNAME_LEN];	// empty = unused slot
+	int				bytes;				// at the last report
+	int				peak;				// highest seen at any report
+} memtrace_tag_t;
+
+static const char *memtrace_kindnames[MEMTRACE_NUMKINDS] = {"hunk", "highhunk", "zone", "cache"};
+
+const char	*mem_trace_file;
+int			mem_trace_line;
+
+static memtrace_site_t	*memtrace_sites;	// NULL when tracing is off
+static memtrace_tag_t	*memtrace_tags;
+static int				memtrace_droppedsites;
+
+static int	memtrace_peak_low, memtrace_peak_high, memtrace_peak_hunk;
+static int	memtrace_peak_zone, memtrace_peak_cache;
+
+/*
+===================
+Memory_TraceAlloc
+
+Records an allocation against the call site stored by the zone.h wrappers.
+The site is consumed here so allocations made internally by zone.c are
+only counted once.
+===================
+*/
+static void Memory_TraceAlloc (memtrace_kind_t kind, char *tag, int size)
+{
+	memtrace_site_t	*site;
+	const char		*file;
+	int				line, i, hash;
+
+	file = mem_trace_file;
+	line = mem_trace_line;
+	mem_trace_file = NULL;
+
+	if (!memtrace_sites)
+		return;
+
+	if (!file)
+	{
+		file = "zone.c";
+		line = 0;
+	}
+
+	hash = (line * 31 + kind) & (MEMTRACE_MAXSITES - 1);
+	for (i = 0 ; i < MEMTRACE_MAXSITES ; i++)
+	{
+		site = &memtrace_sites[(hash + i) & (MEMTRACE_MAXSITES - 1)];
+		if (!site->file)
 		{
-			strlcpy (cs->name, name, CACHENAME_LEN);
-			c->data = (void *)(cs+1);
-			cs->user = c;
+			site->file = file;
+			site->line = line;
+			site->kind = kind;
 			break;
 		}
+		if (site->line == line && site->kind == kind && (site->file == file || !strcmp (site->file, file)))
+			break;
+	}
 
-	// free the least recently used cahedat
-		if (cache_head.lru_prev == &cache_head)
-			Sys_Error ("out of memory"); // not enough memory at all
+	if (i == MEMTRACE_MAXSITES)
+		memtrace_droppedsites++;
+	else
+	{
+		strlcpy (site->tag, tag, HUNKNAME_LEN);
+		site->count++;
+		site->bytes += size;
+		if (size > site->largest)
+			site->largest = size;
+	}
+
+	if (hunk_low_used > memtrace_peak_low)
+		memtrace_peak_low = hunk_low_used;
+	if (hunk_high_used > memtrace_peak_high)
+		memtrace_peak_high = hunk_high_used;
+	if (hunk_low_used + hunk_high_used > memtrace_peak_hunk)
+		memtrace_peak_hunk = hunk_low_used + hunk_high_used;
+	if (zone_used > memtrace_peak_zone)
+		memtrace_peak_zone = zone_used;
+	if (cache_used > memtrace_peak_cache)
+		memtrace_peak_cache = cache_used;
+}
 
-		Cache_Free (cache_head.lru_prev->user);
+/*
+===================
+Memory_TraceTag
+
+Finds or adds the per-tag budget entry. Cache entries are named after the
+file they hold, so they are grouped by extension to keep the table to one
+line per asset class.
+===================
+*/
+static memtrace_tag_t *Memory_TraceTag (memtrace_kind_t kind, char *name)
+{
+	memtrace_tag_t	*t;
+	char			*ext;
+	int				i;
+
+	if (kind == MEMTRACE_CACHE && (ext = strrchr (name, '.')))
+		name = ext;
+
+	for (i = 0, t = memtrace_tags ; i < MEMTRACE_MAXTAGS ; i++, t++)
+	{
+		if (!t->name[0])
+		{
+			t->kind = kind;
+			strlcpy (t->name, name, HUNKNAME_LEN);
+			return t;
+		}
+		if (t->kind == kind && !strncmp (t->name, name, HUNKNAME_LEN - 1))
+			return t;
 	}
 
-	return Cache_Check (c);
+	return NULL;
+}
+
+/*
+===================
+Memory_TraceTally
+
+Recounts what every tag is holding right now and raises the high-water
+marks. Hunk blocks are walked like Hunk_Print does.
+===================
+*/
+static void Memory_TraceTally (void)
+{
+	memtrace_tag_t	*t;
+	hunk_t			*h, *end;
+	cache_system_t	*cs;
+	int				i;
+
+	for (i = 0 ; i < MEMTRACE_MAXTAGS ; i++)
+		memtrace_tags[i].bytes = 0;
+
+	for (i = 0 ; i < 2 ; i++)
+	{
+		if (!i)
+		{
+			h = (hunk_t *)hunk_base;
+			end = (hunk_t *)(hunk_base + hunk_low_used);
+		}
+		else
+		{
+			h = (hunk_t *)(hunk_base + hunk_size - hunk_high_used);
+			end = (hunk_t *)(hunk_base + hunk_size);
+		}
+
+		for ( ; h != end ; h = (hunk_t *)((byte *)h + h->size))
+		{
+			if (h->sentinel != HUNK_SENTINEL)
+				Sys_Error ("trashed sentinel");
+			if ((t = Memory_TraceTag (i ? MEMTRACE_HIGHHUNK : MEMTRACE_HUNK, h->name)))
+				t->bytes += h->size;
+		}
+	}
+
+	for (cs = cache_head.next ; cs != &cache_head ; cs = cs->next)
+	{
+		if ((t = Memory_TraceTag (MEMTRACE_CACHE, cs->name)))
+			t->bytes += cs->size;
+	}
+
+	if ((t = Memory_TraceTag (MEMTRACE_ZONE, "zone")))
+		t->bytes = zone_used;
+
+	for (i = 0, t = memtrace_tags ; i < MEMTRACE_MAXTAGS && t->name[0] ; i++, t++)
+	{
+		if (t->bytes > t->peak)
+			t->peak = t->bytes;
+	}
+}
+
+/*
+===================
+Memory_WriteJSONString
+===================
+*/
+static void Memory_WriteJSONString (FILE *f, const char *s)
+{
+	fputc ('"', f);
+	for ( ; *s ; s++)
+	{
+		if (*s == '"' || *s == '\\')
+			fprintf (f, "\\%c", *s);
+		else if ((unsigned char)*s < ' ')
+			fprintf (f, "\\u%04x", (unsigned char)*s);
+		else
+			fputc (*s, f);
+	}
+	fputc ('"', f);
+}
+
+/*
+===================
+Memory_TraceReport
+
+Called once a map has finished spawning. Writes memreport_<map>.json to
+the game directory.
+===================
+*/
+void Memory_TraceReport (char *mapname)
+{
+	FILE			*f;
+	memtrace_site_t	*site;
+	memtrace_tag_t	*t;
+	const char		*file;
+	int				i, first;
+
+	if (!memtrace_sites)
+		return;
+
+	Memory_TraceTally ();
+
+	f = fopen (va("%s/%smemreport_%s.json%s", com_gamedir, FILE_SPECIAL_PREFIX, mapname, FILE_SPECIAL_SUFFIX), "w");
+	if (!f)
+	{
+		Con_Printf ("Memory_TraceReport: couldn't write report for %s\n", mapname);
+		return;
+	}
+
+	fprintf (f, "{\n\t\"map\": ");
+	Memory_WriteJSONString (f, mapname);
+	fprintf (f, ",\n");
+	fprintf (f, "\t\"hunk\": {\"size\": %i, \"low_used\": %i, \"high_used\": %i, \"low_peak\": %i, \"high_peak\": %i, \"peak\": %i},\n",
+		hunk_size, hunk_low_used, hunk_high_used, memtrace_peak_low, memtrace_peak_high, memtrace_peak_hunk);
+	fprintf (f, "\t\"zone\": {\"size\": %i, \"used\": %i, \"peak\": %i},\n",
+		mainzone->size, zone_used, memtrace_peak_zone);
+	fprintf (f, "\t\"cache\": {\"used\": %i, \"peak\": %i, \"hits\": %i, \"misses\": %i, \"evictions\": %i, \"moves\": %i},\n",
+		cache_used, memtrace_peak_cache, cache_hits, cache_misses, cache_evictions, cache_moves);
+
+	fprintf (f, "\t\"tags\": [");
+	for (i = 0, t = memtrace_tags ; i < MEMTRACE_MAXTAGS && t->name[0] ; i++, t++)
+	{
+		fprintf (f, "%s\n\t\t{\"kind\": \"%s\", \"name\": ", i ? "," : "", memtrace_kindnames[t->kind]);
+		Memory_WriteJSONString (f, t->name);
+		fprintf (f, ", \"bytes\": %i, \"peak\": %i}", t->bytes, t->peak);
+	}
+	fprintf (f, "\n\t],\n");
+
+	fprintf (f, "\t\"sites\": [");
+	first = true;
+	for (i = 0, site = memtrace_sites ; i < MEMTRACE_MAXSITES ; i++, site++)
+	{
+		if (!site->file)
+			continue;
+
+		// strip the build directory, keep the path from source/ down
+		file = strstr (site->file, "source/");
+		file = file ? file + 7 : site->file;
+
+		fprintf (f, "%s\n\t\t{\"kind\": \"%s\", \"file\": ", first ? "" : ",", memtrace_kindnames[site->kind]);
+		Memory_WriteJSONString (f, file);
+		fprintf (f, ", \"line\": %i, \"tag\": ", site->line);
+		Memory_WriteJSONString (f, site->tag);
+		fprintf (f, ", \"count\": %i, \"bytes\": %i, \"largest\": %i}", site->count, site->bytes, site->largest);
+		first = false;
+	}
+	fprintf (f, "\n\t],\n");
+	fprintf (f, "\t\"dropped_sites\": %i\n}\n", memtrace_droppedsites);
+
+	fclose (f);
+
+	Con_Printf ("Wrote memory report for %s (hunk peak %i of %i)\n", mapname, memtrace_peak_hunk, hunk_size);
+}
+
+/*
+===================
+Memory_TraceStart
+===================
+*/
+static void Memory_TraceStart (void)
+{
+	if (memtrace_sites)
+		return;
+
+	memtrace_sites = (memtrace_site_t *) Q_calloc (MEMTRACE_MAXSITES, sizeof(memtrace_site_t));
+	memtrace_tags = (memtrace_tag_t *) Q_calloc (MEMTRACE_MAXTAGS, sizeof(memtrace_tag_t));
+	memtrace_droppedsites = 0;
+	memtrace_peak_low = hunk_low_used;
+	memtrace_peak_high = hunk_high_used;
+	memtrace_peak_hunk = hunk_low_used + hunk_high_used;
+	memtrace_peak_zone = zone_used;
+	memtrace_peak_cache = cache_used;
+}
+
+/*
+===================
+Memory_Trace_f
+
+memtrace [on|off|report]
+===================
+*/
+void Memory_Trace_f (void)
+{
+	char	*arg;
+
+	arg = Cmd_Argv (1);
+
+	if (!strcmp (arg, "on"))
+		Memory_TraceStart ();
+	else if (!strcmp (arg, "off"))
+	{
+		if (memtrace_sites)
+		{
+			free (memtrace_sites);
+			free (memtrace_tags);
+			memtrace_sites = NULL;
+			memtrace_tags = NULL;
+		}
+	}
+	else if (!strcmp (arg, "report"))
+	{
+		if (!memtrace_sites)
+			Con_Printf ("memory tracing is off\n");
+		else
+			Memory_TraceReport (sv.active ? sv.name : "none");
+	}
+	else
+	{
+		Con_Printf ("usage: memtrace [on|off|report]\n");
+		Con_Printf ("memory tracing is %s\n", memtrace_sites ? "on" : "off");
+	}
 }
 
 //============================================================================
@@ -1343,6 +1949,8 @@ void Memory_InitZone (memzone_t *zone, int size)
 	zone->blocklist.size = 0;
 	zone->rover = block;
 
+	zone->size = size;
+
 	block->prev = block->next = &zone->blocklist;
 	block->tag = 0;			// free block
 	block->id = ZONEID;
@@ -1373,9 +1981,13 @@ void Memory_Init (void *buf, int size)
 		else
 			Sys_Error ("you must specify a size in KB after -zone");
 	}
+	if (COM_CheckParm ("-memtrace"))
+		Memory_TraceStart ();
+
 	mainzone = (memzone_t *) Hunk_AllocName (zonesize, "zone" );
 	Memory_InitZone (mainzone, zonesize);
 
 	Cmd_AddCommand ("hunk_print", Hunk_Print_f); //johnfitz
+	Cmd_AddCommand ("memtrace", Memory_Trace_f);
 }
 
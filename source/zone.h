@@ -135,6 +135,29 @@ void *Cache_Alloc (cache_user_t *c, int size, char *name);
 
 void Cache_Report (void);
 
+//
+// allocation tracing, enabled with -memtrace or the memtrace command.
+// every hunk, zone and cache allocation is recorded against the file and
+// line that made it, and Memory_TraceReport writes a json budget report
+// with per-tag high-water marks that persist across map loads.
+//
+extern const char	*mem_trace_file;
+extern int			mem_trace_line;
+
+void Memory_TraceReport (char *mapname);
+
+#ifndef ZONE_INTERNAL
+#define Z_Malloc(size)						(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Z_Malloc (size))
+#define Z_Realloc(ptr, size)				(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Z_Realloc (ptr, size))
+#define Z_Strdup(s)							(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Z_Strdup (s))
+#define Hunk_Alloc(size)					(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Hunk_Alloc (size))
+#define Hunk_AllocName(size, name)			(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Hunk_AllocName (size, name))
+#define Hunk_HighAllocName(size, name)		(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Hunk_HighAllocName (size, name))
+#define Hunk_Strdup(s, name)				(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Hunk_Strdup (s, name))
+#define Hunk_TempAlloc(size)				(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Hunk_TempAlloc (size))
+#define Cache_Alloc(c, size, name)			(mem_trace_file = __FILE__, mem_trace_line = __LINE__, Cache_Alloc (c, size, name))
+#endif // ZONE_INTERNAL
+
 #ifdef PSP_VFPU
 void* memcpy_vfpu(void* dst, void* src, unsigned int size);
 #endif // PSP_VFPU
@@ -0,0 +1,99 @@
+#!/bin/bash
+#
+# Nazi Zombies: Portable
+# Linux test code init
+# ----
+# Prepares a testing environment targeting
+# the headless Linux build.
+#
+# This is intended to be used via a Docker
+# container running ubuntu:24.04.
+#
+set -o errexit
+
+source "nzp_utility.sh"
+
+# Read by our test scripts.
+NZP_BIN="/working/nzportable/nzportable"
+
+# How many seconds to wait before time out
+TIMEOUT=90
+
+testing_dir_path=""
+
+# tzdata will try to display an interactive install prompt by
+# default, so make sure we define our system as non-interactive.
+export DEBIAN_FRONTEND=noninteractive DEBCONF_NONINTERACTIVE_SEEN=true
+
+function install_dependencies
+{
+    # Nothing to do when the toolchain is already there.
+    if command -v make > /dev/null && command -v gcc > /dev/null; then
+        return
+    fi
+
+    print_info "Installing dependancies.."
+    apt update -y
+    apt install build-essential wget zip unzip -y
+}
+
+#
+# obtain_content
+# ---
+# Game content comes from NZP_CONTENT (a directory
+# holding nzp/) when set, otherwise from the latest
+# release.
+#
+function obtain_content
+{
+    mkdir -p /working/nzportable
+
+    if [[ -n "${NZP_CONTENT}" ]]; then
+        print_info "Copying game content from [${NZP_CONTENT}].."
+        cp -R "${NZP_CONTENT}/nzp" /working/nzportable/
+        return
+    fi
+
+    print_info "Obtaining latest Nazi Zombies: Portable release content.."
+    sleep 0.5
+    cd /working
+    wget https://github.com/nzp-team/nzportable/releases/download/nightly/nzportable-psp.zip
+    unzip -o nzportable-psp.zip
+}
+
+function build_nzportable
+{
+    print_info "Building headless Linux binary.."
+    local command="make -f Makefile.linux -j$(nproc)"
+    cd "${testing_dir_path}/.."
+    echo "[${command}]"
+    ${command}
+    cp build/linux/bin/nzportable "${NZP_BIN}"
+}
+
+function begin_setup()
+{
+    testing_dir_path="${1}"
+
+    # Create our working directory.
+    rm -rf /working
+    mkdir -p /working
+    cd /working
+
+    install_dependencies;
+    obtain_content;
+    build_nzportable;
+
+    print_info "Done setting up for Linux testing!"
+}
+
+#
+# run_nzportable
+# ---
+# Returns command used to run the game,
+# extra arguments are passed along.
+#
+function run_nzportable()
+{
+    echo "timeout ${TIMEOUT} ${NZP_BIN} -basedir /working/nzportable $@"
+}
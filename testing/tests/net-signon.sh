@@ -0,0 +1,120 @@
+#!/bin/bash
+#
+# Nazi Zombies: Portable
+# net-signon tests
+# ----
+# Connects a client to a dedicated server over
+# loopback UDP with a simulated 100ms round trip
+# and packet loss (-netsim), with windowed reliable
+# messages and with stop-and-wait, and verifies the
+# windowed signon is the faster one.
+#
+# Needs the headless Linux build, intended to be
+# used via a Docker container running ubuntu:24.04
+#
+set -o errexit
+
+PLATFORM="$1"
+CONTENT_DIR="$2"
+MODE="$3"
+
+source "setup/${PLATFORM}.sh"
+
+# Each end holds its packets 50ms and drops a seeded 5% of them.
+NETSIM="net_simlatency 50; net_simloss 5; net_simseed 1"
+
+# Signons timed for each mode, the median is compared.
+RUNS="3"
+
+# Seconds each client gets to connect and sign on.
+CLIENT_TIME="15"
+
+#
+# time_signon
+# ---
+# Connects once with the given net_window and
+# prints how long the signon took. Commands go
+# in on stdin, the headless console. Once in game
+# quit only opens the menu, so the client drops
+# its server slot and is left to time out. The
+# simulator is switched off first so the
+# disconnect isn't held in its queue.
+#
+function time_signon()
+{
+    local window="$1"
+    local TIMEOUT="${CLIENT_TIME}"
+    local command=$(run_nzportable "-netsim")
+
+    (echo "${NETSIM}; developer 1; net_window ${window}; connect 127.0.0.1"; sleep $(( CLIENT_TIME - 2 )); echo "net_simlatency 0; net_simloss 0; disconnect") \
+        | ${command} 2>&1 | grep "Signon completed in" | awk '{ print $4 }' || true
+}
+
+#
+# median
+# ---
+# Middle of the numbers given on stdin, or
+# nothing if there are none.
+#
+function median()
+{
+    sort -n | awk '{ v[NR] = $1 } END { if (NR) print v[int((NR + 1) / 2)] }'
+}
+
+#
+# run_netsignon_test
+# ---
+# Kicks off our net-signon test.
+#
+function run_netsignon_test()
+{
+    print_info "Beginning net-signon test.."
+
+    if [[ "${PLATFORM}" != "linux" ]]; then
+        echo "[SKIP]: net-signon needs the headless Linux build."
+        return 0
+    fi
+
+    local bsp=$(ls /working/nzportable/nzp/maps/*.bsp | head -n 1)
+    local pretty_bsp=$(basename ${bsp} .bsp)
+    local lifetime=$(( RUNS * 2 * CLIENT_TIME + 10 ))
+    local TIMEOUT=$(( lifetime + 5 ))
+    local server=$(run_nzportable "-dedicated 4 -netsim")
+
+    print_info "Starting dedicated server on map [${pretty_bsp}].."
+    echo "[${server}]"
+    (echo "${NETSIM}; map ${pretty_bsp}"; sleep ${lifetime}; echo "quit") \
+        | ${server} > /dev/null 2>&1 &
+    local server_pid="$!"
+    sleep 5
+
+    local windowed=""
+    local stopandwait=""
+    for run in $(seq ${RUNS}); do
+        windowed="${windowed} $(time_signon 1)"
+        stopandwait="${stopandwait} $(time_signon 0)"
+    done
+
+    wait ${server_pid} || true
+
+    echo "windowed signon (s):      ${windowed}"
+    echo "stop-and-wait signon (s): ${stopandwait}"
+
+    local windowed_median=$(echo ${windowed} | tr ' ' '\n' | median)
+    local stopandwait_median=$(echo ${stopandwait} | tr ' ' '\n' | median)
+
+    if [[ $(echo ${windowed} | wc -w) -ne "${RUNS}" ]] || [[ $(echo ${stopandwait} | wc -w) -ne "${RUNS}" ]]; then
+        echo "[ERROR]: FAILED to complete every signon!"
+        exit 1
+    fi
+
+    if awk "BEGIN { exit !(${windowed_median} < ${stopandwait_median}) }"; then
+        echo "[PASS]: Windowed signon took ${windowed_median}s, stop-and-wait ${stopandwait_median}s."
+        exit 0
+    else
+        echo "[ERROR]: Windowed signon took ${windowed_median}s, no faster than stop-and-wait ${stopandwait_median}s!"
+        exit 1
+    fi
+}
+
+run_netsignon_test;